@@ -0,0 +1,7 @@
+g++ -std=c++11 -O3 -march=native -fno-trapping-math -fopenmp ./src/bench_latency.cpp 	\
+			   ./src/tensor/*.cpp 	\
+			   ./src/utils/*.cpp 	\
+			   ./src/nn/*.cpp		\
+			   ./src/models/*.cpp	\
+			   ./src/data/*.cpp		\
+    -o ./bin/bench_latency.out
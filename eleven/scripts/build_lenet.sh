@@ -1,4 +1,4 @@
-g++ -std=c++11 ./src/train_lenet.cpp 	\
+g++ -std=c++11 -O3 -march=native -fno-trapping-math -fopenmp ./src/train_lenet.cpp 	\
 			   ./src/tensor/*.cpp 	\
 			   ./src/utils/*.cpp 	\
 			   ./src/nn/*.cpp		\
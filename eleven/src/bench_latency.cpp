@@ -0,0 +1,114 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "tensor/tensor.h"
+#include "expression/op.h"
+#include "nn/nn.h"
+#include "models/models.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+using namespace el;
+
+// Latency of scoring one request at a time: the graph forward with batch 1, the same with the weights
+// prepacked (prepare_inference), and the inference path of the model (models::LeNetInference,
+// models::TripleLinearInference). Every request is timed on its own, tail latency is what matters for
+// online scoring.
+index_t num_warmup = 100;
+index_t num_requests = 5000;
+
+// Microseconds of each call of run(i), i in [0, num_requests), after the warm-up calls.
+template<typename Func>
+vector<double> time_requests(const Func& run) {
+	for(index_t i = 0; i < num_warmup; i++)
+		run(i);
+	vector<double> latency(num_requests);
+	for(index_t i = 0; i < num_requests; i++) {
+		auto start = std::chrono::steady_clock::now();
+		run(i);
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+		latency[i] = elapsed.count();
+	}
+	return latency;
+}
+
+double percentile(vector<double> latency, double p) {
+	index_t k = std::min((index_t)latency.size() - 1, (index_t)(p * latency.size()));
+	std::nth_element(latency.begin(), latency.begin() + k, latency.end());
+	return latency[k];
+}
+
+void report(const string& model, const string& path, const vector<double>& latency) {
+	cout << std::left << std::setw(14) << model << std::setw(11) << path << std::right << std::fixed
+		 << std::setprecision(1) << std::setw(10) << percentile(latency, 0.5)
+		 << std::setw(10) << percentile(latency, 0.99)
+		 << std::setw(10) << *std::max_element(latency.begin(), latency.end()) << endl;
+}
+
+// Requests cycle through a few random inputs, so they aren't all the same cached values.
+vector<el::float_t> random_inputs(index_t num, index_t size) {
+	vector<el::float_t> inputs(num * size);
+	for(auto& v: inputs)
+		v = std::rand() / (el::float_t)RAND_MAX;
+	return inputs;
+}
+
+// Largest difference of the logits of both paths, over all inputs.
+template<typename Graph, typename Fast>
+el::float_t max_diff(index_t num, const Graph& graph, const Fast& fast) {
+	el::float_t diff = 0;
+	for(index_t i = 0; i < num; i++) {
+		auto output = graph(i);
+		const el::float_t* logits = fast(i);
+		for(index_t j = 0; j < 10; j++)
+			diff = std::max(diff, std::fabs(output.get_tensor().eval(j) - logits[j]));
+	}
+	return diff;
+}
+
+int main() {
+	const index_t num_inputs = 16;
+	cout << "threads: " << num_threads() << ", requests: " << num_requests << endl;
+	cout << std::left << std::setw(14) << "model" << std::setw(11) << "path" << std::right
+		 << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << endl;
+
+	{
+		models::LeNet net(true);
+		models::LeNetInference fast(net);
+		auto inputs = random_inputs(num_inputs, 28 * 28);
+		auto graph = [&](index_t i) {
+			Tensor<el::float_t> image(inputs.data() + i % num_inputs * 28 * 28, {1, 1, 28, 28});
+			return net.forward(op::node(image));
+		};
+		auto infer = [&](index_t i) {return fast.forward(inputs.data() + i % num_inputs * 28 * 28);};
+		report("LeNet", "graph", time_requests(graph));
+		net.prepare_inference();
+		report("LeNet", "prepacked", time_requests(graph));
+		report("LeNet", "batch-1", time_requests(infer));
+		cout << "  max |graph - batch-1|: " << std::scientific << max_diff(num_inputs, graph, infer) << endl;
+	}
+	{
+		models::TripleLinear net(true);
+		models::TripleLinearInference fast(net);
+		auto inputs = random_inputs(num_inputs, 784);
+		auto graph = [&](index_t i) {
+			Tensor<el::float_t> input(inputs.data() + i % num_inputs * 784, {1, 784});
+			return net.forward(op::node(input));
+		};
+		auto infer = [&](index_t i) {return fast.forward(inputs.data() + i % num_inputs * 784);};
+		report("TripleLinear", "graph", time_requests(graph));
+		net.prepare_inference();
+		report("TripleLinear", "prepacked", time_requests(graph));
+		report("TripleLinear", "batch-1", time_requests(infer));
+		cout << "  max |graph - batch-1|: " << std::scientific << max_diff(num_inputs, graph, infer) << endl;
+	}
+	return 0;
+}
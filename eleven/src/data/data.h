@@ -7,6 +7,8 @@
 #include <memory>
 
 #include "../utils/base.h"
+#include "idx.h"
+#include "data_loader.h"
 
 
 namespace el {
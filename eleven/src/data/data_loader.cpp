@@ -0,0 +1,128 @@
+#include <ctime>
+#include <numeric>
+#include <algorithm>
+#include "data_loader.h"
+
+
+namespace el {
+namespace data {
+
+DataLoader::DataLoader(const IdxFile& data, const IdxFile& target, index_t batch_size, bool shuffle,
+					   index_t num_workers, float_t scale)
+	: data_(data), target_(target), batch_size_(batch_size),
+	  num_batches_((data.num() + batch_size - 1) / std::max(batch_size, (index_t)1)),
+	  shuffle_(shuffle), scale_(scale), engine_(std::time(0)),
+	  released_(0), job_(0), consumed_(0), stop_(false) {
+	CHECK_TRUE(batch_size > 0, IndexOutOfRange, "Batch size should be positive, but got %d", batch_size);
+	CHECK_TRUE(num_workers >= 0, IndexOutOfRange,
+		"Number of workers can't be negative, but got %d", num_workers);
+	CHECK_EQUAL(target.dim(), 1, DimNotMatch, "Targets should be 1D, but got %dD", target.dim());
+	CHECK_EQUAL(target.num(), data.num(), DsizeNotMatch,
+		"There are %d samples, but %d targets", data.num(), target.num());
+	CHECK_TRUE(data.num() > 0, DsizeNotMatch, "There are no samples to load");
+	for(index_t i = 0; i < num_workers + 2; i++)
+		slots_.emplace_back(new Slot(batch_size * data.sample_size(), batch_size));
+	for(index_t i = 0; i < num_workers; i++)
+		workers_.emplace_back(&DataLoader::work, this);
+}
+
+DataLoader::~DataLoader() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	slot_free_.notify_all();
+	for(auto& worker: workers_)
+		worker.join();
+}
+
+index_t DataLoader::batch_samples(index_t batch) const {
+	index_t pos = batch % num_batches_;
+	return std::min(batch_size_, data_.num() - pos * batch_size_);
+}
+
+// Called with mutex_ held. Epochs the caller has gone past are dropped, workers building their last
+// batches keep the order alive by themselves.
+DataLoader::Order DataLoader::order(index_t epoch) {
+	auto it = orders_.find(epoch);
+	if(it != orders_.end()) return it->second;
+	orders_.erase(orders_.begin(), orders_.lower_bound(released_ / num_batches_));
+	std::shared_ptr<std::vector<index_t>> ids(new std::vector<index_t>(data_.num()));
+	std::iota(ids->begin(), ids->end(), 0);
+	if(shuffle_)
+		std::shuffle(ids->begin(), ids->end(), engine_);
+	orders_[epoch] = ids;
+	return ids;
+}
+
+// Converts the samples one by one in this thread. Workers already run side by side, and running
+// OpenMP teams in each of them too would just fight the training for the cores.
+void DataLoader::build(index_t batch, const Order& order) {
+	Slot& slot = *slots_[batch % slots_.size()];
+	const index_t* ids = order->data() + (batch % num_batches_) * batch_size_;
+	index_t n = batch_samples(batch), sample_size = data_.sample_size();
+	index_t data_width = idx_type_size(data_.type()), target_width = idx_type_size(target_.type());
+	for(index_t i = 0; i < n; i++) {
+		convert_idx(data_.type(), data_.data() + (std::size_t)ids[i] * sample_size * data_width, sample_size,
+					slot.data.data() + (std::size_t)i * sample_size, scale_);
+		convert_idx(target_.type(), target_.data() + (std::size_t)ids[i] * target_width, 1,
+					slot.target.data() + i, (int_t)1);
+	}
+}
+
+void DataLoader::work(void) {
+	index_t num_slots = slots_.size();
+	while(true) {
+		index_t batch;
+		Order batch_order;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			slot_free_.wait(lock, [this, num_slots] {return stop_ || job_ < released_ + num_slots;});
+			if(stop_) return;
+			batch = job_++;
+			batch_order = order(batch / num_batches_);
+		}
+		build(batch, batch_order);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			slots_[batch % num_slots]->ready = batch;
+		}
+		slot_ready_.notify_all();
+	}
+}
+
+Batch DataLoader::next(void) {
+	index_t num_slots = slots_.size();
+	index_t batch;
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		// The batch handed out last time goes back to the workers, and will be overwritten.
+		if(consumed_ > 0) {
+			Slot& last = *slots_[(consumed_ - 1) % num_slots];
+			last.data.version_forward();
+			last.target.version_forward();
+		}
+		released_ = consumed_;
+		batch = consumed_++;
+		if(workers_.empty()) {
+			job_ = consumed_;
+			Order batch_order = order(batch / num_batches_);
+			lock.unlock();
+			build(batch, batch_order);
+			lock.lock();
+			slots_[batch % num_slots]->ready = batch;
+		}
+		slot_free_.notify_all();
+		Slot& slot = *slots_[batch % num_slots];
+		slot_ready_.wait(lock, [&slot, batch] {return slot.ready == batch;});
+	}
+
+	Slot& slot = *slots_[batch % num_slots];
+	index_t n = batch_samples(batch);
+	Shape shape(data_.shape());
+	shape[0] = n;
+	return Batch{Tensor<float_t>(slot.data, shape), Tensor<int_t>(slot.target, {n})};
+}
+
+}  // namespace data
+}  // namespace el
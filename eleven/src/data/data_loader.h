@@ -0,0 +1,85 @@
+#ifndef DATA_DATA_LOADER_H_
+#define DATA_DATA_LOADER_H_
+
+#include <vector>
+#include <memory>
+#include <map>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "../utils/base.h"
+#include "../tensor/tensor.h"
+#include "idx.h"
+
+
+namespace el {
+namespace data {
+
+// One batch, data of shape (n,) + the sample shape and the targets, (n).
+struct Batch {
+	Tensor<float_t> data;
+	Tensor<int_t> target;
+};
+
+// Batches of samples from data and their targets, over and over, one epoch after another. Each epoch
+// takes the samples in a new random order if shuffle, or in file order, and its last batch may be short.
+//
+// num_workers threads build the upcoming batches straight from the mapped files into a ring of
+// num_workers + 2 preallocated buffers, while the caller trains on the current one. next() hands out
+// the buffer itself, without copying, so a batch is only valid until the following call of next(),
+// when its buffer goes back to the workers and its values get overwritten by a later batch. Nothing
+// checks for that: a graph kept across next() computes its gradients from whatever is in the buffer
+// by then. Copy a batch that has to outlive the step. Its version is bumped when it's given back, for
+// caches which compare versions. With no workers, next() builds the batch itself.
+class DataLoader {
+public:
+	DataLoader(const IdxFile& data, const IdxFile& target, index_t batch_size, bool shuffle=true,
+			   index_t num_workers=1, float_t scale=1 / 255.);
+	~DataLoader();
+
+	index_t batch_size(void) const {return batch_size_;}
+	// number of batches in one epoch
+	index_t num_batches(void) const {return num_batches_;}
+	index_t num_samples(void) const {return data_.num();}
+	Batch next(void);
+
+	DataLoader(const DataLoader& other) = delete;
+	DataLoader& operator=(const DataLoader& other) = delete;
+private:
+	struct Slot {
+		Storage<float_t> data;
+		Storage<int_t> target;
+		index_t ready;  // the batch in the buffer, -1 if none yet
+		Slot(index_t data_size, index_t target_size): data(data_size), target(target_size), ready(-1) {}
+	};
+	using Order = std::shared_ptr<const std::vector<index_t>>;
+
+	IdxFile data_, target_;
+	index_t batch_size_, num_batches_;
+	bool shuffle_;
+	float_t scale_;
+	std::default_random_engine engine_;
+	std::vector<std::unique_ptr<Slot>> slots_;
+	std::vector<std::thread> workers_;
+
+	// Batches are numbered through all epochs. Batches before released_ are done with, the ones from
+	// job_ on aren't started, and batch j may be built once j < released_ + number of slots.
+	std::mutex mutex_;
+	std::condition_variable slot_free_, slot_ready_;
+	index_t released_, job_, consumed_;
+	bool stop_;
+	std::map<index_t, Order> orders_;  // order of the samples in each epoch still in use
+
+	index_t batch_samples(index_t batch) const;
+	Order order(index_t epoch);
+	void build(index_t batch, const Order& order);
+	void work(void);
+};
+
+}  // namespace data
+}  // namespace el
+
+
+#endif
@@ -0,0 +1,139 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "idx.h"
+
+
+namespace el {
+namespace data {
+
+index_t idx_type_size(IdxType type) {
+	switch(type) {
+	case IdxType::UInt8:
+	case IdxType::Int8: return 1;
+	case IdxType::Int16: return 2;
+	case IdxType::Int32:
+	case IdxType::Float32: return 4;
+	case IdxType::Float64: return 8;
+	}
+	return 0;
+}
+
+struct IdxMapping {
+	std::shared_ptr<const void> handle;
+	const std::uint8_t* bytes;
+	std::size_t size;
+};
+
+namespace {
+
+// Map the whole file read-only. An empty file can't be mapped, and is left to the header check.
+IdxMapping map_file(const std::string& filename) {
+	IdxMapping mapping{nullptr, nullptr, 0};
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		THROW_ERROR(FileReadFailure, "Can't open %.150s.", filename.c_str());
+	LARGE_INTEGER size;
+	GetFileSizeEx(file, &size);
+	mapping.size = size.QuadPart;
+	if(mapping.size == 0) {
+		CloseHandle(file);
+		return mapping;
+	}
+	HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if(map == nullptr)
+		THROW_ERROR(FileReadFailure, "Can't map %.150s.", filename.c_str());
+	void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(map);
+	if(view == nullptr)
+		THROW_ERROR(FileReadFailure, "Can't map %.150s.", filename.c_str());
+	mapping.handle.reset(view, [](const void* p) {UnmapViewOfFile(p);});
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		THROW_ERROR(FileReadFailure, "Can't open %.150s.", filename.c_str());
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		THROW_ERROR(FileReadFailure, "Can't stat %.150s.", filename.c_str());
+	}
+	mapping.size = st.st_size;
+	if(mapping.size == 0) {
+		close(fd);
+		return mapping;
+	}
+	void* view = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(view == MAP_FAILED)
+		THROW_ERROR(FileReadFailure, "Can't map %.150s.", filename.c_str());
+	// Samples are mostly read front to back, so let the kernel read ahead.
+	madvise(view, mapping.size, MADV_SEQUENTIAL);
+	std::size_t size = mapping.size;
+	mapping.handle.reset(view, [size](const void* p) {munmap(const_cast<void*>(p), size);});
+#endif
+	mapping.bytes = static_cast<const std::uint8_t*>(mapping.handle.get());
+	return mapping;
+}
+
+std::uint32_t read_big_endian(const std::uint8_t* b) {
+	return (std::uint32_t)b[0] << 24 | (std::uint32_t)b[1] << 16 | (std::uint32_t)b[2] << 8 | b[3];
+}
+
+// The magic number is two zero bytes, the type and the rank, followed by the rank sizes.
+IdxType read_type(const IdxMapping& mapping, const std::string& filename) {
+	CHECK_TRUE(mapping.size >= 4, FileReadFailure,
+		"%.150s has %d bytes, too short for an IDX header.", filename.c_str(), (index_t)mapping.size);
+	const std::uint8_t* b = mapping.bytes;
+	CHECK_TRUE(b[0] == 0 && b[1] == 0, FileReadFailure,
+		"%.150s isn't an IDX file, its magic number is 0x%08x.", filename.c_str(), read_big_endian(b));
+	IdxType type = static_cast<IdxType>(b[2]);
+	CHECK_TRUE(idx_type_size(type) != 0, FileReadFailure,
+		"%.150s has an unknown IDX type 0x%02x.", filename.c_str(), b[2]);
+	CHECK_TRUE(b[3] > 0, FileReadFailure, "%.150s has rank 0, there are no samples.", filename.c_str());
+	return type;
+}
+
+Shape read_shape(const IdxMapping& mapping, const std::string& filename) {
+	index_t rank = mapping.bytes[3];
+	CHECK_TRUE(mapping.size >= 4 + 4 * (std::size_t)rank, FileReadFailure,
+		"%.150s is truncated, it ends in the sizes of its %d dimensions.", filename.c_str(), rank);
+	index_t dims[256];
+	long long dsize = 1;
+	for(index_t i = 0; i < rank; i++) {
+		std::uint32_t d = read_big_endian(mapping.bytes + 4 + 4 * i);
+		CHECK_TRUE(d <= (std::uint32_t)INDEX_MAX, FileReadFailure,
+			"%.150s has a size %u on dimension %d, which is too large.", filename.c_str(), d, i);
+		dims[i] = d;
+		dsize *= d;
+		CHECK_TRUE(dsize <= INDEX_MAX, FileReadFailure,
+			"%.150s has more than %d values.", filename.c_str(), INDEX_MAX);
+	}
+	return Shape(dims, rank);
+}
+
+}  // namespace
+
+IdxFile::IdxFile(const std::string& filename)
+	: IdxFile(map_file(filename), filename) {}
+
+IdxFile::IdxFile(const IdxMapping& mapping, const std::string& filename)
+	: filename_(filename), mapping_(mapping.handle), type_(read_type(mapping, filename)),
+	  shape_(read_shape(mapping, filename)), sample_size_(shape_.subsize(1)) {
+	std::size_t header = 4 + 4 * shape_.dim();
+	data_ = mapping.bytes + header;
+	std::size_t payload = (std::size_t)shape_.dsize() * idx_type_size(type_);
+	CHECK_TRUE(mapping.size - header >= payload, FileReadFailure,
+		"%.150s is truncated, its shape needs %llu bytes of data, but there are %llu.",
+		filename.c_str(), (unsigned long long)payload, (unsigned long long)(mapping.size - header));
+}
+
+}  // namespace data
+}  // namespace el
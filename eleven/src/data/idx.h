@@ -0,0 +1,166 @@
+#ifndef DATA_IDX_H_
+#define DATA_IDX_H_
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+
+#include "../utils/base.h"
+#include "../utils/parallel.h"
+#include "../tensor/tensor.h"
+
+
+namespace el {
+namespace data {
+
+// Type of the values in an IDX file, the third byte of its magic number.
+enum class IdxType: unsigned char {
+	UInt8 = 0x08,
+	Int8 = 0x09,
+	Int16 = 0x0B,
+	Int32 = 0x0C,
+	Float32 = 0x0D,
+	Float64 = 0x0E
+};
+
+index_t idx_type_size(IdxType type);
+
+struct IdxMapping;
+
+// An IDX file (the MNIST format) mapped into memory read-only. The header is parsed and checked
+// against the file size when it's opened, and the payload is never copied: data() points right into
+// the mapping, big-endian as on disk. Pages are read by the OS when they're first touched, so opening
+// is cheap and reading is bound by the disk, not by stream calls.
+// Copies and tensor()s share the mapping, which is unmapped when the last of them goes away.
+class IdxFile {
+public:
+	explicit IdxFile(const std::string& filename);
+
+	IdxType type(void) const {return type_;}
+	index_t dim(void) const {return shape_.dim();}
+	index_t size(index_t idx) const {return shape_[idx];}
+	const Shape& shape(void) const {return shape_;}
+	// number of samples, the size of dimension 0
+	index_t num(void) const {return shape_[0];}
+	// number of values in one sample
+	index_t sample_size(void) const {return sample_size_;}
+	const std::uint8_t* data(void) const {return data_;}
+	const std::uint8_t* sample(index_t idx) const;
+	// The payload of a uint8 file as a tensor of shape(), borrowing the mapping, which stays alive with
+	// it. Its storage is read-only, like the pages: reading works as with any tensor, writing throws
+	// TensorReadOnly. Copy it into a tensor of its own to change the values.
+	Tensor<std::uint8_t> tensor(void) const;
+	// The mapping, a handle which keeps data() valid as long as it's held.
+	const std::shared_ptr<const void>& mapping(void) const {return mapping_;}
+
+	// out[i] = scale * value i of samples [begin, begin + count), converted from any IDX type.
+	template<typename Dtype>
+	void convert(index_t begin, index_t count, Dtype* out, Dtype scale=1) const;
+	// The same for samples ids[0..n), out gets them one after another.
+	template<typename Dtype>
+	void gather(const index_t* ids, index_t n, Dtype* out, Dtype scale=1) const;
+private:
+	IdxFile(const IdxMapping& mapping, const std::string& filename);
+
+	std::string filename_;
+	std::shared_ptr<const void> mapping_;
+	const std::uint8_t* data_;
+	IdxType type_;
+	Shape shape_;
+	index_t sample_size_;
+};
+
+// out[i] = scale * src[i] for n big-endian values of type. Bytes are swapped by shifts, which the
+// compiler turns into vector shuffles, and uint8 (all MNIST is) is one widening multiply.
+template<typename Dtype>
+void convert_idx(IdxType type, const std::uint8_t* src, index_t n, Dtype* out, Dtype scale) {
+	switch(type) {
+	case IdxType::UInt8:
+		#pragma omp simd
+		for(index_t i = 0; i < n; i++)
+			out[i] = scale * (Dtype)src[i];
+		break;
+	case IdxType::Int8:
+		#pragma omp simd
+		for(index_t i = 0; i < n; i++)
+			out[i] = scale * (Dtype)(std::int8_t)src[i];
+		break;
+	case IdxType::Int16:
+		#pragma omp simd
+		for(index_t i = 0; i < n; i++)
+			out[i] = scale * (Dtype)(std::int16_t)((src[2*i] << 8) | src[2*i + 1]);
+		break;
+	case IdxType::Int32:
+		#pragma omp simd
+		for(index_t i = 0; i < n; i++) {
+			const std::uint8_t* b = src + 4*i;
+			std::uint32_t u = (std::uint32_t)b[0] << 24 | (std::uint32_t)b[1] << 16 | (std::uint32_t)b[2] << 8 | b[3];
+			out[i] = scale * (Dtype)(std::int32_t)u;
+		}
+		break;
+	case IdxType::Float32:
+		for(index_t i = 0; i < n; i++) {
+			const std::uint8_t* b = src + 4*i;
+			std::uint32_t u = (std::uint32_t)b[0] << 24 | (std::uint32_t)b[1] << 16 | (std::uint32_t)b[2] << 8 | b[3];
+			float f;
+			std::memcpy(&f, &u, sizeof(f));
+			out[i] = scale * (Dtype)f;
+		}
+		break;
+	case IdxType::Float64:
+		for(index_t i = 0; i < n; i++) {
+			std::uint64_t u = 0;
+			for(index_t j = 0; j < 8; j++)
+				u = u << 8 | src[8*i + j];
+			double f;
+			std::memcpy(&f, &u, sizeof(f));
+			out[i] = scale * (Dtype)f;
+		}
+		break;
+	}
+}
+
+inline const std::uint8_t* IdxFile::sample(index_t idx) const {
+	CHECK_BETWEEN(idx, 0, num(), IndexOutOfRange,
+		"%.150s has %d samples, but got index %d", filename_.c_str(), num(), idx);
+	return data_ + (std::size_t)idx * sample_size_ * idx_type_size(type_);
+}
+
+inline Tensor<std::uint8_t> IdxFile::tensor(void) const {
+	CHECK_TRUE(type_ == IdxType::UInt8, FileReadFailure,
+		"%.150s holds values of IDX type 0x%02x, not uint8.", filename_.c_str(), (unsigned)type_);
+	return Tensor<std::uint8_t>(Storage<std::uint8_t>(data_, mapping_), shape_);
+}
+
+template<typename Dtype>
+void IdxFile::convert(index_t begin, index_t count, Dtype* out, Dtype scale) const {
+	CHECK_TRUE(begin >= 0 && count >= 0 && begin + count <= num(), IndexOutOfRange,
+		"%.150s has %d samples, but got [%d, %d)", filename_.c_str(), num(), begin, begin + count);
+	if(count == 0) return;
+	const std::uint8_t* src = sample(begin);
+	index_t width = idx_type_size(type_);
+	index_t n = count * sample_size_;
+	parallel_for(0, n, 1 << 16, [&](index_t b, index_t e) {
+		convert_idx(type_, src + (std::size_t)b * width, e - b, out + b, scale);
+	});
+}
+
+template<typename Dtype>
+void IdxFile::gather(const index_t* ids, index_t n, Dtype* out, Dtype scale) const {
+	for(index_t i = 0; i < n; i++)
+		CHECK_BETWEEN(ids[i], 0, num(), IndexOutOfRange,
+			"%.150s has %d samples, but got index %d", filename_.c_str(), num(), ids[i]);
+	std::size_t stride = (std::size_t)sample_size_ * idx_type_size(type_);
+	parallel_for(0, n, std::max((index_t)1, (1 << 14) / std::max(sample_size_, (index_t)1)),
+				 [&](index_t b, index_t e) {
+		for(index_t i = b; i < e; i++)
+			convert_idx(type_, data_ + ids[i] * stride, sample_size_, out + (std::size_t)i * sample_size_, scale);
+	});
+}
+
+}  // namespace data
+}  // namespace el
+
+
+#endif
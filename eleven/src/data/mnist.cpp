@@ -3,36 +3,19 @@
 namespace el {
 namespace data {
 
-int ReverseInt(int i) {
-	unsigned char ch1, ch2, ch3, ch4;
-	ch1 = i & 255;
-	ch2 = (i >> 8) & 255;
-	ch3 = (i >> 16) & 255;
-	ch4 = (i >> 24) & 255;
-	return((int)ch1 << 24) + ((int)ch2 << 16) + ((int)ch3 << 8) + ch4;
-}
-
+// Both are read through the mapped IdxFile, and converted in parallel in one pass.
 std::shared_ptr<int_t> read_mnist_labels(std::string filename) {
 	using namespace std;
 
-	ifstream file(filename, ios::binary);
-	if(!file.is_open())
-		THROW_ERROR(NotImplementError, "MNIST labels file can't open.");
-	int magic_number, num_images;
-	file.read((char*)&magic_number, sizeof(magic_number));
-	file.read((char*)&num_images, sizeof(num_images));
-	magic_number = ReverseInt(magic_number);
-	num_images = ReverseInt(num_images);
+	IdxFile file(filename);
+	CHECK_TRUE(file.type() == IdxType::UInt8 && file.dim() == 1, FileReadFailure,
+		"%.150s isn't a MNIST labels file.", filename.c_str());
+	index_t num_images = file.num();
 
 	shared_ptr<index_t> labels_ptr(new int_t[num_images], 
 								   std::default_delete<int_t[]>());
-	auto labels = labels_ptr.get();
-	for(index_t i = 0; i < num_images; i++) {
-		unsigned char buffer;
-		file.read((char*)&buffer, sizeof(buffer));
-		labels[i] = buffer;
-	}
-	cout << "magic_number = " << magic_number << endl;
+	file.convert(0, num_images, labels_ptr.get());
+	cout << "magic_number = " << 0x800 + file.dim() << endl;
 	cout << "number of images = " << num_images << endl;
 	return labels_ptr;
 }
@@ -40,29 +23,15 @@ std::shared_ptr<int_t> read_mnist_labels(std::string filename) {
 std::shared_ptr<float_t> read_mnist_images(std::string filename) {
 	using namespace std;
 
-	ifstream file(filename, ios::binary);
-	if(!file.is_open())
-		THROW_ERROR(NotImplementError, "MNIST images file can't open.");
-	int magic_number, num_images, num_rows, num_cols;
-	file.read((char*)&magic_number, sizeof(magic_number));
-	file.read((char*)&num_images, sizeof(num_images));
-	file.read((char*)&num_rows, sizeof(num_rows));
-	file.read((char*)&num_cols, sizeof(num_cols));
-	magic_number = ReverseInt(magic_number);
-	num_images = ReverseInt(num_images);
-	num_rows = ReverseInt(num_rows);
-	num_cols = ReverseInt(num_cols);
+	IdxFile file(filename);
+	CHECK_TRUE(file.type() == IdxType::UInt8 && file.dim() == 3, FileReadFailure,
+		"%.150s isn't a MNIST images file.", filename.c_str());
+	index_t num_images = file.num(), num_rows = file.size(1), num_cols = file.size(2);
 
-	index_t num_pixels = num_images * num_rows * num_cols;
-	shared_ptr<float_t> images_ptr(new float_t[num_pixels], 
+	shared_ptr<float_t> images_ptr(new float_t[file.shape().dsize()], 
 								   std::default_delete<float_t[]>());
-	auto images = images_ptr.get();
-	for(index_t i = 0; i < num_pixels; i++) {
-		unsigned char buffer;
-		file.read((char*)&buffer, sizeof(buffer));
-		images[i] = (float_t)buffer / 255.;
-	}
-	cout << "magic_number = " << magic_number << endl;
+	file.convert(0, num_images, images_ptr.get(), 1 / 255.);
+	cout << "magic_number = " << 0x800 + file.dim() << endl;
 	cout << "number of images = " << num_images << endl;
 	cout << "size of images = (" << num_rows << ", "; 
 	cout << num_cols << ')' << endl;
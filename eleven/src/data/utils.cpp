@@ -1,6 +1,7 @@
 #include <ctime>
 #include <random>
 #include "data.h"
+#include "../expression/kernels/embedding.h"
 
 
 namespace el {
@@ -28,21 +29,12 @@ std::shared_ptr<index_t> shuffle_indice(index_t num) {
 void dup_images(const el::float_t* base_images, el::float_t* batch_images, 
 	 	        const index_t* ids, index_t batch_size, 
 	 	        index_t num_pixels) {
-	for(index_t i = 0; i < batch_size; i++) {
-		index_t sample_idx = ids[i];
-		const el::float_t* base_sample = base_images + sample_idx * num_pixels;
-		el::float_t* batch_sample = batch_images + i * num_pixels;
-		for(index_t j = 0; j < num_pixels; j++)
-			batch_sample[j] = base_sample[j];
-	}
+	kernel::gather_rows(batch_size, num_pixels, ids, base_images, batch_images);
 }
 
 void dup_labels(const el::int_t* base_labels, el::int_t* batch_labels, 
 	 	        const index_t* ids, index_t batch_size) {
-	for(index_t i = 0; i < batch_size; i++) {
-		index_t sample_idx = ids[i];
-		batch_labels[i] = base_labels[sample_idx];
-	}
+	kernel::gather_rows(batch_size, 1, ids, base_labels, batch_labels);
 }
 
 }  // namespace data
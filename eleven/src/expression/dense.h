@@ -0,0 +1,78 @@
+#ifndef EXPRESSION_DENSE_H_
+#define EXPRESSION_DENSE_H_
+
+#include <memory>
+#include "expression.h"
+#include "kernels/layout.h"
+
+namespace el {
+
+// Evaluate exp into out, in row-major order of exp's own shape. It's the same loop as
+// Tensor::set_self(), but writes to a plain buffer.
+template<typename Dtype>
+void eval_dense(const Exp<Dtype>& exp, Dtype* out) {
+	index_t num_dim = exp.dim();
+	index_t* loc = new index_t[num_dim];
+	index_t* shape = new index_t[num_dim];
+	index_t idx = 0, offset = 0;
+	for(index_t i = 0; i < num_dim; i++) {
+		loc[i] = -1;
+		shape[i] = exp.size(i);
+	}
+
+	while(idx >= 0) {
+		if(idx == num_dim) {
+			out[offset++] = exp.eval(loc);
+			idx--;
+		} else if(loc[idx] < shape[idx] - 1) {
+			loc[idx]++;
+			if(idx < num_dim - 1) loc[idx+1] = -1;
+			idx++;
+		} else idx--;
+	}
+	delete [] loc;
+	delete [] shape;
+}
+
+// Contiguous read-only access to the values of an expression. If the expression exposes its buffer
+// by data(), the buffer is used directly. Otherwise the expression is evaluated into a temporary one,
+// which lives as long as the Dense object (and its copies).
+//
+// With a layout other than NCHW, the values of a 4D expression are given in that layout. A buffer
+// already in that layout is used directly, any other one is converted.
+template<typename Dtype>
+class Dense {
+public:
+	explicit Dense(const Exp<Dtype>& exp, Layout layout=Layout::NCHW)
+		: ptr_(exp.layout() == layout ? exp.layout_data() : nullptr) {
+		if(ptr_ != nullptr) return;
+		const Dtype* src = exp.layout_data();
+		Layout from = exp.layout();
+		if(src == nullptr) {
+			index_t dsize = 1;
+			for(index_t i = 0; i < exp.dim(); i++)
+				dsize *= exp.size(i);
+			buffer_.reset(new Dtype[dsize], std::default_delete<Dtype[]>());
+			eval_dense(exp, buffer_.get());
+			ptr_ = buffer_.get();
+			if(layout == Layout::NCHW) return;
+			src = ptr_;
+			from = Layout::NCHW;
+		}
+		index_t batch = exp.size(0), channels = exp.size(1), plane = exp.size(2) * exp.size(3);
+		std::shared_ptr<Dtype> converted(new Dtype[layout_dsize(layout, batch, channels, plane)],
+										 std::default_delete<Dtype[]>());
+		kernel::convert_layout(from, layout, batch, channels, plane, src, converted.get());
+		buffer_ = converted;
+		ptr_ = buffer_.get();
+	}
+	const Dtype* data(void) const {return ptr_;}
+	const Dtype& operator[](index_t i) const {return ptr_[i];}
+private:
+	std::shared_ptr<Dtype> buffer_;
+	const Dtype* ptr_;
+};
+
+}  // namespace el
+
+#endif
@@ -5,6 +5,7 @@
 #include <memory>
 #include <initializer_list>
 #include "../utils/base.h"
+#include "../utils/layout.h"
 
 namespace el {
 template<typename Dtype> class ConstExptr;
@@ -22,6 +23,14 @@ public:
 	virtual index_t dim(void) const = 0;
 	virtual index_t size(index_t idx) const = 0;
 	virtual bool requires_grad(void) const = 0;
+	// Tensors and expressions evaluated eagerly hold their values in a contiguous buffer. They expose it 
+	// here, so kernels can read raw memory instead of calling eval() for every element.
+	virtual const Dtype* data(void) const {return nullptr;}
+	// 4D tensors and eager expressions may keep their values in another layout (see utils/layout.h),
+	// then data() is nullptr and layout_data() returns the buffer in that layout. eval() always takes
+	// NCHW indices whatever the layout is.
+	virtual Layout layout(void) const {return Layout::NCHW;}
+	virtual const Dtype* layout_data(void) const {return data();}
 	virtual ~Exp() {};
 	friend class ConstExptr<Dtype>;
 	friend class Node<Dtype>;
@@ -79,7 +88,7 @@ public:
 
 	virtual index_t dim(void) const {return this->roperand_->dim();}
 	virtual index_t size(index_t idx) const {return std::max(this->roperand_->size(idx), this->loperand_->size(idx));}
-	virtual bool requires_grad(void) const final {return loperand_.requires_grad() || roperand_.requires_grad();}
+	virtual bool requires_grad(void) const {return loperand_.requires_grad() || roperand_.requires_grad();}
 protected:
 	ConstExptr<Dtype> loperand_;
 	ConstExptr<Dtype> roperand_;
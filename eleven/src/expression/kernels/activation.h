@@ -0,0 +1,92 @@
+#ifndef EXPRESSION_KERNELS_ACTIVATION_H_
+#define EXPRESSION_KERNELS_ACTIVATION_H_
+
+#include "../../utils/base.h"
+#include "math.h"
+
+namespace el {
+namespace kernel {
+
+// Activations which can be fused into the epilogue of a GEMM or a convolution.
+enum class Activation {None, ReLU, Sigmoid, Tanh};
+
+// y = act(x) for n elements, in place is fine.
+template<typename Dtype>
+void activation_forward(Activation act, const Dtype* x, Dtype* y, index_t n) {
+	switch(act) {
+		case Activation::ReLU:
+			for(index_t i = 0; i < n; i++)
+				y[i] = x[i] > 0 ? x[i] : 0;
+			break;
+		case Activation::Sigmoid:
+			vsigmoid(x, y, n);
+			break;
+		case Activation::Tanh:
+			vtanh(x, y, n);
+			break;
+		default:
+			if(x != y)
+				for(index_t i = 0; i < n; i++)
+					y[i] = x[i];
+	}
+}
+
+// dx = dy * act'(x), where the derivative is computed from the output y = act(x). So a fused layer
+// only needs to keep its output for backward.
+template<typename Dtype>
+void activation_backward(Activation act, const Dtype* y, const Dtype* dy, Dtype* dx, index_t n) {
+	switch(act) {
+		case Activation::ReLU:
+			for(index_t i = 0; i < n; i++)
+				dx[i] = y[i] > 0 ? dy[i] : 0;
+			break;
+		case Activation::Sigmoid:
+			for(index_t i = 0; i < n; i++)
+				dx[i] = dy[i] * y[i] * (1 - y[i]);
+			break;
+		case Activation::Tanh:
+			for(index_t i = 0; i < n; i++)
+				dx[i] = dy[i] * (1 - y[i] * y[i]);
+			break;
+		default:
+			if(dy != dx)
+				for(index_t i = 0; i < n; i++)
+					dx[i] = dy[i];
+	}
+}
+
+// Epilogues are called by gemm() and the convolution kernels with a piece of an output row,
+// c[0, n) = C[i, j:j+n], right after its final value is computed, while it's still hot.
+template<typename Dtype>
+struct NoEpilogue {
+	void operator()(index_t i, index_t j, Dtype* c, index_t n) const {}
+};
+
+// C[i, j] = act(C[i, j] + row_bias[i] + col_bias[j]), either bias can be nullptr.
+template<typename Dtype>
+struct BiasActEpilogue {
+	const Dtype* row_bias;
+	const Dtype* col_bias;
+	Activation act;
+
+	BiasActEpilogue(const Dtype* row_bias, const Dtype* col_bias, Activation act)
+		: row_bias(row_bias), col_bias(col_bias), act(act) {}
+	void operator()(index_t i, index_t j, Dtype* c, index_t n) const {
+		if(row_bias != nullptr) {
+			Dtype bias = row_bias[i];
+			for(index_t k = 0; k < n; k++)
+				c[k] += bias;
+		}
+		if(col_bias != nullptr) {
+			const Dtype* bias = col_bias + j;
+			for(index_t k = 0; k < n; k++)
+				c[k] += bias[k];
+		}
+		activation_forward(act, c, c, n);
+	}
+};
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,234 @@
+#ifndef EXPRESSION_KERNELS_ATTENTION_H_
+#define EXPRESSION_KERNELS_ATTENTION_H_
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+#include "math.h"
+#include "reduce.h"
+
+namespace el {
+namespace kernel {
+
+// softmax(scale * q k^T) v for q (batch, q_len, dim), k (batch, k_len, dim) and v (batch, k_len, v_dim),
+// without the (q_len, k_len) score matrix. Queries and keys are taken in tiles of kAttnBlockQ and
+// kAttnBlockK rows, and only the scores of one pair of tiles exist at a time. With dim = 64 the tiles
+// of q, k, v, the scores and the output are 32KB each in double, so the working set stays in L2.
+// With causal, query i only sees the keys j <= i.
+//
+// The tile products are written as axpys over rows of k^T, v and so on, which vectorize, rather
+// than through gemm(), whose packing buffers are sized for large matrices.
+const index_t kAttnBlockQ = 64;
+const index_t kAttnBlockK = 64;
+
+// Number of keys of the tile starting at j0 that query i sees, from 0 to bc.
+inline index_t attention_visible(bool causal, index_t i, index_t j0, index_t bc) {
+	return causal ? std::max((index_t)0, std::min(bc, i - j0 + 1)) : bc;
+}
+
+// xt (cols, rows) = x^T for rows rows of x with cols values each.
+template<typename Dtype>
+inline void attention_transpose(index_t rows, index_t cols, const Dtype* x, Dtype* xt) {
+	for(index_t r = 0; r < rows; r++)
+		for(index_t c = 0; c < cols; c++)
+			xt[c * rows + r] = x[r * cols + c];
+}
+
+// c (m, n) = alpha * a (m, k) * b (k, n) + beta * c. Rows of c are updated by axpys over rows of b.
+template<typename Dtype>
+inline void attention_tile_product(index_t m, index_t n, index_t k, Dtype alpha, const Dtype* a,
+								   const Dtype* b, Dtype beta, Dtype* c) {
+	for(index_t i = 0; i < m; i++) {
+		Dtype* c_row = c + i * n;
+		for(index_t j = 0; j < n; j++)
+			c_row[j] = beta == 0 ? Dtype(0) : beta * c_row[j];
+		for(index_t p = 0; p < k; p++) {
+			Dtype a_ip = alpha * a[i * k + p];
+			const Dtype* b_row = b + p * n;
+			for(index_t j = 0; j < n; j++)
+				c_row[j] += a_ip * b_row[j];
+		}
+	}
+}
+
+// c (m, n) += a^T * b, for a (k, m) and b (k, n).
+template<typename Dtype>
+inline void attention_tile_product_tn(index_t m, index_t n, index_t k, const Dtype* a, const Dtype* b, Dtype* c) {
+	for(index_t p = 0; p < k; p++) {
+		const Dtype* b_row = b + p * n;
+		for(index_t i = 0; i < m; i++) {
+			Dtype a_pi = a[p * m + i];
+			Dtype* c_row = c + i * n;
+			for(index_t j = 0; j < n; j++)
+				c_row[j] += a_pi * b_row[j];
+		}
+	}
+}
+
+// ******************** forward ********************
+// Online softmax: each row of a query tile keeps the running max m and sum l of exp(s - m) over the
+// key tiles seen so far, and the output accumulated with those weights. A larger max rescales both
+// by exp(m_old - m_new). lse = m + log(l) of every query row is kept, backward rebuilds the
+// probabilities from it. Tiles of queries run in parallel.
+template<typename Dtype>
+void attention_forward(index_t batch, index_t q_len, index_t k_len, index_t dim, index_t v_dim,
+					   const Dtype* q, const Dtype* k, const Dtype* v, Dtype scale, bool causal,
+					   Dtype* out, Dtype* lse) {
+	index_t q_blocks = (q_len + kAttnBlockQ - 1) / kAttnBlockQ;
+	parallel_for(0, batch * q_blocks, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> kt(dim * kAttnBlockK), s(kAttnBlockQ * kAttnBlockK);
+		std::vector<Dtype> acc(kAttnBlockQ * v_dim), row_max(kAttnBlockQ), row_sum(kAttnBlockQ);
+		for(index_t task = begin; task < end; task++) {
+			index_t b = task / q_blocks;
+			index_t i0 = task % q_blocks * kAttnBlockQ;
+			index_t br = std::min(kAttnBlockQ, q_len - i0);
+			const Dtype* q_tile = q + (b * q_len + i0) * dim;
+			std::fill(acc.begin(), acc.end(), Dtype(0));
+			std::fill(row_max.begin(), row_max.end(), -std::numeric_limits<Dtype>::infinity());
+			std::fill(row_sum.begin(), row_sum.end(), Dtype(0));
+			index_t k_end = causal ? std::min(k_len, i0 + br) : k_len;
+			for(index_t j0 = 0; j0 < k_end; j0 += kAttnBlockK) {
+				index_t bc = std::min(kAttnBlockK, k_end - j0);
+				const Dtype* k_tile = k + (b * k_len + j0) * dim;
+				const Dtype* v_tile = v + (b * k_len + j0) * v_dim;
+				attention_transpose(bc, dim, k_tile, kt.data());
+				attention_tile_product(br, bc, dim, scale, q_tile, kt.data(), Dtype(0), s.data());
+				for(index_t r = 0; r < br; r++) {
+					Dtype* s_row = s.data() + r * bc;
+					index_t visible = attention_visible(causal, i0 + r, j0, bc);
+					if(visible == 0) {
+						std::fill(s_row, s_row + bc, Dtype(0));
+						continue;
+					}
+					Dtype new_max = std::max(row_max[r], reduce_contiguous<MaxOp>(s_row, visible));
+					for(index_t c = 0; c < visible; c++)
+						s_row[c] -= new_max;
+					vexp(s_row, s_row, visible);
+					std::fill(s_row + visible, s_row + bc, Dtype(0));
+					Dtype correction = std::exp(row_max[r] - new_max);
+					row_sum[r] = row_sum[r] * correction + reduce_contiguous<SumOp>(s_row, visible);
+					row_max[r] = new_max;
+					Dtype* acc_row = acc.data() + r * v_dim;
+					for(index_t c = 0; c < v_dim; c++)
+						acc_row[c] *= correction;
+				}
+				attention_tile_product(br, v_dim, bc, Dtype(1), s.data(), v_tile, Dtype(1), acc.data());
+			}
+			for(index_t r = 0; r < br; r++) {
+				Dtype inv_sum = Dtype(1) / row_sum[r];
+				Dtype* out_row = out + (b * q_len + i0 + r) * v_dim;
+				for(index_t c = 0; c < v_dim; c++)
+					out_row[c] = acc[r * v_dim + c] * inv_sum;
+				lse[b * q_len + i0 + r] = row_max[r] + std::log(row_sum[r]);
+			}
+		}
+	});
+}
+
+// ******************** backward ********************
+// With p = exp(scale * q k^T - lse), dp = dout v^T, delta = rowsum(dout * out) and
+// ds = p * (dp - delta):
+//   dq = scale * ds k,  dk = scale * ds^T q,  dv = p^T dout.
+// dq sums over keys and dk, dv over queries, so the tiles are visited twice instead of having threads
+// add into shared rows: once by query tiles in parallel for dq, then by key tiles in parallel for dk
+// and dv. p and dp are recomputed from lse each time, and the result doesn't depend on the thread
+// count. Memory is the tiles and delta, linear in the lengths.
+template<typename Dtype>
+void attention_backward(index_t batch, index_t q_len, index_t k_len, index_t dim, index_t v_dim,
+						const Dtype* q, const Dtype* k, const Dtype* v, const Dtype* out, const Dtype* lse,
+						const Dtype* dout, Dtype scale, bool causal, Dtype* dq, Dtype* dk, Dtype* dv) {
+	std::vector<Dtype> delta(batch * q_len);
+	parallel_for(0, batch * q_len, std::max((index_t)1, 4096 / v_dim), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			Dtype sum = 0;
+			for(index_t c = 0; c < v_dim; c++)
+				sum += dout[i * v_dim + c] * out[i * v_dim + c];
+			delta[i] = sum;
+		}
+	});
+
+	// p and ds of the (query tile i0, key tile j0) pair into s and dp, with kt and vt the transposed
+	// key and value tiles.
+	auto tile_grads = [&](index_t b, index_t i0, index_t br, index_t j0, index_t bc,
+						  const Dtype* kt, const Dtype* vt, Dtype* s, Dtype* dp) {
+		const Dtype* q_tile = q + (b * q_len + i0) * dim;
+		const Dtype* dout_tile = dout + (b * q_len + i0) * v_dim;
+		attention_tile_product(br, bc, dim, scale, q_tile, kt, Dtype(0), s);
+		attention_tile_product(br, bc, v_dim, Dtype(1), dout_tile, vt, Dtype(0), dp);
+		for(index_t r = 0; r < br; r++) {
+			Dtype* s_row = s + r * bc;
+			Dtype* dp_row = dp + r * bc;
+			index_t visible = attention_visible(causal, i0 + r, j0, bc);
+			Dtype row_lse = lse[b * q_len + i0 + r], row_delta = delta[b * q_len + i0 + r];
+			for(index_t c = 0; c < visible; c++)
+				s_row[c] -= row_lse;
+			vexp(s_row, s_row, visible);
+			std::fill(s_row + visible, s_row + bc, Dtype(0));
+			for(index_t c = 0; c < bc; c++)
+				dp_row[c] = s_row[c] * (dp_row[c] - row_delta);
+		}
+	};
+
+	index_t q_blocks = (q_len + kAttnBlockQ - 1) / kAttnBlockQ;
+	index_t k_blocks = (k_len + kAttnBlockK - 1) / kAttnBlockK;
+	if(dq != nullptr) {
+		parallel_for(0, batch * q_blocks, 1, [&](index_t begin, index_t end) {
+			std::vector<Dtype> kt(dim * kAttnBlockK), vt(v_dim * kAttnBlockK);
+			std::vector<Dtype> s(kAttnBlockQ * kAttnBlockK), ds(kAttnBlockQ * kAttnBlockK);
+			for(index_t task = begin; task < end; task++) {
+				index_t b = task / q_blocks;
+				index_t i0 = task % q_blocks * kAttnBlockQ;
+				index_t br = std::min(kAttnBlockQ, q_len - i0);
+				Dtype* dq_tile = dq + (b * q_len + i0) * dim;
+				std::fill(dq_tile, dq_tile + br * dim, Dtype(0));
+				index_t k_end = causal ? std::min(k_len, i0 + br) : k_len;
+				for(index_t j0 = 0; j0 < k_end; j0 += kAttnBlockK) {
+					index_t bc = std::min(kAttnBlockK, k_end - j0);
+					const Dtype* k_tile = k + (b * k_len + j0) * dim;
+					attention_transpose(bc, dim, k_tile, kt.data());
+					attention_transpose(bc, v_dim, v + (b * k_len + j0) * v_dim, vt.data());
+					tile_grads(b, i0, br, j0, bc, kt.data(), vt.data(), s.data(), ds.data());
+					attention_tile_product(br, dim, bc, scale, ds.data(), k_tile, Dtype(1), dq_tile);
+				}
+			}
+		});
+	}
+	if(dk == nullptr && dv == nullptr) return;
+	parallel_for(0, batch * k_blocks, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> kt(dim * kAttnBlockK), vt(v_dim * kAttnBlockK);
+		std::vector<Dtype> s(kAttnBlockQ * kAttnBlockK), ds(kAttnBlockQ * kAttnBlockK);
+		std::vector<Dtype> dk_tile(kAttnBlockK * dim), dv_tile(kAttnBlockK * v_dim);
+		for(index_t task = begin; task < end; task++) {
+			index_t b = task / k_blocks;
+			index_t j0 = task % k_blocks * kAttnBlockK;
+			index_t bc = std::min(kAttnBlockK, k_len - j0);
+			attention_transpose(bc, dim, k + (b * k_len + j0) * dim, kt.data());
+			attention_transpose(bc, v_dim, v + (b * k_len + j0) * v_dim, vt.data());
+			std::fill(dk_tile.begin(), dk_tile.end(), Dtype(0));
+			std::fill(dv_tile.begin(), dv_tile.end(), Dtype(0));
+			// With causal, the query tiles before key j0 see none of these keys.
+			index_t i_begin = causal ? j0 / kAttnBlockQ * kAttnBlockQ : 0;
+			for(index_t i0 = i_begin; i0 < q_len; i0 += kAttnBlockQ) {
+				index_t br = std::min(kAttnBlockQ, q_len - i0);
+				tile_grads(b, i0, br, j0, bc, kt.data(), vt.data(), s.data(), ds.data());
+				attention_tile_product_tn(bc, v_dim, br, s.data(), dout + (b * q_len + i0) * v_dim, dv_tile.data());
+				attention_tile_product_tn(bc, dim, br, ds.data(), q + (b * q_len + i0) * dim, dk_tile.data());
+			}
+			if(dk != nullptr) {
+				Dtype* dk_rows = dk + (b * k_len + j0) * dim;
+				for(index_t i = 0; i < bc * dim; i++)
+					dk_rows[i] = scale * dk_tile[i];
+			}
+			if(dv != nullptr)
+				std::copy(dv_tile.begin(), dv_tile.begin() + bc * v_dim, dv + (b * k_len + j0) * v_dim);
+		}
+	});
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,1128 @@
+#ifndef EXPRESSION_KERNELS_CONV_H_
+#define EXPRESSION_KERNELS_CONV_H_
+
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include "gemm.h"
+#include "layout.h"
+
+namespace el {
+namespace kernel {
+
+// Algorithms to compute a 2D convolution. All of them give the same result (up to rounding),
+// but each one is only fast (or only available) for some layer shapes.
+//   Im2Col:      unfold patches into a (c*kh*kw, oh*ow) matrix, then one GEMM. Works for every shape.
+//   Direct:      loop over the kernel and accumulate whole output rows. Good for few channels.
+//   Gemm1x1:     1x1 kernel, stride 1 and no padding. The image is already the im2col matrix.
+//   Winograd2x2: Winograd F(2x2, 3x3), 3x3 kernel with stride 1.
+//   Winograd4x4: Winograd F(4x4, 3x3), fewer multiplications than F(2x2, 3x3), a bit less accurate.
+//   Depthwise:   one group per input channel. Each output row sums kh*kw shifted input rows.
+// Auto picks one of them by a heuristic, and Measure times them at first use (see nn::Conv2d).
+//
+// With groups > 1, the channels are split into groups convolved independently, and the other
+// algorithms run once per (image, group) on a convolution of in_c / groups to out_c / groups channels.
+enum class ConvAlgo {Auto, Measure, Im2Col, Direct, Gemm1x1, Winograd2x2, Winograd4x4, Depthwise};
+
+const char* conv_algo_name(ConvAlgo algo);
+
+struct ConvParam {
+	index_t batch, in_c, in_h, in_w;
+	index_t out_c, out_h, out_w;
+	index_t kh, kw, sh, sw, ph, pw;
+	index_t groups;
+
+	ConvParam(index_t batch, index_t in_c, index_t in_h, index_t in_w, index_t out_c,
+			  const std::pair<index_t, index_t>& kernel_size,
+			  const std::pair<index_t, index_t>& stride,
+			  const std::pair<index_t, index_t>& padding,
+			  index_t groups = 1)
+		: batch(batch), in_c(in_c), in_h(in_h), in_w(in_w), out_c(out_c),
+		  kh(kernel_size.first), kw(kernel_size.second),
+		  sh(stride.first), sw(stride.second),
+		  ph(padding.first), pw(padding.second),
+		  groups(groups) {
+		out_h = (in_h + 2 * ph - kh) / sh + 1;
+		out_w = (in_w + 2 * pw - kw) / sw + 1;
+	}
+	index_t group_in_c(void) const {return in_c / groups;}
+	index_t group_out_c(void) const {return out_c / groups;}
+	// Length of a weight row, one output channel sees the input channels of its group only.
+	index_t col_rows(void) const {return group_in_c() * kh * kw;}
+	index_t in_plane(void) const {return in_h * in_w;}
+	index_t out_plane(void) const {return out_h * out_w;}
+	// Convolution of a single group over some images.
+	ConvParam group_param(index_t images) const {
+		ConvParam g(*this);
+		g.batch = images;
+		g.in_c = group_in_c();
+		g.out_c = group_out_c();
+		g.groups = 1;
+		return g;
+	}
+	// Field by field, so a convolution can key a map.
+	bool operator<(const ConvParam& other) const {
+		return std::tie(batch, in_c, in_h, in_w, out_c, kh, kw, sh, sw, ph, pw, groups) <
+			   std::tie(other.batch, other.in_c, other.in_h, other.in_w, other.out_c, other.kh, other.kw,
+						other.sh, other.sw, other.ph, other.pw, other.groups);
+	}
+};
+
+bool conv_algo_supported(ConvAlgo algo, const ConvParam& p);
+ConvAlgo select_conv_algo(const ConvParam& p);
+
+// x: (batch, in_c, in_h, in_w), w: (out_c, in_c/groups*kh*kw), y: (batch, out_c, out_h, out_w), all contiguous.
+// Outputs are overwritten. Gradients of the weight are summed over the batch. The epilogue of forward
+// is called with row index = output channel on each output plane as soon as it's computed.
+template<typename Dtype, typename Epilogue>
+void conv2d_forward(ConvAlgo algo, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y,
+					const Epilogue& epilogue);
+template<typename Dtype>
+void conv2d_forward(ConvAlgo algo, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y);
+template<typename Dtype>
+void conv2d_backward_data(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx);
+template<typename Dtype>
+void conv2d_backward_weight(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw);
+
+
+// ******************** algorithm selection ********************
+inline const char* conv_algo_name(ConvAlgo algo) {
+	switch(algo) {
+		case ConvAlgo::Auto: return "auto";
+		case ConvAlgo::Measure: return "measure";
+		case ConvAlgo::Im2Col: return "im2col";
+		case ConvAlgo::Direct: return "direct";
+		case ConvAlgo::Gemm1x1: return "gemm1x1";
+		case ConvAlgo::Winograd2x2: return "winograd2x2";
+		case ConvAlgo::Winograd4x4: return "winograd4x4";
+		default: return "depthwise";
+	}
+}
+
+inline bool conv_algo_supported(ConvAlgo algo, const ConvParam& p) {
+	switch(algo) {
+		case ConvAlgo::Im2Col:
+		case ConvAlgo::Direct:
+			return true;
+		case ConvAlgo::Gemm1x1:
+			return p.kh == 1 && p.kw == 1 && p.sh == 1 && p.sw == 1 && p.ph == 0 && p.pw == 0;
+		case ConvAlgo::Winograd2x2:
+		case ConvAlgo::Winograd4x4:
+			// backward of data is a Winograd convolution with padding 2 - padding.
+			return p.kh == 3 && p.kw == 3 && p.sh == 1 && p.sw == 1 && p.ph <= 2 && p.pw <= 2;
+		case ConvAlgo::Depthwise:
+			return p.groups == p.in_c;
+		default:
+			return false;
+	}
+}
+
+// Winograd pays off once the channel GEMMs are big enough to hide the transforms, and F(4x4, 3x3)
+// only when the feature map holds a few 4x4 tiles. With few input channels, im2col just copies the
+// image kh*kw times for a tiny GEMM, so the direct loops win. Grouped layers are judged by the
+// channels of one group.
+inline ConvAlgo select_conv_algo(const ConvParam& p) {
+	if(p.groups > 1 && conv_algo_supported(ConvAlgo::Depthwise, p))
+		return ConvAlgo::Depthwise;
+	if(conv_algo_supported(ConvAlgo::Gemm1x1, p))
+		return ConvAlgo::Gemm1x1;
+	if(conv_algo_supported(ConvAlgo::Winograd4x4, p) && p.group_in_c() >= 8 && p.group_out_c() >= 8)
+		return p.out_h >= 8 && p.out_w >= 8 ? ConvAlgo::Winograd4x4 : ConvAlgo::Winograd2x2;
+	if(p.group_in_c() <= 4 && p.group_out_c() <= 16)
+		return ConvAlgo::Direct;
+	return ConvAlgo::Im2Col;
+}
+
+
+// ******************** im2col ********************
+// col: (in_c*kh*kw, out_h*out_w) for one image.
+template<typename Dtype>
+void im2col(const ConvParam& p, const Dtype* x, Dtype* col) {
+	for(index_t c = 0; c < p.in_c; c++) {
+		for(index_t i = 0; i < p.kh; i++) {
+			for(index_t j = 0; j < p.kw; j++) {
+				for(index_t oh = 0; oh < p.out_h; oh++) {
+					index_t ih = oh * p.sh - p.ph + i;
+					Dtype* col_row = col + oh * p.out_w;
+					if(ih < 0 || ih >= p.in_h) {
+						std::fill(col_row, col_row + p.out_w, Dtype(0));
+						continue;
+					}
+					const Dtype* x_row = x + (c * p.in_h + ih) * p.in_w;
+					for(index_t ow = 0; ow < p.out_w; ow++) {
+						index_t iw = ow * p.sw - p.pw + j;
+						col_row[ow] = iw < 0 || iw >= p.in_w ? 0 : x_row[iw];
+					}
+				}
+				col += p.out_plane();
+			}
+		}
+	}
+}
+
+// Accumulate col back into the image, dx should be initialized.
+template<typename Dtype>
+void col2im(const ConvParam& p, const Dtype* col, Dtype* dx) {
+	for(index_t c = 0; c < p.in_c; c++) {
+		for(index_t i = 0; i < p.kh; i++) {
+			for(index_t j = 0; j < p.kw; j++) {
+				for(index_t oh = 0; oh < p.out_h; oh++) {
+					index_t ih = oh * p.sh - p.ph + i;
+					if(ih < 0 || ih >= p.in_h) continue;
+					const Dtype* col_row = col + oh * p.out_w;
+					Dtype* dx_row = dx + (c * p.in_h + ih) * p.in_w;
+					for(index_t ow = 0; ow < p.out_w; ow++) {
+						index_t iw = ow * p.sw - p.pw + j;
+						if(iw >= 0 && iw < p.in_w)
+							dx_row[iw] += col_row[ow];
+					}
+				}
+				col += p.out_plane();
+			}
+		}
+	}
+}
+
+template<typename Dtype, typename Epilogue>
+void conv2d_im2col_forward(const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y, const Epilogue& epilogue) {
+	parallel_for(0, p.batch, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> col(p.col_rows() * p.out_plane());
+		for(index_t b = begin; b < end; b++) {
+			im2col(p, x + b * p.in_c * p.in_plane(), col.data());
+			gemm(false, false, p.out_c, p.out_plane(), p.col_rows(),
+				 Dtype(1), w, p.col_rows(), col.data(), p.out_plane(),
+				 Dtype(0), y + b * p.out_c * p.out_plane(), p.out_plane(), epilogue);
+		}
+	});
+}
+
+template<typename Dtype>
+void conv2d_im2col_backward_data(const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	parallel_for(0, p.batch, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> col(p.col_rows() * p.out_plane());
+		for(index_t b = begin; b < end; b++) {
+			// dcol = w^T * dy
+			gemm(true, false, p.col_rows(), p.out_plane(), p.out_c,
+				 Dtype(1), w, p.col_rows(), dy + b * p.out_c * p.out_plane(), p.out_plane(),
+				 Dtype(0), col.data(), p.out_plane());
+			Dtype* dx_b = dx + b * p.in_c * p.in_plane();
+			std::fill(dx_b, dx_b + p.in_c * p.in_plane(), Dtype(0));
+			col2im(p, col.data(), dx_b);
+		}
+	});
+}
+
+// Each chunk of the batch accumulates its own dw, then the partial results are added in order.
+template<typename Dtype>
+void conv2d_im2col_backward_weight(const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	index_t wsize = p.out_c * p.col_rows();
+	index_t chunks = num_chunks(0, p.batch, 1);
+	std::vector<Dtype> partial(chunks * wsize);
+	parallel_chunks(0, p.batch, 1, [&](index_t chunk, index_t begin, index_t end) {
+		std::vector<Dtype> col(p.col_rows() * p.out_plane());
+		Dtype* dw_part = partial.data() + chunk * wsize;
+		for(index_t b = begin; b < end; b++) {
+			im2col(p, x + b * p.in_c * p.in_plane(), col.data());
+			// dw += dy * col^T
+			gemm(false, true, p.out_c, p.col_rows(), p.out_plane(),
+				 Dtype(1), dy + b * p.out_c * p.out_plane(), p.out_plane(), col.data(), p.out_plane(),
+				 Dtype(b == begin ? 0 : 1), dw_part, p.col_rows());
+		}
+	});
+	std::fill(dw, dw + wsize, Dtype(0));
+	for(index_t chunk = 0; chunk < chunks; chunk++)
+		for(index_t i = 0; i < wsize; i++)
+			dw[i] += partial[chunk * wsize + i];
+}
+
+
+// ******************** direct ********************
+// Range of output columns [lo, hi) whose input column ow * sw - pw + j falls inside the image.
+inline void conv_valid_cols(const ConvParam& p, index_t j, index_t& lo, index_t& hi) {
+	lo = p.pw - j > 0 ? (p.pw - j + p.sw - 1) / p.sw : 0;
+	hi = p.in_w - 1 + p.pw - j >= 0 ? std::min(p.out_w, (p.in_w - 1 + p.pw - j) / p.sw + 1) : 0;
+}
+
+template<typename Dtype, typename Epilogue>
+void conv2d_direct_forward(const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y, const Epilogue& epilogue) {
+	parallel_for(0, p.batch * p.out_c, 1, [&](index_t begin, index_t end) {
+		for(index_t bo = begin; bo < end; bo++) {
+			index_t b = bo / p.out_c, o = bo % p.out_c;
+			Dtype* y_plane = y + bo * p.out_plane();
+			std::fill(y_plane, y_plane + p.out_plane(), Dtype(0));
+			const Dtype* w_o = w + o * p.col_rows();
+			for(index_t c = 0; c < p.in_c; c++) {
+				const Dtype* x_plane = x + (b * p.in_c + c) * p.in_plane();
+				for(index_t i = 0; i < p.kh; i++) {
+					for(index_t j = 0; j < p.kw; j++) {
+						Dtype wv = w_o[(c * p.kh + i) * p.kw + j];
+						index_t lo, hi;
+						conv_valid_cols(p, j, lo, hi);
+						for(index_t oh = 0; oh < p.out_h; oh++) {
+							index_t ih = oh * p.sh - p.ph + i;
+							if(ih < 0 || ih >= p.in_h) continue;
+							Dtype* y_row = y_plane + oh * p.out_w;
+							const Dtype* x_row = x_plane + ih * p.in_w - p.pw + j;
+							if(p.sw == 1) {
+								for(index_t ow = lo; ow < hi; ow++)
+									y_row[ow] += wv * x_row[ow];
+							} else {
+								for(index_t ow = lo; ow < hi; ow++)
+									y_row[ow] += wv * x_row[ow * p.sw];
+							}
+						}
+					}
+				}
+			}
+			epilogue(o, 0, y_plane, p.out_plane());
+		}
+	});
+}
+
+template<typename Dtype>
+void conv2d_direct_backward_data(const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	parallel_for(0, p.batch * p.in_c, 1, [&](index_t begin, index_t end) {
+		for(index_t bc = begin; bc < end; bc++) {
+			index_t b = bc / p.in_c, c = bc % p.in_c;
+			Dtype* dx_plane = dx + bc * p.in_plane();
+			std::fill(dx_plane, dx_plane + p.in_plane(), Dtype(0));
+			for(index_t o = 0; o < p.out_c; o++) {
+				const Dtype* dy_plane = dy + (b * p.out_c + o) * p.out_plane();
+				const Dtype* w_oc = w + o * p.col_rows() + c * p.kh * p.kw;
+				for(index_t i = 0; i < p.kh; i++) {
+					for(index_t j = 0; j < p.kw; j++) {
+						Dtype wv = w_oc[i * p.kw + j];
+						index_t lo, hi;
+						conv_valid_cols(p, j, lo, hi);
+						for(index_t oh = 0; oh < p.out_h; oh++) {
+							index_t ih = oh * p.sh - p.ph + i;
+							if(ih < 0 || ih >= p.in_h) continue;
+							const Dtype* dy_row = dy_plane + oh * p.out_w;
+							Dtype* dx_row = dx_plane + ih * p.in_w - p.pw + j;
+							if(p.sw == 1) {
+								for(index_t ow = lo; ow < hi; ow++)
+									dx_row[ow] += wv * dy_row[ow];
+							} else {
+								for(index_t ow = lo; ow < hi; ow++)
+									dx_row[ow * p.sw] += wv * dy_row[ow];
+							}
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+// Every (out channel, in channel) pair owns its kh*kw weights, so pairs are computed in parallel
+// and each weight is summed over the batch by one thread.
+template<typename Dtype>
+void conv2d_direct_backward_weight(const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	parallel_for(0, p.out_c * p.in_c, 1, [&](index_t begin, index_t end) {
+		for(index_t oc = begin; oc < end; oc++) {
+			index_t o = oc / p.in_c, c = oc % p.in_c;
+			Dtype* dw_oc = dw + o * p.col_rows() + c * p.kh * p.kw;
+			for(index_t i = 0; i < p.kh; i++) {
+				for(index_t j = 0; j < p.kw; j++) {
+					index_t lo, hi;
+					conv_valid_cols(p, j, lo, hi);
+					Dtype value = 0;
+					for(index_t b = 0; b < p.batch; b++) {
+						const Dtype* dy_plane = dy + (b * p.out_c + o) * p.out_plane();
+						const Dtype* x_plane = x + (b * p.in_c + c) * p.in_plane();
+						for(index_t oh = 0; oh < p.out_h; oh++) {
+							index_t ih = oh * p.sh - p.ph + i;
+							if(ih < 0 || ih >= p.in_h) continue;
+							const Dtype* dy_row = dy_plane + oh * p.out_w;
+							const Dtype* x_row = x_plane + ih * p.in_w - p.pw + j;
+							for(index_t ow = lo; ow < hi; ow++)
+								value += dy_row[ow] * x_row[ow * p.sw];
+						}
+					}
+					dw_oc[i * p.kw + j] = value;
+				}
+			}
+		}
+	});
+}
+
+
+// ******************** 1x1 as GEMM ********************
+template<typename Dtype, typename Epilogue>
+void conv2d_gemm1x1_forward(const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y, const Epilogue& epilogue) {
+	parallel_for(0, p.batch, 1, [&](index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++)
+			gemm(false, false, p.out_c, p.in_plane(), p.in_c,
+				 Dtype(1), w, p.in_c, x + b * p.in_c * p.in_plane(), p.in_plane(),
+				 Dtype(0), y + b * p.out_c * p.out_plane(), p.out_plane(), epilogue);
+	});
+}
+
+template<typename Dtype>
+void conv2d_gemm1x1_backward_data(const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	parallel_for(0, p.batch, 1, [&](index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++)
+			gemm(true, false, p.in_c, p.in_plane(), p.out_c,
+				 Dtype(1), w, p.in_c, dy + b * p.out_c * p.out_plane(), p.out_plane(),
+				 Dtype(0), dx + b * p.in_c * p.in_plane(), p.in_plane());
+	});
+}
+
+template<typename Dtype>
+void conv2d_gemm1x1_backward_weight(const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	index_t wsize = p.out_c * p.in_c;
+	index_t chunks = num_chunks(0, p.batch, 1);
+	std::vector<Dtype> partial(chunks * wsize);
+	parallel_chunks(0, p.batch, 1, [&](index_t chunk, index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++)
+			gemm(false, true, p.out_c, p.in_c, p.in_plane(),
+				 Dtype(1), dy + b * p.out_c * p.out_plane(), p.out_plane(), x + b * p.in_c * p.in_plane(), p.in_plane(),
+				 Dtype(b == begin ? 0 : 1), partial.data() + chunk * wsize, p.in_c);
+	});
+	std::fill(dw, dw + wsize, Dtype(0));
+	for(index_t chunk = 0; chunk < chunks; chunk++)
+		for(index_t i = 0; i < wsize; i++)
+			dw[i] += partial[chunk * wsize + i];
+}
+
+
+// ******************** depthwise ********************
+// groups == in_c, so output channel o only sees input channel o / (out_c / in_c) and w is (out_c, kh*kw).
+// Output rows are finished one at a time, all kh*kw taps added to a row while it's in cache, and the
+// loop over a row is unit stride for stride 1, so it vectorizes.
+template<typename Dtype, typename Epilogue>
+void conv2d_depthwise_forward(const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y, const Epilogue& epilogue) {
+	index_t multiplier = p.out_c / p.in_c;
+	std::vector<index_t> lo(p.kw), hi(p.kw);
+	for(index_t j = 0; j < p.kw; j++)
+		conv_valid_cols(p, j, lo[j], hi[j]);
+	parallel_for(0, p.batch * p.out_c, 1, [&](index_t begin, index_t end) {
+		for(index_t bo = begin; bo < end; bo++) {
+			index_t b = bo / p.out_c, o = bo % p.out_c;
+			const Dtype* x_plane = x + (b * p.in_c + o / multiplier) * p.in_plane();
+			const Dtype* w_o = w + o * p.kh * p.kw;
+			Dtype* y_plane = y + bo * p.out_plane();
+			for(index_t oh = 0; oh < p.out_h; oh++) {
+				Dtype* y_row = y_plane + oh * p.out_w;
+				std::fill(y_row, y_row + p.out_w, Dtype(0));
+				for(index_t i = 0; i < p.kh; i++) {
+					index_t ih = oh * p.sh - p.ph + i;
+					if(ih < 0 || ih >= p.in_h) continue;
+					for(index_t j = 0; j < p.kw; j++) {
+						Dtype wv = w_o[i * p.kw + j];
+						const Dtype* x_row = x_plane + ih * p.in_w - p.pw + j;
+						if(p.sw == 1) {
+							for(index_t ow = lo[j]; ow < hi[j]; ow++)
+								y_row[ow] += wv * x_row[ow];
+						} else {
+							for(index_t ow = lo[j]; ow < hi[j]; ow++)
+								y_row[ow] += wv * x_row[ow * p.sw];
+						}
+					}
+				}
+			}
+			epilogue(o, 0, y_plane, p.out_plane());
+		}
+	});
+}
+
+template<typename Dtype>
+void conv2d_depthwise_backward_data(const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	index_t multiplier = p.out_c / p.in_c;
+	std::vector<index_t> lo(p.kw), hi(p.kw);
+	for(index_t j = 0; j < p.kw; j++)
+		conv_valid_cols(p, j, lo[j], hi[j]);
+	parallel_for(0, p.batch * p.in_c, 1, [&](index_t begin, index_t end) {
+		for(index_t bc = begin; bc < end; bc++) {
+			index_t b = bc / p.in_c, c = bc % p.in_c;
+			Dtype* dx_plane = dx + bc * p.in_plane();
+			std::fill(dx_plane, dx_plane + p.in_plane(), Dtype(0));
+			for(index_t o = c * multiplier; o < (c + 1) * multiplier; o++) {
+				const Dtype* dy_plane = dy + (b * p.out_c + o) * p.out_plane();
+				const Dtype* w_o = w + o * p.kh * p.kw;
+				for(index_t oh = 0; oh < p.out_h; oh++) {
+					const Dtype* dy_row = dy_plane + oh * p.out_w;
+					for(index_t i = 0; i < p.kh; i++) {
+						index_t ih = oh * p.sh - p.ph + i;
+						if(ih < 0 || ih >= p.in_h) continue;
+						for(index_t j = 0; j < p.kw; j++) {
+							Dtype wv = w_o[i * p.kw + j];
+							Dtype* dx_row = dx_plane + ih * p.in_w - p.pw + j;
+							if(p.sw == 1) {
+								for(index_t ow = lo[j]; ow < hi[j]; ow++)
+									dx_row[ow] += wv * dy_row[ow];
+							} else {
+								for(index_t ow = lo[j]; ow < hi[j]; ow++)
+									dx_row[ow * p.sw] += wv * dy_row[ow];
+							}
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+// Each output channel owns its kh*kw weights. Every tap keeps one partial sum per output column,
+// which vectorizes without reordering the sum, and the columns are added up at the end.
+template<typename Dtype>
+void conv2d_depthwise_backward_weight(const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	index_t multiplier = p.out_c / p.in_c, window = p.kh * p.kw;
+	std::vector<index_t> lo(p.kw), hi(p.kw);
+	for(index_t j = 0; j < p.kw; j++)
+		conv_valid_cols(p, j, lo[j], hi[j]);
+	parallel_for(0, p.out_c, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> partial(window * p.out_w);
+		for(index_t o = begin; o < end; o++) {
+			std::fill(partial.begin(), partial.end(), Dtype(0));
+			for(index_t b = 0; b < p.batch; b++) {
+				const Dtype* dy_plane = dy + (b * p.out_c + o) * p.out_plane();
+				const Dtype* x_plane = x + (b * p.in_c + o / multiplier) * p.in_plane();
+				for(index_t oh = 0; oh < p.out_h; oh++) {
+					const Dtype* dy_row = dy_plane + oh * p.out_w;
+					for(index_t i = 0; i < p.kh; i++) {
+						index_t ih = oh * p.sh - p.ph + i;
+						if(ih < 0 || ih >= p.in_h) continue;
+						for(index_t j = 0; j < p.kw; j++) {
+							const Dtype* x_row = x_plane + ih * p.in_w - p.pw + j;
+							Dtype* sums = partial.data() + (i * p.kw + j) * p.out_w;
+							if(p.sw == 1) {
+								for(index_t ow = lo[j]; ow < hi[j]; ow++)
+									sums[ow] += dy_row[ow] * x_row[ow];
+							} else {
+								for(index_t ow = lo[j]; ow < hi[j]; ow++)
+									sums[ow] += dy_row[ow] * x_row[ow * p.sw];
+							}
+						}
+					}
+				}
+			}
+			Dtype* dw_o = dw + o * window;
+			for(index_t k = 0; k < window; k++) {
+				Dtype value = 0;
+				for(index_t ow = 0; ow < p.out_w; ow++)
+					value += partial[k * p.out_w + ow];
+				dw_o[k] = value;
+			}
+		}
+	});
+}
+
+
+// ******************** Winograd ********************
+// Y = A^T [(G g G^T) . (B^T d B)] A, where g is a 3x3 kernel, d is a (m+2, m+2) input tile and Y is
+// a (m, m) output tile. The element-wise product summed over input channels is a batch of
+// (m+2)^2 GEMMs of (out_c, in_c) x (in_c, tiles).
+struct WinogradMatrices {
+	index_t m, alpha;
+	const double* bt;  // (alpha, alpha)
+	const double* g;   // (alpha, 3)
+	const double* at;  // (m, alpha)
+};
+
+inline WinogradMatrices winograd_matrices(index_t m) {
+	static const double bt2[16] = {
+		1,  0, -1,  0,
+		0,  1,  1,  0,
+		0, -1,  1,  0,
+		0,  1,  0, -1};
+	static const double g2[12] = {
+		1,    0,   0,
+		0.5,  0.5, 0.5,
+		0.5, -0.5, 0.5,
+		0,    0,   1};
+	static const double at2[8] = {
+		1, 1,  1,  0,
+		0, 1, -1, -1};
+	static const double bt4[36] = {
+		4,  0, -5,  0, 1, 0,
+		0, -4, -4,  1, 1, 0,
+		0,  4, -4, -1, 1, 0,
+		0, -2, -1,  2, 1, 0,
+		0,  2, -1, -2, 1, 0,
+		0,  4,  0, -5, 0, 1};
+	static const double g4[18] = {
+		 1./4,     0,       0,
+		-1./6,    -1./6,   -1./6,
+		-1./6,     1./6,   -1./6,
+		 1./24,    1./12,   1./6,
+		 1./24,   -1./12,   1./6,
+		 0,        0,       1};
+	static const double at4[24] = {
+		1, 1,  1, 1,  1, 0,
+		0, 1, -1, 2, -2, 0,
+		0, 1,  1, 4,  4, 0,
+		0, 1, -1, 8, -8, 1};
+	if(m == 2) return WinogradMatrices{2, 4, bt2, g2, at2};
+	return WinogradMatrices{4, 6, bt4, g4, at4};
+}
+
+// out = l * in * r^T, where l is (rows, n), in is (n, n') and r is (cols, n').
+template<typename Dtype>
+inline void winograd_sandwich(const double* l, index_t rows, const Dtype* in, index_t n, index_t n2,
+							  const double* r, index_t cols, Dtype* tmp, Dtype* out) {
+	for(index_t i = 0; i < rows; i++)
+		for(index_t j = 0; j < n2; j++) {
+			Dtype value = 0;
+			for(index_t k = 0; k < n; k++)
+				value += l[i * n + k] * in[k * n2 + j];
+			tmp[i * n2 + j] = value;
+		}
+	for(index_t i = 0; i < rows; i++)
+		for(index_t j = 0; j < cols; j++) {
+			Dtype value = 0;
+			for(index_t k = 0; k < n2; k++)
+				value += tmp[i * n2 + k] * r[j * n2 + k];
+			out[i * cols + j] = value;
+		}
+}
+
+// Forward with stride 1 and a 3x3 kernel. m is 2 or 4.
+template<typename Dtype, typename Epilogue>
+void conv2d_winograd_forward(index_t m, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y,
+							 const Epilogue& epilogue) {
+	WinogradMatrices wm = winograd_matrices(m);
+	index_t alpha = wm.alpha, alpha2 = alpha * alpha;
+	index_t tiles_h = (p.out_h + m - 1) / m, tiles_w = (p.out_w + m - 1) / m;
+	index_t tiles = tiles_h * tiles_w;
+
+	// U: (alpha^2, out_c, in_c)
+	std::vector<Dtype> u(alpha2 * p.out_c * p.in_c);
+	parallel_for(0, p.out_c * p.in_c, 16, [&](index_t begin, index_t end) {
+		Dtype tmp[6 * 3], ut[6 * 6];
+		for(index_t oc = begin; oc < end; oc++) {
+			winograd_sandwich(wm.g, alpha, w + oc * 9, 3, 3, wm.g, alpha, tmp, ut);
+			for(index_t xi = 0; xi < alpha2; xi++)
+				u[xi * p.out_c * p.in_c + oc] = ut[xi];
+		}
+	});
+
+	parallel_for(0, p.batch, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> v(alpha2 * p.in_c * tiles);   // (alpha^2, in_c, tiles)
+		std::vector<Dtype> mm(alpha2 * p.out_c * tiles); // (alpha^2, out_c, tiles)
+		Dtype d[6 * 6], tmp[6 * 6], vt[6 * 6];
+		for(index_t b = begin; b < end; b++) {
+			// input transform
+			for(index_t c = 0; c < p.in_c; c++) {
+				const Dtype* x_plane = x + (b * p.in_c + c) * p.in_plane();
+				for(index_t t = 0; t < tiles; t++) {
+					index_t h0 = t / tiles_w * m - p.ph, w0 = t % tiles_w * m - p.pw;
+					for(index_t i = 0; i < alpha; i++)
+						for(index_t j = 0; j < alpha; j++) {
+							index_t ih = h0 + i, iw = w0 + j;
+							d[i * alpha + j] = ih < 0 || ih >= p.in_h || iw < 0 || iw >= p.in_w ?
+								0 : x_plane[ih * p.in_w + iw];
+						}
+					winograd_sandwich(wm.bt, alpha, d, alpha, alpha, wm.bt, alpha, tmp, vt);
+					for(index_t xi = 0; xi < alpha2; xi++)
+						v[(xi * p.in_c + c) * tiles + t] = vt[xi];
+				}
+			}
+			// batched GEMM over the transform domain
+			for(index_t xi = 0; xi < alpha2; xi++)
+				gemm(false, false, p.out_c, tiles, p.in_c,
+					 Dtype(1), u.data() + xi * p.out_c * p.in_c, p.in_c, v.data() + xi * p.in_c * tiles, tiles,
+					 Dtype(0), mm.data() + xi * p.out_c * tiles, tiles);
+			// output transform
+			for(index_t o = 0; o < p.out_c; o++) {
+				Dtype* y_plane = y + (b * p.out_c + o) * p.out_plane();
+				for(index_t t = 0; t < tiles; t++) {
+					for(index_t xi = 0; xi < alpha2; xi++)
+						d[xi] = mm[(xi * p.out_c + o) * tiles + t];
+					winograd_sandwich(wm.at, m, d, alpha, alpha, wm.at, m, tmp, vt);
+					index_t h0 = t / tiles_w * m, w0 = t % tiles_w * m;
+					for(index_t i = 0; i < m && h0 + i < p.out_h; i++)
+						for(index_t j = 0; j < m && w0 + j < p.out_w; j++)
+							y_plane[(h0 + i) * p.out_w + w0 + j] = vt[i * m + j];
+				}
+				epilogue(o, 0, y_plane, p.out_plane());
+			}
+		}
+	});
+}
+
+// The gradient of data for a stride 1 convolution is the convolution of dy with the kernel flipped
+// and its channels swapped, padded by kernel_size - 1 - padding. So it's a Winograd convolution too.
+template<typename Dtype>
+void conv2d_winograd_backward_data(index_t m, const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	ConvParam tp(p.batch, p.out_c, p.out_h, p.out_w, p.in_c, {3, 3}, {1, 1}, {2 - p.ph, 2 - p.pw});
+	std::vector<Dtype> flipped(p.in_c * p.out_c * 9);
+	for(index_t o = 0; o < p.out_c; o++)
+		for(index_t c = 0; c < p.in_c; c++)
+			for(index_t k = 0; k < 9; k++)
+				flipped[(c * p.out_c + o) * 9 + 8 - k] = w[(o * p.in_c + c) * 9 + k];
+	conv2d_winograd_forward(m, tp, dy, flipped.data(), dx, NoEpilogue<Dtype>());
+}
+
+
+// ******************** channels innermost ********************
+// Images stored as (batch, channel blocks, h, w, block), i.e. NHWC or NCHW[x]c (see utils/layout.h),
+// and the output in the same layout. Patches are gathered as rows of (kh, kw, in_c), copying whole
+// runs of adjacent channels, and one GEMM of (pixels, kh*kw*in_c) x (kh*kw*in_c, out_c) gives NHWC
+// rows of output, with the bias and activation applied per column. Blocked outputs are converted
+// from those rows. Batches are cut into chunks of images so the patch matrix stays small. A 1x1 NHWC
+// convolution with stride 1 and no padding reads the image itself as the patch matrix.
+//
+// Grouped layers gather the channels of one group at a time, and run one GEMM per group into its
+// columns of the output rows. Depthwise layers with one output channel per input channel skip the
+// GEMM, see conv2d_depthwise_channels_last_forward.
+
+// Weight (out_c, in_c/groups, kh, kw) to (out_c, kh, kw, in_c/groups), or back with to_hwc = false.
+template<typename Dtype>
+void reorder_weight_hwc(const ConvParam& p, const Dtype* src, Dtype* dst, bool to_hwc) {
+	index_t window = p.kh * p.kw, channels = p.group_in_c();
+	for(index_t o = 0; o < p.out_c; o++)
+		for(index_t c = 0; c < channels; c++)
+			for(index_t k = 0; k < window; k++) {
+				index_t chw = (o * channels + c) * window + k, hwc = (o * window + k) * channels + c;
+				if(to_hwc) dst[hwc] = src[chw];
+				else dst[chw] = src[hwc];
+			}
+}
+
+inline bool conv_pixels_are_rows(const ConvParam& p, Layout layout) {
+	return layout == Layout::NHWC && p.groups == 1 &&
+		   p.kh == 1 && p.kw == 1 && p.sh == 1 && p.sw == 1 && p.ph == 0 && p.pw == 0;
+}
+
+inline bool conv_channels_last_depthwise(const ConvParam& p) {
+	return p.groups > 1 && p.groups == p.in_c && p.out_c == p.in_c;
+}
+
+inline index_t conv_rows_chunk(const ConvParam& p) {
+	const index_t budget = 1 << 20;
+	return std::max((index_t)1, std::min(p.batch, budget / std::max(p.out_plane() * p.col_rows(), (index_t)1)));
+}
+
+// Patch rows of a group's channels in images [n0, n0 + images), out_plane() rows per image.
+template<typename Dtype>
+void im2row(const ConvParam& p, Layout layout, const Dtype* x, index_t group, index_t n0, index_t images, Dtype* col) {
+	index_t block = layout_block(layout, p.in_c), blocks = layout_blocks(layout, p.in_c);
+	index_t channels = p.group_in_c(), c0 = group * channels;
+	parallel_for(0, images * p.out_plane(), 16, [&](index_t begin, index_t end) {
+		for(index_t r = begin; r < end; r++) {
+			index_t n = n0 + r / p.out_plane();
+			index_t oh = r % p.out_plane() / p.out_w, ow = r % p.out_w;
+			Dtype* row = col + r * p.col_rows();
+			for(index_t i = 0; i < p.kh; i++) {
+				index_t ih = oh * p.sh - p.ph + i;
+				for(index_t j = 0; j < p.kw; j++) {
+					index_t iw = ow * p.sw - p.pw + j;
+					Dtype* dst = row + (i * p.kw + j) * channels;
+					if(ih < 0 || ih >= p.in_h || iw < 0 || iw >= p.in_w) {
+						std::fill(dst, dst + channels, Dtype(0));
+						continue;
+					}
+					for(index_t c = c0; c < c0 + channels;) {
+						index_t b = c / block, count = std::min(block - c % block, c0 + channels - c);
+						const Dtype* src = x + ((n * blocks + b) * p.in_plane() + ih * p.in_w + iw) * block + c % block;
+						std::copy(src, src + count, dst + c - c0);
+						c += count;
+					}
+				}
+			}
+		}
+	});
+}
+
+// Accumulate patch rows back into a group's channels in images [n0, n0 + images) of dx, one image per thread.
+template<typename Dtype>
+void row2im(const ConvParam& p, Layout layout, const Dtype* col, index_t group, index_t n0, index_t images, Dtype* dx) {
+	index_t block = layout_block(layout, p.in_c), blocks = layout_blocks(layout, p.in_c);
+	index_t channels = p.group_in_c(), c0 = group * channels;
+	parallel_for(0, images, 1, [&](index_t begin, index_t end) {
+		for(index_t image = begin; image < end; image++) {
+			index_t n = n0 + image;
+			for(index_t q = 0; q < p.out_plane(); q++) {
+				index_t oh = q / p.out_w, ow = q % p.out_w;
+				const Dtype* row = col + (image * p.out_plane() + q) * p.col_rows();
+				for(index_t i = 0; i < p.kh; i++) {
+					index_t ih = oh * p.sh - p.ph + i;
+					if(ih < 0 || ih >= p.in_h) continue;
+					for(index_t j = 0; j < p.kw; j++) {
+						index_t iw = ow * p.sw - p.pw + j;
+						if(iw < 0 || iw >= p.in_w) continue;
+						const Dtype* src = row + (i * p.kw + j) * channels - c0;
+						for(index_t c = c0; c < c0 + channels;) {
+							index_t b = c / block, count = std::min(block - c % block, c0 + channels - c);
+							Dtype* dst = dx + ((n * blocks + b) * p.in_plane() + ih * p.in_w + iw) * block + c % block;
+							for(index_t k = 0; k < count; k++)
+								dst[k] += src[c + k];
+							c += count;
+						}
+					}
+				}
+			}
+		}
+	});
+}
+
+// ******************** depthwise, channels innermost ********************
+// groups == in_c == out_c. Every output pixel is kh*kw products of whole channel blocks, so the loops
+// over a block vectorize whatever the plane is. The weight is reordered to (blocks, kh*kw, block),
+// with zeros for the padded channels, which keeps them zero in the output.
+template<typename Dtype>
+void reorder_weight_depthwise(const ConvParam& p, Layout layout, const Dtype* w, Dtype* w_blk) {
+	index_t block = layout_block(layout, p.in_c), window = p.kh * p.kw;
+	std::fill(w_blk, w_blk + layout_blocks(layout, p.in_c) * window * block, Dtype(0));
+	for(index_t c = 0; c < p.in_c; c++)
+		for(index_t k = 0; k < window; k++)
+			w_blk[(c / block * window + k) * block + c % block] = w[c * window + k];
+}
+
+template<typename Dtype>
+void conv2d_depthwise_channels_last_forward(const ConvParam& p, Layout layout, const Dtype* x, const Dtype* w,
+											Dtype* y, const Dtype* bias, Activation act) {
+	index_t block = layout_block(layout, p.in_c), blocks = layout_blocks(layout, p.in_c), window = p.kh * p.kw;
+	std::vector<Dtype> w_blk(blocks * window * block);
+	reorder_weight_depthwise(p, layout, w, w_blk.data());
+	std::vector<index_t> lo(p.kw), hi(p.kw);
+	for(index_t j = 0; j < p.kw; j++)
+		conv_valid_cols(p, j, lo[j], hi[j]);
+	parallel_for(0, p.batch * blocks * p.out_h, 1, [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t image_block = task / p.out_h, oh = task % p.out_h;
+			index_t b = image_block % blocks, count = std::min(block, p.in_c - b * block);
+			const Dtype* x_block = x + image_block * p.in_plane() * block;
+			Dtype* y_row = y + (image_block * p.out_plane() + oh * p.out_w) * block;
+			std::fill(y_row, y_row + p.out_w * block, Dtype(0));
+			for(index_t i = 0; i < p.kh; i++) {
+				index_t ih = oh * p.sh - p.ph + i;
+				if(ih < 0 || ih >= p.in_h) continue;
+				for(index_t j = 0; j < p.kw; j++) {
+					const Dtype* w_tap = w_blk.data() + (b * window + i * p.kw + j) * block;
+					for(index_t ow = lo[j]; ow < hi[j]; ow++) {
+						const Dtype* x_pix = x_block + (ih * p.in_w + ow * p.sw - p.pw + j) * block;
+						Dtype* y_pix = y_row + ow * block;
+						for(index_t k = 0; k < block; k++)
+							y_pix[k] += w_tap[k] * x_pix[k];
+					}
+				}
+			}
+			for(index_t ow = 0; ow < p.out_w; ow++) {
+				Dtype* y_pix = y_row + ow * block;
+				if(bias != nullptr)
+					for(index_t k = 0; k < count; k++)
+						y_pix[k] += bias[b * block + k];
+				activation_forward(act, y_pix, y_pix, count);
+			}
+		}
+	});
+}
+
+// Images of a chunk of (image, block) pairs write disjoint parts of dx, while dw and db are summed
+// per chunk and the partial results are added in order.
+template<typename Dtype>
+void conv2d_depthwise_channels_last_backward(const ConvParam& p, Layout layout, const Dtype* dy, const Dtype* x,
+											 const Dtype* w, Dtype* dx, Dtype* dw, Dtype* db) {
+	index_t block = layout_block(layout, p.in_c), blocks = layout_blocks(layout, p.in_c), window = p.kh * p.kw;
+	index_t wsize = blocks * window * block, bsize = blocks * block;
+	std::vector<Dtype> w_blk(wsize);
+	reorder_weight_depthwise(p, layout, w, w_blk.data());
+	std::vector<index_t> lo(p.kw), hi(p.kw);
+	for(index_t j = 0; j < p.kw; j++)
+		conv_valid_cols(p, j, lo[j], hi[j]);
+	index_t chunks = num_chunks(0, p.batch * blocks, 1);
+	std::vector<Dtype> dw_part(dw != nullptr ? chunks * wsize : 0, Dtype(0));
+	std::vector<Dtype> db_part(db != nullptr ? chunks * bsize : 0, Dtype(0));
+	parallel_chunks(0, p.batch * blocks, 1, [&](index_t chunk, index_t begin, index_t end) {
+		for(index_t image_block = begin; image_block < end; image_block++) {
+			index_t b = image_block % blocks;
+			const Dtype* x_block = x + image_block * p.in_plane() * block;
+			const Dtype* dy_block = dy + image_block * p.out_plane() * block;
+			Dtype* dx_block = dx != nullptr ? dx + image_block * p.in_plane() * block : nullptr;
+			if(dx_block != nullptr)
+				std::fill(dx_block, dx_block + p.in_plane() * block, Dtype(0));
+			if(db != nullptr) {
+				Dtype* db_b = db_part.data() + chunk * bsize + b * block;
+				for(index_t q = 0; q < p.out_plane(); q++)
+					for(index_t k = 0; k < block; k++)
+						db_b[k] += dy_block[q * block + k];
+			}
+			for(index_t oh = 0; oh < p.out_h; oh++) {
+				const Dtype* dy_row = dy_block + oh * p.out_w * block;
+				for(index_t i = 0; i < p.kh; i++) {
+					index_t ih = oh * p.sh - p.ph + i;
+					if(ih < 0 || ih >= p.in_h) continue;
+					for(index_t j = 0; j < p.kw; j++) {
+						index_t tap = (b * window + i * p.kw + j) * block;
+						index_t offset = (ih * p.in_w - p.pw + j) * block;
+						if(dw != nullptr) {
+							Dtype* dw_tap = dw_part.data() + chunk * wsize + tap;
+							for(index_t ow = lo[j]; ow < hi[j]; ow++) {
+								const Dtype* x_pix = x_block + offset + ow * p.sw * block;
+								const Dtype* dy_pix = dy_row + ow * block;
+								for(index_t k = 0; k < block; k++)
+									dw_tap[k] += dy_pix[k] * x_pix[k];
+							}
+						}
+						if(dx_block != nullptr) {
+							const Dtype* w_tap = w_blk.data() + tap;
+							for(index_t ow = lo[j]; ow < hi[j]; ow++) {
+								Dtype* dx_pix = dx_block + offset + ow * p.sw * block;
+								const Dtype* dy_pix = dy_row + ow * block;
+								for(index_t k = 0; k < block; k++)
+									dx_pix[k] += w_tap[k] * dy_pix[k];
+							}
+						}
+					}
+				}
+			}
+		}
+	});
+	if(dw != nullptr) {
+		std::fill(dw, dw + p.out_c * window, Dtype(0));
+		for(index_t chunk = 0; chunk < chunks; chunk++)
+			for(index_t c = 0; c < p.in_c; c++)
+				for(index_t k = 0; k < window; k++)
+					dw[c * window + k] += dw_part[chunk * wsize + (c / block * window + k) * block + c % block];
+	}
+	if(db != nullptr) {
+		std::fill(db, db + p.out_c, Dtype(0));
+		for(index_t chunk = 0; chunk < chunks; chunk++)
+			for(index_t c = 0; c < p.in_c; c++)
+				db[c] += db_part[chunk * bsize + c];
+	}
+}
+
+
+// bias (out_c) can be nullptr. y is overwritten.
+template<typename Dtype>
+void conv2d_channels_last_forward(const ConvParam& p, Layout layout, const Dtype* x, const Dtype* w,
+								  Dtype* y, const Dtype* bias, Activation act) {
+	if(conv_channels_last_depthwise(p)) {
+		conv2d_depthwise_channels_last_forward(p, layout, x, w, y, bias, act);
+		return;
+	}
+	index_t chunk = conv_rows_chunk(p);
+	index_t group_c = p.group_out_c();
+	index_t out_size = layout_blocks(layout, p.out_c) * p.out_plane() * layout_block(layout, p.out_c);
+	bool nhwc = layout == Layout::NHWC;
+	std::vector<Dtype> w_hwc(p.out_c * p.col_rows());
+	reorder_weight_hwc(p, w, w_hwc.data(), true);
+	bool pixels_are_rows = conv_pixels_are_rows(p, layout);
+	std::vector<Dtype> col(pixels_are_rows ? 0 : chunk * p.out_plane() * p.col_rows());
+	std::vector<Dtype> rows(nhwc ? 0 : chunk * p.out_plane() * p.out_c);
+	for(index_t n0 = 0; n0 < p.batch; n0 += chunk) {
+		index_t images = std::min(chunk, p.batch - n0);
+		Dtype* y_rows = nhwc ? y + n0 * out_size : rows.data();
+		for(index_t group = 0; group < p.groups; group++) {
+			const Dtype* x_rows = x + n0 * p.in_plane() * p.in_c;
+			if(!pixels_are_rows) {
+				im2row(p, layout, x, group, n0, images, col.data());
+				x_rows = col.data();
+			}
+			gemm(false, true, images * p.out_plane(), group_c, p.col_rows(),
+				 Dtype(1), x_rows, p.col_rows(), w_hwc.data() + group * group_c * p.col_rows(), p.col_rows(),
+				 Dtype(0), y_rows + group * group_c, p.out_c,
+				 BiasActEpilogue<Dtype>(nullptr, bias != nullptr ? bias + group * group_c : nullptr, act));
+		}
+		if(!nhwc)
+			convert_layout(Layout::NHWC, layout, images, p.out_c, p.out_plane(), y_rows, y + n0 * out_size);
+	}
+}
+
+// dy is the gradient before the activation. dx, dw and db are overwritten, any of them can be nullptr.
+template<typename Dtype>
+void conv2d_channels_last_backward(const ConvParam& p, Layout layout, const Dtype* dy, const Dtype* x,
+								   const Dtype* w, Dtype* dx, Dtype* dw, Dtype* db) {
+	if(conv_channels_last_depthwise(p)) {
+		conv2d_depthwise_channels_last_backward(p, layout, dy, x, w, dx, dw, db);
+		return;
+	}
+	index_t chunk = conv_rows_chunk(p);
+	index_t group_c = p.group_out_c();
+	index_t in_size = layout_blocks(layout, p.in_c) * p.in_plane() * layout_block(layout, p.in_c);
+	index_t out_size = layout_blocks(layout, p.out_c) * p.out_plane() * layout_block(layout, p.out_c);
+	bool nhwc = layout == Layout::NHWC;
+	std::vector<Dtype> w_hwc(dx != nullptr ? p.out_c * p.col_rows() : 0);
+	std::vector<Dtype> dw_hwc(dw != nullptr ? p.out_c * p.col_rows() : 0);
+	if(dx != nullptr) {
+		reorder_weight_hwc(p, w, w_hwc.data(), true);
+		std::fill(dx, dx + p.batch * in_size, Dtype(0));
+	}
+	if(db != nullptr)
+		std::fill(db, db + p.out_c, Dtype(0));
+	bool pixels_are_rows = conv_pixels_are_rows(p, layout);
+	std::vector<Dtype> col(pixels_are_rows ? 0 : chunk * p.out_plane() * p.col_rows());
+	std::vector<Dtype> rows(nhwc ? 0 : chunk * p.out_plane() * p.out_c);
+	for(index_t n0 = 0; n0 < p.batch; n0 += chunk) {
+		index_t images = std::min(chunk, p.batch - n0);
+		index_t num_rows = images * p.out_plane();
+		index_t in_offset = n0 * in_size;
+		const Dtype* dy_rows = dy + n0 * out_size;
+		if(!nhwc) {
+			convert_layout(layout, Layout::NHWC, images, p.out_c, p.out_plane(), dy_rows, rows.data());
+			dy_rows = rows.data();
+		}
+		if(db != nullptr)
+			for(index_t r = 0; r < num_rows; r++)
+				for(index_t o = 0; o < p.out_c; o++)
+					db[o] += dy_rows[r * p.out_c + o];
+		for(index_t group = 0; group < p.groups; group++) {
+			const Dtype* dy_group = dy_rows + group * group_c;
+			index_t w_offset = group * group_c * p.col_rows();
+			if(dw != nullptr) {
+				const Dtype* x_rows = x + in_offset;
+				if(!pixels_are_rows) {
+					im2row(p, layout, x, group, n0, images, col.data());
+					x_rows = col.data();
+				}
+				gemm(true, false, group_c, p.col_rows(), num_rows,
+					 Dtype(1), dy_group, p.out_c, x_rows, p.col_rows(),
+					 Dtype(n0 == 0 ? 0 : 1), dw_hwc.data() + w_offset, p.col_rows());
+			}
+			if(dx != nullptr) {
+				gemm(false, false, num_rows, p.col_rows(), group_c,
+					 Dtype(1), dy_group, p.out_c, w_hwc.data() + w_offset, p.col_rows(),
+					 Dtype(0), pixels_are_rows ? dx + in_offset : col.data(), p.col_rows());
+				if(!pixels_are_rows)
+					row2im(p, layout, col.data(), group, n0, images, dx);
+			}
+		}
+	}
+	if(dw != nullptr)
+		reorder_weight_hwc(p, dw_hwc.data(), dw, false);
+}
+
+
+// ******************** dispatch ********************
+template<typename Dtype, typename Epilogue>
+void conv2d_ungrouped_forward(ConvAlgo algo, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y,
+							  const Epilogue& epilogue) {
+	switch(algo) {
+		case ConvAlgo::Direct: conv2d_direct_forward(p, x, w, y, epilogue); break;
+		case ConvAlgo::Gemm1x1: conv2d_gemm1x1_forward(p, x, w, y, epilogue); break;
+		case ConvAlgo::Winograd2x2: conv2d_winograd_forward(2, p, x, w, y, epilogue); break;
+		case ConvAlgo::Winograd4x4: conv2d_winograd_forward(4, p, x, w, y, epilogue); break;
+		default: conv2d_im2col_forward(p, x, w, y, epilogue);
+	}
+}
+
+template<typename Dtype>
+void conv2d_ungrouped_backward_data(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	switch(algo) {
+		case ConvAlgo::Direct: conv2d_direct_backward_data(p, dy, w, dx); break;
+		case ConvAlgo::Gemm1x1: conv2d_gemm1x1_backward_data(p, dy, w, dx); break;
+		case ConvAlgo::Winograd2x2: conv2d_winograd_backward_data(2, p, dy, w, dx); break;
+		case ConvAlgo::Winograd4x4: conv2d_winograd_backward_data(4, p, dy, w, dx); break;
+		default: conv2d_im2col_backward_data(p, dy, w, dx);
+	}
+}
+
+// The gradient of a Winograd layer's weight is a correlation of x and dy with a (out_h, out_w)
+// "kernel", which Winograd F(m, 3) doesn't cover, so those layers use the im2col GEMM for it.
+template<typename Dtype>
+void conv2d_ungrouped_backward_weight(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	switch(algo) {
+		case ConvAlgo::Direct: conv2d_direct_backward_weight(p, dy, x, dw); break;
+		case ConvAlgo::Gemm1x1: conv2d_gemm1x1_backward_weight(p, dy, x, dw); break;
+		default: conv2d_im2col_backward_weight(p, dy, x, dw);
+	}
+}
+
+// ******************** grouped ********************
+// Every (image, group) is a convolution of its own, done by a dense algorithm on group_param(1).
+// Input, output and weight of a group are contiguous slices, so only the pointers move.
+template<typename Epilogue>
+struct GroupEpilogue {
+	const Epilogue& epilogue;
+	index_t row0;
+
+	GroupEpilogue(const Epilogue& epilogue, index_t row0): epilogue(epilogue), row0(row0) {}
+	template<typename Dtype>
+	void operator()(index_t i, index_t j, Dtype* c, index_t n) const {epilogue(row0 + i, j, c, n);}
+};
+
+template<typename Dtype, typename Epilogue>
+void conv2d_grouped_forward(ConvAlgo algo, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y,
+							const Epilogue& epilogue) {
+	ConvParam g = p.group_param(1);
+	parallel_for(0, p.batch * p.groups, 1, [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t b = task / p.groups, group = task % p.groups;
+			conv2d_ungrouped_forward(algo, g, x + (b * p.in_c + group * g.in_c) * p.in_plane(),
+						   w + group * g.out_c * g.col_rows(), y + (b * p.out_c + group * g.out_c) * p.out_plane(),
+						   GroupEpilogue<Epilogue>(epilogue, group * g.out_c));
+		}
+	});
+}
+
+template<typename Dtype>
+void conv2d_grouped_backward_data(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	ConvParam g = p.group_param(1);
+	parallel_for(0, p.batch * p.groups, 1, [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t b = task / p.groups, group = task % p.groups;
+			conv2d_ungrouped_backward_data(algo, g, dy + (b * p.out_c + group * g.out_c) * p.out_plane(),
+								 w + group * g.out_c * g.col_rows(), dx + (b * p.in_c + group * g.in_c) * p.in_plane());
+		}
+	});
+}
+
+// Each chunk of the batch accumulates its own dw, then the partial results are added in order.
+template<typename Dtype>
+void conv2d_grouped_backward_weight(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	ConvParam g = p.group_param(1);
+	index_t wsize = p.out_c * p.col_rows(), group_wsize = g.out_c * g.col_rows();
+	index_t chunks = num_chunks(0, p.batch, 1);
+	std::vector<Dtype> partial(chunks * wsize, Dtype(0));
+	parallel_chunks(0, p.batch, 1, [&](index_t chunk, index_t begin, index_t end) {
+		std::vector<Dtype> dw_image(group_wsize);
+		for(index_t b = begin; b < end; b++) {
+			for(index_t group = 0; group < p.groups; group++) {
+				conv2d_ungrouped_backward_weight(algo, g, dy + (b * p.out_c + group * g.out_c) * p.out_plane(),
+									   x + (b * p.in_c + group * g.in_c) * p.in_plane(), dw_image.data());
+				Dtype* dw_part = partial.data() + chunk * wsize + group * group_wsize;
+				for(index_t i = 0; i < group_wsize; i++)
+					dw_part[i] += dw_image[i];
+			}
+		}
+	});
+	std::fill(dw, dw + wsize, Dtype(0));
+	for(index_t chunk = 0; chunk < chunks; chunk++)
+		for(index_t i = 0; i < wsize; i++)
+			dw[i] += partial[chunk * wsize + i];
+}
+
+
+template<typename Dtype, typename Epilogue>
+void conv2d_forward(ConvAlgo algo, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y,
+					const Epilogue& epilogue) {
+	if(algo == ConvAlgo::Depthwise)
+		conv2d_depthwise_forward(p, x, w, y, epilogue);
+	else if(p.groups > 1)
+		conv2d_grouped_forward(algo, p, x, w, y, epilogue);
+	else
+		conv2d_ungrouped_forward(algo, p, x, w, y, epilogue);
+}
+
+template<typename Dtype>
+void conv2d_forward(ConvAlgo algo, const ConvParam& p, const Dtype* x, const Dtype* w, Dtype* y) {
+	conv2d_forward(algo, p, x, w, y, NoEpilogue<Dtype>());
+}
+
+template<typename Dtype>
+void conv2d_backward_data(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* w, Dtype* dx) {
+	if(algo == ConvAlgo::Depthwise)
+		conv2d_depthwise_backward_data(p, dy, w, dx);
+	else if(p.groups > 1)
+		conv2d_grouped_backward_data(algo, p, dy, w, dx);
+	else
+		conv2d_ungrouped_backward_data(algo, p, dy, w, dx);
+}
+
+template<typename Dtype>
+void conv2d_backward_weight(ConvAlgo algo, const ConvParam& p, const Dtype* dy, const Dtype* x, Dtype* dw) {
+	if(algo == ConvAlgo::Depthwise)
+		conv2d_depthwise_backward_weight(p, dy, x, dw);
+	else if(p.groups > 1)
+		conv2d_grouped_backward_weight(algo, p, dy, x, dw);
+	else
+		conv2d_ungrouped_backward_weight(algo, p, dy, x, dw);
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef EXPRESSION_KERNELS_EMBEDDING_H_
+#define EXPRESSION_KERNELS_EMBEDDING_H_
+
+#include <vector>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+
+namespace el {
+namespace kernel {
+
+// ******************** gather ********************
+// out[i] = table[ids[i]] for n ids, rows of cols values, for embedding and index_select. Each row is
+// one memcpy.
+template<typename Dtype, typename Itype>
+void gather_rows(index_t n, index_t cols, const Itype* ids, const Dtype* table, Dtype* out) {
+	parallel_for(0, n, std::max((index_t)1, 4096 / std::max(cols, (index_t)1)), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++)
+			std::memcpy(out + (std::size_t)i * cols, table + (std::size_t)ids[i] * cols, cols * sizeof(Dtype));
+	});
+}
+
+// ******************** sparse rows ********************
+// The gradient of a table where only some rows are nonzero: rows are unique and sorted, and values
+// holds cols values for each of them. A step of a large vocabulary touches a few rows, and that's
+// all this stores, instead of a dense (num, cols) gradient.
+template<typename Dtype>
+struct SparseRows {
+	index_t cols;
+	std::vector<index_t> rows;
+	std::vector<Dtype> values;
+
+	explicit SparseRows(index_t cols=0): cols(cols) {}
+	index_t nnz_rows(void) const {return rows.size();}
+	void clear(void) {
+		rows.clear();
+		values.clear();
+	}
+};
+
+// grad += the rows of dy (n, cols) added to rows ids. The ids are sorted with their positions, so
+// the dy rows of one id are summed in order, each unique id by one thread. Then the result is merged
+// with the rows grad already has, which are sorted as well.
+template<typename Dtype, typename Itype>
+void sparse_rows_add(index_t n, index_t cols, const Itype* ids, const Dtype* dy, SparseRows<Dtype>& grad) {
+	std::vector<index_t> order(n);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [ids](index_t a, index_t b) {return ids[a] < ids[b];});
+	std::vector<index_t> starts;
+	for(index_t i = 0; i < n; i++)
+		if(i == 0 || ids[order[i]] != ids[order[i - 1]])
+			starts.push_back(i);
+	index_t unique = starts.size();
+	starts.push_back(n);
+
+	std::vector<index_t> rows(unique);
+	std::vector<Dtype> values(unique * cols);
+	parallel_for(0, unique, std::max((index_t)1, 4096 / cols), [&](index_t begin, index_t end) {
+		for(index_t u = begin; u < end; u++) {
+			rows[u] = ids[order[starts[u]]];
+			Dtype* value = values.data() + u * cols;
+			std::copy(dy + order[starts[u]] * cols, dy + (order[starts[u]] + 1) * cols, value);
+			for(index_t i = starts[u] + 1; i < starts[u + 1]; i++) {
+				const Dtype* dy_row = dy + order[i] * cols;
+				for(index_t c = 0; c < cols; c++)
+					value[c] += dy_row[c];
+			}
+		}
+	});
+	if(grad.rows.empty()) {
+		grad.rows.swap(rows);
+		grad.values.swap(values);
+		return;
+	}
+
+	std::vector<index_t> merged_rows;
+	std::vector<Dtype> merged_values;
+	merged_rows.reserve(grad.rows.size() + unique);
+	merged_values.reserve((grad.rows.size() + unique) * cols);
+	index_t a = 0, b = 0, num_a = grad.rows.size();
+	while(a < num_a || b < unique) {
+		bool take_a = b == unique || (a < num_a && grad.rows[a] <= rows[b]);
+		bool take_b = a == num_a || (b < unique && rows[b] <= grad.rows[a]);
+		const Dtype* value_a = grad.values.data() + a * cols;
+		const Dtype* value_b = values.data() + b * cols;
+		merged_rows.push_back(take_a ? grad.rows[a] : rows[b]);
+		if(take_a && take_b) {
+			for(index_t c = 0; c < cols; c++)
+				merged_values.push_back(value_a[c] + value_b[c]);
+		} else {
+			const Dtype* value = take_a ? value_a : value_b;
+			merged_values.insert(merged_values.end(), value, value + cols);
+		}
+		a += take_a;
+		b += take_b;
+	}
+	grad.rows.swap(merged_rows);
+	grad.values.swap(merged_values);
+}
+
+// table[row] += alpha * value for every row of grad, the sparse SGD update. Rows are unique, so they
+// are updated in parallel.
+template<typename Dtype>
+void sparse_rows_axpy(Dtype alpha, const SparseRows<Dtype>& grad, Dtype* table) {
+	index_t cols = grad.cols;
+	parallel_for(0, grad.nnz_rows(), std::max((index_t)1, 4096 / cols), [&](index_t begin, index_t end) {
+		for(index_t u = begin; u < end; u++) {
+			Dtype* row = table + grad.rows[u] * cols;
+			const Dtype* value = grad.values.data() + u * cols;
+			for(index_t c = 0; c < cols; c++)
+				row[c] += alpha * value[c];
+		}
+	});
+}
+
+// table[ids[i]] += dy[i] for n rows of cols values, the backward of gather_rows into a dense table.
+// Repeated ids are summed first by sparse_rows_add, so the rows are added in parallel without races.
+template<typename Dtype, typename Itype>
+void scatter_add_rows(index_t n, index_t cols, const Itype* ids, const Dtype* dy, Dtype* table) {
+	SparseRows<Dtype> rows(cols);
+	sparse_rows_add(n, cols, ids, dy, rows);
+	sparse_rows_axpy(Dtype(1), rows, table);
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef EXPRESSION_KERNELS_GEMM_H_
+#define EXPRESSION_KERNELS_GEMM_H_
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+#include "activation.h"
+
+namespace el {
+namespace kernel {
+
+// Blocking sizes of gemm. A (kGemmMC, kGemmKC) block of A and a (kGemmKC, kGemmNC) block of B are
+// packed into panels, then the micro kernel computes a (kGemmMR, kGemmNR) tile of C from them.
+// The tile is small enough to be kept in registers, and the inner loop over kGemmNR is the one
+// compilers vectorize.
+const index_t kGemmMR = 4;
+const index_t kGemmNR = 8;
+const index_t kGemmMC = 64;
+const index_t kGemmKC = 256;
+const index_t kGemmNC = 512;
+
+// Pack rows [i0, i0+mc) and columns [p0, p0+kc) of op(A) into panels of kGemmMR rows. In each panel,
+// the kGemmMR values of one column are adjacent. Rows out of range are padded with zero.
+template<typename Dtype>
+void pack_a(bool trans, const Dtype* a, index_t lda, index_t i0, index_t mc, index_t p0, index_t kc, Dtype* pa) {
+	for(index_t ir = 0; ir < mc; ir += kGemmMR) {
+		index_t mr = std::min(kGemmMR, mc - ir);
+		for(index_t p = 0; p < kc; p++) {
+			for(index_t r = 0; r < mr; r++) {
+				index_t i = i0 + ir + r, k = p0 + p;
+				pa[p * kGemmMR + r] = trans ? a[k * lda + i] : a[i * lda + k];
+			}
+			for(index_t r = mr; r < kGemmMR; r++)
+				pa[p * kGemmMR + r] = 0;
+		}
+		pa += kc * kGemmMR;
+	}
+}
+
+// Pack rows [p0, p0+kc) and columns [j0, j0+nc) of op(B) into panels of kGemmNR columns.
+template<typename Dtype>
+void pack_b(bool trans, const Dtype* b, index_t ldb, index_t p0, index_t kc, index_t j0, index_t nc, Dtype* pb) {
+	for(index_t jr = 0; jr < nc; jr += kGemmNR) {
+		index_t nr = std::min(kGemmNR, nc - jr);
+		for(index_t p = 0; p < kc; p++) {
+			for(index_t c = 0; c < nr; c++) {
+				index_t j = j0 + jr + c, k = p0 + p;
+				pb[p * kGemmNR + c] = trans ? b[j * ldb + k] : b[k * ldb + j];
+			}
+			for(index_t c = nr; c < kGemmNR; c++)
+				pb[p * kGemmNR + c] = 0;
+		}
+		pb += kc * kGemmNR;
+	}
+}
+
+// acc = pa * pb, where pa is a packed (kGemmMR, kc) panel and pb is a packed (kc, kGemmNR) panel.
+template<typename Dtype>
+inline void gemm_micro_kernel(index_t kc, const Dtype* pa, const Dtype* pb, Dtype* acc) {
+	for(index_t i = 0; i < kGemmMR * kGemmNR; i++)
+		acc[i] = 0;
+	for(index_t p = 0; p < kc; p++) {
+		for(index_t r = 0; r < kGemmMR; r++) {
+			Dtype a = pa[r];
+			for(index_t c = 0; c < kGemmNR; c++)
+				acc[r * kGemmNR + c] += a * pb[c];
+		}
+		pa += kGemmMR;
+		pb += kGemmNR;
+	}
+}
+
+// Blocks of op(A) and op(B) for gemm_blocked(). A PackingSource packs a block into a buffer when it's
+// needed, a PackedMatrix (below) holds all of them already. rows are the rows of op(A) or the columns
+// of op(B).
+template<typename Dtype>
+struct PackingSource {
+	static const bool needs_buffer = true;
+	bool is_a, trans;
+	const Dtype* x;
+	index_t ld;
+
+	PackingSource(bool is_a, bool trans, const Dtype* x, index_t ld): is_a(is_a), trans(trans), x(x), ld(ld) {}
+	const Dtype* block(index_t r0, index_t rows, index_t p0, index_t kc, Dtype* buffer) const {
+		if(is_a) pack_a(trans, x, ld, r0, rows, p0, kc, buffer);
+		else pack_b(trans, x, ld, p0, kc, r0, rows, buffer);
+		return buffer;
+	}
+};
+
+// op(A) or op(B) packed once, every block in the panels gemm would pack it into, so a matrix used by
+// many products (the weight of a layer at inference) skips packing. Blocks of kGemmMC rows of op(A),
+// or kGemmNC columns of op(B), are stored one after another, each one as its blocks of kGemmKC in k.
+// Full blocks are whole panels, so the block at (r0, p0) starts at r0 * k + p0 * (its padded rows).
+// The panels are aligned to a cache line.
+template<typename Dtype>
+class PackedMatrix {
+public:
+	static const bool needs_buffer = false;
+
+	PackedMatrix(void): is_a_(true), rows_(0), k_(0) {}
+	// is_a: x is A and op(A) is (rows, k), else x is B and op(B) is (k, rows).
+	void pack(bool is_a, bool trans, index_t rows, index_t k, const Dtype* x, index_t ld) {
+		is_a_ = is_a;
+		rows_ = rows;
+		k_ = k;
+		buffer_.assign(k * padded(rows) + kAlign, Dtype(0));
+		PackingSource<Dtype> source(is_a, trans, x, ld);
+		index_t block = is_a ? kGemmMC : kGemmNC;
+		for(index_t r0 = 0; r0 < rows; r0 += block) {
+			index_t rc = std::min(block, rows - r0);
+			for(index_t p0 = 0; p0 < k; p0 += kGemmKC)
+				source.block(r0, rc, p0, std::min(kGemmKC, k - p0), data() + offset(r0, rc, p0));
+		}
+	}
+	bool empty(void) const {return rows_ == 0;}
+	bool is_a(void) const {return is_a_;}
+	index_t rows(void) const {return rows_;}
+	index_t k(void) const {return k_;}
+	const Dtype* block(index_t r0, index_t rows, index_t p0, index_t kc, Dtype* buffer) const {
+		return data() + offset(r0, rows, p0);
+	}
+
+private:
+	static const index_t kAlign = 64 / sizeof(Dtype) > 0 ? 64 / sizeof(Dtype) : 1;
+	bool is_a_;
+	index_t rows_, k_;
+	std::vector<Dtype> buffer_;
+
+	index_t padded(index_t rows) const {
+		index_t panel = is_a_ ? kGemmMR : kGemmNR;
+		return (rows + panel - 1) / panel * panel;
+	}
+	index_t offset(index_t r0, index_t rows, index_t p0) const {return r0 * k_ + p0 * padded(rows);}
+	const Dtype* data(void) const {return align(buffer_.data());}
+	Dtype* data(void) {return const_cast<Dtype*>(align(buffer_.data()));}
+	static const Dtype* align(const Dtype* p) {
+		uintptr_t bytes = kAlign * sizeof(Dtype);
+		return reinterpret_cast<const Dtype*>((reinterpret_cast<uintptr_t>(p) + bytes - 1) / bytes * bytes);
+	}
+};
+
+// C = alpha * op(A) * op(B) + beta * C, with op(A) (m, k) and op(B) (k, n) given by their packed blocks.
+// epilogue is applied to each tile of C right after the last block of k is added to it.
+//
+// Blocks of C rows are computed in parallel. Each element of C is accumulated in the same order
+// whatever the thread count is, so the result is deterministic.
+template<typename Dtype, typename SourceA, typename SourceB, typename Epilogue>
+void gemm_blocked(index_t m, index_t n, index_t k, Dtype alpha, const SourceA& a, const SourceB& b,
+				  Dtype beta, Dtype* c, index_t ldc, const Epilogue& epilogue) {
+	if(m <= 0 || n <= 0) return;
+	if(beta != 1) {
+		for(index_t i = 0; i < m; i++)
+			for(index_t j = 0; j < n; j++)
+				c[i * ldc + j] = beta == 0 ? 0 : beta * c[i * ldc + j];
+	}
+	if(k <= 0 || alpha == 0) {
+		for(index_t i = 0; i < m; i++)
+			epilogue(i, 0, c + i * ldc, n);
+		return;
+	}
+
+	index_t num_mblocks = (m + kGemmMC - 1) / kGemmMC;
+	std::vector<Dtype> pb_buffer(SourceB::needs_buffer ? kGemmKC * ((kGemmNC + kGemmNR - 1) / kGemmNR * kGemmNR) : 0);
+	for(index_t j0 = 0; j0 < n; j0 += kGemmNC) {
+		index_t nc = std::min(kGemmNC, n - j0);
+		for(index_t p0 = 0; p0 < k; p0 += kGemmKC) {
+			index_t kc = std::min(kGemmKC, k - p0);
+			bool last = p0 + kc == k;
+			const Dtype* pb = b.block(j0, nc, p0, kc, pb_buffer.data());
+
+			parallel_for(0, num_mblocks, 1, [&](index_t block_begin, index_t block_end) {
+				std::vector<Dtype> pa_buffer(SourceA::needs_buffer ? kGemmMC * kc : 0);
+				Dtype acc[kGemmMR * kGemmNR];
+				for(index_t block = block_begin; block < block_end; block++) {
+					index_t i0 = block * kGemmMC;
+					index_t mc = std::min(kGemmMC, m - i0);
+					const Dtype* pa = a.block(i0, mc, p0, kc, pa_buffer.data());
+					for(index_t jr = 0; jr < nc; jr += kGemmNR) {
+						index_t nr = std::min(kGemmNR, nc - jr);
+						for(index_t ir = 0; ir < mc; ir += kGemmMR) {
+							index_t mr = std::min(kGemmMR, mc - ir);
+							gemm_micro_kernel(kc, pa + ir * kc, pb + jr * kc, acc);
+							Dtype* c_tile = c + (i0 + ir) * ldc + j0 + jr;
+							for(index_t r = 0; r < mr; r++) {
+								for(index_t cc = 0; cc < nr; cc++)
+									c_tile[r * ldc + cc] += alpha * acc[r * kGemmNR + cc];
+								if(last)
+									epilogue(i0 + ir + r, j0 + jr, c_tile + r * ldc, nr);
+							}
+						}
+					}
+				}
+			});
+		}
+	}
+}
+
+// C = alpha * op(A) * op(B) + beta * C, where all matrices are row-major, op(A) is (m, k), op(B) is (k, n)
+// and C is (m, n). op(X) is X or X^T, decided by trans_a and trans_b. lda, ldb and ldc are the row
+// strides of A, B and C as they are stored. When beta is 0, C doesn't need to be initialized.
+// epilogue is applied to each tile of C right after the last block of k is added to it.
+template<typename Dtype, typename Epilogue>
+void gemm(bool trans_a, bool trans_b, index_t m, index_t n, index_t k,
+		  Dtype alpha, const Dtype* a, index_t lda, const Dtype* b, index_t ldb,
+		  Dtype beta, Dtype* c, index_t ldc, const Epilogue& epilogue) {
+	gemm_blocked(m, n, k, alpha, PackingSource<Dtype>(true, trans_a, a, lda), PackingSource<Dtype>(false, trans_b, b, ldb),
+				 beta, c, ldc, epilogue);
+}
+
+template<typename Dtype>
+void gemm(bool trans_a, bool trans_b, index_t m, index_t n, index_t k,
+		  Dtype alpha, const Dtype* a, index_t lda, const Dtype* b, index_t ldb,
+		  Dtype beta, Dtype* c, index_t ldc) {
+	gemm(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc, NoEpilogue<Dtype>());
+}
+
+// gemm() with op(B) packed beforehand, packed_b.rows() == n and packed_b.k() == k.
+template<typename Dtype, typename Epilogue>
+void gemm_packed_b(bool trans_a, index_t m, Dtype alpha, const Dtype* a, index_t lda,
+				   const PackedMatrix<Dtype>& packed_b, Dtype beta, Dtype* c, index_t ldc, const Epilogue& epilogue) {
+	gemm_blocked(m, packed_b.rows(), packed_b.k(), alpha, PackingSource<Dtype>(true, trans_a, a, lda), packed_b,
+				 beta, c, ldc, epilogue);
+}
+
+// ******************** batched ********************
+// C = sum_i op(A[i]) * op(B[i]), the gradient of an operand shared by a batched product. The batch
+// and the inner dimension are contracted together, as one (m, batch * k) x (batch * k, n) gemm.
+// A transposed A, or a column vector A, already stacks into (batch * k, m), and a plain B into
+// (batch * k, n). Other layouts are packed into that shape first.
+template<typename Dtype>
+void batched_gemm_reduce(bool trans_a, bool trans_b, index_t batch, index_t m, index_t n, index_t k,
+						 const Dtype* a, index_t a_stride, const Dtype* b, index_t b_stride, Dtype* c) {
+	index_t lda = trans_a ? m : k;
+	index_t ldb = trans_b ? k : n;
+	index_t depth = batch * k;
+	std::vector<Dtype> packed_a, packed_b;
+
+	bool stacked_a = (trans_a && a_stride == k * m) || (k == 1 && a_stride == m);
+	if(!stacked_a) {
+		// packed_a is op(A) as (m, batch * k).
+		packed_a.resize(m * depth);
+		for(index_t i = 0; i < batch; i++)
+			for(index_t r = 0; r < m; r++)
+				for(index_t p = 0; p < k; p++)
+					packed_a[r * depth + i * k + p] = trans_a ? a[i * a_stride + p * lda + r]
+															  : a[i * a_stride + r * lda + p];
+	}
+	bool stacked_b = (!trans_b && b_stride == k * n) || (k == 1 && b_stride == n);
+	if(!stacked_b) {
+		// packed_b is op(B) as (batch * k, n).
+		packed_b.resize(depth * n);
+		for(index_t i = 0; i < batch; i++)
+			for(index_t p = 0; p < k; p++)
+				for(index_t j = 0; j < n; j++)
+					packed_b[(i * k + p) * n + j] = trans_b ? b[i * b_stride + j * ldb + p]
+															: b[i * b_stride + p * ldb + j];
+	}
+	gemm(stacked_a, false, m, n, depth, Dtype(1),
+		 stacked_a ? a : packed_a.data(), stacked_a ? m : depth,
+		 stacked_b ? b : packed_b.data(), n,
+		 Dtype(0), c, n);
+}
+
+// C[i] = op(A[i]) * op(B[i]) for i in [0, batch), where matrices of A, B and C are a_stride, b_stride and
+// c_stride apart. A stride of 0 shares one matrix over the batch, and c_stride = 0 sums all products
+// into one C, see batched_gemm_reduce(). Layouts which are really one big matrix product go to a single
+// gemm:
+//   - B shared, A not transposed: the batch of A is stacked into one (batch * m, k) matrix.
+//   - A shared, n = 1: the batch of B is one (batch, k) matrix, and C^T = B^T * op(A)^T is (batch, m).
+// The others run one gemm per matrix, which still shares the blocking of each gemm.
+template<typename Dtype>
+void batched_gemm(bool trans_a, bool trans_b, index_t batch, index_t m, index_t n, index_t k,
+				  const Dtype* a, index_t a_stride, const Dtype* b, index_t b_stride, Dtype* c, index_t c_stride) {
+	index_t lda = trans_a ? m : k;
+	index_t ldb = trans_b ? k : n;
+	if(c_stride == 0 && batch > 1) {
+		batched_gemm_reduce(trans_a, trans_b, batch, m, n, k, a, a_stride, b, b_stride, c);
+	} else if(c_stride == m * n && b_stride == 0 && !trans_a && (a_stride == m * k || batch == 1)) {
+		gemm(false, trans_b, batch * m, n, k, Dtype(1), a, lda, b, ldb, Dtype(0), c, n);
+	} else if(c_stride == m && a_stride == 0 && n == 1 && (b_stride == k || batch == 1)) {
+		gemm(false, !trans_a, batch, m, k, Dtype(1), b, k, a, lda, Dtype(0), c, m);
+	} else {
+		for(index_t i = 0; i < batch; i++)
+			gemm(trans_a, trans_b, m, n, k, Dtype(1), a + i * a_stride, lda, b + i * b_stride, ldb,
+				 Dtype(0), c + i * c_stride, n);
+	}
+}
+
+// ******************** gemv ********************
+// y = act(W x + bias) for a single input row x (in) and W (out, in), the batch-1 case of a linear layer,
+// where gemm would pack the whole weight for one row. The weight is stored transposed, wt (in, out), so
+// every x[i] scales a contiguous row of wt, which vectorizes without reordering any sum, unlike dot
+// products of W's rows. Outputs go by blocks kept in L1 while the rows of wt stream over them, and
+// blocks are split over threads only when there's enough weight to pay for it. Zero inputs, which are
+// common after a ReLU, skip their row. bias can be nullptr.
+const index_t kGemvBlock = 64;
+
+template<typename Dtype>
+void gemv_t(index_t in, index_t out, const Dtype* x, const Dtype* wt, const Dtype* bias,
+			Activation act, Dtype* y) {
+	index_t num_blocks = (out + kGemvBlock - 1) / kGemvBlock;
+	index_t grain = std::max((index_t)1, (1 << 17) / std::max(in * kGemvBlock, (index_t)1));
+	parallel_for(0, num_blocks, grain, [&](index_t block_begin, index_t block_end) {
+		Dtype acc[kGemvBlock];
+		for(index_t block = block_begin; block < block_end; block++) {
+			index_t j0 = block * kGemvBlock;
+			index_t len = std::min(kGemvBlock, out - j0);
+			for(index_t j = 0; j < len; j++)
+				acc[j] = bias == nullptr ? Dtype(0) : bias[j0 + j];
+			for(index_t i = 0; i < in; i++) {
+				Dtype xi = x[i];
+				if(xi == 0) continue;
+				const Dtype* wt_row = wt + i * out + j0;
+				for(index_t j = 0; j < len; j++)
+					acc[j] += xi * wt_row[j];
+			}
+			activation_forward(act, acc, y + j0, len);
+		}
+	});
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef EXPRESSION_KERNELS_LAYOUT_H_
+#define EXPRESSION_KERNELS_LAYOUT_H_
+
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/layout.h"
+#include "../../utils/parallel.h"
+
+namespace el {
+namespace kernel {
+
+// Copy x (batch, channels, plane) stored in layout from into y stored in layout to. Padded channels
+// of y are zeroed. Work is split by output channel block and by runs of pixels, and each channel is
+// copied as one strided loop, which is unit stride on at least one side unless both layouts are blocked.
+template<typename Dtype>
+void convert_layout(Layout from, Layout to, index_t batch, index_t channels, index_t plane,
+					const Dtype* x, Dtype* y) {
+	index_t in_block = layout_block(from, channels), in_blocks = layout_blocks(from, channels);
+	index_t out_block = layout_block(to, channels), out_blocks = layout_blocks(to, channels);
+	const index_t run = 256;
+	index_t runs = (plane + run - 1) / run;
+	parallel_for(0, batch * out_blocks * runs, 1, [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t image_block = task / runs;
+			index_t n = image_block / out_blocks, b = image_block % out_blocks;
+			index_t p0 = task % runs * run, p1 = std::min(p0 + run, plane);
+			Dtype* y_block = y + image_block * plane * out_block;
+			for(index_t k = 0; k < out_block; k++) {
+				index_t c = b * out_block + k;
+				if(c >= channels) {
+					for(index_t p = p0; p < p1; p++)
+						y_block[p * out_block + k] = 0;
+					continue;
+				}
+				const Dtype* x_channel = x + (n * in_blocks + c / in_block) * plane * in_block + c % in_block;
+				for(index_t p = p0; p < p1; p++)
+					y_block[p * out_block + k] = x_channel[p * in_block];
+			}
+		}
+	});
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef EXPRESSION_KERNELS_MATH_H_
+#define EXPRESSION_KERNELS_MATH_H_
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "../../utils/base.h"
+
+namespace el {
+namespace kernel {
+
+// exp, log, tanh, sigmoid, erf and GELU written without branches or libm calls, so loops over them
+// are vectorized by the compiler, for whatever vector width the target has. Arguments are reduced into
+// a small interval where the Cephes polynomials apply. Special cases are handled by computing every
+// path and selecting one, which gcc only turns into vector blends under -fno-trapping-math, so the
+// build scripts pass it, along with -march=native for the wide vectors.
+//
+// Measured against libm, errors are within 3 ulp, except for double GELU, which is within 16 ulp
+// around x = -1.4 where erfc is taken as 1 - erf. Float erf and GELU are computed in double.
+//
+// The array versions take x and y of n elements, in place is fine.
+
+namespace math_detail {
+
+inline int64_t bits(double x) {int64_t i; std::memcpy(&i, &x, sizeof(i)); return i;}
+inline int32_t bits(float x) {int32_t i; std::memcpy(&i, &x, sizeof(i)); return i;}
+inline double double_from(int64_t i) {double x; std::memcpy(&x, &i, sizeof(x)); return x;}
+inline float float_from(int32_t i) {float x; std::memcpy(&x, &i, sizeof(x)); return x;}
+
+// x * 2^n. n is split in two halves, so every n an exp() can produce, from subnormal results to
+// overflows, has both factors in the normal range.
+inline double scale(double x, int64_t n) {
+	int64_t n1 = n >> 1, n2 = n - n1;
+	return x * double_from((n1 + 1023) << 52) * double_from((n2 + 1023) << 52);
+}
+inline float scale(float x, int32_t n) {
+	int32_t n1 = n >> 1, n2 = n - n1;
+	return x * float_from((n1 + 127) << 23) * float_from((n2 + 127) << 23);
+}
+
+}  // namespace math_detail
+
+// ******************** exp ********************
+// exp(x) = 2^n * exp(r) with n = round(x / ln2), |r| <= ln2 / 2. Rounding adds and subtracts 1.5 * 2^52,
+// which also leaves n in the low bits of the sum.
+inline double vexp(double x) {
+	const double round_magic = 6755399441055744.0;
+	x = x < -746.0 ? -746.0 : x;
+	x = x > 710.0 ? 710.0 : x;
+	double t = x * 1.4426950408889634073599 + round_magic;
+	int64_t n = math_detail::bits(t) - math_detail::bits(round_magic);
+	double fn = t - round_magic;
+	double r = x - fn * 6.93145751953125E-1 - fn * 1.42860682030941723212E-6;
+	double rr = r * r;
+	double p = r * ((1.26177193074810590878E-4 * rr + 3.02994407707441961300E-2) * rr + 9.99999999999999999910E-1);
+	double q = ((3.00198505138664455042E-6 * rr + 2.52448340349684104192E-3) * rr + 2.27265548208155028766E-1) * rr
+			   + 2.00000000000000000009E0;
+	return math_detail::scale(1 + 2 * p / (q - p), n);
+}
+
+inline float vexp(float x) {
+	const float round_magic = 12582912.0f;
+	x = x < -104.0f ? -104.0f : x;
+	x = x > 89.0f ? 89.0f : x;
+	float t = x * 1.44269504088896341f + round_magic;
+	int32_t n = math_detail::bits(t) - math_detail::bits(round_magic);
+	float fn = t - round_magic;
+	float r = x - fn * 0.693359375f + fn * 2.12194440e-4f;
+	float p = ((((1.9875691500E-4f * r + 1.3981999507E-3f) * r + 8.3334519073E-3f) * r + 4.1665795894E-2f) * r
+			   + 1.6666665459E-1f) * r + 5.0000001201E-1f;
+	return math_detail::scale(p * r * r + r + 1, n);
+}
+
+// ******************** log ********************
+// log(x) = e * ln2 + log(m) with m in [sqrt(1/2), sqrt(2)). Subnormals are scaled up first. Zero gives
+// -inf, negatives and NaN give NaN.
+inline double vlog(double x) {
+	bool subnormal = x < std::numeric_limits<double>::min();
+	double v = subnormal ? x * 18014398509481984.0 : x;
+	int64_t i = math_detail::bits(v);
+	int32_t e = (int32_t)((i >> 52) & 0x7ff) - 1022 - (subnormal ? 54 : 0);
+	double m = math_detail::double_from((i & 0x000fffffffffffffLL) | 0x3fe0000000000000LL);
+	bool low = m < 0.70710678118654752440;
+	e = low ? e - 1 : e;
+	m = low ? m + m - 1 : m - 1;
+	double fe = (double)e;
+	double z = m * m;
+	double p = ((((1.01875663804580931796E-4 * m + 4.97494994976747001425E-1) * m + 4.70579119878881725854E0) * m
+				 + 1.44989225341610930846E1) * m + 1.79368678507819816313E1) * m + 7.70838733755885391666E0;
+	double q = ((((m + 1.12873587189167450590E1) * m + 4.52279145837532221105E1) * m + 8.29875266912776603211E1) * m
+				+ 7.11544750618563894466E1) * m + 2.31251620126765340583E1;
+	double y = m * z * p / q - fe * 2.121944400546905827679E-4 - 0.5 * z;
+	double result = m + y + fe * 0.693359375;
+	result = x == std::numeric_limits<double>::infinity() ? x : result;
+	result = x == 0 ? -std::numeric_limits<double>::infinity() : result;
+	return x < 0 || x != x ? std::numeric_limits<double>::quiet_NaN() : result;
+}
+
+inline float vlog(float x) {
+	bool subnormal = x < std::numeric_limits<float>::min();
+	float v = subnormal ? x * 33554432.0f : x;
+	int32_t i = math_detail::bits(v);
+	int32_t e = ((i >> 23) & 0xff) - 126 - (subnormal ? 25 : 0);
+	float m = math_detail::float_from((i & 0x007fffff) | 0x3f000000);
+	bool low = m < 0.707106781186547524f;
+	e = low ? e - 1 : e;
+	m = low ? m + m - 1 : m - 1;
+	float fe = (float)e;
+	float z = m * m;
+	float p = ((((((((7.0376836292E-2f * m - 1.1514610310E-1f) * m + 1.1676998740E-1f) * m - 1.2420140846E-1f) * m
+				  + 1.4249322787E-1f) * m - 1.6668057665E-1f) * m + 2.0000714765E-1f) * m - 2.4999993993E-1f) * m
+			  + 3.3333331174E-1f);
+	float y = p * m * z - fe * 2.12194440e-4f - 0.5f * z;
+	float result = m + y + fe * 0.693359375f;
+	result = x == std::numeric_limits<float>::infinity() ? x : result;
+	result = x == 0 ? -std::numeric_limits<float>::infinity() : result;
+	return x < 0 || x != x ? std::numeric_limits<float>::quiet_NaN() : result;
+}
+
+// ******************** tanh and sigmoid ********************
+// A rational function of x^2 below 0.625, 1 - 2 / (exp(2|x|) + 1) above it. Both are computed and
+// the right one selected, which is cheaper than a branch once vectorized.
+inline double vtanh(double x) {
+	double a = x < 0 ? -x : x;
+	double z = x * x;
+	double p = (-9.64399179425052238628E-1 * z - 9.92877231001918586564E1) * z - 1.61468768441708447952E3;
+	double q = ((z + 1.12811678491632931402E2) * z + 2.23548839060100448583E3) * z + 4.84406305325125486048E3;
+	double small = x + x * z * p / q;
+	double large = 1 - 2 / (vexp(a + a) + 1);
+	large = x < 0 ? -large : large;
+	return a < 0.625 ? small : large;
+}
+
+inline float vtanh(float x) {
+	float a = x < 0 ? -x : x;
+	float z = x * x;
+	float small = ((((-5.70498872745E-3f * z + 2.06390887954E-2f) * z - 5.37397155531E-2f) * z
+				   + 1.33314422036E-1f) * z - 3.33332819422E-1f) * z * x + x;
+	float large = 1 - 2 / (vexp(a + a) + 1);
+	large = x < 0 ? -large : large;
+	return a < 0.625f ? small : large;
+}
+
+// 1 / (1 + exp(-x)), or exp(x) / (1 + exp(x)) for negative x, which doesn't overflow.
+template<typename Dtype>
+inline Dtype vsigmoid(Dtype x) {
+	Dtype e = vexp(x < 0 ? x : -x);
+	Dtype s = 1 / (1 + e);
+	return x < 0 ? e * s : s;
+}
+
+// ******************** erf, erfc and GELU ********************
+namespace math_detail {
+
+// exp(-k * x^2) for k = 1 or 1/2. x^2 is split into the exact square of the upper half of x and a
+// small rest, otherwise the rounding of x^2 is amplified by exp.
+inline double exp_minus_square(double x, double k) {
+	x = x > 40 ? 40 : x;
+	double high = (double)(float)x;
+	double low = x - high;
+	return vexp(-k * high * high) * vexp(-k * (high + x) * low);
+}
+
+// erfc(a) for a >= 0, given e = exp(-a^2). Below 1 it's 1 - erf(a), above it e * P(a) / Q(a).
+inline double erfc_positive(double a, double e) {
+	a = a > 40 ? 40 : a;
+	double z = a * a;
+	double t = (((9.60497373987051638749E0 * z + 9.00260197203842689217E1) * z + 2.23200534594684319226E3) * z
+				+ 7.00332514112805075473E3) * z + 5.55923013010394962768E4;
+	double u = ((((z + 3.35617141647503099647E1) * z + 5.21357949780152679795E2) * z + 4.59432382970980127987E3) * z
+				+ 2.26290000613890934246E4) * z + 4.92673942608635921086E4;
+	double near = 1 - a * t / u;
+
+	double p = (((((((2.46196981473530512524E-10 * a + 5.64189564831068821977E-1) * a + 7.46321056442269912687E0) * a
+				   + 4.86371970985681366614E1) * a + 1.96520832956077098242E2) * a + 5.26445194995477358631E2) * a
+				 + 9.34528527171957607540E2) * a + 1.02755188689515710272E3) * a + 5.57535335369399327526E2;
+	double q = (((((((a + 1.32281951154744992508E1) * a + 8.67072140885989742329E1) * a + 3.54937778887819891062E2) * a
+				   + 9.75708501743205489753E2) * a + 1.82390916687909736289E3) * a + 2.24633760818710981792E3) * a
+				 + 1.65666309194161350182E3) * a + 5.57535340817727675546E2;
+	double r = ((((5.64189583547755073984E-1 * a + 1.27536670759978104416E0) * a + 5.01905042251180477414E0) * a
+				 + 6.16021097993053585195E0) * a + 7.40974269950448939160E0) * a + 2.97886665372100240670E0;
+	double s = (((((a + 2.26052863220117276590E0) * a + 9.39603524938001434673E0) * a + 1.20489539808096656605E1) * a
+				 + 1.70814450747565897222E1) * a + 9.60896809063285878198E0) * a + 3.36907645100081516050E0;
+	double far = a < 8 ? e * p / q : e * r / s;
+	return a < 1 ? near : far;
+}
+
+}  // namespace math_detail
+
+inline double verf(double x) {
+	double a = x < 0 ? -x : x;
+	double z = x * x;
+	double t = (((9.60497373987051638749E0 * z + 9.00260197203842689217E1) * z + 2.23200534594684319226E3) * z
+				+ 7.00332514112805075473E3) * z + 5.55923013010394962768E4;
+	double u = ((((z + 3.35617141647503099647E1) * z + 5.21357949780152679795E2) * z + 4.59432382970980127987E3) * z
+				+ 2.26290000613890934246E4) * z + 4.92673942608635921086E4;
+	double large = 1 - math_detail::erfc_positive(a, math_detail::exp_minus_square(a, 1));
+	large = x < 0 ? -large : large;
+	return a < 1 ? x * t / u : large;
+}
+inline float verf(float x) {return (float)verf((double)x);}
+
+inline double verfc(double x) {
+	double a = x < 0 ? -x : x;
+	double c = math_detail::erfc_positive(a, math_detail::exp_minus_square(a, 1));
+	return x < 0 ? 2 - c : c;
+}
+inline float verfc(float x) {return (float)verfc((double)x);}
+
+// Standard normal cdf, Phi(x) = erfc(-x / sqrt(2)) / 2. The left tail comes from erfc directly, so
+// it keeps its relative precision, and exp(-x^2 / 2) is taken from x rather than from x / sqrt(2).
+inline double vnormal_cdf(double x) {
+	double a = x < 0 ? -x : x;
+	double c = 0.5 * math_detail::erfc_positive(a * 0.70710678118654752440, math_detail::exp_minus_square(a, 0.5));
+	return x < 0 ? c : 1 - c;
+}
+inline float vnormal_cdf(float x) {return (float)vnormal_cdf((double)x);}
+
+// GELU(x) = x * Phi(x).
+inline double vgelu(double x) {return x * vnormal_cdf(x);}
+inline float vgelu(float x) {return (float)vgelu((double)x);}
+
+// ******************** arrays ********************
+#define EL_MATH_ARRAY_FUNC(name)											\
+	template<typename Dtype>												\
+	void name(const Dtype* x, Dtype* y, index_t n) {						\
+		_Pragma("omp simd")													\
+		for(index_t i = 0; i < n; i++)										\
+			y[i] = name(x[i]);												\
+	}
+
+EL_MATH_ARRAY_FUNC(vexp)
+EL_MATH_ARRAY_FUNC(vlog)
+EL_MATH_ARRAY_FUNC(vtanh)
+EL_MATH_ARRAY_FUNC(vsigmoid)
+EL_MATH_ARRAY_FUNC(verf)
+EL_MATH_ARRAY_FUNC(vnormal_cdf)
+EL_MATH_ARRAY_FUNC(vgelu)
+
+#undef EL_MATH_ARRAY_FUNC
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
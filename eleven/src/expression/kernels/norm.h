@@ -0,0 +1,455 @@
+#ifndef EXPRESSION_KERNELS_NORM_H_
+#define EXPRESSION_KERNELS_NORM_H_
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/layout.h"
+#include "../../utils/parallel.h"
+
+namespace el {
+namespace kernel {
+
+// ******************** Welford ********************
+// Running mean and m2 (sum of squared deviations) of each of cols columns over rows rows, row r
+// starting at x + r * ld. Every column has seen the same number of values, so the update of a whole
+// row shares one 1 / count and vectorizes over the columns. One read of x, and no cancellation
+// like sum(x^2) - sum(x)^2 has.
+template<typename Dtype>
+void welford_columns(index_t rows, index_t cols, const Dtype* x, index_t ld, Dtype* mean, Dtype* m2) {
+	std::fill(mean, mean + cols, Dtype(0));
+	std::fill(m2, m2 + cols, Dtype(0));
+	for(index_t r = 0; r < rows; r++) {
+		const Dtype* x_row = x + r * ld;
+		Dtype inv_count = Dtype(1) / (r + 1);
+		for(index_t c = 0; c < cols; c++) {
+			Dtype delta = x_row[c] - mean[c];
+			mean[c] += delta * inv_count;
+			m2[c] += delta * (x_row[c] - mean[c]);
+		}
+	}
+}
+
+// Mean and m2 of n contiguous values in one pass. Eight Welford lanes take every eighth value, they're
+// the columns of welford_columns, then the lanes are merged like the pixels of batch_norm_statistics
+// and the tail is added one by one.
+template<typename Dtype>
+inline void welford_contiguous(const Dtype* x, index_t n, Dtype& mean, Dtype& m2) {
+	const index_t lanes = 8;
+	index_t rows = n / lanes;
+	mean = 0;
+	m2 = 0;
+	if(rows > 0) {
+		Dtype lane_mean[lanes], lane_m2[lanes];
+		welford_columns(rows, lanes, x, lanes, lane_mean, lane_m2);
+		Dtype sum = 0, spread = 0;
+		for(index_t k = 0; k < lanes; k++)
+			sum += lane_mean[k];
+		mean = sum / lanes;
+		for(index_t k = 0; k < lanes; k++) {
+			Dtype d = lane_mean[k] - mean;
+			m2 += lane_m2[k];
+			spread += d * d;
+		}
+		m2 += rows * spread;
+	}
+	for(index_t i = rows * lanes; i < n; i++) {
+		Dtype delta = x[i] - mean;
+		mean += delta / (i + 1);
+		m2 += delta * (x[i] - mean);
+	}
+}
+
+// Sum of squares of n contiguous values, with lanes like reduce_contiguous.
+template<typename Dtype>
+inline Dtype sum_squares_contiguous(const Dtype* x, index_t n) {
+	const index_t lanes = 8;
+	Dtype acc[lanes] = {0};
+	index_t i = 0;
+	for(; i + lanes <= n; i += lanes)
+		for(index_t k = 0; k < lanes; k++)
+			acc[k] += x[i + k] * x[i + k];
+	for(; i < n; i++)
+		acc[0] += x[i] * x[i];
+	for(index_t width = lanes / 2; width > 0; width /= 2)
+		for(index_t k = 0; k < width; k++)
+			acc[k] += acc[k + width];
+	return acc[0];
+}
+
+// ******************** batch norm ********************
+// x is (batch, channels, plane), where plane = h * w for images, or 1 for (batch, features).
+
+// Mean and biased variance of every channel over the batch and the plane, in one pass over x.
+// Features (plane = 1) are the columns of x, so chunks of them are Welford columns directly. An image
+// channel keeps one column per pixel over the batch, then the pixels are merged. They all hold batch
+// values, and Chan's formula for equal counts is mean = average of the means and
+// m2 = sum of the m2 + batch * sum of (pixel mean - mean)^2.
+template<typename Dtype>
+void batch_norm_statistics(index_t batch, index_t channels, index_t plane, const Dtype* x,
+						   Dtype* mean, Dtype* var) {
+	index_t count = batch * plane;
+	if(plane == 1) {
+		parallel_for(0, channels, std::max((index_t)64, 16384 / std::max(batch, (index_t)1)),
+					 [&](index_t begin, index_t end) {
+			welford_columns(batch, end - begin, x + begin, channels, mean + begin, var + begin);
+			for(index_t c = begin; c < end; c++)
+				var[c] /= count;
+		});
+		return;
+	}
+	parallel_for(0, channels, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> pixel_mean(plane), pixel_m2(plane);
+		for(index_t c = begin; c < end; c++) {
+			welford_columns(batch, plane, x + c * plane, channels * plane, pixel_mean.data(), pixel_m2.data());
+			Dtype sum = 0;
+			for(index_t p = 0; p < plane; p++)
+				sum += pixel_mean[p];
+			Dtype m = sum / plane, m2 = 0, spread = 0;
+			for(index_t p = 0; p < plane; p++) {
+				Dtype d = pixel_mean[p] - m;
+				m2 += pixel_m2[p];
+				spread += d * d;
+			}
+			mean[c] = m;
+			var[c] = (m2 + batch * spread) / count;
+		}
+	});
+}
+
+// y = x * scale[c] + shift[c] for channel c. Normalization and the affine transform folded together.
+template<typename Dtype>
+void batch_norm_apply(index_t batch, index_t channels, index_t plane, const Dtype* x,
+					  const Dtype* scale, const Dtype* shift, Dtype* y) {
+	if(plane == 1) {
+		parallel_for(0, batch, std::max((index_t)1, 4096 / channels), [&](index_t begin, index_t end) {
+			for(index_t b = begin; b < end; b++) {
+				const Dtype* x_row = x + b * channels;
+				Dtype* y_row = y + b * channels;
+				for(index_t c = 0; c < channels; c++)
+					y_row[c] = x_row[c] * scale[c] + shift[c];
+			}
+		});
+		return;
+	}
+	parallel_for(0, batch * channels, std::max((index_t)1, 4096 / plane), [&](index_t begin, index_t end) {
+		for(index_t bc = begin; bc < end; bc++) {
+			Dtype s = scale[bc % channels], t = shift[bc % channels];
+			const Dtype* x_plane = x + bc * plane;
+			Dtype* y_plane = y + bc * plane;
+			for(index_t p = 0; p < plane; p++)
+				y_plane[p] = x_plane[p] * s + t;
+		}
+	});
+}
+
+// sum_dy[c] = sum of dy and sum_dy_xhat[c] = sum of dy * xhat over a channel, both in one pass, where
+// xhat = (x - mean) * inv_std is recomputed instead of stored. They're the gradients of the bias
+// and the weight.
+template<typename Dtype>
+void batch_norm_backward_reduce(index_t batch, index_t channels, index_t plane, const Dtype* x, const Dtype* dy,
+								const Dtype* mean, const Dtype* inv_std, Dtype* sum_dy, Dtype* sum_dy_xhat) {
+	if(plane == 1) {
+		parallel_for(0, channels, std::max((index_t)64, 16384 / std::max(batch, (index_t)1)),
+					 [&](index_t begin, index_t end) {
+			std::fill(sum_dy + begin, sum_dy + end, Dtype(0));
+			std::fill(sum_dy_xhat + begin, sum_dy_xhat + end, Dtype(0));
+			for(index_t b = 0; b < batch; b++) {
+				const Dtype* x_row = x + b * channels;
+				const Dtype* dy_row = dy + b * channels;
+				for(index_t c = begin; c < end; c++) {
+					sum_dy[c] += dy_row[c];
+					sum_dy_xhat[c] += dy_row[c] * (x_row[c] - mean[c]);
+				}
+			}
+			for(index_t c = begin; c < end; c++)
+				sum_dy_xhat[c] *= inv_std[c];
+		});
+		return;
+	}
+	// One partial sum per pixel, so the loops over a plane vectorize without reordering a sum.
+	parallel_for(0, channels, 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> pixel_dy(plane), pixel_dy_xc(plane);
+		for(index_t c = begin; c < end; c++) {
+			Dtype m = mean[c];
+			std::fill(pixel_dy.begin(), pixel_dy.end(), Dtype(0));
+			std::fill(pixel_dy_xc.begin(), pixel_dy_xc.end(), Dtype(0));
+			for(index_t b = 0; b < batch; b++) {
+				const Dtype* x_plane = x + (b * channels + c) * plane;
+				const Dtype* dy_plane = dy + (b * channels + c) * plane;
+				for(index_t p = 0; p < plane; p++) {
+					pixel_dy[p] += dy_plane[p];
+					pixel_dy_xc[p] += dy_plane[p] * (x_plane[p] - m);
+				}
+			}
+			Dtype s = 0, sx = 0;
+			for(index_t p = 0; p < plane; p++) {
+				s += pixel_dy[p];
+				sx += pixel_dy_xc[p];
+			}
+			sum_dy[c] = s;
+			sum_dy_xhat[c] = sx * inv_std[c];
+		}
+	});
+}
+
+// dx = dy * a[c] + x * b[c] + d[c]. With statistics of the batch, the gradient through the mean and
+// the variance is
+//   dx = weight * inv_std * (dy - sum_dy / n - xhat * sum_dy_xhat / n),
+// which is that form once xhat is expanded. With fixed statistics, it's only dy * weight * inv_std.
+template<typename Dtype>
+void batch_norm_backward_data(index_t batch, index_t channels, index_t plane, const Dtype* dy, const Dtype* x,
+							  const Dtype* a, const Dtype* b, const Dtype* d, Dtype* dx) {
+	if(plane == 1) {
+		parallel_for(0, batch, std::max((index_t)1, 4096 / channels), [&](index_t begin, index_t end) {
+			for(index_t r = begin; r < end; r++) {
+				const Dtype* dy_row = dy + r * channels;
+				const Dtype* x_row = x + r * channels;
+				Dtype* dx_row = dx + r * channels;
+				for(index_t c = 0; c < channels; c++)
+					dx_row[c] = dy_row[c] * a[c] + x_row[c] * b[c] + d[c];
+			}
+		});
+		return;
+	}
+	parallel_for(0, batch * channels, std::max((index_t)1, 4096 / plane), [&](index_t begin, index_t end) {
+		for(index_t bc = begin; bc < end; bc++) {
+			index_t c = bc % channels;
+			Dtype a_c = a[c], b_c = b[c], d_c = d[c];
+			const Dtype* dy_plane = dy + bc * plane;
+			const Dtype* x_plane = x + bc * plane;
+			Dtype* dx_plane = dx + bc * plane;
+			for(index_t p = 0; p < plane; p++)
+				dx_plane[p] = dy_plane[p] * a_c + x_plane[p] * b_c + d_c;
+		}
+	});
+}
+
+// ******************** batch norm, channels innermost ********************
+// x is a batch of images in NHWC or a blocked layout, (batch, blocks, plane, block) in memory, so an
+// image's channel block is plane rows of block channels. Every loop runs over the channels of a pixel
+// and vectorizes, like the depthwise convolution does. Padded channels are left out of the statistics
+// and written as zeros.
+
+// Per channel values padded with zeros to whole blocks.
+template<typename Dtype>
+std::vector<Dtype> pad_channels(Layout layout, index_t channels, const Dtype* v) {
+	std::vector<Dtype> padded(layout_blocks(layout, channels) * layout_block(layout, channels), Dtype(0));
+	std::copy(v, v + channels, padded.begin());
+	return padded;
+}
+
+// One Welford pass per image and block, in parallel, then the images of a channel are merged by Chan's
+// formula for equal counts, as the pixels are in batch_norm_statistics.
+template<typename Dtype>
+void batch_norm_blocked_statistics(Layout layout, index_t batch, index_t channels, index_t plane,
+								   const Dtype* x, Dtype* mean, Dtype* var) {
+	index_t block = layout_block(layout, channels), blocks = layout_blocks(layout, channels);
+	std::vector<Dtype> image_mean(batch * blocks * block), image_m2(batch * blocks * block);
+	parallel_for(0, batch * blocks, 1, [&](index_t begin, index_t end) {
+		for(index_t g = begin; g < end; g++)
+			welford_columns(plane, block, x + g * plane * block, block,
+							image_mean.data() + g * block, image_m2.data() + g * block);
+	});
+	for(index_t c = 0; c < channels; c++) {
+		index_t stride = blocks * block;
+		Dtype sum = 0;
+		for(index_t n = 0; n < batch; n++)
+			sum += image_mean[n * stride + c];
+		Dtype m = sum / batch, m2 = 0, spread = 0;
+		for(index_t n = 0; n < batch; n++) {
+			Dtype d = image_mean[n * stride + c] - m;
+			m2 += image_m2[n * stride + c];
+			spread += d * d;
+		}
+		mean[c] = m;
+		var[c] = (m2 + plane * spread) / (batch * plane);
+	}
+}
+
+// y = x * scale[c] + shift[c], see batch_norm_apply.
+template<typename Dtype>
+void batch_norm_blocked_apply(Layout layout, index_t batch, index_t channels, index_t plane, const Dtype* x,
+							  const Dtype* scale, const Dtype* shift, Dtype* y) {
+	index_t block = layout_block(layout, channels), blocks = layout_blocks(layout, channels);
+	std::vector<Dtype> s = pad_channels(layout, channels, scale), t = pad_channels(layout, channels, shift);
+	parallel_for(0, batch * blocks * plane, std::max((index_t)1, 4096 / block), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			index_t b = i / plane % blocks;
+			const Dtype* s_block = s.data() + b * block;
+			const Dtype* t_block = t.data() + b * block;
+			const Dtype* x_pixel = x + i * block;
+			Dtype* y_pixel = y + i * block;
+			for(index_t k = 0; k < block; k++)
+				y_pixel[k] = x_pixel[k] * s_block[k] + t_block[k];
+		}
+	});
+}
+
+// See batch_norm_backward_reduce. Partial sums per image and block, in parallel, then added up per
+// channel in order.
+template<typename Dtype>
+void batch_norm_blocked_backward_reduce(Layout layout, index_t batch, index_t channels, index_t plane,
+										const Dtype* x, const Dtype* dy, const Dtype* mean, const Dtype* inv_std,
+										Dtype* sum_dy, Dtype* sum_dy_xhat) {
+	index_t block = layout_block(layout, channels), blocks = layout_blocks(layout, channels);
+	std::vector<Dtype> m = pad_channels(layout, channels, mean);
+	std::vector<Dtype> image_dy(batch * blocks * block, Dtype(0)), image_dy_xc(batch * blocks * block, Dtype(0));
+	parallel_for(0, batch * blocks, 1, [&](index_t begin, index_t end) {
+		for(index_t g = begin; g < end; g++) {
+			const Dtype* m_block = m.data() + g % blocks * block;
+			Dtype* s = image_dy.data() + g * block;
+			Dtype* sx = image_dy_xc.data() + g * block;
+			for(index_t p = 0; p < plane; p++) {
+				const Dtype* x_pixel = x + (g * plane + p) * block;
+				const Dtype* dy_pixel = dy + (g * plane + p) * block;
+				for(index_t k = 0; k < block; k++) {
+					s[k] += dy_pixel[k];
+					sx[k] += dy_pixel[k] * (x_pixel[k] - m_block[k]);
+				}
+			}
+		}
+	});
+	for(index_t c = 0; c < channels; c++) {
+		index_t stride = blocks * block;
+		Dtype s = 0, sx = 0;
+		for(index_t n = 0; n < batch; n++) {
+			s += image_dy[n * stride + c];
+			sx += image_dy_xc[n * stride + c];
+		}
+		sum_dy[c] = s;
+		sum_dy_xhat[c] = sx * inv_std[c];
+	}
+}
+
+// dx = dy * a[c] + x * b[c] + d[c], see batch_norm_backward_data.
+template<typename Dtype>
+void batch_norm_blocked_backward_data(Layout layout, index_t batch, index_t channels, index_t plane,
+									  const Dtype* dy, const Dtype* x, const Dtype* a, const Dtype* b,
+									  const Dtype* d, Dtype* dx) {
+	index_t block = layout_block(layout, channels), blocks = layout_blocks(layout, channels);
+	std::vector<Dtype> a_pad = pad_channels(layout, channels, a), b_pad = pad_channels(layout, channels, b);
+	std::vector<Dtype> d_pad = pad_channels(layout, channels, d);
+	parallel_for(0, batch * blocks * plane, std::max((index_t)1, 4096 / block), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			index_t offset = i / plane % blocks * block;
+			const Dtype* a_block = a_pad.data() + offset;
+			const Dtype* b_block = b_pad.data() + offset;
+			const Dtype* d_block = d_pad.data() + offset;
+			const Dtype* dy_pixel = dy + i * block;
+			const Dtype* x_pixel = x + i * block;
+			Dtype* dx_pixel = dx + i * block;
+			for(index_t k = 0; k < block; k++)
+				dx_pixel[k] = dy_pixel[k] * a_block[k] + x_pixel[k] * b_block[k] + d_block[k];
+		}
+	});
+}
+
+// ******************** layer norm ********************
+// x is (rows, cols), and every row is normalized over its cols values, with weight and bias of cols
+// values. A row is read once from memory: its statistics take one pass, and the output is written
+// while the row is still in cache. rstd = 1 / sqrt(var + eps) and, for layer norm, the mean of each
+// row are kept for backward.
+
+// y = (x - mean) * rstd * weight + bias.
+template<typename Dtype>
+void layer_norm_rows(index_t rows, index_t cols, const Dtype* x, const Dtype* weight, const Dtype* bias,
+					 Dtype eps, Dtype* y, Dtype* mean, Dtype* rstd) {
+	parallel_for(0, rows, std::max((index_t)1, 4096 / cols), [&](index_t begin, index_t end) {
+		for(index_t r = begin; r < end; r++) {
+			const Dtype* x_row = x + r * cols;
+			Dtype* y_row = y + r * cols;
+			Dtype m, m2;
+			welford_contiguous(x_row, cols, m, m2);
+			Dtype s = Dtype(1) / std::sqrt(m2 / cols + eps);
+			mean[r] = m;
+			rstd[r] = s;
+			for(index_t c = 0; c < cols; c++)
+				y_row[c] = (x_row[c] - m) * s * weight[c] + bias[c];
+		}
+	});
+}
+
+// y = x * rstd * weight, with rstd = 1 / sqrt(mean of x^2 + eps).
+template<typename Dtype>
+void rms_norm_rows(index_t rows, index_t cols, const Dtype* x, const Dtype* weight,
+				   Dtype eps, Dtype* y, Dtype* rstd) {
+	parallel_for(0, rows, std::max((index_t)1, 4096 / cols), [&](index_t begin, index_t end) {
+		for(index_t r = begin; r < end; r++) {
+			const Dtype* x_row = x + r * cols;
+			Dtype* y_row = y + r * cols;
+			Dtype s = Dtype(1) / std::sqrt(sum_squares_contiguous(x_row, cols) / cols + eps);
+			rstd[r] = s;
+			for(index_t c = 0; c < cols; c++)
+				y_row[c] = x_row[c] * s * weight[c];
+		}
+	});
+}
+
+// Backward of both in one pass over the rows, in parallel. With xhat = (x - mean) * rstd (x * rstd
+// for rms norm) and g = dy * weight, a row gets
+//   dx = rstd * (g - mean of g - xhat * mean of g * xhat),
+// without the mean of g for rms norm. The first loop over a row takes both means and adds dy * xhat
+// and dy to the weight and bias gradients of its chunk, the second one writes dx from cache. The
+// chunks are summed in order at the end. mean = nullptr means rms norm, and any of dx, dweight and
+// dbias can be nullptr when it isn't needed.
+template<typename Dtype>
+void layer_norm_backward(index_t rows, index_t cols, const Dtype* x, const Dtype* dy, const Dtype* weight,
+						 const Dtype* mean, const Dtype* rstd, Dtype* dx, Dtype* dweight, Dtype* dbias) {
+	index_t grain = std::max((index_t)1, 4096 / cols);
+	index_t chunks = num_chunks(0, rows, grain);
+	bool params = dweight != nullptr || dbias != nullptr;
+	std::vector<Dtype> partial_dweight(params ? chunks * cols : 0);
+	std::vector<Dtype> partial_dbias(params ? chunks * cols : 0);
+	parallel_chunks(0, rows, grain, [&](index_t chunk, index_t begin, index_t end) {
+		Dtype* dw = params ? partial_dweight.data() + chunk * cols : nullptr;
+		Dtype* db = params ? partial_dbias.data() + chunk * cols : nullptr;
+		for(index_t r = begin; r < end; r++) {
+			const Dtype* x_row = x + r * cols;
+			const Dtype* dy_row = dy + r * cols;
+			Dtype m = mean != nullptr ? mean[r] : Dtype(0);
+			Dtype s = rstd[r];
+			Dtype sum_g = 0, sum_g_xhat = 0;
+			if(params) {
+				for(index_t c = 0; c < cols; c++) {
+					Dtype xhat = (x_row[c] - m) * s;
+					Dtype g = dy_row[c] * weight[c];
+					sum_g += g;
+					sum_g_xhat += g * xhat;
+					dw[c] += dy_row[c] * xhat;
+					db[c] += dy_row[c];
+				}
+			} else {
+				for(index_t c = 0; c < cols; c++) {
+					Dtype g = dy_row[c] * weight[c];
+					sum_g += g;
+					sum_g_xhat += g * (x_row[c] - m) * s;
+				}
+			}
+			if(dx == nullptr) continue;
+			Dtype mean_g = mean != nullptr ? sum_g / cols : Dtype(0);
+			Dtype mean_g_xhat = sum_g_xhat / cols;
+			Dtype* dx_row = dx + r * cols;
+			for(index_t c = 0; c < cols; c++) {
+				Dtype xhat = (x_row[c] - m) * s;
+				dx_row[c] = s * (dy_row[c] * weight[c] - mean_g - xhat * mean_g_xhat);
+			}
+		}
+	});
+	if(!params) return;
+	for(index_t c = 0; c < cols; c++) {
+		Dtype w = 0, b = 0;
+		for(index_t chunk = 0; chunk < chunks; chunk++) {
+			w += partial_dweight[chunk * cols + c];
+			b += partial_dbias[chunk * cols + c];
+		}
+		if(dweight != nullptr) dweight[c] = w;
+		if(dbias != nullptr) dbias[c] = b;
+	}
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
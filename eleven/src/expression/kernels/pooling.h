@@ -0,0 +1,459 @@
+#ifndef EXPRESSION_KERNELS_POOLING_H_
+#define EXPRESSION_KERNELS_POOLING_H_
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/layout.h"
+#include "../../utils/parallel.h"
+
+namespace el {
+namespace kernel {
+
+enum class PoolMode {Max, Avg};
+
+// Shape of a 2D pooling. There are two kinds of windows:
+//   - sliding windows of (kh, kw) with stride and zero padding. Padded pixels are never picked by max
+//     and aren't counted by average. With ceil_mode, a last partial window is added if it starts
+//     inside the image or the left padding.
+//   - adaptive windows, which split the image into out_h x out_w nearly equal windows, start at
+//     floor(o * in / out) and end at ceil((o + 1) * in / out). kh and kw are then the largest size of
+//     a window, so the offset of a pixel in its window is still (i - origin_h) * kw + (j - origin_w).
+struct PoolParam {
+	index_t batch, channels, in_h, in_w;
+	index_t kh, kw, sh, sw, ph, pw;
+	index_t out_h, out_w;
+	bool adaptive;
+
+	PoolParam(index_t batch, index_t channels, index_t in_h, index_t in_w,
+			  const std::pair<index_t, index_t>& kernel_size,
+			  const std::pair<index_t, index_t>& stride,
+			  const std::pair<index_t, index_t>& padding,
+			  bool ceil_mode)
+		: batch(batch), channels(channels), in_h(in_h), in_w(in_w),
+		  kh(kernel_size.first), kw(kernel_size.second),
+		  sh(stride.first), sw(stride.second),
+		  ph(padding.first), pw(padding.second),
+		  adaptive(false) {
+		out_h = out_size(in_h, kh, sh, ph, ceil_mode);
+		out_w = out_size(in_w, kw, sw, pw, ceil_mode);
+	}
+	static PoolParam adaptive_output(index_t batch, index_t channels, index_t in_h, index_t in_w,
+									 const std::pair<index_t, index_t>& output_size) {
+		PoolParam p(batch, channels, in_h, in_w, {in_h, in_w}, {1, 1}, {0, 0}, false);
+		p.adaptive = true;
+		p.out_h = output_size.first;
+		p.out_w = output_size.second;
+		p.kh = (in_h + p.out_h - 1) / p.out_h + 1;
+		p.kw = (in_w + p.out_w - 1) / p.out_w + 1;
+		return p;
+	}
+
+	index_t planes(void) const {return batch * channels;}
+	index_t in_plane(void) const {return in_h * in_w;}
+	index_t out_plane(void) const {return out_h * out_w;}
+	index_t window(void) const {return kh * kw;}
+	// Offsets within a window are kept in one byte when the window is small enough, which is
+	// almost always the case.
+	bool small_window(void) const {return window() <= 256;}
+
+	// The window of output row oh starts at origin, and covers [begin, end) of the input rows.
+	void window_h(index_t oh, index_t& origin, index_t& begin, index_t& end) const {
+		window_range(oh, in_h, out_h, kh, sh, ph, origin, begin, end);
+	}
+	void window_w(index_t ow, index_t& origin, index_t& begin, index_t& end) const {
+		window_range(ow, in_w, out_w, kw, sw, pw, origin, begin, end);
+	}
+	// Every window is a full k x k square with stride s inside the image, so no bound checks.
+	bool plain(index_t k, index_t s) const {
+		return !adaptive && kh == k && kw == k && sh == s && sw == s && ph == 0 && pw == 0 &&
+			   (out_h - 1) * s + k <= in_h && (out_w - 1) * s + k <= in_w;
+	}
+	// A single window covering the whole image.
+	bool global(void) const {
+		return out_h == 1 && out_w == 1 && (adaptive || (ph == 0 && pw == 0 && kh == in_h && kw == in_w));
+	}
+
+private:
+	static index_t out_size(index_t in, index_t k, index_t s, index_t p, bool ceil_mode) {
+		index_t span = in + 2 * p - k;
+		index_t out = (ceil_mode ? (span + s - 1) / s : span / s) + 1;
+		if(ceil_mode && (out - 1) * s >= in + p)
+			out--;
+		return out;
+	}
+	void window_range(index_t o, index_t in, index_t out, index_t k, index_t s, index_t p,
+					  index_t& origin, index_t& begin, index_t& end) const {
+		if(adaptive) {
+			origin = begin = o * in / out;
+			end = ((o + 1) * in + out - 1) / out;
+		} else {
+			origin = o * s - p;
+			begin = std::max(origin, index_t(0));
+			end = std::min(origin + k, in);
+		}
+	}
+};
+
+// ******************** max pooling ********************
+// y gets the max of each window and argmax its offset in the window, (i - origin_h) * kw + (j - origin_w).
+// The first max wins on ties. Offset is uint8_t or int32_t, see PoolParam::small_window().
+template<typename Dtype, typename Offset>
+void max_pool2d_plane(const PoolParam& p, const Dtype* x, Dtype* y, Offset* argmax) {
+	for(index_t oh = 0; oh < p.out_h; oh++) {
+		index_t origin_h, h_begin, h_end;
+		p.window_h(oh, origin_h, h_begin, h_end);
+		for(index_t ow = 0; ow < p.out_w; ow++) {
+			index_t origin_w, w_begin, w_end;
+			p.window_w(ow, origin_w, w_begin, w_end);
+			Dtype value = x[h_begin * p.in_w + w_begin];
+			index_t offset = (h_begin - origin_h) * p.kw + (w_begin - origin_w);
+			for(index_t i = h_begin; i < h_end; i++)
+				for(index_t j = w_begin; j < w_end; j++)
+					if(x[i * p.in_w + j] > value) {
+						value = x[i * p.in_w + j];
+						offset = (i - origin_h) * p.kw + (j - origin_w);
+					}
+			y[oh * p.out_w + ow] = value;
+			argmax[oh * p.out_w + ow] = static_cast<Offset>(offset);
+		}
+	}
+}
+
+// 2x2 windows with stride 2. The max is picked by selects instead of branches, so the loop over
+// the output row can be vectorized.
+template<typename Dtype, typename Offset>
+void max_pool2d_plane_2x2(const PoolParam& p, const Dtype* x, Dtype* y, Offset* argmax) {
+	for(index_t oh = 0; oh < p.out_h; oh++) {
+		const Dtype* r0 = x + 2 * oh * p.in_w;
+		const Dtype* r1 = r0 + p.in_w;
+		Dtype* y_row = y + oh * p.out_w;
+		Offset* argmax_row = argmax + oh * p.out_w;
+		for(index_t ow = 0; ow < p.out_w; ow++) {
+			Dtype a = r0[2 * ow], b = r0[2 * ow + 1];
+			Dtype c = r1[2 * ow], d = r1[2 * ow + 1];
+			Dtype top = b > a ? b : a;
+			Offset top_offset = b > a ? 1 : 0;
+			Dtype bottom = d > c ? d : c;
+			Offset bottom_offset = d > c ? 3 : 2;
+			bool lower = bottom > top;
+			y_row[ow] = lower ? bottom : top;
+			argmax_row[ow] = lower ? bottom_offset : top_offset;
+		}
+	}
+}
+
+// 3x3 windows with stride 2. The max of the three rows is taken first for every input column, which
+// is a vectorized loop over the whole width, then the max of three neighbouring columns.
+template<typename Dtype, typename Offset>
+void max_pool2d_plane_3x3s2(const PoolParam& p, const Dtype* x, Dtype* y, Offset* argmax,
+							Dtype* col_max, Offset* col_row) {
+	for(index_t oh = 0; oh < p.out_h; oh++) {
+		const Dtype* r0 = x + 2 * oh * p.in_w;
+		const Dtype* r1 = r0 + p.in_w;
+		const Dtype* r2 = r1 + p.in_w;
+		for(index_t j = 0; j < p.in_w; j++) {
+			Dtype m01 = r1[j] > r0[j] ? r1[j] : r0[j];
+			Offset i01 = r1[j] > r0[j] ? 3 : 0;
+			bool last = r2[j] > m01;
+			col_max[j] = last ? r2[j] : m01;
+			col_row[j] = last ? 6 : i01;
+		}
+		Dtype* y_row = y + oh * p.out_w;
+		Offset* argmax_row = argmax + oh * p.out_w;
+		for(index_t ow = 0; ow < p.out_w; ow++) {
+			const Dtype* m = col_max + 2 * ow;
+			const Offset* r = col_row + 2 * ow;
+			Dtype m01 = m[1] > m[0] ? m[1] : m[0];
+			Offset i01 = m[1] > m[0] ? r[1] + 1 : r[0];
+			bool last = m[2] > m01;
+			y_row[ow] = last ? m[2] : m01;
+			argmax_row[ow] = last ? r[2] + 2 : i01;
+		}
+	}
+}
+
+template<typename Dtype, typename Offset>
+void max_pool2d_forward(const PoolParam& p, const Dtype* x, Dtype* y, Offset* argmax) {
+	bool is_2x2 = p.plain(2, 2), is_3x3s2 = p.plain(3, 2);
+	parallel_for(0, p.planes(), 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> col_max(is_3x3s2 ? p.in_w : 0);
+		std::vector<Offset> col_row(is_3x3s2 ? p.in_w : 0);
+		for(index_t plane = begin; plane < end; plane++) {
+			const Dtype* x_plane = x + plane * p.in_plane();
+			Dtype* y_plane = y + plane * p.out_plane();
+			Offset* argmax_plane = argmax + plane * p.out_plane();
+			if(is_2x2) max_pool2d_plane_2x2(p, x_plane, y_plane, argmax_plane);
+			else if(is_3x3s2) max_pool2d_plane_3x3s2(p, x_plane, y_plane, argmax_plane, col_max.data(), col_row.data());
+			else max_pool2d_plane(p, x_plane, y_plane, argmax_plane);
+		}
+	});
+}
+
+// dx is overwritten: zero, except dy scattered to the pixel each window picked. Windows may overlap,
+// so each plane is done by one thread.
+template<typename Dtype, typename Offset>
+void max_pool2d_backward(const PoolParam& p, const Dtype* dy, const Offset* argmax, Dtype* dx) {
+	parallel_for(0, p.planes(), 1, [&](index_t begin, index_t end) {
+		for(index_t plane = begin; plane < end; plane++) {
+			const Dtype* dy_plane = dy + plane * p.out_plane();
+			const Offset* argmax_plane = argmax + plane * p.out_plane();
+			Dtype* dx_plane = dx + plane * p.in_plane();
+			for(index_t i = 0; i < p.in_plane(); i++)
+				dx_plane[i] = 0;
+			for(index_t oh = 0; oh < p.out_h; oh++) {
+				index_t origin_h, h_begin, h_end;
+				p.window_h(oh, origin_h, h_begin, h_end);
+				for(index_t ow = 0; ow < p.out_w; ow++) {
+					index_t origin_w, w_begin, w_end;
+					p.window_w(ow, origin_w, w_begin, w_end);
+					index_t offset = argmax_plane[oh * p.out_w + ow];
+					index_t h = origin_h + offset / p.kw;
+					index_t w = origin_w + offset % p.kw;
+					dx_plane[h * p.in_w + w] += dy_plane[oh * p.out_w + ow];
+				}
+			}
+		}
+	});
+}
+
+// ******************** average pooling ********************
+// Each window is divided by the number of its pixels inside the image, padding isn't counted.
+template<typename Dtype>
+void avg_pool2d_plane(const PoolParam& p, const Dtype* x, Dtype* y) {
+	for(index_t oh = 0; oh < p.out_h; oh++) {
+		index_t origin_h, h_begin, h_end;
+		p.window_h(oh, origin_h, h_begin, h_end);
+		for(index_t ow = 0; ow < p.out_w; ow++) {
+			index_t origin_w, w_begin, w_end;
+			p.window_w(ow, origin_w, w_begin, w_end);
+			Dtype value = 0;
+			for(index_t i = h_begin; i < h_end; i++)
+				for(index_t j = w_begin; j < w_end; j++)
+					value += x[i * p.in_w + j];
+			y[oh * p.out_w + ow] = value / ((h_end - h_begin) * (w_end - w_begin));
+		}
+	}
+}
+
+template<typename Dtype>
+void avg_pool2d_plane_2x2(const PoolParam& p, const Dtype* x, Dtype* y) {
+	for(index_t oh = 0; oh < p.out_h; oh++) {
+		const Dtype* r0 = x + 2 * oh * p.in_w;
+		const Dtype* r1 = r0 + p.in_w;
+		Dtype* y_row = y + oh * p.out_w;
+		for(index_t ow = 0; ow < p.out_w; ow++)
+			y_row[ow] = (r0[2 * ow] + r0[2 * ow + 1] + r1[2 * ow] + r1[2 * ow + 1]) * Dtype(0.25);
+	}
+}
+
+template<typename Dtype>
+void avg_pool2d_plane_3x3s2(const PoolParam& p, const Dtype* x, Dtype* y, Dtype* col_sum) {
+	for(index_t oh = 0; oh < p.out_h; oh++) {
+		const Dtype* r0 = x + 2 * oh * p.in_w;
+		const Dtype* r1 = r0 + p.in_w;
+		const Dtype* r2 = r1 + p.in_w;
+		for(index_t j = 0; j < p.in_w; j++)
+			col_sum[j] = r0[j] + r1[j] + r2[j];
+		Dtype* y_row = y + oh * p.out_w;
+		for(index_t ow = 0; ow < p.out_w; ow++)
+			y_row[ow] = (col_sum[2 * ow] + col_sum[2 * ow + 1] + col_sum[2 * ow + 2]) / Dtype(9);
+	}
+}
+
+template<typename Dtype>
+void avg_pool2d_forward(const PoolParam& p, const Dtype* x, Dtype* y) {
+	if(p.global()) {
+		// Global average pooling is a plain reduction of every plane.
+		parallel_for(0, p.planes(), 16, [&](index_t begin, index_t end) {
+			for(index_t plane = begin; plane < end; plane++) {
+				const Dtype* x_plane = x + plane * p.in_plane();
+				Dtype value = 0;
+				for(index_t i = 0; i < p.in_plane(); i++)
+					value += x_plane[i];
+				y[plane] = value / p.in_plane();
+			}
+		});
+		return;
+	}
+	bool is_2x2 = p.plain(2, 2), is_3x3s2 = p.plain(3, 2);
+	parallel_for(0, p.planes(), 1, [&](index_t begin, index_t end) {
+		std::vector<Dtype> col_sum(is_3x3s2 ? p.in_w : 0);
+		for(index_t plane = begin; plane < end; plane++) {
+			const Dtype* x_plane = x + plane * p.in_plane();
+			Dtype* y_plane = y + plane * p.out_plane();
+			if(is_2x2) avg_pool2d_plane_2x2(p, x_plane, y_plane);
+			else if(is_3x3s2) avg_pool2d_plane_3x3s2(p, x_plane, y_plane, col_sum.data());
+			else avg_pool2d_plane(p, x_plane, y_plane);
+		}
+	});
+}
+
+// dx is overwritten.
+template<typename Dtype>
+void avg_pool2d_backward(const PoolParam& p, const Dtype* dy, Dtype* dx) {
+	if(p.global()) {
+		parallel_for(0, p.planes(), 16, [&](index_t begin, index_t end) {
+			for(index_t plane = begin; plane < end; plane++) {
+				Dtype* dx_plane = dx + plane * p.in_plane();
+				Dtype value = dy[plane] / p.in_plane();
+				for(index_t i = 0; i < p.in_plane(); i++)
+					dx_plane[i] = value;
+			}
+		});
+		return;
+	}
+	parallel_for(0, p.planes(), 1, [&](index_t begin, index_t end) {
+		for(index_t plane = begin; plane < end; plane++) {
+			const Dtype* dy_plane = dy + plane * p.out_plane();
+			Dtype* dx_plane = dx + plane * p.in_plane();
+			for(index_t i = 0; i < p.in_plane(); i++)
+				dx_plane[i] = 0;
+			for(index_t oh = 0; oh < p.out_h; oh++) {
+				index_t origin_h, h_begin, h_end;
+				p.window_h(oh, origin_h, h_begin, h_end);
+				for(index_t ow = 0; ow < p.out_w; ow++) {
+					index_t origin_w, w_begin, w_end;
+					p.window_w(ow, origin_w, w_begin, w_end);
+					Dtype value = dy_plane[oh * p.out_w + ow] / ((h_end - h_begin) * (w_end - w_begin));
+					for(index_t i = h_begin; i < h_end; i++)
+						for(index_t j = w_begin; j < w_end; j++)
+							dx_plane[i * p.in_w + j] += value;
+				}
+			}
+		}
+	});
+}
+
+// ******************** channels innermost ********************
+// Images stored as (batch, channel blocks, h, w, block), i.e. NHWC or NCHW[x]c (see utils/layout.h),
+// and the output in the same layout. Every window is walked once for a whole block of channels, so
+// the inner loops run over adjacent values and are vectorized. argmax keeps an offset per output
+// value, as for NCHW. Padded channels are pooled like the others, and never read afterwards.
+template<typename Dtype, typename Offset>
+void max_pool2d_blocked_forward(const PoolParam& p, Layout layout, const Dtype* x, Dtype* y, Offset* argmax) {
+	index_t block = layout_block(layout, p.channels);
+	index_t groups = p.batch * layout_blocks(layout, p.channels);
+	parallel_for(0, groups * p.out_h, 1, [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t group = task / p.out_h, oh = task % p.out_h;
+			const Dtype* x_group = x + group * p.in_plane() * block;
+			index_t origin_h, h_begin, h_end;
+			p.window_h(oh, origin_h, h_begin, h_end);
+			for(index_t ow = 0; ow < p.out_w; ow++) {
+				index_t origin_w, w_begin, w_end;
+				p.window_w(ow, origin_w, w_begin, w_end);
+				index_t out = (group * p.out_plane() + oh * p.out_w + ow) * block;
+				Dtype* y_pixel = y + out;
+				Offset* argmax_pixel = argmax + out;
+				const Dtype* first = x_group + (h_begin * p.in_w + w_begin) * block;
+				Offset first_offset = static_cast<Offset>((h_begin - origin_h) * p.kw + (w_begin - origin_w));
+				for(index_t k = 0; k < block; k++) {
+					y_pixel[k] = first[k];
+					argmax_pixel[k] = first_offset;
+				}
+				for(index_t i = h_begin; i < h_end; i++)
+					for(index_t j = w_begin; j < w_end; j++) {
+						const Dtype* x_pixel = x_group + (i * p.in_w + j) * block;
+						Offset offset = static_cast<Offset>((i - origin_h) * p.kw + (j - origin_w));
+						for(index_t k = 0; k < block; k++) {
+							bool greater = x_pixel[k] > y_pixel[k];
+							y_pixel[k] = greater ? x_pixel[k] : y_pixel[k];
+							argmax_pixel[k] = greater ? offset : argmax_pixel[k];
+						}
+					}
+			}
+		}
+	});
+}
+
+// dx is overwritten. Windows may overlap, so each group of channels is done by one thread.
+template<typename Dtype, typename Offset>
+void max_pool2d_blocked_backward(const PoolParam& p, Layout layout, const Dtype* dy, const Offset* argmax, Dtype* dx) {
+	index_t block = layout_block(layout, p.channels);
+	index_t groups = p.batch * layout_blocks(layout, p.channels);
+	parallel_for(0, groups, 1, [&](index_t begin, index_t end) {
+		for(index_t group = begin; group < end; group++) {
+			Dtype* dx_group = dx + group * p.in_plane() * block;
+			std::fill(dx_group, dx_group + p.in_plane() * block, Dtype(0));
+			for(index_t oh = 0; oh < p.out_h; oh++) {
+				index_t origin_h, h_begin, h_end;
+				p.window_h(oh, origin_h, h_begin, h_end);
+				for(index_t ow = 0; ow < p.out_w; ow++) {
+					index_t origin_w, w_begin, w_end;
+					p.window_w(ow, origin_w, w_begin, w_end);
+					index_t out = (group * p.out_plane() + oh * p.out_w + ow) * block;
+					for(index_t k = 0; k < block; k++) {
+						index_t offset = argmax[out + k];
+						index_t h = origin_h + offset / p.kw, w = origin_w + offset % p.kw;
+						dx_group[(h * p.in_w + w) * block + k] += dy[out + k];
+					}
+				}
+			}
+		}
+	});
+}
+
+template<typename Dtype>
+void avg_pool2d_blocked_forward(const PoolParam& p, Layout layout, const Dtype* x, Dtype* y) {
+	index_t block = layout_block(layout, p.channels);
+	index_t groups = p.batch * layout_blocks(layout, p.channels);
+	parallel_for(0, groups * p.out_h, 1, [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t group = task / p.out_h, oh = task % p.out_h;
+			const Dtype* x_group = x + group * p.in_plane() * block;
+			index_t origin_h, h_begin, h_end;
+			p.window_h(oh, origin_h, h_begin, h_end);
+			for(index_t ow = 0; ow < p.out_w; ow++) {
+				index_t origin_w, w_begin, w_end;
+				p.window_w(ow, origin_w, w_begin, w_end);
+				Dtype* y_pixel = y + (group * p.out_plane() + oh * p.out_w + ow) * block;
+				std::fill(y_pixel, y_pixel + block, Dtype(0));
+				for(index_t i = h_begin; i < h_end; i++)
+					for(index_t j = w_begin; j < w_end; j++) {
+						const Dtype* x_pixel = x_group + (i * p.in_w + j) * block;
+						for(index_t k = 0; k < block; k++)
+							y_pixel[k] += x_pixel[k];
+					}
+				Dtype scale = Dtype(1) / ((h_end - h_begin) * (w_end - w_begin));
+				for(index_t k = 0; k < block; k++)
+					y_pixel[k] *= scale;
+			}
+		}
+	});
+}
+
+// dx is overwritten.
+template<typename Dtype>
+void avg_pool2d_blocked_backward(const PoolParam& p, Layout layout, const Dtype* dy, Dtype* dx) {
+	index_t block = layout_block(layout, p.channels);
+	index_t groups = p.batch * layout_blocks(layout, p.channels);
+	parallel_for(0, groups, 1, [&](index_t begin, index_t end) {
+		for(index_t group = begin; group < end; group++) {
+			Dtype* dx_group = dx + group * p.in_plane() * block;
+			std::fill(dx_group, dx_group + p.in_plane() * block, Dtype(0));
+			for(index_t oh = 0; oh < p.out_h; oh++) {
+				index_t origin_h, h_begin, h_end;
+				p.window_h(oh, origin_h, h_begin, h_end);
+				for(index_t ow = 0; ow < p.out_w; ow++) {
+					index_t origin_w, w_begin, w_end;
+					p.window_w(ow, origin_w, w_begin, w_end);
+					const Dtype* dy_pixel = dy + (group * p.out_plane() + oh * p.out_w + ow) * block;
+					Dtype scale = Dtype(1) / ((h_end - h_begin) * (w_end - w_begin));
+					for(index_t i = h_begin; i < h_end; i++)
+						for(index_t j = w_begin; j < w_end; j++) {
+							Dtype* dx_pixel = dx_group + (i * p.in_w + j) * block;
+							for(index_t k = 0; k < block; k++)
+								dx_pixel[k] += dy_pixel[k] * scale;
+						}
+				}
+			}
+		}
+	});
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
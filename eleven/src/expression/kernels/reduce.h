@@ -0,0 +1,265 @@
+#ifndef EXPRESSION_KERNELS_REDUCE_H_
+#define EXPRESSION_KERNELS_REDUCE_H_
+
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+
+namespace el {
+namespace kernel {
+
+enum class ReduceOp {Sum, Mean, Max, Min, Var};
+
+// Shape of a contiguous tensor with some axes reduced. Adjacent axes which are both reduced or both
+// kept are merged, and axes of size 1 are dropped, so (b, c, h, w) reduced over (h, w) becomes
+// [b*c kept, h*w reduced]. Most reductions end up with one or two groups.
+struct ReduceShape {
+	std::vector<index_t> sizes;
+	std::vector<bool> reduced;
+
+	ReduceShape(const std::vector<index_t>& shape, const std::vector<bool>& reduce_axes) {
+		for(size_t i = 0; i < shape.size(); i++) {
+			if(shape[i] == 1) continue;
+			if(!sizes.empty() && reduced.back() == reduce_axes[i]) {
+				sizes.back() *= shape[i];
+			} else {
+				sizes.push_back(shape[i]);
+				reduced.push_back(reduce_axes[i]);
+			}
+		}
+	}
+	index_t groups(void) const {return sizes.size();}
+	index_t in_count(void) const {return product(0, groups(), false) * product(0, groups(), true);}
+	index_t out_count(void) const {return product(0, groups(), false);}
+	index_t reduce_count(void) const {return product(0, groups(), true);}
+	// Product of the reduced (or kept) groups in [begin, end).
+	index_t product(index_t begin, index_t end, bool of_reduced) const {
+		index_t value = 1;
+		for(index_t i = begin; i < end; i++)
+			if(reduced[i] == of_reduced) value *= sizes[i];
+		return value;
+	}
+};
+
+struct SumOp {
+	template<typename Dtype> static Dtype init(const Dtype* x) {return 0;}
+	template<typename Dtype> static Dtype apply(Dtype a, Dtype b) {return a + b;}
+};
+struct MaxOp {
+	template<typename Dtype> static Dtype init(const Dtype* x) {return x[0];}
+	template<typename Dtype> static Dtype apply(Dtype a, Dtype b) {return b > a ? b : a;}
+};
+struct MinOp {
+	template<typename Dtype> static Dtype init(const Dtype* x) {return x[0];}
+	template<typename Dtype> static Dtype apply(Dtype a, Dtype b) {return b < a ? b : a;}
+};
+
+// ******************** one axis ********************
+// Reduce n contiguous values. Eight independent accumulators let compilers keep them in one vector
+// register, then they are combined as a fixed tree, so the order never changes.
+template<typename Op, typename Dtype>
+inline Dtype reduce_contiguous(const Dtype* x, index_t n) {
+	const index_t lanes = 8;
+	Dtype acc[lanes];
+	for(index_t k = 0; k < lanes; k++)
+		acc[k] = Op::init(x);
+	index_t i = 0;
+	for(; i + lanes <= n; i += lanes)
+		for(index_t k = 0; k < lanes; k++)
+			acc[k] = Op::apply(acc[k], x[i + k]);
+	for(; i < n; i++)
+		acc[0] = Op::apply(acc[0], x[i]);
+	for(index_t width = lanes / 2; width > 0; width /= 2)
+		for(index_t k = 0; k < width; k++)
+			acc[k] = Op::apply(acc[k], acc[k + width]);
+	return acc[0];
+}
+
+// y[o, i] = reduce(x[o, :, i]) for x (outer, n, inner).
+//   - outer = inner = 1: the row is split into one chunk per thread, partial results are combined in order.
+//   - inner = 1: each row is reduced horizontally, rows in parallel.
+//   - otherwise: whole rows of inner values are accumulated, which is vectorized over inner.
+template<typename Op, typename Dtype>
+void reduce_axis(index_t outer, index_t n, index_t inner, const Dtype* x, Dtype* y) {
+	if(outer == 1 && inner == 1) {
+		index_t chunks = num_chunks(0, n, 4096);
+		std::vector<Dtype> partial(std::max(chunks, (index_t)1), Op::init(x));
+		parallel_chunks(0, n, 4096, [&](index_t chunk, index_t begin, index_t end) {
+			partial[chunk] = reduce_contiguous<Op>(x + begin, end - begin);
+		});
+		Dtype value = partial[0];
+		for(index_t chunk = 1; chunk < chunks; chunk++)
+			value = Op::apply(value, partial[chunk]);
+		y[0] = value;
+	} else if(inner == 1) {
+		parallel_for(0, outer, std::max(1, 4096 / n), [&](index_t begin, index_t end) {
+			for(index_t o = begin; o < end; o++)
+				y[o] = reduce_contiguous<Op>(x + o * n, n);
+		});
+	} else {
+		const index_t block = 1024;
+		index_t num_blocks = (inner + block - 1) / block;
+		parallel_for(0, outer * num_blocks, 1, [&](index_t begin, index_t end) {
+			for(index_t task = begin; task < end; task++) {
+				index_t o = task / num_blocks;
+				index_t i0 = task % num_blocks * block;
+				index_t len = std::min(block, inner - i0);
+				const Dtype* x_block = x + o * n * inner + i0;
+				Dtype* y_block = y + o * inner + i0;
+				for(index_t i = 0; i < len; i++)
+					y_block[i] = x_block[i];
+				for(index_t r = 1; r < n; r++) {
+					const Dtype* x_row = x_block + r * inner;
+					for(index_t i = 0; i < len; i++)
+						y_block[i] = Op::apply(y_block[i], x_row[i]);
+				}
+			}
+		});
+	}
+}
+
+// ******************** all axes ********************
+// Reduce every reduced group of s, one group per pass from the innermost one. After a pass, the
+// groups behind the reduced one are all kept, so each pass is a plain (outer, n, inner) reduction.
+// y gets out_count() values.
+template<typename Op, typename Dtype>
+void reduce_groups(const ReduceShape& s, const Dtype* x, Dtype* y) {
+	if(s.reduce_count() == 1) {
+		std::copy(x, x + s.in_count(), y);
+		return;
+	}
+	std::vector<Dtype> buffer[2];
+	const Dtype* src = x;
+	index_t last = -1;
+	for(index_t g = s.groups() - 1; g >= 0; g--)
+		if(s.reduced[g]) {last = g; break;}
+	index_t first = 0;
+	while(!s.reduced[first]) first++;
+
+	index_t current = 0;
+	for(index_t g = last; g >= 0; g--) {
+		if(!s.reduced[g]) continue;
+		index_t outer = 1, inner = 1;
+		for(index_t i = 0; i < g; i++) outer *= s.sizes[i];
+		for(index_t i = g + 1; i < s.groups(); i++)
+			if(!s.reduced[i]) inner *= s.sizes[i];
+		Dtype* dst;
+		if(g == first) {
+			dst = y;
+		} else {
+			buffer[current].resize(outer * inner);
+			dst = buffer[current].data();
+		}
+		reduce_axis<Op>(outer, s.sizes[g], inner, src, dst);
+		src = dst;
+		current = 1 - current;
+	}
+}
+
+// Call func(x_offset, y_offset, n, y_step) for every contiguous run of x, where the run x[x_offset:
+// x_offset+n] maps to y[y_offset], y[y_offset+y_step], ..., with y holding the kept groups only.
+// Runs are visited in parallel, and never share elements of x.
+template<typename Func>
+void reduce_broadcast(const ReduceShape& s, const Func& func) {
+	index_t groups = s.groups();
+	if(groups == 0) {
+		func(0, 0, 1, 0);
+		return;
+	}
+	index_t n = s.sizes[groups - 1];
+	index_t y_step = s.reduced[groups - 1] ? 0 : 1;
+	index_t runs = s.in_count() / n;
+	parallel_for(0, runs, std::max(1, 4096 / n), [&](index_t begin, index_t end) {
+		for(index_t run = begin; run < end; run++) {
+			// decompose run into indices of groups [0, groups-1), and compute y offset from kept ones.
+			index_t rest = run, y_offset = 0, y_stride = y_step ? n : 1;
+			for(index_t g = groups - 2; g >= 0; g--) {
+				index_t idx = rest % s.sizes[g];
+				rest /= s.sizes[g];
+				if(!s.reduced[g]) {
+					y_offset += idx * y_stride;
+					y_stride *= s.sizes[g];
+				}
+			}
+			func(run * n, y_offset, n, y_step);
+		}
+	});
+}
+
+// ******************** forward and backward ********************
+// y = op(x) over the reduced groups. Var divides by reduce_count() - correction.
+template<typename Dtype>
+void reduce_forward(ReduceOp op, const ReduceShape& s, const Dtype* x, Dtype* y, index_t correction=1) {
+	index_t count = s.reduce_count();
+	switch(op) {
+		case ReduceOp::Max: reduce_groups<MaxOp>(s, x, y); return;
+		case ReduceOp::Min: reduce_groups<MinOp>(s, x, y); return;
+		case ReduceOp::Sum: reduce_groups<SumOp>(s, x, y); return;
+		default: break;
+	}
+	// Mean, and Var by two passes: mean first, then the sum of squared deviations.
+	reduce_groups<SumOp>(s, x, y);
+	index_t out_count = s.out_count();
+	for(index_t i = 0; i < out_count; i++)
+		y[i] /= count;
+	if(op == ReduceOp::Mean) return;
+
+	std::vector<Dtype> deviation(s.in_count());
+	reduce_broadcast(s, [&](index_t x_offset, index_t y_offset, index_t n, index_t y_step) {
+		for(index_t i = 0; i < n; i++) {
+			Dtype d = x[x_offset + i] - y[y_offset + i * y_step];
+			deviation[x_offset + i] = d * d;
+		}
+	});
+	reduce_groups<SumOp>(s, deviation.data(), y);
+	Dtype divisor = std::max(count - correction, (index_t)1);
+	for(index_t i = 0; i < out_count; i++)
+		y[i] /= divisor;
+}
+
+// dx is overwritten. x and y are needed by Max, Min and Var only. Max and Min split the gradient
+// evenly between all elements equal to the result.
+template<typename Dtype>
+void reduce_backward(ReduceOp op, const ReduceShape& s, const Dtype* x, const Dtype* y, const Dtype* dy,
+					 Dtype* dx, index_t correction=1) {
+	index_t count = s.reduce_count();
+	switch(op) {
+		case ReduceOp::Sum:
+		case ReduceOp::Mean: {
+			Dtype scale = op == ReduceOp::Mean ? Dtype(1) / count : Dtype(1);
+			reduce_broadcast(s, [&](index_t x_offset, index_t y_offset, index_t n, index_t y_step) {
+				for(index_t i = 0; i < n; i++)
+					dx[x_offset + i] = scale * dy[y_offset + i * y_step];
+			});
+			return;
+		}
+		case ReduceOp::Var: {
+			std::vector<Dtype> mean(s.out_count());
+			reduce_forward(ReduceOp::Mean, s, x, mean.data());
+			Dtype scale = Dtype(2) / std::max(count - correction, (index_t)1);
+			reduce_broadcast(s, [&](index_t x_offset, index_t y_offset, index_t n, index_t y_step) {
+				for(index_t i = 0; i < n; i++)
+					dx[x_offset + i] = scale * (x[x_offset + i] - mean[y_offset + i * y_step]) * dy[y_offset + i * y_step];
+			});
+			return;
+		}
+		default: {
+			std::vector<Dtype> ties(s.out_count());
+			reduce_broadcast(s, [&](index_t x_offset, index_t y_offset, index_t n, index_t y_step) {
+				for(index_t i = 0; i < n; i++)
+					dx[x_offset + i] = x[x_offset + i] == y[y_offset + i * y_step] ? 1 : 0;
+			});
+			reduce_groups<SumOp>(s, dx, ties.data());
+			reduce_broadcast(s, [&](index_t x_offset, index_t y_offset, index_t n, index_t y_step) {
+				for(index_t i = 0; i < n; i++)
+					dx[x_offset + i] *= dy[y_offset + i * y_step] / ties[y_offset + i * y_step];
+			});
+		}
+	}
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
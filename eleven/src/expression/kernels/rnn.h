@@ -0,0 +1,250 @@
+#ifndef EXPRESSION_KERNELS_RNN_H_
+#define EXPRESSION_KERNELS_RNN_H_
+
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+#include "gemm.h"
+#include "math.h"
+
+namespace el {
+namespace kernel {
+
+// Recurrent layers over a whole sequence x (seq, batch, in), giving h (seq, batch, hidden), from zero
+// initial states. The gates of a step are the rows of one (gates * hidden, in) weight_ih and one
+// (gates * hidden, hidden) weight_hh, as in PyTorch:
+//   - LSTM, gates i, f, g, o: c = f * c_prev + i * g and h = o * tanh(c).
+//   - GRU, gates r, z, n: n = tanh(x_n + r * (h_prev W_hn + b_hn)) and h = (1 - z) * n + z * h_prev.
+// The input projections of all steps are one (seq * batch, in) x (in, gates * hidden) gemm before the
+// time loop. Each step is then one gemm of h_prev with weight_hh, packed once for the whole sequence,
+// and one pass over the gates of each row, which does all the element-wise math in a vectorized loop.
+enum class RNNMode {LSTM, GRU};
+
+inline index_t rnn_gates(RNNMode mode) {return mode == RNNMode::LSTM ? 4 : 3;}
+
+// ******************** cells ********************
+// gates (batch, 4 * hidden) holds the projections of the step, with h_prev's added, and gets the
+// activated gates. c_prev = nullptr means zeros.
+template<typename Dtype>
+void lstm_cell_forward(index_t batch, index_t hidden, Dtype* gates, const Dtype* b_ih, const Dtype* b_hh,
+					   const Dtype* c_prev, Dtype* c, Dtype* h) {
+	parallel_for(0, batch, std::max((index_t)1, 1024 / hidden), [&](index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++) {
+			Dtype* gi = gates + b * 4 * hidden;
+			Dtype* gf = gi + hidden;
+			Dtype* gg = gf + hidden;
+			Dtype* go = gg + hidden;
+			const Dtype* cp = c_prev == nullptr ? nullptr : c_prev + b * hidden;
+			Dtype* c_row = c + b * hidden;
+			Dtype* h_row = h + b * hidden;
+			#pragma omp simd
+			for(index_t j = 0; j < hidden; j++) {
+				Dtype i = vsigmoid(gi[j] + b_ih[j] + b_hh[j]);
+				Dtype f = vsigmoid(gf[j] + b_ih[hidden + j] + b_hh[hidden + j]);
+				Dtype g = vtanh(gg[j] + b_ih[2 * hidden + j] + b_hh[2 * hidden + j]);
+				Dtype o = vsigmoid(go[j] + b_ih[3 * hidden + j] + b_hh[3 * hidden + j]);
+				Dtype cell = i * g + (cp == nullptr ? Dtype(0) : f * cp[j]);
+				gi[j] = i;
+				gf[j] = f;
+				gg[j] = g;
+				go[j] = o;
+				c_row[j] = cell;
+				h_row[j] = o * vtanh(cell);
+			}
+		}
+	});
+}
+
+// gates (batch, 3 * hidden) holds the input projections of the step and gets the activated gates.
+// hproj (batch, 3 * hidden) = h_prev W_hh^T, nullptr for zeros. hn = h_prev W_hn + b_hn is kept for
+// backward.
+template<typename Dtype>
+void gru_cell_forward(index_t batch, index_t hidden, Dtype* gates, const Dtype* hproj, const Dtype* b_ih,
+					  const Dtype* b_hh, const Dtype* h_prev, Dtype* hn, Dtype* h) {
+	parallel_for(0, batch, std::max((index_t)1, 1024 / hidden), [&](index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++) {
+			Dtype* gr = gates + b * 3 * hidden;
+			Dtype* gz = gr + hidden;
+			Dtype* gn = gz + hidden;
+			const Dtype* hp = hproj == nullptr ? nullptr : hproj + b * 3 * hidden;
+			const Dtype* h_prev_row = h_prev == nullptr ? nullptr : h_prev + b * hidden;
+			Dtype* hn_row = hn + b * hidden;
+			Dtype* h_row = h + b * hidden;
+			#pragma omp simd
+			for(index_t j = 0; j < hidden; j++) {
+				Dtype hr = b_hh[j] + (hp == nullptr ? Dtype(0) : hp[j]);
+				Dtype hz = b_hh[hidden + j] + (hp == nullptr ? Dtype(0) : hp[hidden + j]);
+				Dtype hn_j = b_hh[2 * hidden + j] + (hp == nullptr ? Dtype(0) : hp[2 * hidden + j]);
+				Dtype r = vsigmoid(gr[j] + b_ih[j] + hr);
+				Dtype z = vsigmoid(gz[j] + b_ih[hidden + j] + hz);
+				Dtype n = vtanh(gn[j] + b_ih[2 * hidden + j] + r * hn_j);
+				gr[j] = r;
+				gz[j] = z;
+				gn[j] = n;
+				hn_row[j] = hn_j;
+				h_row[j] = (1 - z) * n + (h_prev_row == nullptr ? Dtype(0) : z * h_prev_row[j]);
+			}
+		}
+	});
+}
+
+// dh = dh_out + dh_next is the gradient of this step's h, dc (batch, hidden) comes in as the gradient
+// of c from the next step and leaves as the one of c_prev. dgates gets the gradients of the gates
+// before activation.
+template<typename Dtype>
+void lstm_cell_backward(index_t batch, index_t hidden, const Dtype* gates, const Dtype* c_prev, const Dtype* c,
+						const Dtype* dh_out, const Dtype* dh_next, Dtype* dc, Dtype* dgates) {
+	parallel_for(0, batch, std::max((index_t)1, 1024 / hidden), [&](index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++) {
+			const Dtype* gi = gates + b * 4 * hidden;
+			const Dtype* gf = gi + hidden;
+			const Dtype* gg = gf + hidden;
+			const Dtype* go = gg + hidden;
+			const Dtype* cp = c_prev == nullptr ? nullptr : c_prev + b * hidden;
+			const Dtype* c_row = c + b * hidden;
+			const Dtype* dh_out_row = dh_out + b * hidden;
+			const Dtype* dh_next_row = dh_next + b * hidden;
+			Dtype* dc_row = dc + b * hidden;
+			Dtype* di = dgates + b * 4 * hidden;
+			Dtype* df = di + hidden;
+			Dtype* dg = df + hidden;
+			Dtype* dout = dg + hidden;
+			#pragma omp simd
+			for(index_t j = 0; j < hidden; j++) {
+				Dtype i = gi[j], f = gf[j], g = gg[j], o = go[j];
+				Dtype tanh_c = vtanh(c_row[j]);
+				Dtype dh = dh_out_row[j] + dh_next_row[j];
+				Dtype dcell = dc_row[j] + dh * o * (1 - tanh_c * tanh_c);
+				Dtype prev = cp == nullptr ? Dtype(0) : cp[j];
+				di[j] = dcell * g * i * (1 - i);
+				df[j] = dcell * prev * f * (1 - f);
+				dg[j] = dcell * i * (1 - g * g);
+				dout[j] = dh * tanh_c * o * (1 - o);
+				dc_row[j] = dcell * f;
+			}
+		}
+	});
+}
+
+// dgx and dgh get the gradients of the input and the hidden projections of the gates, which differ
+// in the n gate only, and dh_prev the gradient of h_prev through z, the part not going by weight_hh.
+template<typename Dtype>
+void gru_cell_backward(index_t batch, index_t hidden, const Dtype* gates, const Dtype* hn, const Dtype* h_prev,
+					   const Dtype* dh_out, const Dtype* dh_next, Dtype* dgx, Dtype* dgh, Dtype* dh_prev) {
+	parallel_for(0, batch, std::max((index_t)1, 1024 / hidden), [&](index_t begin, index_t end) {
+		for(index_t b = begin; b < end; b++) {
+			const Dtype* gr = gates + b * 3 * hidden;
+			const Dtype* gz = gr + hidden;
+			const Dtype* gn = gz + hidden;
+			const Dtype* hn_row = hn + b * hidden;
+			const Dtype* h_prev_row = h_prev == nullptr ? nullptr : h_prev + b * hidden;
+			const Dtype* dh_out_row = dh_out + b * hidden;
+			const Dtype* dh_next_row = dh_next + b * hidden;
+			Dtype* dgx_row = dgx + b * 3 * hidden;
+			Dtype* dgh_row = dgh + b * 3 * hidden;
+			Dtype* dh_prev_row = dh_prev + b * hidden;
+			#pragma omp simd
+			for(index_t j = 0; j < hidden; j++) {
+				Dtype r = gr[j], z = gz[j], n = gn[j];
+				Dtype prev = h_prev_row == nullptr ? Dtype(0) : h_prev_row[j];
+				Dtype dh = dh_out_row[j] + dh_next_row[j];
+				Dtype dn = dh * (1 - z) * (1 - n * n);
+				Dtype dr = dn * hn_row[j] * r * (1 - r);
+				Dtype dz = dh * (prev - n) * z * (1 - z);
+				dgx_row[j] = dr;
+				dgx_row[hidden + j] = dz;
+				dgx_row[2 * hidden + j] = dn;
+				dgh_row[j] = dr;
+				dgh_row[hidden + j] = dz;
+				dgh_row[2 * hidden + j] = dn * r;
+				dh_prev_row[j] = dh * z;
+			}
+		}
+	});
+}
+
+// ******************** sequence ********************
+// gates (seq, batch, gates * hidden) and state (seq, batch, hidden) are kept for backward: the
+// activated gates, and c for LSTM or hn for GRU.
+template<typename Dtype>
+void rnn_forward(RNNMode mode, index_t seq, index_t batch, index_t in, index_t hidden, const Dtype* x,
+				 const Dtype* w_ih, const Dtype* w_hh, const Dtype* b_ih, const Dtype* b_hh,
+				 Dtype* gates, Dtype* state, Dtype* h) {
+	index_t width = rnn_gates(mode) * hidden;
+	index_t step = batch * width;
+	gemm(false, true, seq * batch, width, in, Dtype(1), x, in, w_ih, in, Dtype(0), gates, width);
+	PackedMatrix<Dtype> packed_w_hh;
+	packed_w_hh.pack(false, true, width, hidden, w_hh, hidden);
+	std::vector<Dtype> hproj(mode == RNNMode::GRU ? step : 0);
+	for(index_t t = 0; t < seq; t++) {
+		const Dtype* h_prev = t == 0 ? nullptr : h + (t - 1) * batch * hidden;
+		Dtype* gates_t = gates + t * step;
+		if(mode == RNNMode::LSTM) {
+			if(h_prev != nullptr)
+				gemm_packed_b(false, batch, Dtype(1), h_prev, hidden, packed_w_hh, Dtype(1), gates_t, width,
+							  NoEpilogue<Dtype>());
+			lstm_cell_forward(batch, hidden, gates_t, b_ih, b_hh, t == 0 ? nullptr : state + (t - 1) * batch * hidden,
+							  state + t * batch * hidden, h + t * batch * hidden);
+		} else {
+			if(h_prev != nullptr)
+				gemm_packed_b(false, batch, Dtype(1), h_prev, hidden, packed_w_hh, Dtype(0), hproj.data(), width,
+							  NoEpilogue<Dtype>());
+			gru_cell_forward(batch, hidden, gates_t, h_prev == nullptr ? nullptr : hproj.data(), b_ih, b_hh, h_prev,
+							 state + t * batch * hidden, h + t * batch * hidden);
+		}
+	}
+}
+
+// Backward through time for dh (seq, batch, hidden), the gradient of every output. The gradients of
+// h and c flowing to the previous step live in two (batch, hidden) buffers reused by every step, and
+// dh_next = dgh W_hh is one gemm with weight_hh packed once. The gate gradients of all steps are kept,
+// so the weight gradients, the bias gradients and dx are each one gemm or sum over the whole sequence
+// after the loop, like the input projections of forward. Any of dx, dw_ih, dw_hh, db_ih and db_hh can
+// be nullptr when it isn't needed.
+template<typename Dtype>
+void rnn_backward(RNNMode mode, index_t seq, index_t batch, index_t in, index_t hidden, const Dtype* x,
+				  const Dtype* w_ih, const Dtype* w_hh, const Dtype* gates, const Dtype* state, const Dtype* h,
+				  const Dtype* dh, Dtype* dx, Dtype* dw_ih, Dtype* dw_hh, Dtype* db_ih, Dtype* db_hh) {
+	index_t width = rnn_gates(mode) * hidden;
+	index_t step = batch * width;
+	index_t plane = batch * hidden;
+	PackedMatrix<Dtype> packed_w_hh;
+	packed_w_hh.pack(false, false, hidden, width, w_hh, hidden);
+	std::vector<Dtype> dgx(seq * step), dgh_buffer(mode == RNNMode::GRU ? seq * step : 0);
+	Dtype* dgh = mode == RNNMode::GRU ? dgh_buffer.data() : dgx.data();
+	std::vector<Dtype> dh_next(plane, Dtype(0)), dc(mode == RNNMode::LSTM ? plane : 0, Dtype(0));
+	for(index_t t = seq - 1; t >= 0; t--) {
+		const Dtype* h_prev = t == 0 ? nullptr : h + (t - 1) * plane;
+		if(mode == RNNMode::LSTM) {
+			lstm_cell_backward(batch, hidden, gates + t * step, t == 0 ? nullptr : state + (t - 1) * plane,
+							   state + t * plane, dh + t * plane, dh_next.data(), dc.data(), dgx.data() + t * step);
+		} else {
+			gru_cell_backward(batch, hidden, gates + t * step, state + t * plane, h_prev, dh + t * plane,
+							  dh_next.data(), dgx.data() + t * step, dgh + t * step, dh_next.data());
+		}
+		if(t > 0)
+			gemm_packed_b(false, batch, Dtype(1), dgh + t * step, width, packed_w_hh,
+						  mode == RNNMode::GRU ? Dtype(1) : Dtype(0), dh_next.data(), hidden, NoEpilogue<Dtype>());
+	}
+	if(dx != nullptr)
+		gemm(false, false, seq * batch, in, width, Dtype(1), dgx.data(), width, w_ih, in, Dtype(0), dx, in);
+	if(dw_ih != nullptr)
+		gemm(true, false, width, in, seq * batch, Dtype(1), dgx.data(), width, x, in, Dtype(0), dw_ih, in);
+	if(dw_hh != nullptr)
+		gemm(true, false, width, hidden, (seq - 1) * batch, Dtype(1), dgh + step, width, h, hidden,
+			 Dtype(0), dw_hh, hidden);
+	auto column_sums = [&](const Dtype* g, Dtype* db) {
+		std::fill(db, db + width, Dtype(0));
+		for(index_t r = 0; r < seq * batch; r++)
+			for(index_t j = 0; j < width; j++)
+				db[j] += g[r * width + j];
+	};
+	if(db_ih != nullptr) column_sums(dgx.data(), db_ih);
+	if(db_hh != nullptr) column_sums(dgh, db_hh);
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef EXPRESSION_KERNELS_SOFTMAX_H_
+#define EXPRESSION_KERNELS_SOFTMAX_H_
+
+#include <algorithm>
+#include <limits>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+#include "math.h"
+#include "reduce.h"
+
+namespace el {
+namespace kernel {
+
+// log(sum(exp(x))) of n values, as max + log(sum(exp(x - max))) so nothing overflows, in one pass.
+// x goes in blocks through a small buffer: the block's max is taken, the running sum is rescaled if
+// the max grew, then exp(x - max) is summed, each step vectorized over the block, which is still in
+// L1 from the first one.
+template<typename Dtype>
+inline Dtype log_sum_exp(const Dtype* x, index_t n) {
+	const index_t block = 256;
+	const Dtype neg_inf = -std::numeric_limits<Dtype>::infinity();
+	Dtype buffer[block];
+	Dtype max_item = neg_inf, exp_sum = 0;
+	for(index_t begin = 0; begin < n; begin += block) {
+		index_t len = std::min(block, n - begin);
+		Dtype block_max = reduce_contiguous<MaxOp>(x + begin, len);
+		if(block_max == neg_inf) continue;
+		if(block_max > max_item) {
+			exp_sum *= vexp(max_item - block_max);
+			max_item = block_max;
+		}
+		for(index_t j = 0; j < len; j++)
+			buffer[j] = x[begin + j] - max_item;
+		vexp(buffer, buffer, len);
+		exp_sum += reduce_contiguous<SumOp>(buffer, len);
+	}
+	return max_item + vlog(exp_sum);
+}
+
+// y[i] = x[i] - log_sum_exp(x[i]) for each row of x (batch, num_cls).
+template<typename Dtype>
+void log_softmax_forward(index_t batch, index_t num_cls, const Dtype* x, Dtype* y) {
+	parallel_for(0, batch, std::max(1, 4096 / num_cls), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			const Dtype* x_row = x + i * num_cls;
+			Dtype* y_row = y + i * num_cls;
+			Dtype lse = log_sum_exp(x_row, num_cls);
+			for(index_t j = 0; j < num_cls; j++)
+				y_row[j] = x_row[j] - lse;
+		}
+	});
+}
+
+// dx[i] = dy[i] - softmax(x[i]) * sum(dy[i]), with softmax = exp(y) taken from the output.
+template<typename Dtype>
+void log_softmax_backward(index_t batch, index_t num_cls, const Dtype* y, const Dtype* dy, Dtype* dx) {
+	parallel_for(0, batch, std::max(1, 4096 / num_cls), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			const Dtype* dy_row = dy + i * num_cls;
+			Dtype* dx_row = dx + i * num_cls;
+			Dtype grad_sum = reduce_contiguous<SumOp>(dy_row, num_cls);
+			vexp(y + i * num_cls, dx_row, num_cls);
+			for(index_t j = 0; j < num_cls; j++)
+				dx_row[j] = dy_row[j] - dx_row[j] * grad_sum;
+		}
+	});
+}
+
+// log_softmax_backward for a dy which is zero except for values[i] at (i, index[i]): then sum(dy) is
+// values[i], so dx[i] = onehot(index[i]) * values[i] - softmax(x[i]) * values[i].
+template<typename Dtype>
+void log_softmax_backward_one_hot(index_t batch, index_t num_cls, const Dtype* y, const int_t* index,
+								  const Dtype* values, Dtype* dx) {
+	parallel_for(0, batch, std::max(1, 4096 / num_cls), [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			Dtype* dx_row = dx + i * num_cls;
+			Dtype value = values[i];
+			vexp(y + i * num_cls, dx_row, num_cls);
+			for(index_t j = 0; j < num_cls; j++)
+				dx_row[j] *= -value;
+			dx_row[index[i]] += value;
+		}
+	});
+}
+
+// loss[i] = log_sum_exp(x[i]) - x[i][labels[i]] for each row of x (batch, num_cls), which is
+// -log(softmax(x[i])[labels[i]]). log_sum_exp of every row is kept in lse for backward.
+template<typename Dtype>
+void softmax_cross_entropy_forward(index_t batch, index_t num_cls, const Dtype* x, const int_t* labels,
+								   Dtype* lse, Dtype* loss) {
+	parallel_for(0, batch, 64, [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			const Dtype* row = x + i * num_cls;
+			lse[i] = log_sum_exp(row, num_cls);
+			loss[i] = lse[i] - row[labels[i]];
+		}
+	});
+}
+
+// dx[i] = scale * (softmax(x[i]) - onehot(labels[i])), with softmax recomputed from lse.
+template<typename Dtype>
+void softmax_cross_entropy_backward(index_t batch, index_t num_cls, Dtype scale, const Dtype* x,
+									const int_t* labels, const Dtype* lse, Dtype* dx) {
+	parallel_for(0, batch, 64, [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++) {
+			const Dtype* row = x + i * num_cls;
+			Dtype* dx_row = dx + i * num_cls;
+			Dtype row_lse = lse[i];
+			for(index_t j = 0; j < num_cls; j++)
+				dx_row[j] = row[j] - row_lse;
+			vexp(dx_row, dx_row, num_cls);
+			for(index_t j = 0; j < num_cls; j++)
+				dx_row[j] *= scale;
+			dx_row[labels[i]] -= scale;
+		}
+	});
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
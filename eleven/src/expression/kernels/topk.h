@@ -0,0 +1,163 @@
+#ifndef EXPRESSION_KERNELS_TOPK_H_
+#define EXPRESSION_KERNELS_TOPK_H_
+
+#include <vector>
+#include <algorithm>
+#include "../../utils/base.h"
+#include "../../utils/parallel.h"
+#include "reduce.h"
+
+namespace el {
+namespace kernel {
+
+// Largest values come first, ties go to the lower index, the same order as a scalar scan that only
+// takes strictly larger values.
+
+// ******************** argmax ********************
+// Index of the first largest value of n contiguous values. The maximum comes from the vectorized
+// reduction, then a short scan finds where it is. A NaN maximum matches nothing, then the scalar scan
+// decides, as argmax_axis does for columns: NaNs are never larger, so they're passed over unless x[0]
+// is one.
+template<typename Dtype>
+inline index_t argmax_contiguous(const Dtype* x, index_t n) {
+	Dtype max_item = reduce_contiguous<MaxOp>(x, n);
+	for(index_t i = 0; i < n; i++)
+		if(x[i] == max_item) return i;
+	index_t best = 0;
+	for(index_t i = 1; i < n; i++)
+		if(x[i] > x[best]) best = i;
+	return best;
+}
+
+// y[o, i] = argmax(x[o, :, i]) for x (outer, n, inner). Rows are done in parallel. With inner > 1,
+// blocks of inner keep the best value and index of each column, and the update is a compare and
+// select on whole rows, which vectorizes.
+template<typename Dtype, typename Itype>
+void argmax_axis(index_t outer, index_t n, index_t inner, const Dtype* x, Itype* y) {
+	if(inner == 1) {
+		parallel_for(0, outer, std::max(1, 4096 / n), [&](index_t begin, index_t end) {
+			for(index_t o = begin; o < end; o++)
+				y[o] = argmax_contiguous(x + o * n, n);
+		});
+		return;
+	}
+	const index_t block = 1024;
+	index_t num_blocks = (inner + block - 1) / block;
+	parallel_for(0, outer * num_blocks, 1, [&](index_t begin, index_t end) {
+		Dtype best[block];
+		index_t best_index[block];
+		for(index_t task = begin; task < end; task++) {
+			index_t o = task / num_blocks;
+			index_t i0 = task % num_blocks * block;
+			index_t len = std::min(block, inner - i0);
+			const Dtype* x_block = x + o * n * inner + i0;
+			for(index_t i = 0; i < len; i++) {
+				best[i] = x_block[i];
+				best_index[i] = 0;
+			}
+			for(index_t r = 1; r < n; r++) {
+				const Dtype* x_row = x_block + r * inner;
+				for(index_t i = 0; i < len; i++) {
+					bool larger = x_row[i] > best[i];
+					best[i] = larger ? x_row[i] : best[i];
+					best_index[i] = larger ? r : best_index[i];
+				}
+			}
+			Itype* y_block = y + o * inner + i0;
+			for(index_t i = 0; i < len; i++)
+				y_block[i] = best_index[i];
+		}
+	});
+}
+
+// ******************** top-k ********************
+// The k largest of n values with a stride, as indices in order. order is a buffer of n indices.
+// A small k keeps a sorted list of the best k seen so far. A value enters it only if it's larger
+// than the k-th one, which soon gets rare, so it's about one comparison per value. Otherwise
+// nth_element moves the k best to the front in O(n), and only those k get sorted.
+template<typename Dtype>
+void topk_strided(const Dtype* x, index_t n, index_t stride, index_t k, index_t* order) {
+	const index_t small_k = 16;
+	if(k <= small_k) {
+		Dtype best[small_k];
+		index_t count = 0;
+		for(index_t i = 0; i < n; i++) {
+			Dtype value = x[i * stride];
+			if(count == k && !(value > best[k - 1])) continue;
+			// Equal values stay behind the ones seen before, which have lower indices.
+			index_t pos = count < k ? count++ : k - 1;
+			while(pos > 0 && value > best[pos - 1]) {
+				best[pos] = best[pos - 1];
+				order[pos] = order[pos - 1];
+				pos--;
+			}
+			best[pos] = value;
+			order[pos] = i;
+		}
+		return;
+	}
+	for(index_t i = 0; i < n; i++)
+		order[i] = i;
+	auto before = [x, stride](index_t a, index_t b) {
+		Dtype va = x[a * stride], vb = x[b * stride];
+		return va > vb || (va == vb && a < b);
+	};
+	if(k < n)
+		std::nth_element(order, order + k, order + n, before);
+	std::sort(order, order + k, before);
+}
+
+// values[o, r, i] and indices[o, r, i] are the r-th largest of x[o, :, i] and its index, for x
+// (outer, n, inner) and r < k. Every (o, i) is selected on its own, in parallel.
+template<typename Dtype, typename Itype>
+void topk_axis(index_t outer, index_t n, index_t inner, index_t k, const Dtype* x,
+			   Dtype* values, Itype* indices) {
+	parallel_for(0, outer * inner, std::max(1, 4096 / n), [&](index_t begin, index_t end) {
+		std::vector<index_t> order(n);
+		for(index_t task = begin; task < end; task++) {
+			index_t o = task / inner, i = task % inner;
+			const Dtype* x_col = x + o * n * inner + i;
+			topk_strided(x_col, n, inner, k, order.data());
+			for(index_t r = 0; r < k; r++) {
+				index_t out = (o * k + r) * inner + i;
+				values[out] = x_col[order[r] * inner];
+				indices[out] = order[r];
+			}
+		}
+	});
+}
+
+// ******************** label rank ********************
+// For each row of x (rows, n) and its label l: predictions = argmax of the row, and ranks = the
+// number of values which come before x[l], i.e. larger ones, or equal ones with a lower index. The
+// label is among the top k iff its rank is below k, so accuracy at any k needs no selection, only
+// comparisons of the whole row with one value, which vectorize. A NaN x[l] has rank n, it's never
+// correct, where the comparisons alone would all be false and rank it first.
+template<typename Dtype, typename Ltype>
+void label_rank_rows(index_t rows, index_t n, const Dtype* x, const Ltype* labels,
+					 index_t* predictions, index_t* ranks) {
+	parallel_for(0, rows, std::max(1, 4096 / n), [&](index_t begin, index_t end) {
+		for(index_t row = begin; row < end; row++) {
+			const Dtype* x_row = x + row * n;
+			index_t label = labels[row];
+			Dtype value = x_row[label];
+			if(value != value) {
+				ranks[row] = n;
+				predictions[row] = argmax_contiguous(x_row, n);
+				continue;
+			}
+			index_t rank = 0;
+			for(index_t j = 0; j < label; j++)
+				rank += x_row[j] >= value;
+			for(index_t j = label + 1; j < n; j++)
+				rank += x_row[j] > value;
+			ranks[row] = rank;
+			predictions[row] = rank == 0 ? label : argmax_contiguous(x_row, n);
+		}
+	});
+}
+
+}  // namespace kernel
+}  // namespace el
+
+#endif
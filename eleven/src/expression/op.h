@@ -3,18 +3,33 @@
 
 #include "node.h"
 #include "expression.h"
+#include "dense.h"
 #include "../tensor/tensor_impl.h"
 
 #include "operations/base_ops.h"
 #include "operations/img2col.h"
+#include "operations/conv2d.h"
+#include "operations/linear.h"
+#include "operations/attention.h"
+#include "operations/batch_norm.h"
+#include "operations/embedding.h"
+#include "operations/index_select.h"
+#include "operations/layer_norm.h"
 #include "operations/matrix_multiply.h"
+#include "operations/rnn.h"
 #include "operations/sigmoid.h"
+#include "operations/tanh.h"
 #include "operations/relu.h"
+#include "operations/leaky_relu.h"
+#include "operations/gelu.h"
 #include "operations/nll_loss.h"
 #include "operations/log_softmax.h"
-#include "operations/max_pooling.h"
-#include "operations/mean_reduce.h"
+#include "operations/cross_entropy.h"
+#include "operations/pooling.h"
+#include "operations/reduce.h"
 #include "operations/argmax.h"
+#include "operations/topk.h"
+#include "operations/layout.h"
 #include "op_impl.h"
 
 namespace el {
@@ -36,6 +51,15 @@ template<typename Dtype> Node<Dtype> relu(const Node<Dtype>& operand);
 template<typename Dtype> SigmoidExp<Dtype> sigmoid(const Exp<Dtype>& operand);
 template<typename Dtype> Node<Dtype> sigmoid(const Node<Dtype>& operand);
 
+template<typename Dtype> TanhExp<Dtype> tanh(const Exp<Dtype>& operand);
+template<typename Dtype> Node<Dtype> tanh(const Node<Dtype>& operand);
+
+template<typename Dtype> LeakyReLUExp<Dtype> leaky_relu(const Exp<Dtype>& operand, float_t negative_slope);
+template<typename Dtype> Node<Dtype> leaky_relu(const Node<Dtype>& operand, float_t negative_slope);
+
+template<typename Dtype> GELUExp<Dtype> gelu(const Exp<Dtype>& operand);
+template<typename Dtype> Node<Dtype> gelu(const Node<Dtype>& operand);
+
 template<typename Dtype> MatrixTransposeExp<Dtype> transpose(const Exp<Dtype>& operand);
 template<typename Dtype> Node<Dtype> transpose(const Node<Dtype>& operand);
 
@@ -48,6 +72,83 @@ template<typename Dtype> Node<Dtype> img2col(const Node<Dtype>& operand,
 								             const std::pair<index_t, index_t>& stride, 
 								             const std::pair<index_t, index_t>& padding); 
 
+template<typename Dtype> Conv2DExp<Dtype> conv2d(const Exp<Dtype>& imgs, const Exp<Dtype>& weight,
+								                 const std::pair<index_t, index_t>& kernel_size,
+								                 const std::pair<index_t, index_t>& stride,
+								                 const std::pair<index_t, index_t>& padding,
+								                 kernel::ConvAlgo algo,
+								                 index_t groups);
+template<typename Dtype> Node<Dtype> conv2d(const Node<Dtype>& imgs, const Node<Dtype>& weight,
+								            const std::pair<index_t, index_t>& kernel_size,
+								            const std::pair<index_t, index_t>& stride,
+								            const std::pair<index_t, index_t>& padding,
+								            kernel::ConvAlgo algo,
+								            index_t groups);
+template<typename Dtype> Conv2DExp<Dtype> conv2d(const Exp<Dtype>& imgs, const Exp<Dtype>& weight,
+								                 const Exp<Dtype>& bias,
+								                 const std::pair<index_t, index_t>& kernel_size,
+								                 const std::pair<index_t, index_t>& stride,
+								                 const std::pair<index_t, index_t>& padding,
+								                 kernel::Activation act,
+								                 kernel::ConvAlgo algo,
+								                 index_t groups);
+template<typename Dtype> Node<Dtype> conv2d(const Node<Dtype>& imgs, const Node<Dtype>& weight,
+								            const Node<Dtype>& bias,
+								            const std::pair<index_t, index_t>& kernel_size,
+								            const std::pair<index_t, index_t>& stride,
+								            const std::pair<index_t, index_t>& padding,
+								            kernel::Activation act,
+								            kernel::ConvAlgo algo,
+								            index_t groups);
+
+template<typename Dtype> LinearExp<Dtype> linear(const Exp<Dtype>& input, const Exp<Dtype>& weight,
+								                 const Exp<Dtype>& bias, kernel::Activation act,
+								                 const kernel::PackedMatrix<Dtype>* packed_weight);
+template<typename Dtype> Node<Dtype> linear(const Node<Dtype>& input, const Node<Dtype>& weight,
+								            const Node<Dtype>& bias, kernel::Activation act,
+								            const kernel::PackedMatrix<Dtype>* packed_weight);
+
+template<typename Dtype> BatchNormExp<Dtype> batch_norm(const Exp<Dtype>& input, const Exp<Dtype>& weight,
+								                        const Exp<Dtype>& bias, const Tensor<Dtype>* running_mean,
+								                        const Tensor<Dtype>* running_var, float_t eps);
+template<typename Dtype> Node<Dtype> batch_norm(const Node<Dtype>& input, const Node<Dtype>& weight,
+								                const Node<Dtype>& bias, const Tensor<Dtype>* running_mean,
+								                const Tensor<Dtype>* running_var, float_t eps);
+
+template<typename Dtype> LayerNormExp<Dtype> layer_norm(const Exp<Dtype>& input, const Exp<Dtype>& weight,
+								                        const Exp<Dtype>& bias, float_t eps);
+template<typename Dtype> Node<Dtype> layer_norm(const Node<Dtype>& input, const Node<Dtype>& weight,
+								                const Node<Dtype>& bias, float_t eps);
+
+template<typename Dtype> RMSNormExp<Dtype> rms_norm(const Exp<Dtype>& input, const Exp<Dtype>& weight, float_t eps);
+template<typename Dtype> Node<Dtype> rms_norm(const Node<Dtype>& input, const Node<Dtype>& weight, float_t eps);
+
+template<typename Dtype> AttentionExp<Dtype> attention(const Exp<Dtype>& query, const Exp<Dtype>& key,
+								                       const Exp<Dtype>& value, bool causal, float_t scale);
+template<typename Dtype> Node<Dtype> attention(const Node<Dtype>& query, const Node<Dtype>& key,
+								               const Node<Dtype>& value, bool causal, float_t scale);
+
+template<typename Dtype> EmbeddingExp<Dtype> embedding(const Exp<Dtype>& weight, const Exp<int_t>& index,
+								                       kernel::SparseRows<Dtype>* sparse_grad);
+template<typename Dtype> Node<Dtype> embedding(const Node<Dtype>& weight, const Node<int_t>& index,
+								               kernel::SparseRows<Dtype>* sparse_grad);
+
+template<typename Dtype> IndexSelectExp<Dtype> index_select(const Exp<Dtype>& input, const Exp<int_t>& index);
+template<typename Dtype> Node<Dtype> index_select(const Node<Dtype>& input, const Node<int_t>& index);
+template<typename Dtype> void index_select(const Exp<Dtype>& input, const Exp<int_t>& index, Tensor<Dtype>& out);
+
+template<typename Dtype> RNNExp<Dtype> lstm(const Exp<Dtype>& input, const Exp<Dtype>& weight_ih,
+								            const Exp<Dtype>& weight_hh, const Exp<Dtype>& bias_ih,
+								            const Exp<Dtype>& bias_hh);
+template<typename Dtype> Node<Dtype> lstm(const Node<Dtype>& input, const Node<Dtype>& weight_ih,
+								          const Node<Dtype>& weight_hh, const Node<Dtype>& bias_ih,
+								          const Node<Dtype>& bias_hh);
+template<typename Dtype> RNNExp<Dtype> gru(const Exp<Dtype>& input, const Exp<Dtype>& weight_ih,
+								           const Exp<Dtype>& weight_hh, const Exp<Dtype>& bias_ih,
+								           const Exp<Dtype>& bias_hh);
+template<typename Dtype> Node<Dtype> gru(const Node<Dtype>& input, const Node<Dtype>& weight_ih,
+								         const Node<Dtype>& weight_hh, const Node<Dtype>& bias_ih,
+								         const Node<Dtype>& bias_hh);
 
 template<typename Dtype> AddExp<Dtype> operator+(const Exp<Dtype>& loperand, const Exp<Dtype>& roperand);
 template<typename Dtype> Node<Dtype> operator+(const Node<Dtype>& loperand, const Node<Dtype>& roperand);
@@ -70,15 +171,56 @@ template<typename Dtype> Node<Dtype> nll_loss(const Node<Dtype>& src, const Node
 template<typename Dtype> LogSoftmaxExp<Dtype> log_softmax(const Exp<Dtype>& src);
 template<typename Dtype> Node<Dtype> log_softmax(const Node<Dtype>& src);
 
-template<typename Dtype> MaxPool2DExp<Dtype> maxpooling2d(const Exp<Dtype>& operand, const std::pair<index_t, index_t>& kernel_size);
+template<typename Dtype> CrossEntropyExp<Dtype> cross_entropy(const Exp<Dtype>& src, const Exp<int_t>& index);
+template<typename Dtype> Node<Dtype> cross_entropy(const Node<Dtype>& src, const Node<int_t>& index);
+
+template<typename Dtype> Pool2DExp<Dtype> pool2d(const Exp<Dtype>& operand, kernel::PoolMode mode,
+								               const std::pair<index_t, index_t>& kernel_size,
+								               const std::pair<index_t, index_t>& stride,
+								               const std::pair<index_t, index_t>& padding,
+								               bool ceil_mode);
+template<typename Dtype> Node<Dtype> pool2d(const Node<Dtype>& operand, kernel::PoolMode mode,
+								          const std::pair<index_t, index_t>& kernel_size,
+								          const std::pair<index_t, index_t>& stride,
+								          const std::pair<index_t, index_t>& padding,
+								          bool ceil_mode);
+
+template<typename Dtype> Pool2DExp<Dtype> adaptive_pool2d(const Exp<Dtype>& operand, kernel::PoolMode mode,
+								                        const std::pair<index_t, index_t>& output_size);
+template<typename Dtype> Node<Dtype> adaptive_pool2d(const Node<Dtype>& operand, kernel::PoolMode mode,
+								                   const std::pair<index_t, index_t>& output_size);
+
+template<typename Dtype> Pool2DExp<Dtype> maxpooling2d(const Exp<Dtype>& operand, const std::pair<index_t, index_t>& kernel_size);
 template<typename Dtype> Node<Dtype> maxpooling2d(const Node<Dtype>& operand, const std::pair<index_t, index_t>& kernel_size);
 
-template<typename Dtype> MeanReduceExp<Dtype> mean(const Exp<Dtype>& operand, index_t dim);
+template<typename Dtype> ReduceExp<Dtype> sum(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+template<typename Dtype> Node<Dtype> sum(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+
+template<typename Dtype> ReduceExp<Dtype> mean(const Exp<Dtype>& operand, index_t dim);
 template<typename Dtype> Node<Dtype> mean(const Node<Dtype>& operand, index_t dim);
+template<typename Dtype> ReduceExp<Dtype> mean(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+template<typename Dtype> Node<Dtype> mean(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+
+template<typename Dtype> ReduceExp<Dtype> max(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+template<typename Dtype> Node<Dtype> max(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+
+template<typename Dtype> ReduceExp<Dtype> min(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+template<typename Dtype> Node<Dtype> min(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim);
+
+template<typename Dtype> ReduceExp<Dtype> var(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim, 
+											  bool unbiased);
+template<typename Dtype> Node<Dtype> var(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim, 
+										 bool unbiased);
 
 template<typename Dtype> ArgmaxExp<Dtype> argmax(const Exp<Dtype>& operand, index_t dim);
 template<typename Dtype> Node<Dtype> argmax(const Node<Dtype>& operand, index_t dim);
 
+template<typename Dtype> TopKExp<Dtype> topk(const Exp<Dtype>& operand, index_t k, index_t dim);
+template<typename Dtype> Node<Dtype> topk(const Node<Dtype>& operand, index_t k, index_t dim);
+
+template<typename Dtype> ToLayoutExp<Dtype> to_layout(const Exp<Dtype>& operand, Layout layout);
+template<typename Dtype> Node<Dtype> to_layout(const Node<Dtype>& operand, Layout layout);
+
 }  // namespace op
 }  // namespace el
 
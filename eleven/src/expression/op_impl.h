@@ -43,6 +43,39 @@ inline Node<Dtype> sigmoid(const Node<Dtype>& operand) {
 	return Node<Dtype>(new SigmoidExp<Dtype>(operand.get_exp_ptr()));
 }
 
+template<typename Dtype>
+inline TanhExp<Dtype> tanh(const Exp<Dtype>& operand) {
+	return TanhExp<Dtype>(operand);
+}
+template<typename Dtype>
+inline Node<Dtype> tanh(const Node<Dtype>& operand) {
+	return Node<Dtype>(new TanhExp<Dtype>(operand.get_exp_ptr()));
+}
+
+#define CHECK_LEAKY_RELU(negative_slope)	\
+	CHECK_TRUE((negative_slope) >= 0, NotImplementError,	\
+		"LeakyReLU's backward expects negative_slope >= 0, but got %f", (negative_slope))
+
+template<typename Dtype>
+inline LeakyReLUExp<Dtype> leaky_relu(const Exp<Dtype>& operand, float_t negative_slope=0.01) {
+	CHECK_LEAKY_RELU(negative_slope);
+	return LeakyReLUExp<Dtype>(operand, negative_slope);
+}
+template<typename Dtype>
+inline Node<Dtype> leaky_relu(const Node<Dtype>& operand, float_t negative_slope=0.01) {
+	CHECK_LEAKY_RELU(negative_slope);
+	return Node<Dtype>(new LeakyReLUExp<Dtype>(operand.get_exp_ptr(), negative_slope));
+}
+
+template<typename Dtype>
+inline GELUExp<Dtype> gelu(const Exp<Dtype>& operand) {
+	return GELUExp<Dtype>(operand);
+}
+template<typename Dtype>
+inline Node<Dtype> gelu(const Node<Dtype>& operand) {
+	return Node<Dtype>(new GELUExp<Dtype>(operand.get_exp_ptr()));
+}
+
 template<typename Dtype>
 inline MatrixTransposeExp<Dtype> transpose(const Exp<Dtype>& operand) {
 	CHECK_EQUAL(operand.dim(), 2, DimNotMatch,
@@ -85,6 +118,331 @@ inline Node<Dtype> img2col(const Node<Dtype>& operand,
 	return Node<Dtype>(ret);
 }
 
+#define CHECK_CONV2D(imgs, weight, kernel_size, stride, padding, groups)	do {	\
+	CHECK_EQUAL((imgs).dim(), 4, DimNotMatch,	\
+		"Conv2d expect 4D tensor:(b, c, h, w), but got %dD tensor", (imgs).dim());	\
+	CHECK_EQUAL((weight).dim(), 3, DimNotMatch,	\
+		"Conv2d expect 3D weight:(1, oc, c/groups*kh*kw), but got %dD tensor", (weight).dim());	\
+	CHECK_TRUE((groups) > 0 && (imgs).size(1) % (groups) == 0 && (weight).size(1) % (groups) == 0, OperandSizeNotMatch,	\
+		"Conv2d can't split %d input channels and %d output channels into %d groups",	\
+		(imgs).size(1), (weight).size(1), (groups));	\
+	CHECK_EQUAL((weight).size(2), (imgs).size(1) / (groups) * (kernel_size).first * (kernel_size).second, OperandSizeNotMatch,	\
+		"Conv2d weight has size %d on dimension 2, but the image has %d channels in %d groups and kernel size is (%d, %d)",	\
+		(weight).size(2), (imgs).size(1), (groups), (kernel_size).first, (kernel_size).second);	\
+	CHECK_TRUE((imgs).size(2) + 2 * (padding).first >= (kernel_size).first &&	\
+			   (imgs).size(3) + 2 * (padding).second >= (kernel_size).second, OperandSizeNotMatch,	\
+		"Can't convolve on image(%d, %d) because of too big kernel size(%d, %d)",	\
+		(imgs).size(2), (imgs).size(3), (kernel_size).first, (kernel_size).second);	\
+} while(0)
+
+template<typename Dtype>
+inline Conv2DExp<Dtype> conv2d(const Exp<Dtype>& imgs, const Exp<Dtype>& weight,
+							   const std::pair<index_t, index_t>& kernel_size,
+							   const std::pair<index_t, index_t>& stride,
+							   const std::pair<index_t, index_t>& padding,
+							   kernel::ConvAlgo algo=kernel::ConvAlgo::Auto,
+							   index_t groups=1) {
+	CHECK_CONV2D(imgs, weight, kernel_size, stride, padding, groups);
+	return Conv2DExp<Dtype>(imgs, weight, kernel_size, stride, padding, algo, groups);
+}
+template<typename Dtype>
+inline Node<Dtype> conv2d(const Node<Dtype>& imgs, const Node<Dtype>& weight,
+						  const std::pair<index_t, index_t>& kernel_size,
+						  const std::pair<index_t, index_t>& stride,
+						  const std::pair<index_t, index_t>& padding,
+						  kernel::ConvAlgo algo=kernel::ConvAlgo::Auto,
+						  index_t groups=1) {
+	CHECK_CONV2D(imgs, weight, kernel_size, stride, padding, groups);
+	return Node<Dtype>(new Conv2DExp<Dtype>(imgs.get_exp_ptr(), weight.get_exp_ptr(),
+											kernel_size, stride, padding, algo, groups));
+}
+
+#define CHECK_BIAS(bias, features, name)	do {	\
+	index_t bias_dsize = 1;	\
+	for(index_t i = 0; i < (bias).dim(); i++)	\
+		bias_dsize *= (bias).size(i);	\
+	CHECK_EQUAL(bias_dsize, (features), OperandSizeNotMatch,	\
+		name " expect a bias with %d elements, but got %d", (features), bias_dsize);	\
+} while(0)
+
+template<typename Dtype>
+inline Conv2DExp<Dtype> conv2d(const Exp<Dtype>& imgs, const Exp<Dtype>& weight,
+							   const Exp<Dtype>& bias,
+							   const std::pair<index_t, index_t>& kernel_size,
+							   const std::pair<index_t, index_t>& stride,
+							   const std::pair<index_t, index_t>& padding,
+							   kernel::Activation act=kernel::Activation::None,
+							   kernel::ConvAlgo algo=kernel::ConvAlgo::Auto,
+							   index_t groups=1) {
+	CHECK_CONV2D(imgs, weight, kernel_size, stride, padding, groups);
+	CHECK_BIAS(bias, weight.size(1), "Conv2d");
+	return Conv2DExp<Dtype>(imgs, weight, bias, kernel_size, stride, padding, act, algo, groups);
+}
+template<typename Dtype>
+inline Node<Dtype> conv2d(const Node<Dtype>& imgs, const Node<Dtype>& weight,
+						  const Node<Dtype>& bias,
+						  const std::pair<index_t, index_t>& kernel_size,
+						  const std::pair<index_t, index_t>& stride,
+						  const std::pair<index_t, index_t>& padding,
+						  kernel::Activation act=kernel::Activation::None,
+						  kernel::ConvAlgo algo=kernel::ConvAlgo::Auto,
+						  index_t groups=1) {
+	CHECK_CONV2D(imgs, weight, kernel_size, stride, padding, groups);
+	CHECK_BIAS(bias, weight.size(1), "Conv2d");
+	return Node<Dtype>(new Conv2DExp<Dtype>(imgs.get_exp_ptr(), weight.get_exp_ptr(), bias.get_exp_ptr(),
+											kernel_size, stride, padding, act, algo, groups));
+}
+
+#define CHECK_LINEAR(input, weight)	do {	\
+	CHECK_EQUAL((input).dim(), 2, DimNotMatch,	\
+		"Linear expect 2D input:(batch, in), but got %dD tensor", (input).dim());	\
+	CHECK_EQUAL((weight).dim(), 3, DimNotMatch,	\
+		"Linear expect 3D weight:(1, out, in), but got %dD tensor", (weight).dim());	\
+	CHECK_EQUAL((weight).size(2), (input).size(1), OperandSizeNotMatch,	\
+		"Linear weight has %d input features, but the input has %d", (weight).size(2), (input).size(1));	\
+} while(0)
+
+#define CHECK_PACKED_WEIGHT(packed_weight, weight) do {	\
+	if((packed_weight) == nullptr) break;	\
+	CHECK_TRUE(!(packed_weight)->is_a() && (packed_weight)->rows() == (weight).size(1) &&	\
+			   (packed_weight)->k() == (weight).size(2), OperandSizeNotMatch,	\
+		"Packed weight of (%d, %d) doesn't match weight (1, %d, %d)",	\
+		(packed_weight)->rows(), (packed_weight)->k(), (weight).size(1), (weight).size(2));	\
+} while(0)
+
+template<typename Dtype>
+inline LinearExp<Dtype> linear(const Exp<Dtype>& input, const Exp<Dtype>& weight,
+							   const Exp<Dtype>& bias, kernel::Activation act=kernel::Activation::None,
+							   const kernel::PackedMatrix<Dtype>* packed_weight=nullptr) {
+	CHECK_LINEAR(input, weight);
+	CHECK_BIAS(bias, weight.size(1), "Linear");
+	CHECK_PACKED_WEIGHT(packed_weight, weight);
+	return LinearExp<Dtype>(input, weight, bias, act, packed_weight);
+}
+template<typename Dtype>
+inline Node<Dtype> linear(const Node<Dtype>& input, const Node<Dtype>& weight,
+						  const Node<Dtype>& bias, kernel::Activation act=kernel::Activation::None,
+						  const kernel::PackedMatrix<Dtype>* packed_weight=nullptr) {
+	CHECK_LINEAR(input, weight);
+	CHECK_BIAS(bias, weight.size(1), "Linear");
+	CHECK_PACKED_WEIGHT(packed_weight, weight);
+	return Node<Dtype>(new LinearExp<Dtype>(input.get_exp_ptr(), weight.get_exp_ptr(), bias.get_exp_ptr(),
+											act, packed_weight));
+}
+
+#define CHECK_CHANNEL_PARAM(param, channels, name)	do {	\
+	index_t param_dsize = 1;	\
+	for(index_t i = 0; i < (param).dim(); i++)	\
+		param_dsize *= (param).size(i);	\
+	CHECK_EQUAL(param_dsize, (channels), OperandSizeNotMatch,	\
+		name " expect one value per channel, %d, but got %d", (channels), param_dsize);	\
+} while(0)
+
+#define CHECK_BATCH_NORM(input, weight, bias, running_mean, running_var)	do {	\
+	CHECK_TRUE((input).dim() == 2 || (input).dim() == 4, DimNotMatch,	\
+		"BatchNorm expect input:(batch, channels) or (batch, channels, h, w), but got %dD tensor", (input).dim());	\
+	CHECK_CHANNEL_PARAM(weight, (input).size(1), "BatchNorm weight");	\
+	CHECK_CHANNEL_PARAM(bias, (input).size(1), "BatchNorm bias");	\
+	CHECK_TRUE(((running_mean) == nullptr) == ((running_var) == nullptr), OperandSizeNotMatch,	\
+		"BatchNorm needs both running mean and running var, or neither");	\
+	if((running_mean) != nullptr) {	\
+		CHECK_CHANNEL_PARAM(*(running_mean), (input).size(1), "BatchNorm running mean");	\
+		CHECK_CHANNEL_PARAM(*(running_var), (input).size(1), "BatchNorm running var");	\
+	}	\
+} while(0)
+
+// Statistics of the batch when running_mean and running_var are nullptr, else those.
+template<typename Dtype>
+inline BatchNormExp<Dtype> batch_norm(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+									  const Tensor<Dtype>* running_mean=nullptr,
+									  const Tensor<Dtype>* running_var=nullptr, float_t eps=1e-5) {
+	CHECK_BATCH_NORM(input, weight, bias, running_mean, running_var);
+	return BatchNormExp<Dtype>(input, weight, bias, running_mean, running_var, eps);
+}
+template<typename Dtype>
+inline Node<Dtype> batch_norm(const Node<Dtype>& input, const Node<Dtype>& weight, const Node<Dtype>& bias,
+							  const Tensor<Dtype>* running_mean=nullptr,
+							  const Tensor<Dtype>* running_var=nullptr, float_t eps=1e-5) {
+	CHECK_BATCH_NORM(input, weight, bias, running_mean, running_var);
+	return Node<Dtype>(new BatchNormExp<Dtype>(input.get_exp_ptr(), weight.get_exp_ptr(), bias.get_exp_ptr(),
+											   running_mean, running_var, eps));
+}
+
+// The last dims of input must be the dims of param.
+#define CHECK_NORMALIZED_SHAPE(input, param, name)	do {	\
+	CHECK_TRUE((param).dim() >= 1 && (input).dim() >= (param).dim(), DimNotMatch,	\
+		name " expect input with the dims of the weight last, but got %dD input and %dD weight",	\
+		(input).dim(), (param).dim());	\
+	index_t lead_dims = (input).dim() - (param).dim();	\
+	for(index_t i = 0; i < (param).dim(); i++)	\
+		CHECK_EQUAL((input).size(lead_dims + i), (param).size(i), OperandSizeNotMatch,	\
+			name " expect size %d at dim %d of input, but got %d", (param).size(i), lead_dims + i,	\
+			(input).size(lead_dims + i));	\
+} while(0)
+
+#define CHECK_SAME_SHAPE(param, other, name)	do {	\
+	CHECK_EQUAL((param).dim(), (other).dim(), DimNotMatch,	\
+		name " expect %dD, but got %dD", (other).dim(), (param).dim());	\
+	for(index_t i = 0; i < (param).dim(); i++)	\
+		CHECK_EQUAL((param).size(i), (other).size(i), OperandSizeNotMatch,	\
+			name " expect size %d at dim %d, but got %d", (other).size(i), i, (param).size(i));	\
+} while(0)
+
+template<typename Dtype>
+inline LayerNormExp<Dtype> layer_norm(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+									  float_t eps=1e-5) {
+	CHECK_NORMALIZED_SHAPE(input, weight, "LayerNorm");
+	CHECK_SAME_SHAPE(bias, weight, "LayerNorm bias");
+	return LayerNormExp<Dtype>(input, weight, bias, eps);
+}
+template<typename Dtype>
+inline Node<Dtype> layer_norm(const Node<Dtype>& input, const Node<Dtype>& weight, const Node<Dtype>& bias,
+							  float_t eps=1e-5) {
+	CHECK_NORMALIZED_SHAPE(input, weight, "LayerNorm");
+	CHECK_SAME_SHAPE(bias, weight, "LayerNorm bias");
+	return Node<Dtype>(new LayerNormExp<Dtype>(input.get_exp_ptr(), weight.get_exp_ptr(), bias.get_exp_ptr(), eps));
+}
+
+template<typename Dtype>
+inline RMSNormExp<Dtype> rms_norm(const Exp<Dtype>& input, const Exp<Dtype>& weight, float_t eps=1e-6) {
+	CHECK_NORMALIZED_SHAPE(input, weight, "RMSNorm");
+	return RMSNormExp<Dtype>(input, weight, eps);
+}
+template<typename Dtype>
+inline Node<Dtype> rms_norm(const Node<Dtype>& input, const Node<Dtype>& weight, float_t eps=1e-6) {
+	CHECK_NORMALIZED_SHAPE(input, weight, "RMSNorm");
+	return Node<Dtype>(new RMSNormExp<Dtype>(input.get_exp_ptr(), weight.get_exp_ptr(), eps));
+}
+
+#define CHECK_ATTENTION(query, key, value)	do {	\
+	CHECK_TRUE((query).dim() == 3 && (key).dim() == 3 && (value).dim() == 3, DimNotMatch,	\
+		"Attention expect query, key and value of (batch, len, dim), but got %dD, %dD and %dD tensors",	\
+		(query).dim(), (key).dim(), (value).dim());	\
+	CHECK_TRUE((key).size(0) == (query).size(0) && (value).size(0) == (query).size(0), OperandSizeNotMatch,	\
+		"Attention expect the same batch, but got %d, %d and %d", (query).size(0), (key).size(0), (value).size(0));	\
+	CHECK_EQUAL((key).size(2), (query).size(2), OperandSizeNotMatch,	\
+		"Attention expect key dim %d like the query, but got %d", (query).size(2), (key).size(2));	\
+	CHECK_EQUAL((value).size(1), (key).size(1), OperandSizeNotMatch,	\
+		"Attention expect one value per key, %d, but got %d", (key).size(1), (value).size(1));	\
+	CHECK_TRUE((key).size(1) > 0, OperandSizeNotMatch, "Attention expect at least one key");	\
+} while(0)
+
+// scale <= 0 means 1 / sqrt(dim). With causal, query i attends to the keys j <= i.
+template<typename Dtype>
+inline AttentionExp<Dtype> attention(const Exp<Dtype>& query, const Exp<Dtype>& key, const Exp<Dtype>& value,
+									 bool causal=false, float_t scale=0) {
+	CHECK_ATTENTION(query, key, value);
+	return AttentionExp<Dtype>(query, key, value, causal, scale > 0 ? scale : 1 / std::sqrt(float_t(query.size(2))));
+}
+template<typename Dtype>
+inline Node<Dtype> attention(const Node<Dtype>& query, const Node<Dtype>& key, const Node<Dtype>& value,
+							 bool causal=false, float_t scale=0) {
+	CHECK_ATTENTION(query, key, value);
+	return Node<Dtype>(new AttentionExp<Dtype>(query.get_exp_ptr(), key.get_exp_ptr(), value.get_exp_ptr(), causal,
+											   scale > 0 ? scale : 1 / std::sqrt(float_t(query.size(2)))));
+}
+
+#define CHECK_EMBEDDING(weight, index)	do {	\
+	CHECK_EQUAL((weight).dim(), 2, DimNotMatch,	\
+		"Embedding expect weight:(num, dim), but got %dD tensor", (weight).dim());	\
+	CHECK_TRUE((index).dim() >= 1, DimNotMatch, "Embedding expect a tensor of indices, but got a scalar");	\
+} while(0)
+
+// Index values out of [0, num) throw IndexOutOfRange.
+template<typename Dtype>
+inline EmbeddingExp<Dtype> embedding(const Exp<Dtype>& weight, const Exp<int_t>& index,
+									 kernel::SparseRows<Dtype>* sparse_grad=nullptr) {
+	CHECK_EMBEDDING(weight, index);
+	return EmbeddingExp<Dtype>(weight, index, sparse_grad);
+}
+template<typename Dtype>
+inline Node<Dtype> embedding(const Node<Dtype>& weight, const Node<int_t>& index,
+							 kernel::SparseRows<Dtype>* sparse_grad=nullptr) {
+	CHECK_EMBEDDING(weight, index);
+	return Node<Dtype>(new EmbeddingExp<Dtype>(weight.get_exp_ptr(), index.get_exp_ptr(), sparse_grad));
+}
+
+#define CHECK_INDEX_SELECT(input, index)	do {	\
+	CHECK_TRUE((input).dim() >= 1, DimNotMatch, "index_select expect a tensor, but got a scalar");	\
+	CHECK_EQUAL((index).dim(), 1, DimNotMatch,	\
+		"index_select expect a 1D index, but got %dD tensor", (index).dim());	\
+} while(0)
+
+// Picks along dim 0. Index values out of [0, num) throw IndexOutOfRange.
+template<typename Dtype>
+inline IndexSelectExp<Dtype> index_select(const Exp<Dtype>& input, const Exp<int_t>& index) {
+	CHECK_INDEX_SELECT(input, index);
+	return IndexSelectExp<Dtype>(input, index);
+}
+template<typename Dtype>
+inline Node<Dtype> index_select(const Node<Dtype>& input, const Node<int_t>& index) {
+	CHECK_INDEX_SELECT(input, index);
+	return Node<Dtype>(new IndexSelectExp<Dtype>(input.get_exp_ptr(), index.get_exp_ptr()));
+}
+// Gathers straight into out, a contiguous tensor of n slices of the same number of values, like a
+// preallocated (n, 1, 28, 28) batch from a (num, 784) table, with no expression or buffer in between.
+// out's version goes forward, as with any assignment to it.
+template<typename Dtype>
+inline void index_select(const Exp<Dtype>& input, const Exp<int_t>& index, Tensor<Dtype>& out) {
+	CHECK_INDEX_SELECT(input, index);
+	CHECK_TRUE(out.data() != nullptr, TensorNotContiguous, "index_select expect a contiguous output tensor");
+	CHECK_TRUE(out.size(0) == index.size(0) && out.size().subsize(1) == Shape(input).subsize(1),
+			   OperandSizeNotMatch,
+		"index_select of %d slices of %d values can't be written to a tensor of %d",
+		index.size(0), Shape(input).subsize(1), out.size().dsize());
+	index_t num = input.size(0), n = index.size(0);
+	Dense<int_t> ids(index);
+	for(index_t i = 0; i < n; i++)
+		CHECK_BETWEEN(ids.data()[i], 0, num, IndexOutOfRange,
+			"index_select from %d slices, but got index %d", num, ids.data()[i]);
+	Dense<Dtype> src(input);
+	kernel::gather_rows(n, out.size().subsize(1), ids.data(), src.data(), out.data());
+	out.version_forward();
+}
+
+#define CHECK_RNN(input, weight_ih, weight_hh, bias_ih, bias_hh, gates, name)	do {	\
+	CHECK_EQUAL((input).dim(), 3, DimNotMatch,	\
+		name " expect input:(seq, batch, in), but got %dD tensor", (input).dim());	\
+	CHECK_TRUE((weight_ih).dim() == 2 && (weight_hh).dim() == 2, DimNotMatch,	\
+		name " expect 2D weights, but got %dD and %dD tensors", (weight_ih).dim(), (weight_hh).dim());	\
+	index_t rnn_width = (gates) * (weight_hh).size(1);	\
+	CHECK_TRUE((weight_ih).size(0) == rnn_width && (weight_hh).size(0) == rnn_width, OperandSizeNotMatch,	\
+		name " expect weights of %d gate rows, but got %d and %d", rnn_width, (weight_ih).size(0),	\
+		(weight_hh).size(0));	\
+	CHECK_EQUAL((weight_ih).size(1), (input).size(2), OperandSizeNotMatch,	\
+		name " expect input size %d, but got %d", (weight_ih).size(1), (input).size(2));	\
+	CHECK_CHANNEL_PARAM(bias_ih, rnn_width, name " bias_ih");	\
+	CHECK_CHANNEL_PARAM(bias_hh, rnn_width, name " bias_hh");	\
+} while(0)
+
+template<typename Dtype>
+inline RNNExp<Dtype> lstm(const Exp<Dtype>& input, const Exp<Dtype>& weight_ih, const Exp<Dtype>& weight_hh,
+						  const Exp<Dtype>& bias_ih, const Exp<Dtype>& bias_hh) {
+	CHECK_RNN(input, weight_ih, weight_hh, bias_ih, bias_hh, 4, "LSTM");
+	return RNNExp<Dtype>(kernel::RNNMode::LSTM, input, weight_ih, weight_hh, bias_ih, bias_hh);
+}
+template<typename Dtype>
+inline Node<Dtype> lstm(const Node<Dtype>& input, const Node<Dtype>& weight_ih, const Node<Dtype>& weight_hh,
+						const Node<Dtype>& bias_ih, const Node<Dtype>& bias_hh) {
+	CHECK_RNN(input, weight_ih, weight_hh, bias_ih, bias_hh, 4, "LSTM");
+	return Node<Dtype>(new RNNExp<Dtype>(kernel::RNNMode::LSTM, input.get_exp_ptr(), weight_ih.get_exp_ptr(),
+										 weight_hh.get_exp_ptr(), bias_ih.get_exp_ptr(), bias_hh.get_exp_ptr()));
+}
+
+template<typename Dtype>
+inline RNNExp<Dtype> gru(const Exp<Dtype>& input, const Exp<Dtype>& weight_ih, const Exp<Dtype>& weight_hh,
+						 const Exp<Dtype>& bias_ih, const Exp<Dtype>& bias_hh) {
+	CHECK_RNN(input, weight_ih, weight_hh, bias_ih, bias_hh, 3, "GRU");
+	return RNNExp<Dtype>(kernel::RNNMode::GRU, input, weight_ih, weight_hh, bias_ih, bias_hh);
+}
+template<typename Dtype>
+inline Node<Dtype> gru(const Node<Dtype>& input, const Node<Dtype>& weight_ih, const Node<Dtype>& weight_hh,
+					   const Node<Dtype>& bias_ih, const Node<Dtype>& bias_hh) {
+	CHECK_RNN(input, weight_ih, weight_hh, bias_ih, bias_hh, 3, "GRU");
+	return Node<Dtype>(new RNNExp<Dtype>(kernel::RNNMode::GRU, input.get_exp_ptr(), weight_ih.get_exp_ptr(),
+										 weight_hh.get_exp_ptr(), bias_ih.get_exp_ptr(), bias_hh.get_exp_ptr()));
+}
+
 template<typename Dtype>
 inline AddExp<Dtype> operator+(const Exp<Dtype>& loperand, const Exp<Dtype>& roperand) {
 	CHECK_BROADCAST(loperand, roperand);
@@ -188,42 +546,179 @@ template<typename Dtype> Node<Dtype> log_softmax(const Node<Dtype>& src) {
 	return Node<Dtype>(new LogSoftmaxExp<Dtype>(src.get_exp_ptr()));	
 }
 
+#define CHECK_CROSS_ENTROPY(src, index)	do {	\
+	CHECK_EQUAL((src).dim(), 2, OperandSizeNotMatch,	\
+		"Cross entropy expect src with shape (batch_size, num_cls), but got %dD tensor", (src).dim());	\
+	CHECK_EQUAL((index).dim(), 1, OperandSizeNotMatch,	\
+		"Cross entropy expect 1D tensor as index, but got %dD tensor", (index).dim());	\
+	CHECK_EQUAL((index).size(0), (src).size(0), OperandSizeNotMatch,	\
+		"Cross entropy got %d samples but %d labels", (src).size(0), (index).size(0));	\
+} while(0)
+
+template<typename Dtype> CrossEntropyExp<Dtype> cross_entropy(const Exp<Dtype>& src, const Exp<int_t>& index) {
+	CHECK_CROSS_ENTROPY(src, index);
+	return CrossEntropyExp<Dtype>(src, index);
+}
+template<typename Dtype> Node<Dtype> cross_entropy(const Node<Dtype>& src, const Node<int_t>& index) {
+	CHECK_CROSS_ENTROPY(src, index);
+	return Node<Dtype>(new CrossEntropyExp<Dtype>(src.get_exp_ptr(), index.get_exp_ptr()));
+}
+
+#define CHECK_POOL2D(operand, kernel_size, stride, padding)	do {	\
+	CHECK_EQUAL((operand).dim(), 4, DimNotMatch,	\
+		"Pooling expect 4D tensor:(b, c, h, w), but got %dD tensor", (operand).dim());	\
+	CHECK_TRUE((kernel_size).first > 0 && (kernel_size).second > 0 &&	\
+			   (stride).first > 0 && (stride).second > 0, OperandSizeNotMatch,	\
+		"Pooling expect positive kernel size and stride, but got (%d, %d) and (%d, %d)",	\
+		(kernel_size).first, (kernel_size).second, (stride).first, (stride).second);	\
+	CHECK_TRUE((padding).first >= 0 && (padding).second >= 0 &&	\
+			   2 * (padding).first <= (kernel_size).first && 2 * (padding).second <= (kernel_size).second,	\
+			   OperandSizeNotMatch,	\
+		"Pooling padding(%d, %d) should be at most half of kernel size(%d, %d)",	\
+		(padding).first, (padding).second, (kernel_size).first, (kernel_size).second);	\
+	CHECK_TRUE((operand).size(2) + 2 * (padding).first >= (kernel_size).first &&	\
+			   (operand).size(3) + 2 * (padding).second >= (kernel_size).second, OperandSizeNotMatch,	\
+		"Can't pool on image(%d, %d) because of too big kernel size(%d, %d)",	\
+		(operand).size(2), (operand).size(3), (kernel_size).first, (kernel_size).second);	\
+} while(0)
+
+template<typename Dtype>
+Pool2DExp<Dtype> pool2d(const Exp<Dtype>& operand,
+						kernel::PoolMode mode,
+						const std::pair<index_t, index_t>& kernel_size,
+						const std::pair<index_t, index_t>& stride,
+						const std::pair<index_t, index_t>& padding,
+						bool ceil_mode=false) {
+	CHECK_POOL2D(operand, kernel_size, stride, padding);
+	kernel::PoolParam param(operand.size(0), operand.size(1), operand.size(2), operand.size(3),
+							kernel_size, stride, padding, ceil_mode);
+	return Pool2DExp<Dtype>(operand, mode, param);
+}
+template<typename Dtype>
+Node<Dtype> pool2d(const Node<Dtype>& operand,
+				   kernel::PoolMode mode,
+				   const std::pair<index_t, index_t>& kernel_size,
+				   const std::pair<index_t, index_t>& stride,
+				   const std::pair<index_t, index_t>& padding,
+				   bool ceil_mode=false) {
+	CHECK_POOL2D(operand, kernel_size, stride, padding);
+	kernel::PoolParam param(operand.size(0), operand.size(1), operand.size(2), operand.size(3),
+							kernel_size, stride, padding, ceil_mode);
+	return Node<Dtype>(new Pool2DExp<Dtype>(operand.get_exp_ptr(), mode, param));
+}
+
+#define CHECK_ADAPTIVE_POOL2D(operand, output_size)	do {	\
+	CHECK_EQUAL((operand).dim(), 4, DimNotMatch,	\
+		"Pooling expect 4D tensor:(b, c, h, w), but got %dD tensor", (operand).dim());	\
+	CHECK_TRUE((output_size).first > 0 && (output_size).second > 0 &&	\
+			   (output_size).first <= (operand).size(2) && (output_size).second <= (operand).size(3),	\
+			   OperandSizeNotMatch,	\
+		"Can't pool image(%d, %d) to size(%d, %d)",	\
+		(operand).size(2), (operand).size(3), (output_size).first, (output_size).second);	\
+} while(0)
+
+template<typename Dtype>
+Pool2DExp<Dtype> adaptive_pool2d(const Exp<Dtype>& operand,
+								 kernel::PoolMode mode,
+								 const std::pair<index_t, index_t>& output_size) {
+	CHECK_ADAPTIVE_POOL2D(operand, output_size);
+	auto param = kernel::PoolParam::adaptive_output(operand.size(0), operand.size(1), operand.size(2), 
+													operand.size(3), output_size);
+	return Pool2DExp<Dtype>(operand, mode, param);
+}
+template<typename Dtype>
+Node<Dtype> adaptive_pool2d(const Node<Dtype>& operand,
+							kernel::PoolMode mode,
+							const std::pair<index_t, index_t>& output_size) {
+	CHECK_ADAPTIVE_POOL2D(operand, output_size);
+	auto param = kernel::PoolParam::adaptive_output(operand.size(0), operand.size(1), operand.size(2), 
+													operand.size(3), output_size);
+	return Node<Dtype>(new Pool2DExp<Dtype>(operand.get_exp_ptr(), mode, param));
+}
+
 template<typename Dtype> 
-MaxPool2DExp<Dtype> maxpooling2d(const Exp<Dtype>& operand, 
-     							 const std::pair<index_t, index_t>& kernel_size) {
-	CHECK_EQUAL(operand.dim(), 4, DimNotMatch,
-		"MaxPooling expect 4D tensor:(b, c, h, w), but got %dD tensor", operand.dim());
-	MaxPool2DExp<Dtype> ret(operand, kernel_size);
-	CHECK_TRUE(ret.size(0) > 0 && ret.size(1) > 0, OperandSizeNotMatch,
-		"Can't max pool on image(%d, %d) because of too big kernel size(%d, %d)", 
-		operand.size(2), operand.size(3),
-		kernel_size.first, kernel_size.second);
-	return ret;
+Pool2DExp<Dtype> maxpooling2d(const Exp<Dtype>& operand, 
+     						  const std::pair<index_t, index_t>& kernel_size) {
+	return pool2d(operand, kernel::PoolMode::Max, kernel_size, kernel_size, {0, 0});
 }
 template<typename Dtype> 
 Node<Dtype> maxpooling2d(const Node<Dtype>& operand, 
      					 const std::pair<index_t, index_t>& kernel_size) {
-	CHECK_EQUAL(operand.dim(), 4, DimNotMatch,
-		"MaxPooling expect 4D tensor:(b, c, h, w), but got %dD tensor", operand.dim());
-	MaxPool2DExp<Dtype>* ret = new MaxPool2DExp<Dtype>(operand.get_exp_ptr(), kernel_size);
-	CHECK_TRUE(ret->size(0) > 0 && ret->size(1) > 0, OperandSizeNotMatch,
-		"Can't max pool on image(%d, %d) because of too big kernel size(%d, %d)", 
-		operand.size(2), operand.size(3),
-		kernel_size.first, kernel_size.second);
-	return Node<Dtype>(ret);
+	return pool2d(operand, kernel::PoolMode::Max, kernel_size, kernel_size, {0, 0});
 }
 
+#define CHECK_REDUCE(operand, axes)	do {	\
+	for(size_t ii = 0; ii < (axes).size(); ii++)	\
+		CHECK_BETWEEN((axes)[ii], 0, (operand).dim(), IndexOutOfRange,	\
+			"Reduce is called on a %dD tensor, but got axis = %d", (operand).dim(), (axes)[ii]);	\
+} while(0)
+
 template<typename Dtype>
-MeanReduceExp<Dtype> mean(const Exp<Dtype>& operand, index_t dim) {
-	CHECK_BETWEEN(dim, 0, operand.dim(), IndexOutOfRange,
-		"SumReduce is called on a %dD tensor, but got dim = %d", operand.dim(), dim);
-	return MeanReduceExp<Dtype>(operand, dim);
+ReduceExp<Dtype> sum(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return ReduceExp<Dtype>(operand, kernel::ReduceOp::Sum, axes, keepdim);
+}
+template<typename Dtype>
+Node<Dtype> sum(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return Node<Dtype>(new ReduceExp<Dtype>(operand.get_exp_ptr(), kernel::ReduceOp::Sum, axes, keepdim));
+}
+
+template<typename Dtype>
+ReduceExp<Dtype> mean(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return ReduceExp<Dtype>(operand, kernel::ReduceOp::Mean, axes, keepdim);
+}
+template<typename Dtype>
+Node<Dtype> mean(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return Node<Dtype>(new ReduceExp<Dtype>(operand.get_exp_ptr(), kernel::ReduceOp::Mean, axes, keepdim));
+}
+
+template<typename Dtype>
+ReduceExp<Dtype> mean(const Exp<Dtype>& operand, index_t dim) {
+	return mean(operand, std::vector<index_t>{dim});
 }
 template<typename Dtype>
 Node<Dtype> mean(const Node<Dtype>& operand, index_t dim) {
-	CHECK_BETWEEN(dim, 0, operand.dim(), IndexOutOfRange,
-		"SumReduce is called on a %dD tensor, but got dim = %d", operand.dim(), dim);
-	return Node<Dtype>(new MeanReduceExp<Dtype>(operand.get_exp_ptr(), dim));
+	return mean(operand, std::vector<index_t>{dim});
+}
+
+template<typename Dtype>
+ReduceExp<Dtype> max(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return ReduceExp<Dtype>(operand, kernel::ReduceOp::Max, axes, keepdim);
+}
+template<typename Dtype>
+Node<Dtype> max(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return Node<Dtype>(new ReduceExp<Dtype>(operand.get_exp_ptr(), kernel::ReduceOp::Max, axes, keepdim));
+}
+
+template<typename Dtype>
+ReduceExp<Dtype> min(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return ReduceExp<Dtype>(operand, kernel::ReduceOp::Min, axes, keepdim);
+}
+template<typename Dtype>
+Node<Dtype> min(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false) {
+	CHECK_REDUCE(operand, axes);
+	return Node<Dtype>(new ReduceExp<Dtype>(operand.get_exp_ptr(), kernel::ReduceOp::Min, axes, keepdim));
+}
+
+// The unbiased variance divides by n - 1 instead of n.
+template<typename Dtype>
+ReduceExp<Dtype> var(const Exp<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false, 
+					 bool unbiased=true) {
+	CHECK_REDUCE(operand, axes);
+	return ReduceExp<Dtype>(operand, kernel::ReduceOp::Var, axes, keepdim, unbiased ? 1 : 0);
+}
+template<typename Dtype>
+Node<Dtype> var(const Node<Dtype>& operand, const std::vector<index_t>& axes, bool keepdim=false, 
+				bool unbiased=true) {
+	CHECK_REDUCE(operand, axes);
+	return Node<Dtype>(new ReduceExp<Dtype>(operand.get_exp_ptr(), kernel::ReduceOp::Var, axes, keepdim, 
+											unbiased ? 1 : 0));
 }
 
 template<typename Dtype>
@@ -239,6 +734,39 @@ Node<Dtype> argmax(const Node<Dtype>& operand, index_t dim) {
 	return Node<Dtype>(new ArgmaxExp<Dtype>(operand.get_exp_ptr(), dim));
 }
 
+#define CHECK_TOPK(operand, k, dim)	do {	\
+	CHECK_BETWEEN(dim, 0, (operand).dim(), IndexOutOfRange,	\
+		"Topk is called on a %dD tensor, but got dim = %d", (operand).dim(), dim);	\
+	CHECK_TRUE((k) >= 1 && (k) <= (operand).size(dim), OperandSizeNotMatch,	\
+		"Topk can't take %d values out of %d on dim %d", (k), (operand).size(dim), dim);	\
+} while(0)
+
+template<typename Dtype>
+TopKExp<Dtype> topk(const Exp<Dtype>& operand, index_t k, index_t dim) {
+	CHECK_TOPK(operand, k, dim);
+	return TopKExp<Dtype>(operand, k, dim);
+}
+template<typename Dtype>
+Node<Dtype> topk(const Node<Dtype>& operand, index_t k, index_t dim) {
+	CHECK_TOPK(operand, k, dim);
+	return Node<Dtype>(new TopKExp<Dtype>(operand.get_exp_ptr(), k, dim));
+}
+
+#define CHECK_TO_LAYOUT(operand, layout)	\
+	CHECK_TRUE((layout) == Layout::NCHW || (operand).dim() == 4, DimNotMatch,	\
+		"Only 4D tensors can be converted to %s layout, but got %dD tensor", layout_name(layout), (operand).dim())
+
+template<typename Dtype>
+ToLayoutExp<Dtype> to_layout(const Exp<Dtype>& operand, Layout layout) {
+	CHECK_TO_LAYOUT(operand, layout);
+	return ToLayoutExp<Dtype>(operand, layout);
+}
+template<typename Dtype>
+Node<Dtype> to_layout(const Node<Dtype>& operand, Layout layout) {
+	CHECK_TO_LAYOUT(operand, layout);
+	return Node<Dtype>(new ToLayoutExp<Dtype>(operand.get_exp_ptr(), layout));
+}
+
 
 }  // namespace op
 }  // namespace el
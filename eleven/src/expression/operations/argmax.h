@@ -2,10 +2,14 @@
 #define EXPRESSION_OPERATIONS_ARGMAX_H_
 
 #include "../expression.h"
+#include "../dense.h"
+#include "../kernels/topk.h"
 
 namespace el {
 namespace op {
 
+// Index of the largest value along dim, the first one on ties. The indices are computed eagerly by
+// kernel::argmax_axis, when the expression is constructed.
 template<typename Dtype>
 struct ArgmaxExp: public UnaryExp<Dtype> {
 public:	
@@ -13,54 +17,60 @@ public:
 	explicit ArgmaxExp(const Exp<Dtype>* operand, index_t dim);
 	index_t dim(void) const;
 	index_t size(index_t idx) const;
+	const Dtype* data(void) const;
 	Dtype eval(index_t* ids) const;
 	void backward(const Exp<Dtype>& grad) const;
 private:
 	index_t dim_;
+	Tensor<Dtype> out_;
+
+	static Shape make_shape(const Exp<Dtype>& operand, index_t dim);
+	void forward(void);
 };
 
+template<typename Dtype>
+Shape ArgmaxExp<Dtype>::make_shape(const Exp<Dtype>& operand, index_t dim) {
+	if(operand.dim() == 1) return Shape{1};
+	std::vector<index_t> dims;
+	for(index_t i = 0; i < operand.dim(); i++)
+		if(i != dim) dims.push_back(operand.size(i));
+	return Shape(dims.data(), dims.size());
+}
+
 template<typename Dtype>
 ArgmaxExp<Dtype>::ArgmaxExp(const Exp<Dtype>& operand, index_t dim)
-	: UnaryExp<Dtype>(operand), dim_(dim) {}
+	: UnaryExp<Dtype>(operand), dim_(dim), out_(make_shape(operand, dim)) {
+	forward();
+}
 
 template<typename Dtype>
 ArgmaxExp<Dtype>::ArgmaxExp(const Exp<Dtype>* operand, index_t dim)
-	: UnaryExp<Dtype>(operand), dim_(dim) {}
+	: UnaryExp<Dtype>(operand), dim_(dim), out_(make_shape(*operand, dim)) {
+	forward();
+}
 
 template<typename Dtype>
-inline index_t ArgmaxExp<Dtype>::dim(void) const {return std::max(this->operand_->dim() - 1, 1);}
+void ArgmaxExp<Dtype>::forward(void) {
+	index_t outer = 1, inner = 1;
+	for(index_t i = 0; i < dim_; i++)
+		outer *= this->operand_->size(i);
+	for(index_t i = dim_ + 1; i < this->operand_->dim(); i++)
+		inner *= this->operand_->size(i);
+	Dense<Dtype> x(*this->operand_);
+	kernel::argmax_axis(outer, this->operand_->size(dim_), inner, x.data(), out_.data());
+}
 
 template<typename Dtype>
-inline index_t ArgmaxExp<Dtype>::size(index_t idx) const {
-	if(this->operand_->dim() == 1) return 1;
-	if(idx < dim_) return this->operand_->size(idx);
-	return this->operand_->size(idx + 1);
-}
+inline index_t ArgmaxExp<Dtype>::dim(void) const {return out_.dim();}
 
 template<typename Dtype>
-Dtype ArgmaxExp<Dtype>::eval(index_t* ids) const {
-	index_t i;
-	index_t src_dim = this->operand_->dim();
-	index_t src_size = this->operand_->size(dim_);
-	index_t* src_ids = new index_t[src_dim]();
-	for(i = 0; i != dim_; i++)
-		src_ids[i] = ids[i];
-	for(i ++; i < src_dim; i++)
-		src_ids[i] = ids[i-1];
+inline index_t ArgmaxExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
 
-	src_ids[dim_] = 0;
-	index_t max_index = 0;
-	Dtype value, max_value = this->operand_->eval(src_ids);
-	for(i = 1; i < src_size; i++) {
-		src_ids[dim_] = i;
-		value = this->operand_->eval(src_ids);	
-		if(value > max_value) {
-			max_value = value;
-			max_index = i;
-		}
-	}
-	return max_index;
-}	
+template<typename Dtype>
+inline const Dtype* ArgmaxExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype ArgmaxExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
 
 template<typename Dtype>
 void ArgmaxExp<Dtype>::backward(const Exp<Dtype>& grad) const {
@@ -70,4 +80,4 @@ void ArgmaxExp<Dtype>::backward(const Exp<Dtype>& grad) const {
 }  // namespace op
 }  // namespace el
 
-#endif
\ No newline at end of file
+#endif
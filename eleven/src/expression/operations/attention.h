@@ -0,0 +1,123 @@
+#ifndef EXPRESSION_OPERATIONS_ATTENTION_H_
+#define EXPRESSION_OPERATIONS_ATTENTION_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/attention.h"
+
+namespace el {
+namespace op {
+
+// Scaled dot product attention, softmax(scale * query key^T) value, for query (batch, q_len, dim),
+// key (batch, k_len, dim) and value (batch, k_len, v_dim), giving (batch, q_len, v_dim). Heads go in
+// the batch. It's computed eagerly by kernel::attention_forward in tiles with an online softmax, so
+// neither direction ever holds the (q_len, k_len) scores, only the logsumexp of each query row.
+template<typename Dtype>
+struct AttentionExp: public BinaryExp<Dtype> {
+	explicit AttentionExp(const Exp<Dtype>& query, const Exp<Dtype>& key, const Exp<Dtype>& value,
+						  bool causal, float_t scale);
+	explicit AttentionExp(const Exp<Dtype>* query, const Exp<Dtype>* key, const Exp<Dtype>* value,
+						  bool causal, float_t scale);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	ConstExptr<Dtype> value_;
+	bool causal_;
+	Dtype scale_;
+	index_t batch_, q_len_, k_len_, dim_, v_dim_;
+	Tensor<Dtype> out_;
+	std::vector<Dtype> lse_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+AttentionExp<Dtype>::AttentionExp(const Exp<Dtype>& query, const Exp<Dtype>& key, const Exp<Dtype>& value,
+								  bool causal, float_t scale)
+	: BinaryExp<Dtype>(query, key), causal_(causal), scale_(scale),
+	  out_(Shape{query.size(0), query.size(1), value.size(2)}) {
+	ConstExptr<Dtype>::make_uncontrol(value);
+	value_.reset(&value, false);
+	forward();
+}
+
+template<typename Dtype>
+AttentionExp<Dtype>::AttentionExp(const Exp<Dtype>* query, const Exp<Dtype>* key, const Exp<Dtype>* value,
+								  bool causal, float_t scale)
+	: BinaryExp<Dtype>(query, key), value_(value, /*with_grad=*/true), causal_(causal), scale_(scale),
+	  out_(Shape{query->size(0), query->size(1), value->size(2)}) {
+	forward();
+}
+
+template<typename Dtype>
+void AttentionExp<Dtype>::forward(void) {
+	batch_ = this->loperand_->size(0);
+	q_len_ = this->loperand_->size(1);
+	dim_ = this->loperand_->size(2);
+	k_len_ = this->roperand_->size(1);
+	v_dim_ = value_->size(2);
+	lse_.resize(batch_ * q_len_);
+	Dense<Dtype> query(*this->loperand_);
+	Dense<Dtype> key(*this->roperand_);
+	Dense<Dtype> value(*value_);
+	kernel::attention_forward(batch_, q_len_, k_len_, dim_, v_dim_, query.data(), key.data(), value.data(),
+							  scale_, causal_, out_.data(), lse_.data());
+}
+
+template<typename Dtype>
+inline index_t AttentionExp<Dtype>::dim(void) const {return 3;}
+
+template<typename Dtype>
+inline index_t AttentionExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool AttentionExp<Dtype>::requires_grad(void) const {
+	return this->loperand_.requires_grad() || this->roperand_.requires_grad() || value_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* AttentionExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype AttentionExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void AttentionExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dout(grad);
+	Dense<Dtype> query(*this->loperand_);
+	Dense<Dtype> key(*this->roperand_);
+	Dense<Dtype> value(*value_);
+	bool query_grad = this->loperand_.requires_grad();
+	bool key_grad = this->roperand_.requires_grad();
+	bool value_grad = value_.requires_grad();
+	Tensor<Dtype> dq(query_grad ? Shape(*this->loperand_) : Shape{1});
+	Tensor<Dtype> dk(key_grad ? Shape(*this->roperand_) : Shape{1});
+	Tensor<Dtype> dv(value_grad ? Shape(*value_) : Shape{1});
+	kernel::attention_backward(batch_, q_len_, k_len_, dim_, v_dim_, query.data(), key.data(), value.data(),
+							   out_.data(), lse_.data(), dout.data(), scale_, causal_,
+							   query_grad ? dq.data() : nullptr, key_grad ? dk.data() : nullptr,
+							   value_grad ? dv.data() : nullptr);
+	if(value_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dv);
+		value_.backward(dv);
+	}
+	if(key_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dk);
+		this->roperand_.backward(dk);
+	}
+	if(query_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dq);
+		this->loperand_.backward(dq);
+	}
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef EXPRESSION_OPERATIONS_BATCH_NORM_H_
+#define EXPRESSION_OPERATIONS_BATCH_NORM_H_
+
+#include <cmath>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/norm.h"
+
+namespace el {
+namespace op {
+
+// Batch normalization of input (batch, channels) or (batch, channels, h, w), with weight and bias of
+// channels elements: y = (x - mean) / sqrt(var + eps) * weight + bias, per channel. Without
+// running statistics, mean and var come from the batch itself (training). Those are computed by a
+// single Welford pass (kernel::batch_norm_statistics) and kept in mean() and var(), the biased
+// variance, for the layer to update its running averages. With running statistics, they are
+// constants (inference). Either way the output is computed eagerly as x * scale + shift.
+//
+// Backward takes both reductions of a channel in one pass, then dx in another, see
+// kernel::batch_norm_backward_data. Images in NHWC or a blocked layout are normalized in that layout,
+// and give an output in it.
+template<typename Dtype>
+struct BatchNormExp: public BinaryExp<Dtype> {
+	explicit BatchNormExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+						  const Tensor<Dtype>* running_mean, const Tensor<Dtype>* running_var, float_t eps);
+	explicit BatchNormExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, const Exp<Dtype>* bias,
+						  const Tensor<Dtype>* running_mean, const Tensor<Dtype>* running_var, float_t eps);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+	const Tensor<Dtype>& mean(void) const {return mean_;}
+	const Tensor<Dtype>& var(void) const {return var_;}
+private:
+	ConstExptr<Dtype> bias_;
+	bool batch_stats_;
+	Dtype eps_;
+	index_t batch_, channels_, plane_;
+	Tensor<Dtype> out_;
+	Tensor<Dtype> mean_, var_, inv_std_;
+
+	void forward(const Tensor<Dtype>* running_mean, const Tensor<Dtype>* running_var);
+};
+
+template<typename Dtype>
+BatchNormExp<Dtype>::BatchNormExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+								  const Tensor<Dtype>* running_mean, const Tensor<Dtype>* running_var, float_t eps)
+	: BinaryExp<Dtype>(input, weight), batch_stats_(running_mean == nullptr), eps_(eps),
+	  out_(Shape(input), input.layout()), mean_(Shape{input.size(1)}), var_(Shape{input.size(1)}),
+	  inv_std_(Shape{input.size(1)}) {
+	ConstExptr<Dtype>::make_uncontrol(bias);
+	bias_.reset(&bias, false);
+	forward(running_mean, running_var);
+}
+
+template<typename Dtype>
+BatchNormExp<Dtype>::BatchNormExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, const Exp<Dtype>* bias,
+								  const Tensor<Dtype>* running_mean, const Tensor<Dtype>* running_var, float_t eps)
+	: BinaryExp<Dtype>(input, weight), bias_(bias, /*with_grad=*/true), batch_stats_(running_mean == nullptr),
+	  eps_(eps), out_(Shape(*input), input->layout()), mean_(Shape{input->size(1)}), var_(Shape{input->size(1)}),
+	  inv_std_(Shape{input->size(1)}) {
+	forward(running_mean, running_var);
+}
+
+template<typename Dtype>
+void BatchNormExp<Dtype>::forward(const Tensor<Dtype>* running_mean, const Tensor<Dtype>* running_var) {
+	const Exp<Dtype>& input = *this->loperand_;
+	batch_ = input.size(0);
+	channels_ = input.size(1);
+	plane_ = 1;
+	for(index_t i = 2; i < input.dim(); i++)
+		plane_ *= input.size(i);
+	Layout layout = out_.layout();
+	Dense<Dtype> x(input, layout);
+	Dense<Dtype> weight(*this->roperand_);
+	Dense<Dtype> bias(*bias_);
+	Dtype* mean = mean_.data();
+	Dtype* var = var_.data();
+	if(batch_stats_ && layout != Layout::NCHW) {
+		kernel::batch_norm_blocked_statistics(layout, batch_, channels_, plane_, x.data(), mean, var);
+	} else if(batch_stats_) {
+		kernel::batch_norm_statistics(batch_, channels_, plane_, x.data(), mean, var);
+	} else {
+		Dense<Dtype> rm(*running_mean), rv(*running_var);
+		std::copy(rm.data(), rm.data() + channels_, mean);
+		std::copy(rv.data(), rv.data() + channels_, var);
+	}
+	std::vector<Dtype> scale(channels_), shift(channels_);
+	for(index_t c = 0; c < channels_; c++) {
+		inv_std_.data()[c] = Dtype(1) / std::sqrt(var[c] + eps_);
+		scale[c] = weight.data()[c] * inv_std_.data()[c];
+		shift[c] = bias.data()[c] - mean[c] * scale[c];
+	}
+	if(layout != Layout::NCHW)
+		kernel::batch_norm_blocked_apply(layout, batch_, channels_, plane_, x.data(), scale.data(), shift.data(),
+										 out_.layout_data());
+	else
+		kernel::batch_norm_apply(batch_, channels_, plane_, x.data(), scale.data(), shift.data(), out_.data());
+}
+
+template<typename Dtype>
+inline index_t BatchNormExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t BatchNormExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool BatchNormExp<Dtype>::requires_grad(void) const {
+	return this->loperand_.requires_grad() || this->roperand_.requires_grad() || bias_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* BatchNormExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout BatchNormExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* BatchNormExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype BatchNormExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+// With n = batch * plane, d_bias = sum of dy and d_weight = sum of dy * xhat per channel.
+template<typename Dtype>
+void BatchNormExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Layout layout = out_.layout();
+	Dense<Dtype> dy(grad, layout);
+	Dense<Dtype> x(*this->loperand_, layout);
+	Dense<Dtype> weight(*this->roperand_);
+	const Dtype* mean = mean_.data();
+	const Dtype* inv_std = inv_std_.data();
+	std::vector<Dtype> sum_dy(channels_), sum_dy_xhat(channels_);
+	if(layout != Layout::NCHW)
+		kernel::batch_norm_blocked_backward_reduce(layout, batch_, channels_, plane_, x.data(), dy.data(), mean,
+												   inv_std, sum_dy.data(), sum_dy_xhat.data());
+	else
+		kernel::batch_norm_backward_reduce(batch_, channels_, plane_, x.data(), dy.data(), mean, inv_std,
+										   sum_dy.data(), sum_dy_xhat.data());
+	if(bias_.requires_grad()) {
+		Tensor<Dtype> bias_grad((Shape(*bias_)));
+		std::copy(sum_dy.begin(), sum_dy.end(), bias_grad.data());
+		ConstExptr<Dtype>::make_uncontrol(bias_grad);
+		bias_.backward(bias_grad);
+	}
+	if(this->roperand_.requires_grad()) {
+		Tensor<Dtype> weight_grad(Shape(*this->roperand_));
+		std::copy(sum_dy_xhat.begin(), sum_dy_xhat.end(), weight_grad.data());
+		ConstExptr<Dtype>::make_uncontrol(weight_grad);
+		this->roperand_.backward(weight_grad);
+	}
+	if(this->loperand_.requires_grad()) {
+		// dx = a * dy + b * x + d, see kernel::batch_norm_backward_data.
+		Dtype n = batch_ * plane_;
+		std::vector<Dtype> a(channels_), b(channels_, Dtype(0)), d(channels_, Dtype(0));
+		for(index_t c = 0; c < channels_; c++) {
+			a[c] = weight.data()[c] * inv_std[c];
+			if(batch_stats_) {
+				Dtype k = inv_std[c] * sum_dy_xhat[c] / n;
+				b[c] = -a[c] * k;
+				d[c] = a[c] * (k * mean[c] - sum_dy[c] / n);
+			}
+		}
+		Tensor<Dtype> input_grad(Shape(*this->loperand_), layout);
+		if(layout != Layout::NCHW)
+			kernel::batch_norm_blocked_backward_data(layout, batch_, channels_, plane_, dy.data(), x.data(),
+													 a.data(), b.data(), d.data(), input_grad.layout_data());
+		else
+			kernel::batch_norm_backward_data(batch_, channels_, plane_, dy.data(), x.data(),
+											 a.data(), b.data(), d.data(), input_grad.data());
+		ConstExptr<Dtype>::make_uncontrol(input_grad);
+		this->loperand_.backward(input_grad);
+	}
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef EXPRESSION_OPERATIONS_CONV2D_H_
+#define EXPRESSION_OPERATIONS_CONV2D_H_
+
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/conv.h"
+
+namespace el {
+namespace op {
+
+// 2D convolution of imgs (b, c, h, w) with weight (1, oc, c/groups*kh*kw). The output (b, oc, oh, ow) is computed
+// eagerly when the expression is constructed, by the algorithm picked for this shape, and the same
+// algorithm is used for backward. Unlike Img2ColExp + BMMExp, eval() only reads the buffer.
+//
+// Optionally, a bias with oc elements and an activation are applied in the epilogue of the kernel, while
+// each output plane is still in cache. Backward gets the activation's derivative from the output, so
+// the pre-activation value is never stored.
+//
+// Images in NHWC or a blocked layout give an output in the same layout. Those are convolved by one
+// GEMM per group over patches gathered as channel runs (kernel::conv2d_channels_last_forward), whatever
+// algo is, except depthwise layers with oc == c, which have a direct kernel over channel blocks.
+template<typename Dtype>
+struct Conv2DExp: public BinaryExp<Dtype> {
+	explicit Conv2DExp(const Exp<Dtype>& imgs,
+					   const Exp<Dtype>& weight,
+					   const std::pair<index_t, index_t>& kernel_size,
+					   const std::pair<index_t, index_t>& stride,
+					   const std::pair<index_t, index_t>& padding,
+					   kernel::ConvAlgo algo,
+					   index_t groups);
+	explicit Conv2DExp(const Exp<Dtype>& imgs,
+					   const Exp<Dtype>& weight,
+					   const Exp<Dtype>& bias,
+					   const std::pair<index_t, index_t>& kernel_size,
+					   const std::pair<index_t, index_t>& stride,
+					   const std::pair<index_t, index_t>& padding,
+					   kernel::Activation act,
+					   kernel::ConvAlgo algo,
+					   index_t groups);
+	explicit Conv2DExp(const Exp<Dtype>* imgs,
+					   const Exp<Dtype>* weight,
+					   const std::pair<index_t, index_t>& kernel_size,
+					   const std::pair<index_t, index_t>& stride,
+					   const std::pair<index_t, index_t>& padding,
+					   kernel::ConvAlgo algo,
+					   index_t groups);
+	explicit Conv2DExp(const Exp<Dtype>* imgs,
+					   const Exp<Dtype>* weight,
+					   const Exp<Dtype>* bias,
+					   const std::pair<index_t, index_t>& kernel_size,
+					   const std::pair<index_t, index_t>& stride,
+					   const std::pair<index_t, index_t>& padding,
+					   kernel::Activation act,
+					   kernel::ConvAlgo algo,
+					   index_t groups);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+	kernel::ConvAlgo algo(void) const {return algo_;}
+private:
+	ConstExptr<Dtype> bias_;
+	kernel::ConvParam param_;
+	kernel::ConvAlgo algo_;
+	kernel::Activation act_;
+	Tensor<Dtype> out_;
+
+	static kernel::ConvParam make_param(const Exp<Dtype>& imgs,
+										const Exp<Dtype>& weight,
+										const std::pair<index_t, index_t>& kernel_size,
+										const std::pair<index_t, index_t>& stride,
+										const std::pair<index_t, index_t>& padding,
+										index_t groups);
+	void forward(kernel::ConvAlgo algo);
+	void backward_channels_last(const Dtype* dy) const;
+};
+
+template<typename Dtype>
+kernel::ConvParam Conv2DExp<Dtype>::make_param(const Exp<Dtype>& imgs,
+											   const Exp<Dtype>& weight,
+											   const std::pair<index_t, index_t>& kernel_size,
+											   const std::pair<index_t, index_t>& stride,
+											   const std::pair<index_t, index_t>& padding,
+											   index_t groups) {
+	return kernel::ConvParam(imgs.size(0), imgs.size(1), imgs.size(2), imgs.size(3), weight.size(1),
+							 kernel_size, stride, padding, groups);
+}
+
+template<typename Dtype>
+Conv2DExp<Dtype>::Conv2DExp(const Exp<Dtype>& imgs,
+							const Exp<Dtype>& weight,
+							const std::pair<index_t, index_t>& kernel_size,
+							const std::pair<index_t, index_t>& stride,
+							const std::pair<index_t, index_t>& padding,
+							kernel::ConvAlgo algo,
+							index_t groups)
+	: BinaryExp<Dtype>(imgs, weight),
+	  param_(make_param(imgs, weight, kernel_size, stride, padding, groups)),
+	  act_(kernel::Activation::None),
+	  out_(Shape{param_.batch, param_.out_c, param_.out_h, param_.out_w}, imgs.layout()) {
+	forward(algo);
+}
+
+template<typename Dtype>
+Conv2DExp<Dtype>::Conv2DExp(const Exp<Dtype>& imgs,
+							const Exp<Dtype>& weight,
+							const Exp<Dtype>& bias,
+							const std::pair<index_t, index_t>& kernel_size,
+							const std::pair<index_t, index_t>& stride,
+							const std::pair<index_t, index_t>& padding,
+							kernel::Activation act,
+							kernel::ConvAlgo algo,
+							index_t groups)
+	: BinaryExp<Dtype>(imgs, weight),
+	  param_(make_param(imgs, weight, kernel_size, stride, padding, groups)),
+	  act_(act),
+	  out_(Shape{param_.batch, param_.out_c, param_.out_h, param_.out_w}, imgs.layout()) {
+	ConstExptr<Dtype>::make_uncontrol(bias);
+	bias_.reset(&bias, false);
+	forward(algo);
+}
+
+template<typename Dtype>
+Conv2DExp<Dtype>::Conv2DExp(const Exp<Dtype>* imgs,
+							const Exp<Dtype>* weight,
+							const std::pair<index_t, index_t>& kernel_size,
+							const std::pair<index_t, index_t>& stride,
+							const std::pair<index_t, index_t>& padding,
+							kernel::ConvAlgo algo,
+							index_t groups)
+	: BinaryExp<Dtype>(imgs, weight),
+	  param_(make_param(*imgs, *weight, kernel_size, stride, padding, groups)),
+	  act_(kernel::Activation::None),
+	  out_(Shape{param_.batch, param_.out_c, param_.out_h, param_.out_w}, imgs->layout()) {
+	forward(algo);
+}
+
+template<typename Dtype>
+Conv2DExp<Dtype>::Conv2DExp(const Exp<Dtype>* imgs,
+							const Exp<Dtype>* weight,
+							const Exp<Dtype>* bias,
+							const std::pair<index_t, index_t>& kernel_size,
+							const std::pair<index_t, index_t>& stride,
+							const std::pair<index_t, index_t>& padding,
+							kernel::Activation act,
+							kernel::ConvAlgo algo,
+							index_t groups)
+	: BinaryExp<Dtype>(imgs, weight),
+	  bias_(bias, /*with_grad=*/true),
+	  param_(make_param(*imgs, *weight, kernel_size, stride, padding, groups)),
+	  act_(act),
+	  out_(Shape{param_.batch, param_.out_c, param_.out_h, param_.out_w}, imgs->layout()) {
+	forward(algo);
+}
+
+template<typename Dtype>
+void Conv2DExp<Dtype>::forward(kernel::ConvAlgo algo) {
+	Layout layout = out_.layout();
+	if(layout != Layout::NCHW) {
+		algo_ = kernel::conv_channels_last_depthwise(param_) ? kernel::ConvAlgo::Depthwise : kernel::ConvAlgo::Im2Col;
+		Dense<Dtype> imgs(*this->loperand_, layout);
+		Dense<Dtype> weight(*this->roperand_);
+		std::shared_ptr<Dense<Dtype>> bias;
+		if(bias_) bias.reset(new Dense<Dtype>(*bias_));
+		kernel::conv2d_channels_last_forward(param_, layout, imgs.data(), weight.data(), out_.layout_data(),
+											 bias ? bias->data() : nullptr, act_);
+		return;
+	}
+	if(algo == kernel::ConvAlgo::Auto || algo == kernel::ConvAlgo::Measure)
+		algo = kernel::select_conv_algo(param_);
+	CHECK_TRUE(kernel::conv_algo_supported(algo, param_), NotImplementError,
+		"Convolution algorithm %s doesn't support kernel size(%d, %d), stride(%d, %d) and padding(%d, %d)",
+		kernel::conv_algo_name(algo), param_.kh, param_.kw, param_.sh, param_.sw, param_.ph, param_.pw);
+	algo_ = algo;
+
+	Dense<Dtype> imgs(*this->loperand_);
+	Dense<Dtype> weight(*this->roperand_);
+	if(!bias_ && act_ == kernel::Activation::None) {
+		kernel::conv2d_forward(algo_, param_, imgs.data(), weight.data(), out_.data());
+	} else {
+		std::shared_ptr<Dense<Dtype>> bias;
+		if(bias_) bias.reset(new Dense<Dtype>(*bias_));
+		kernel::BiasActEpilogue<Dtype> epilogue(bias ? bias->data() : nullptr, nullptr, act_);
+		kernel::conv2d_forward(algo_, param_, imgs.data(), weight.data(), out_.data(), epilogue);
+	}
+}
+
+template<typename Dtype>
+inline index_t Conv2DExp<Dtype>::dim(void) const {return 4;}
+
+template<typename Dtype>
+inline index_t Conv2DExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool Conv2DExp<Dtype>::requires_grad(void) const {
+	return this->loperand_.requires_grad() || this->roperand_.requires_grad() || bias_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* Conv2DExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout Conv2DExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* Conv2DExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype Conv2DExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void Conv2DExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Layout layout = out_.layout();
+	Dense<Dtype> dout(grad, layout);
+	const Dtype* dy = dout.data();
+	std::shared_ptr<Dtype> act_grad;
+	if(act_ != kernel::Activation::None) {
+		index_t dsize = out_.layout_dsize();
+		act_grad.reset(new Dtype[dsize], std::default_delete<Dtype[]>());
+		Dtype* dz = act_grad.get();
+		parallel_for(0, dsize, 4096, [&](index_t begin, index_t end) {
+			kernel::activation_backward(act_, out_.layout_data() + begin, dy + begin, dz + begin, end - begin);
+		});
+		dy = dz;
+	}
+	if(layout != Layout::NCHW) {
+		backward_channels_last(dy);
+		return;
+	}
+	if(bias_.requires_grad()) {
+		Tensor<Dtype> bias_grad((Shape(*bias_)));
+		Dtype* db = bias_grad.data();
+		parallel_for(0, param_.out_c, 1, [&](index_t begin, index_t end) {
+			for(index_t o = begin; o < end; o++) {
+				Dtype value = 0;
+				for(index_t b = 0; b < param_.batch; b++) {
+					const Dtype* dy_plane = dy + (b * param_.out_c + o) * param_.out_plane();
+					for(index_t i = 0; i < param_.out_plane(); i++)
+						value += dy_plane[i];
+				}
+				db[o] = value;
+			}
+		});
+		ConstExptr<Dtype>::make_uncontrol(bias_grad);
+		bias_.backward(bias_grad);
+	}
+	if(this->loperand_.requires_grad()) {
+		Dense<Dtype> weight(*this->roperand_);
+		Tensor<Dtype> imgs_grad(Shape(*this->loperand_));
+		kernel::conv2d_backward_data(algo_, param_, dy, weight.data(), imgs_grad.data());
+		ConstExptr<Dtype>::make_uncontrol(imgs_grad);
+		this->loperand_.backward(imgs_grad);
+	}
+	if(this->roperand_.requires_grad()) {
+		Dense<Dtype> imgs(*this->loperand_);
+		Tensor<Dtype> weight_grad(Shape(*this->roperand_));
+		kernel::conv2d_backward_weight(algo_, param_, dy, imgs.data(), weight_grad.data());
+		ConstExptr<Dtype>::make_uncontrol(weight_grad);
+		this->roperand_.backward(weight_grad);
+	}
+}
+
+// Gradients of all operands come from one pass over the batch, which shares the patch rows.
+template<typename Dtype>
+void Conv2DExp<Dtype>::backward_channels_last(const Dtype* dy) const {
+	Layout layout = out_.layout();
+	Dense<Dtype> imgs(*this->loperand_, layout);
+	Dense<Dtype> weight(*this->roperand_);
+	std::shared_ptr<Tensor<Dtype>> imgs_grad, weight_grad, bias_grad;
+	if(this->loperand_.requires_grad()) imgs_grad.reset(new Tensor<Dtype>(Shape(*this->loperand_), layout));
+	if(this->roperand_.requires_grad()) weight_grad.reset(new Tensor<Dtype>(Shape(*this->roperand_)));
+	if(bias_.requires_grad()) bias_grad.reset(new Tensor<Dtype>(Shape(*bias_)));
+	kernel::conv2d_channels_last_backward(param_, layout, dy, imgs.data(), weight.data(),
+										  imgs_grad ? imgs_grad->layout_data() : nullptr,
+										  weight_grad ? weight_grad->data() : nullptr,
+										  bias_grad ? bias_grad->data() : nullptr);
+	if(bias_grad) {
+		ConstExptr<Dtype>::make_uncontrol(*bias_grad);
+		bias_.backward(*bias_grad);
+	}
+	if(imgs_grad) {
+		ConstExptr<Dtype>::make_uncontrol(*imgs_grad);
+		this->loperand_.backward(*imgs_grad);
+	}
+	if(weight_grad) {
+		ConstExptr<Dtype>::make_uncontrol(*weight_grad);
+		this->roperand_.backward(*weight_grad);
+	}
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef EXPRESSION_OPERATIONS_CROSS_ENTROPY_H_
+#define EXPRESSION_OPERATIONS_CROSS_ENTROPY_H_
+
+#include <memory>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/softmax.h"
+#include "../kernels/reduce.h"
+
+namespace el {
+namespace op {
+
+// mean(nll_loss(log_softmax(src), index)) in one op. src is (batch, num_cls) and index is (batch).
+// The loss is computed eagerly, one pass per row, and only log_sum_exp of each row is kept. Backward
+// writes (softmax - onehot) / batch straight into the gradient, instead of chaining the gradient
+// expressions of three ops, which costs O(num_cls^2) per row.
+template<typename Dtype>
+struct CrossEntropyExp: public Exp<Dtype> {
+	CrossEntropyExp(const Exp<Dtype>& src, const Exp<int_t>& index);
+	CrossEntropyExp(const Exp<Dtype>* src, const Exp<int_t>* index);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	ConstExptr<Dtype> src_;
+	ConstExptr<int_t> index_;
+	std::shared_ptr<Dtype> log_exp_sum_;
+	Dtype loss_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+CrossEntropyExp<Dtype>::CrossEntropyExp(const Exp<Dtype>& src, const Exp<int_t>& index) {
+	ConstExptr<Dtype>::make_uncontrol(src);
+	ConstExptr<int_t>::make_uncontrol(index);
+	src_.reset(&src, false);
+	index_.reset(&index, false);
+	forward();
+}
+
+template<typename Dtype>
+CrossEntropyExp<Dtype>::CrossEntropyExp(const Exp<Dtype>* src, const Exp<int_t>* index)
+	: src_(src, true), index_(index, false) {
+	forward();
+}
+
+template<typename Dtype>
+void CrossEntropyExp<Dtype>::forward(void) {
+	index_t num_batch = src_->size(0);
+	index_t num_cls = src_->size(1);
+	Dense<Dtype> src(*src_);
+	Dense<int_t> index(*index_);
+	for(index_t i = 0; i < num_batch; i++)
+		CHECK_BETWEEN(index[i], 0, num_cls, IndexOutOfRange,
+			"Label %d of sample %d is out of range [0, %d)", index[i], i, num_cls);
+
+	log_exp_sum_.reset(new Dtype[num_batch], std::default_delete<Dtype[]>());
+	std::unique_ptr<Dtype[]> losses(new Dtype[num_batch]);
+	kernel::softmax_cross_entropy_forward(num_batch, num_cls, src.data(), index.data(),
+										  log_exp_sum_.get(), losses.get());
+	Dtype total;
+	kernel::reduce_axis<kernel::SumOp>(1, num_batch, 1, losses.get(), &total);
+	loss_ = total / num_batch;
+}
+
+template<typename Dtype>
+inline index_t CrossEntropyExp<Dtype>::dim(void) const {return 1;}
+
+template<typename Dtype>
+inline index_t CrossEntropyExp<Dtype>::size(index_t idx) const {return 1;}
+
+template<typename Dtype>
+inline bool CrossEntropyExp<Dtype>::requires_grad(void) const {return src_.requires_grad();}
+
+template<typename Dtype>
+inline const Dtype* CrossEntropyExp<Dtype>::data(void) const {return &loss_;}
+
+template<typename Dtype>
+inline Dtype CrossEntropyExp<Dtype>::eval(index_t* ids) const {return loss_;}
+
+template<typename Dtype>
+void CrossEntropyExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	index_t num_batch = src_->size(0);
+	index_t num_cls = src_->size(1);
+	index_t grad_ids[1] = {0};
+	Dtype scale = grad.eval(grad_ids) / num_batch;
+	Dense<Dtype> src(*src_);
+	Dense<int_t> index(*index_);
+
+	Tensor<Dtype> src_grad(Shape{num_batch, num_cls});
+	kernel::softmax_cross_entropy_backward(num_batch, num_cls, scale, src.data(), index.data(),
+										   log_exp_sum_.get(), src_grad.data());
+	ConstExptr<Dtype>::make_uncontrol(src_grad);
+	src_.backward(src_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef EXPRESSION_OPERATIONS_EMBEDDING_H_
+#define EXPRESSION_OPERATIONS_EMBEDDING_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/embedding.h"
+
+namespace el {
+namespace op {
+
+// Rows of weight (num, dim) picked by index, of any shape, giving index's shape + (dim). It's a
+// gather computed eagerly by kernel::gather_rows. With sparse_grad, backward adds the gradient
+// of the picked rows to it and nothing goes to weight, which then needn't require grad at all.
+// Otherwise weight gets the dense (num, dim) gradient, zero out of the picked rows.
+template<typename Dtype>
+struct EmbeddingExp: public Exp<Dtype> {
+	explicit EmbeddingExp(const Exp<Dtype>& weight, const Exp<int_t>& index, kernel::SparseRows<Dtype>* sparse_grad);
+	explicit EmbeddingExp(const Exp<Dtype>* weight, const Exp<int_t>* index, kernel::SparseRows<Dtype>* sparse_grad);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	ConstExptr<Dtype> weight_;
+	ConstExptr<int_t> index_;
+	kernel::SparseRows<Dtype>* sparse_grad_;
+	Tensor<Dtype> out_;
+	std::vector<int_t> ids_;
+
+	static Shape make_shape(const Exp<Dtype>& weight, const Exp<int_t>& index);
+	void forward(void);
+};
+
+template<typename Dtype>
+Shape EmbeddingExp<Dtype>::make_shape(const Exp<Dtype>& weight, const Exp<int_t>& index) {
+	std::vector<index_t> dims;
+	for(index_t i = 0; i < index.dim(); i++)
+		dims.push_back(index.size(i));
+	dims.push_back(weight.size(1));
+	return Shape(dims.data(), dims.size());
+}
+
+template<typename Dtype>
+EmbeddingExp<Dtype>::EmbeddingExp(const Exp<Dtype>& weight, const Exp<int_t>& index,
+								  kernel::SparseRows<Dtype>* sparse_grad)
+	: sparse_grad_(sparse_grad), out_(make_shape(weight, index)) {
+	ConstExptr<Dtype>::make_uncontrol(weight);
+	ConstExptr<int_t>::make_uncontrol(index);
+	weight_.reset(&weight, false);
+	index_.reset(&index, false);
+	forward();
+}
+
+template<typename Dtype>
+EmbeddingExp<Dtype>::EmbeddingExp(const Exp<Dtype>* weight, const Exp<int_t>* index,
+								  kernel::SparseRows<Dtype>* sparse_grad)
+	: weight_(weight, /*with_grad=*/true), index_(index, false), sparse_grad_(sparse_grad),
+	  out_(make_shape(*weight, *index)) {
+	forward();
+}
+
+// The ids are checked and kept, backward needs them after index may have changed.
+template<typename Dtype>
+void EmbeddingExp<Dtype>::forward(void) {
+	index_t num = weight_->size(0);
+	Dense<int_t> index(*index_);
+	index_t n = out_.size().dsize() / weight_->size(1);
+	ids_.assign(index.data(), index.data() + n);
+	for(index_t i = 0; i < n; i++)
+		CHECK_BETWEEN(ids_[i], 0, num, IndexOutOfRange,
+			"Embedding has %d rows, but got index %d", num, ids_[i]);
+	Dense<Dtype> weight(*weight_);
+	kernel::gather_rows(n, weight_->size(1), ids_.data(), weight.data(), out_.data());
+}
+
+template<typename Dtype>
+inline index_t EmbeddingExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t EmbeddingExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool EmbeddingExp<Dtype>::requires_grad(void) const {
+	return sparse_grad_ != nullptr || weight_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* EmbeddingExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype EmbeddingExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void EmbeddingExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad);
+	index_t cols = weight_->size(1);
+	if(sparse_grad_ != nullptr) {
+		sparse_grad_->cols = cols;
+		kernel::sparse_rows_add(index_t(ids_.size()), cols, ids_.data(), dy.data(), *sparse_grad_);
+		return;
+	}
+	if(!weight_.requires_grad()) return;
+	Tensor<Dtype> weight_grad((Shape(*weight_)));
+	std::fill(weight_grad.data(), weight_grad.data() + weight_->size(0) * cols, Dtype(0));
+	kernel::scatter_add_rows(index_t(ids_.size()), cols, ids_.data(), dy.data(), weight_grad.data());
+	ConstExptr<Dtype>::make_uncontrol(weight_grad);
+	weight_.backward(weight_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
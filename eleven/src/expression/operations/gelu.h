@@ -0,0 +1,93 @@
+#ifndef EXPRESSION_OPERATIONS_GELU_H_
+#define EXPRESSION_OPERATIONS_GELU_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/math.h"
+
+namespace el {
+namespace op {
+
+// GELU(x) = x * Phi(x), with the exact normal cdf from erfc, not the tanh approximation. The output
+// alone doesn't give the derivative Phi(x) + x * phi(x), so forward keeps Phi(x) next to it, and
+// backward only adds the density.
+template<typename Dtype>
+struct GELUExp: public UnaryExp<Dtype> {
+	explicit GELUExp(const Exp<Dtype>& operand);
+	explicit GELUExp(const Exp<Dtype>* operand);
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	Tensor<Dtype> out_;
+	std::vector<Dtype> cdf_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+GELUExp<Dtype>::GELUExp(const Exp<Dtype>& operand)
+	: UnaryExp<Dtype>(operand), out_(Shape(operand), operand.layout()) {
+	forward();
+}
+
+template<typename Dtype>
+GELUExp<Dtype>::GELUExp(const Exp<Dtype>* operand)
+	: UnaryExp<Dtype>(operand), out_(Shape(*operand), operand->layout()) {
+	forward();
+}
+
+template<typename Dtype>
+void GELUExp<Dtype>::forward(void) {
+	Dense<Dtype> dense(*this->operand_, out_.layout());
+	const Dtype* x = dense.data();
+	Dtype* y = out_.layout_data();
+	cdf_.resize(out_.layout_dsize());
+	Dtype* cdf = cdf_.data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		kernel::vnormal_cdf(x + begin, cdf + begin, end - begin);
+		for(index_t i = begin; i < end; i++)
+			y[i] = x[i] * cdf[i];
+	});
+}
+
+template<typename Dtype>
+inline const Dtype* GELUExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout GELUExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* GELUExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype GELUExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void GELUExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	const Dtype inv_sqrt_2pi = 0.39894228040143267794;
+	Dense<Dtype> dense(*this->operand_, out_.layout());
+	Dense<Dtype> dense_grad(grad, out_.layout());
+	const Dtype* x = dense.data();
+	const Dtype* dy = dense_grad.data();
+	const Dtype* cdf = cdf_.data();
+	Tensor<Dtype> operand_grad(Shape(*this->operand_), out_.layout());
+	Dtype* dx = operand_grad.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++)
+			dx[i] = Dtype(-0.5) * x[i] * x[i];
+		kernel::vexp(dx + begin, dx + begin, end - begin);
+		for(index_t i = begin; i < end; i++)
+			dx[i] = dy[i] * (cdf[i] + x[i] * inv_sqrt_2pi * dx[i]);
+	});
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef EXPRESSION_OPERATIONS_INDEX_SELECT_H_
+#define EXPRESSION_OPERATIONS_INDEX_SELECT_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/embedding.h"
+
+namespace el {
+namespace op {
+
+// Slices of input (num, ...) along dim 0 picked by a 1D index (n), giving (n, ...). The slices are
+// contiguous rows of input, gathered eagerly by kernel::gather_rows, one memcpy each. Backward adds the
+// gradient rows back to the picked rows of a dense input gradient, repeated picks summed.
+template<typename Dtype>
+struct IndexSelectExp: public Exp<Dtype> {
+	explicit IndexSelectExp(const Exp<Dtype>& input, const Exp<int_t>& index);
+	explicit IndexSelectExp(const Exp<Dtype>* input, const Exp<int_t>* index);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	ConstExptr<Dtype> input_;
+	ConstExptr<int_t> index_;
+	Tensor<Dtype> out_;
+	std::vector<int_t> ids_;
+
+	static Shape make_shape(const Exp<Dtype>& input, const Exp<int_t>& index);
+	void forward(void);
+};
+
+template<typename Dtype>
+Shape IndexSelectExp<Dtype>::make_shape(const Exp<Dtype>& input, const Exp<int_t>& index) {
+	Shape shape(input);
+	shape[0] = index.size(0);
+	return shape;
+}
+
+template<typename Dtype>
+IndexSelectExp<Dtype>::IndexSelectExp(const Exp<Dtype>& input, const Exp<int_t>& index)
+	: out_(make_shape(input, index)) {
+	ConstExptr<Dtype>::make_uncontrol(input);
+	ConstExptr<int_t>::make_uncontrol(index);
+	input_.reset(&input, false);
+	index_.reset(&index, false);
+	forward();
+}
+
+template<typename Dtype>
+IndexSelectExp<Dtype>::IndexSelectExp(const Exp<Dtype>* input, const Exp<int_t>* index)
+	: input_(input, /*with_grad=*/true), index_(index, false), out_(make_shape(*input, *index)) {
+	forward();
+}
+
+// Like embedding, the ids are checked and kept for backward.
+template<typename Dtype>
+void IndexSelectExp<Dtype>::forward(void) {
+	index_t num = input_->size(0);
+	Dense<int_t> index(*index_);
+	index_t n = index_->size(0);
+	ids_.assign(index.data(), index.data() + n);
+	for(index_t i = 0; i < n; i++)
+		CHECK_BETWEEN(ids_[i], 0, num, IndexOutOfRange,
+			"index_select from %d slices, but got index %d", num, ids_[i]);
+	Dense<Dtype> input(*input_);
+	kernel::gather_rows(n, Shape(*input_).subsize(1), ids_.data(), input.data(), out_.data());
+}
+
+template<typename Dtype>
+inline index_t IndexSelectExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t IndexSelectExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool IndexSelectExp<Dtype>::requires_grad(void) const {return input_.requires_grad();}
+
+template<typename Dtype>
+inline const Dtype* IndexSelectExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype IndexSelectExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void IndexSelectExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	if(!input_.requires_grad()) return;
+	Dense<Dtype> dy(grad);
+	Tensor<Dtype> input_grad((Shape(*input_)));
+	index_t cols = input_grad.size().subsize(1);
+	std::fill(input_grad.data(), input_grad.data() + input_->size(0) * cols, Dtype(0));
+	kernel::scatter_add_rows(index_t(ids_.size()), cols, ids_.data(), dy.data(), input_grad.data());
+	ConstExptr<Dtype>::make_uncontrol(input_grad);
+	input_.backward(input_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef EXPRESSION_OPERATIONS_LAYER_NORM_H_
+#define EXPRESSION_OPERATIONS_LAYER_NORM_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/norm.h"
+
+namespace el {
+namespace op {
+
+// Layer normalization over the last dims of input, the ones of weight's shape:
+// y = (x - mean) / sqrt(var + eps) * weight + bias, with mean and var of each row of those dims.
+// Computed eagerly by kernel::layer_norm_rows, which reads every row once, and backward is one
+// pass of kernel::layer_norm_backward for all three gradients.
+template<typename Dtype>
+struct LayerNormExp: public BinaryExp<Dtype> {
+	explicit LayerNormExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias, float_t eps);
+	explicit LayerNormExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, const Exp<Dtype>* bias, float_t eps);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	ConstExptr<Dtype> bias_;
+	Dtype eps_;
+	index_t rows_, cols_;
+	Tensor<Dtype> out_;
+	std::vector<Dtype> mean_, rstd_;
+
+	void forward(void);
+};
+
+// Root mean square normalization over the last dims of input, the ones of weight's shape:
+// y = x / sqrt(mean of x^2 + eps) * weight. No centering and no bias, otherwise like LayerNormExp.
+template<typename Dtype>
+struct RMSNormExp: public BinaryExp<Dtype> {
+	explicit RMSNormExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, float_t eps);
+	explicit RMSNormExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, float_t eps);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	Dtype eps_;
+	index_t rows_, cols_;
+	Tensor<Dtype> out_;
+	std::vector<Dtype> rstd_;
+
+	void forward(void);
+};
+
+// Rows and cols of input, normalized over the dims of weight.
+template<typename Dtype>
+inline void norm_rows_cols(const Exp<Dtype>& input, const Exp<Dtype>& weight, index_t& rows, index_t& cols) {
+	rows = 1;
+	cols = 1;
+	for(index_t i = 0; i < input.dim(); i++)
+		(i < input.dim() - weight.dim() ? rows : cols) *= input.size(i);
+}
+
+// ******************** layer norm ********************
+template<typename Dtype>
+LayerNormExp<Dtype>::LayerNormExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+								  float_t eps)
+	: BinaryExp<Dtype>(input, weight), eps_(eps), out_(Shape(input)) {
+	ConstExptr<Dtype>::make_uncontrol(bias);
+	bias_.reset(&bias, false);
+	forward();
+}
+
+template<typename Dtype>
+LayerNormExp<Dtype>::LayerNormExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, const Exp<Dtype>* bias,
+								  float_t eps)
+	: BinaryExp<Dtype>(input, weight), bias_(bias, /*with_grad=*/true), eps_(eps), out_(Shape(*input)) {
+	forward();
+}
+
+template<typename Dtype>
+void LayerNormExp<Dtype>::forward(void) {
+	norm_rows_cols(*this->loperand_, *this->roperand_, rows_, cols_);
+	mean_.resize(rows_);
+	rstd_.resize(rows_);
+	Dense<Dtype> x(*this->loperand_);
+	Dense<Dtype> weight(*this->roperand_);
+	Dense<Dtype> bias(*bias_);
+	kernel::layer_norm_rows(rows_, cols_, x.data(), weight.data(), bias.data(), eps_,
+							out_.data(), mean_.data(), rstd_.data());
+}
+
+template<typename Dtype>
+inline index_t LayerNormExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t LayerNormExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool LayerNormExp<Dtype>::requires_grad(void) const {
+	return this->loperand_.requires_grad() || this->roperand_.requires_grad() || bias_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* LayerNormExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype LayerNormExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void LayerNormExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad);
+	Dense<Dtype> x(*this->loperand_);
+	Dense<Dtype> weight(*this->roperand_);
+	bool input_grad = this->loperand_.requires_grad();
+	bool weight_grad = this->roperand_.requires_grad();
+	bool bias_grad = bias_.requires_grad();
+	Tensor<Dtype> dx(input_grad ? Shape(*this->loperand_) : Shape{1});
+	Tensor<Dtype> dweight(weight_grad ? Shape(*this->roperand_) : Shape{1});
+	Tensor<Dtype> dbias(bias_grad ? Shape(*bias_) : Shape{1});
+	kernel::layer_norm_backward(rows_, cols_, x.data(), dy.data(), weight.data(), mean_.data(), rstd_.data(),
+								input_grad ? dx.data() : nullptr, weight_grad ? dweight.data() : nullptr,
+								bias_grad ? dbias.data() : nullptr);
+	if(bias_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dbias);
+		bias_.backward(dbias);
+	}
+	if(weight_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dweight);
+		this->roperand_.backward(dweight);
+	}
+	if(input_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dx);
+		this->loperand_.backward(dx);
+	}
+}
+
+// ******************** rms norm ********************
+template<typename Dtype>
+RMSNormExp<Dtype>::RMSNormExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, float_t eps)
+	: BinaryExp<Dtype>(input, weight), eps_(eps), out_(Shape(input)) {
+	forward();
+}
+
+template<typename Dtype>
+RMSNormExp<Dtype>::RMSNormExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, float_t eps)
+	: BinaryExp<Dtype>(input, weight), eps_(eps), out_(Shape(*input)) {
+	forward();
+}
+
+template<typename Dtype>
+void RMSNormExp<Dtype>::forward(void) {
+	norm_rows_cols(*this->loperand_, *this->roperand_, rows_, cols_);
+	rstd_.resize(rows_);
+	Dense<Dtype> x(*this->loperand_);
+	Dense<Dtype> weight(*this->roperand_);
+	kernel::rms_norm_rows(rows_, cols_, x.data(), weight.data(), eps_, out_.data(), rstd_.data());
+}
+
+template<typename Dtype>
+inline index_t RMSNormExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t RMSNormExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline const Dtype* RMSNormExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype RMSNormExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void RMSNormExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad);
+	Dense<Dtype> x(*this->loperand_);
+	Dense<Dtype> weight(*this->roperand_);
+	bool input_grad = this->loperand_.requires_grad();
+	bool weight_grad = this->roperand_.requires_grad();
+	Tensor<Dtype> dx(input_grad ? Shape(*this->loperand_) : Shape{1});
+	Tensor<Dtype> dweight(weight_grad ? Shape(*this->roperand_) : Shape{1});
+	kernel::layer_norm_backward(rows_, cols_, x.data(), dy.data(), weight.data(), (const Dtype*)nullptr,
+								rstd_.data(), input_grad ? dx.data() : nullptr,
+								weight_grad ? dweight.data() : nullptr, (Dtype*)nullptr);
+	if(weight_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dweight);
+		this->roperand_.backward(dweight);
+	}
+	if(input_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dx);
+		this->loperand_.backward(dx);
+	}
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef EXPRESSION_OPERATIONS_LAYOUT_H_
+#define EXPRESSION_OPERATIONS_LAYOUT_H_
+
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/layout.h"
+
+namespace el {
+namespace op {
+
+// Copy a 4D operand into another memory layout. Values, shape and indices don't change, so it's an
+// identity for everything but kernels reading raw memory. Backward converts the gradient back to the
+// operand's layout.
+template<typename Dtype>
+struct ToLayoutExp: public UnaryExp<Dtype> {
+	explicit ToLayoutExp(const Exp<Dtype>& operand, Layout layout);
+	explicit ToLayoutExp(const Exp<Dtype>* operand, Layout layout);
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	Tensor<Dtype> out_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+ToLayoutExp<Dtype>::ToLayoutExp(const Exp<Dtype>& operand, Layout layout)
+	: UnaryExp<Dtype>(operand), out_(Shape(operand), layout) {
+	forward();
+}
+
+template<typename Dtype>
+ToLayoutExp<Dtype>::ToLayoutExp(const Exp<Dtype>* operand, Layout layout)
+	: UnaryExp<Dtype>(operand), out_(Shape(*operand), layout) {
+	forward();
+}
+
+template<typename Dtype>
+void ToLayoutExp<Dtype>::forward(void) {
+	Dense<Dtype> x(*this->operand_, out_.layout());
+	memcpy(out_.layout_data(), x.data(), out_.layout_dsize() * sizeof(Dtype));
+}
+
+template<typename Dtype>
+inline const Dtype* ToLayoutExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout ToLayoutExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* ToLayoutExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype ToLayoutExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void ToLayoutExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Layout layout = this->operand_->layout();
+	Dense<Dtype> dy(grad, layout);
+	Tensor<Dtype> operand_grad(Shape(*this->operand_), layout);
+	memcpy(operand_grad.layout_data(), dy.data(), operand_grad.layout_dsize() * sizeof(Dtype));
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
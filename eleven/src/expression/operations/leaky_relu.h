@@ -0,0 +1,81 @@
+#ifndef EXPRESSION_OPERATIONS_LEAKY_RELU_H_
+#define EXPRESSION_OPERATIONS_LEAKY_RELU_H_
+
+#include "../expression.h"
+#include "../dense.h"
+
+namespace el {
+namespace op {
+
+// y = x > 0 ? x : negative_slope * x. It's computed eagerly, and backward picks the slope from the
+// sign of the output, which is the sign of the input as long as negative_slope >= 0.
+template<typename Dtype>
+struct LeakyReLUExp: public UnaryExp<Dtype> {
+	explicit LeakyReLUExp(const Exp<Dtype>& operand, Dtype negative_slope);
+	explicit LeakyReLUExp(const Exp<Dtype>* operand, Dtype negative_slope);
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	Dtype negative_slope_;
+	Tensor<Dtype> out_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+LeakyReLUExp<Dtype>::LeakyReLUExp(const Exp<Dtype>& operand, Dtype negative_slope)
+	: UnaryExp<Dtype>(operand), negative_slope_(negative_slope), out_(Shape(operand), operand.layout()) {
+	forward();
+}
+
+template<typename Dtype>
+LeakyReLUExp<Dtype>::LeakyReLUExp(const Exp<Dtype>* operand, Dtype negative_slope)
+	: UnaryExp<Dtype>(operand), negative_slope_(negative_slope), out_(Shape(*operand), operand->layout()) {
+	forward();
+}
+
+template<typename Dtype>
+void LeakyReLUExp<Dtype>::forward(void) {
+	Dense<Dtype> dense(*this->operand_, out_.layout());
+	const Dtype* x = dense.data();
+	Dtype* y = out_.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++)
+			y[i] = x[i] > 0 ? x[i] : negative_slope_ * x[i];
+	});
+}
+
+template<typename Dtype>
+inline const Dtype* LeakyReLUExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout LeakyReLUExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* LeakyReLUExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype LeakyReLUExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void LeakyReLUExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dense(grad, out_.layout());
+	const Dtype* dy = dense.data();
+	const Dtype* y = out_.layout_data();
+	Tensor<Dtype> operand_grad(Shape(*this->operand_), out_.layout());
+	Dtype* dx = operand_grad.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		for(index_t i = begin; i < end; i++)
+			dx[i] = y[i] > 0 ? dy[i] : negative_slope_ * dy[i];
+	});
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef EXPRESSION_OPERATIONS_LINEAR_H_
+#define EXPRESSION_OPERATIONS_LINEAR_H_
+
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/gemm.h"
+
+namespace el {
+namespace op {
+
+// Fully connected layer, act(input * weight^T + bias), where input is (batch, in), weight is (1, out, in),
+// the same layout as nn::Linear keeps it, and bias is anything with out elements, like (1, out, 1). The
+// output is (batch, out). It's one gemm whose epilogue adds the bias and applies the activation, so the
+// output is written only once. Like Conv2DExp, it's computed eagerly, and bias can be omitted.
+// packed_weight, if given, is weight^T already packed as op(B) of that gemm (see nn::Linear), and
+// forward reads it instead of packing the weight again. Backward always uses weight.
+template<typename Dtype>
+struct LinearExp: public BinaryExp<Dtype> {
+	explicit LinearExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, kernel::Activation act,
+					   const kernel::PackedMatrix<Dtype>* packed_weight=nullptr);
+	explicit LinearExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+					   kernel::Activation act, const kernel::PackedMatrix<Dtype>* packed_weight=nullptr);
+	explicit LinearExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, kernel::Activation act,
+					   const kernel::PackedMatrix<Dtype>* packed_weight=nullptr);
+	explicit LinearExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, const Exp<Dtype>* bias,
+					   kernel::Activation act, const kernel::PackedMatrix<Dtype>* packed_weight=nullptr);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	ConstExptr<Dtype> bias_;
+	kernel::Activation act_;
+	index_t batch_, in_features_, out_features_;
+	Tensor<Dtype> out_;
+
+	void forward(const kernel::PackedMatrix<Dtype>* packed_weight);
+};
+
+template<typename Dtype>
+LinearExp<Dtype>::LinearExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, kernel::Activation act,
+							const kernel::PackedMatrix<Dtype>* packed_weight)
+	: BinaryExp<Dtype>(input, weight), act_(act),
+	  batch_(input.size(0)), in_features_(input.size(1)), out_features_(weight.size(1)),
+	  out_(Shape{batch_, out_features_}) {
+	forward(packed_weight);
+}
+
+template<typename Dtype>
+LinearExp<Dtype>::LinearExp(const Exp<Dtype>& input, const Exp<Dtype>& weight, const Exp<Dtype>& bias,
+							kernel::Activation act, const kernel::PackedMatrix<Dtype>* packed_weight)
+	: BinaryExp<Dtype>(input, weight), act_(act),
+	  batch_(input.size(0)), in_features_(input.size(1)), out_features_(weight.size(1)),
+	  out_(Shape{batch_, out_features_}) {
+	ConstExptr<Dtype>::make_uncontrol(bias);
+	bias_.reset(&bias, false);
+	forward(packed_weight);
+}
+
+template<typename Dtype>
+LinearExp<Dtype>::LinearExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, kernel::Activation act,
+							const kernel::PackedMatrix<Dtype>* packed_weight)
+	: BinaryExp<Dtype>(input, weight), act_(act),
+	  batch_(input->size(0)), in_features_(input->size(1)), out_features_(weight->size(1)),
+	  out_(Shape{batch_, out_features_}) {
+	forward(packed_weight);
+}
+
+template<typename Dtype>
+LinearExp<Dtype>::LinearExp(const Exp<Dtype>* input, const Exp<Dtype>* weight, const Exp<Dtype>* bias,
+							kernel::Activation act, const kernel::PackedMatrix<Dtype>* packed_weight)
+	: BinaryExp<Dtype>(input, weight), bias_(bias, /*with_grad=*/true), act_(act),
+	  batch_(input->size(0)), in_features_(input->size(1)), out_features_(weight->size(1)),
+	  out_(Shape{batch_, out_features_}) {
+	forward(packed_weight);
+}
+
+template<typename Dtype>
+void LinearExp<Dtype>::forward(const kernel::PackedMatrix<Dtype>* packed_weight) {
+	Dense<Dtype> input(*this->loperand_);
+	std::shared_ptr<Dense<Dtype>> bias;
+	if(bias_) bias.reset(new Dense<Dtype>(*bias_));
+	kernel::BiasActEpilogue<Dtype> epilogue(nullptr, bias ? bias->data() : nullptr, act_);
+	if(packed_weight != nullptr) {
+		kernel::gemm_packed_b(false, batch_, Dtype(1), input.data(), in_features_, *packed_weight,
+							  Dtype(0), out_.data(), out_features_, epilogue);
+		return;
+	}
+	Dense<Dtype> weight(*this->roperand_);
+	kernel::gemm(false, true, batch_, out_features_, in_features_,
+				 Dtype(1), input.data(), in_features_, weight.data(), in_features_,
+				 Dtype(0), out_.data(), out_features_, epilogue);
+}
+
+template<typename Dtype>
+inline index_t LinearExp<Dtype>::dim(void) const {return 2;}
+
+template<typename Dtype>
+inline index_t LinearExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool LinearExp<Dtype>::requires_grad(void) const {
+	return this->loperand_.requires_grad() || this->roperand_.requires_grad() || bias_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* LinearExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype LinearExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+// With dz = dy * act'(z):  d_input = dz * weight,  d_weight = dz^T * input,  d_bias = column sums of dz.
+template<typename Dtype>
+void LinearExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dout(grad);
+	const Dtype* dy = dout.data();
+	std::shared_ptr<Dtype> act_grad;
+	if(act_ != kernel::Activation::None) {
+		index_t dsize = batch_ * out_features_;
+		act_grad.reset(new Dtype[dsize], std::default_delete<Dtype[]>());
+		Dtype* dz = act_grad.get();
+		parallel_for(0, dsize, 4096, [&](index_t begin, index_t end) {
+			kernel::activation_backward(act_, out_.data() + begin, dy + begin, dz + begin, end - begin);
+		});
+		dy = dz;
+	}
+	if(bias_.requires_grad()) {
+		Tensor<Dtype> bias_grad((Shape(*bias_)));
+		Dtype* db = bias_grad.data();
+		for(index_t j = 0; j < out_features_; j++)
+			db[j] = 0;
+		for(index_t b = 0; b < batch_; b++) {
+			const Dtype* dy_row = dy + b * out_features_;
+			for(index_t j = 0; j < out_features_; j++)
+				db[j] += dy_row[j];
+		}
+		ConstExptr<Dtype>::make_uncontrol(bias_grad);
+		bias_.backward(bias_grad);
+	}
+	if(this->loperand_.requires_grad()) {
+		Dense<Dtype> weight(*this->roperand_);
+		Tensor<Dtype> input_grad(Shape(*this->loperand_));
+		kernel::gemm(false, false, batch_, in_features_, out_features_,
+					 Dtype(1), dy, out_features_, weight.data(), in_features_,
+					 Dtype(0), input_grad.data(), in_features_);
+		ConstExptr<Dtype>::make_uncontrol(input_grad);
+		this->loperand_.backward(input_grad);
+	}
+	if(this->roperand_.requires_grad()) {
+		Dense<Dtype> input(*this->loperand_);
+		Tensor<Dtype> weight_grad(Shape(*this->roperand_));
+		kernel::gemm(true, false, out_features_, in_features_, batch_,
+					 Dtype(1), dy, out_features_, input.data(), in_features_,
+					 Dtype(0), weight_grad.data(), in_features_);
+		ConstExptr<Dtype>::make_uncontrol(weight_grad);
+		this->roperand_.backward(weight_grad);
+	}
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -1,138 +1,67 @@
 #ifndef EXPRESSION_OPERATIONS_LOG_SOFTMAX_H_
 #define EXPRESSION_OPERATIONS_LOG_SOFTMAX_H_
 
-#include <cmath>
-#include <memory>
 #include "../expression.h"
+#include "../dense.h"
+#include "../kernels/softmax.h"
+#include "nll_loss.h"
 
 namespace el {
 namespace op {
 
+// log_softmax over dim 1 of (batch, num_cls). It's computed eagerly with the vectorized exp and log,
+// and backward, dx = dy - softmax * sum(dy), recovers softmax from the output, in O(num_cls) per row.
+// The one-hot gradient of nll_loss is read as its index and values, without a dense dy.
 template<typename Dtype>
 struct LogSoftmaxExp: public UnaryExp<Dtype> {
 	explicit LogSoftmaxExp(const Exp<Dtype>& operand);
 	explicit LogSoftmaxExp(const Exp<Dtype>* operand);
+	const Dtype* data(void) const;
 	Dtype eval(index_t* ids) const;
 	void backward(const Exp<Dtype>& grad) const;
-
-	struct GradExp: public BinaryExp<Dtype> {
-		explicit GradExp(const Exp<Dtype>& operand, 
-			             const Exp<Dtype>& grad, 
-			             const std::shared_ptr<Dtype>& exp_sum, 
-			             const std::shared_ptr<Dtype>& max_item);
-		Dtype eval(index_t* ids) const;
-		void backward(const Exp<Dtype>& grad) const;
-	private:
-		const std::shared_ptr<Dtype> exp_sum_;
-		const std::shared_ptr<Dtype> max_item_;
-	};
-
 private:
-	std::shared_ptr<Dtype> exp_sum_;
-	std::shared_ptr<Dtype> log_exp_sum_;
-	std::shared_ptr<Dtype> max_item_;
+	Tensor<Dtype> out_;
+
+	void forward(void);
 };
 
 template<typename Dtype>
 LogSoftmaxExp<Dtype>::LogSoftmaxExp(const Exp<Dtype>& operand)
-	: UnaryExp<Dtype>(operand),
-	  exp_sum_(new Dtype[operand.size(0)]{0}, std::default_delete<Dtype[]>()),
-	  log_exp_sum_(new Dtype[operand.size(0)], std::default_delete<Dtype[]>()),
-	  max_item_(new Dtype[operand.size(0)], std::default_delete<Dtype[]>()) {
-	
-	auto exp_sum_ptr = exp_sum_.get();
-	auto log_exp_sum_ptr = log_exp_sum_.get();
-	auto max_item_ptr = max_item_.get();
-	index_t ids[2];
-	index_t num_batch = operand.size(0);
-	index_t num_cls = operand.size(1);
-
-	for(index_t i = 0; i < num_batch; i++) {
-		ids[0] = i;
-		ids[1] = 0;
-		max_item_ptr[i] = operand.eval(ids);
-		for(index_t j = 1; j < num_cls; j++) {
-			ids[1] = j;
-			max_item_ptr[i] = std::max(operand.eval(ids), max_item_ptr[i]);
-		}
-		for(index_t j = 0; j < num_cls; j++) {
-			ids[1] = j;
-			exp_sum_ptr[i] += std::exp(operand.eval(ids) - max_item_ptr[i]);
-		}
-		log_exp_sum_ptr[i] = std::log(exp_sum_ptr[i]);
-	}
+	: UnaryExp<Dtype>(operand), out_(Shape(operand)) {
+	forward();
 }
 
 template<typename Dtype>
 LogSoftmaxExp<Dtype>::LogSoftmaxExp(const Exp<Dtype>* operand)
-	: UnaryExp<Dtype>(operand),
-	  exp_sum_(new Dtype[operand->size(0)]{0}, std::default_delete<Dtype[]>()),
-	  log_exp_sum_(new Dtype[operand->size(0)], std::default_delete<Dtype[]>()),
-	  max_item_(new Dtype[operand->size(0)], std::default_delete<Dtype[]>()) {
-	
-	auto exp_sum_ptr = exp_sum_.get();
-	auto log_exp_sum_ptr = log_exp_sum_.get();
-	auto max_item_ptr = max_item_.get();
-	index_t ids[2];
-	index_t num_batch = operand->size(0);
-	index_t num_cls = operand->size(1);
-
-	for(index_t i = 0; i < num_batch; i++) {
-		ids[0] = i;
-		ids[1] = 0;
-		max_item_ptr[i] = operand->eval(ids);
-		for(index_t j = 1; j < num_cls; j++) {
-			ids[1] = j;
-			max_item_ptr[i] = std::max(operand->eval(ids), max_item_ptr[i]);
-		}
-		for(index_t j = 0; j < num_cls; j++) {
-			ids[1] = j;
-			exp_sum_ptr[i] += std::exp(operand->eval(ids) - max_item_ptr[i]);
-		}
-		log_exp_sum_ptr[i] = std::log(exp_sum_ptr[i]);
-	}
+	: UnaryExp<Dtype>(operand), out_(Shape(*operand)) {
+	forward();
 }
 
 template<typename Dtype>
-inline Dtype LogSoftmaxExp<Dtype>::eval(index_t* ids) const {
-	return this->operand_->eval(ids) - max_item_.get()[ids[0]] - log_exp_sum_.get()[ids[0]];
+void LogSoftmaxExp<Dtype>::forward(void) {
+	Dense<Dtype> x(*this->operand_);
+	kernel::log_softmax_forward(out_.size(0), out_.size(1), x.data(), out_.data());
 }
 
 template<typename Dtype>
-inline void LogSoftmaxExp<Dtype>::backward(const Exp<Dtype>& grad) const {
-	GradExp logsoftmax_grad(*this->operand_, grad, exp_sum_, max_item_);
-	ConstExptr<Dtype>::make_uncontrol(logsoftmax_grad);
-	this->operand_.backward(logsoftmax_grad);
-}
+inline const Dtype* LogSoftmaxExp<Dtype>::data(void) const {return out_.data();}
 
 template<typename Dtype>
-LogSoftmaxExp<Dtype>::GradExp::GradExp(const Exp<Dtype>& operand, 
-			             			   const Exp<Dtype>& grad, 
-			                           const std::shared_ptr<Dtype>& exp_sum, 
-			                           const std::shared_ptr<Dtype>& max_item) 
-	: BinaryExp<Dtype>(operand, grad), exp_sum_(exp_sum), max_item_(max_item) {}
+inline Dtype LogSoftmaxExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
 
 template<typename Dtype>
-inline Dtype LogSoftmaxExp<Dtype>::GradExp::eval(index_t* ids) const {
-	index_t num_cls = this->loperand_->size(1);
-	index_t grad_ids[2] = {ids[0], 0};
-	Dtype total_grad = 0;
-	Dtype softmax = std::exp(this->loperand_->eval(ids) - max_item_.get()[ids[0]]) / exp_sum_.get()[ids[0]];
-
-	for(index_t i = 0; i < num_cls; i++) {
-		grad_ids[1] = i;
-		if(ids[1] != i) {
-			total_grad -= softmax * this->roperand_->eval(grad_ids);
-		} else { 
-			total_grad += (1-softmax) * this->roperand_->eval(grad_ids);
-		}
+void LogSoftmaxExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Tensor<Dtype> operand_grad(Shape(*this->operand_));
+	const OneHotExp<Dtype>* one_hot = dynamic_cast<const OneHotExp<Dtype>*>(&grad);
+	if(one_hot != nullptr) {
+		kernel::log_softmax_backward_one_hot(out_.size(0), out_.size(1), out_.data(), one_hot->index(),
+											 one_hot->values(), operand_grad.data());
+	} else {
+		Dense<Dtype> dy(grad);
+		kernel::log_softmax_backward(out_.size(0), out_.size(1), out_.data(), dy.data(), operand_grad.data());
 	}
-	return total_grad;
-}
-
-template<typename Dtype>
-inline void LogSoftmaxExp<Dtype>::GradExp::backward(const Exp<Dtype>& grad) const {
-	THROW_ERROR(NotImplementError, "Not Implement backward for log softmax's gradient backward helper.");
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
 }
 
 }  // namespace op
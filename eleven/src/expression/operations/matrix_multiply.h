@@ -2,6 +2,8 @@
 #define EXPRESSION_OPERATIONS_MATRIX_MULTIPLY_H_
 
 #include "base_ops.h"
+#include "../dense.h"
+#include "../kernels/gemm.h"
 
 
 namespace el {
@@ -39,63 +41,93 @@ struct MMExp: public BinaryExp<Dtype> {
 	} 
 };
 
+// Batched matrix multiply, (lbatch, m, k) x (rbatch, k, n) ==> (batch, m, n), where either batch can
+// be 1 to broadcast that operand, like the (1, out, in) weights of nn layers. It's computed eagerly by
+// kernel::batched_gemm, which turns a broadcast operand into a single gemm whenever the layout allows,
+// so the broadcast matrix is read once for the whole batch instead of once per sample.
 template<typename Dtype>
 struct BMMExp: public BinaryExp<Dtype> {
-	BMMExp(const Exp<Dtype>& loperand, const Exp<Dtype>& roperand)
-		: BinaryExp<Dtype>(loperand, roperand) {}
-	BMMExp(const Exp<Dtype>* loperand, const Exp<Dtype>* roperand)
-		: BinaryExp<Dtype>(loperand, roperand) {}
-	index_t dim(void) const {return 3;}
-	index_t size(index_t idx) const {
-		switch(idx) {
-			case 0: return std::max(this->roperand_->size(0), this->loperand_->size(0));
-			case 1: return this->loperand_->size(1);
-			default: return this->roperand_->size(2);
-		}
-	}
-	Dtype eval(index_t* ids) const {
-		Dtype value = 0;
-		index_t l_loc[3] = {ids[0], ids[1], 0};
-		index_t r_loc[3] = {ids[0], 0, ids[2]};
-		for(index_t i = 0; i < this->loperand_->size(2); i++) {
-			l_loc[2] = i;
-			r_loc[1] = i;
-			value += this->loperand_->eval(l_loc) * this->roperand_->eval(r_loc);
-		}
-		return value;
-	}
-	struct BMTExp: public UnaryExp<Dtype> {
-		BMTExp(const Exp<Dtype>& operand): UnaryExp<Dtype>(operand) {}
-		index_t dim(void) const {return 3;}
-		index_t size(index_t idx) const {
-			switch(idx) {
-				case 0: return this->operand_->size(0);
-				case 1: return this->operand_->size(2);
-				default: return this->operand_->size(1);
-			}
-		}
-		Dtype eval(index_t* ids) const {
-			index_t trans_ids[3] = {ids[0], ids[2], ids[1]};
-			return this->operand_->eval(trans_ids);
-		}
-		void backward(const Exp<Dtype>& grad) const {
-			THROW_ERROR(NotImplementError, "Not Implement backward for Batch Matrix Transpose.");
-		}
-	};
-	void backward(const Exp<Dtype>& grad) const {
-		BMTExp rbmt(*this->roperand_);
-		BMMExp<Dtype> lgrad(grad, rbmt);
-		ConstExptr<Dtype>::make_uncontrol(rbmt);
+	BMMExp(const Exp<Dtype>& loperand, const Exp<Dtype>& roperand);
+	BMMExp(const Exp<Dtype>* loperand, const Exp<Dtype>* roperand);
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	index_t lbatch_, rbatch_, batch_, m_, k_, n_;
+	Tensor<Dtype> out_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+BMMExp<Dtype>::BMMExp(const Exp<Dtype>& loperand, const Exp<Dtype>& roperand)
+	: BinaryExp<Dtype>(loperand, roperand),
+	  lbatch_(loperand.size(0)), rbatch_(roperand.size(0)), batch_(std::max(lbatch_, rbatch_)),
+	  m_(loperand.size(1)), k_(loperand.size(2)), n_(roperand.size(2)),
+	  out_(Shape{batch_, m_, n_}) {
+	forward();
+}
+
+template<typename Dtype>
+BMMExp<Dtype>::BMMExp(const Exp<Dtype>* loperand, const Exp<Dtype>* roperand)
+	: BinaryExp<Dtype>(loperand, roperand),
+	  lbatch_(loperand->size(0)), rbatch_(roperand->size(0)), batch_(std::max(lbatch_, rbatch_)),
+	  m_(loperand->size(1)), k_(loperand->size(2)), n_(roperand->size(2)),
+	  out_(Shape{batch_, m_, n_}) {
+	forward();
+}
+
+template<typename Dtype>
+void BMMExp<Dtype>::forward(void) {
+	Dense<Dtype> lhs(*this->loperand_);
+	Dense<Dtype> rhs(*this->roperand_);
+	kernel::batched_gemm(false, false, batch_, m_, n_, k_,
+						 lhs.data(), lbatch_ == 1 ? 0 : m_ * k_,
+						 rhs.data(), rbatch_ == 1 ? 0 : k_ * n_,
+						 out_.data(), m_ * n_);
+}
+
+template<typename Dtype>
+inline index_t BMMExp<Dtype>::dim(void) const {return 3;}
+
+template<typename Dtype>
+inline index_t BMMExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline const Dtype* BMMExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype BMMExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+// d_lhs[i] = dy[i] * rhs[i]^T and d_rhs[i] = lhs[i]^T * dy[i]. The gradient of a broadcast operand is
+// one gemm contracting over the batch and the inner dimension together, written straight into a
+// gradient of the operand's own (1, ., .) shape, so nothing is left for operator+= to sum.
+template<typename Dtype>
+void BMMExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad);
+	if(this->loperand_.requires_grad()) {
+		Dense<Dtype> rhs(*this->roperand_);
+		Tensor<Dtype> lgrad(Shape{lbatch_, m_, k_});
+		kernel::batched_gemm(false, true, batch_, m_, k_, n_,
+							 dy.data(), m_ * n_,
+							 rhs.data(), rbatch_ == 1 ? 0 : k_ * n_,
+							 lgrad.data(), lbatch_ == 1 ? 0 : m_ * k_);
 		ConstExptr<Dtype>::make_uncontrol(lgrad);
 		this->loperand_.backward(lgrad);
-
-		BMTExp lbmt(*this->loperand_);
-		BMMExp<Dtype> rgrad(lbmt, grad);
-		ConstExptr<Dtype>::make_uncontrol(lbmt);
+	}
+	if(this->roperand_.requires_grad()) {
+		Dense<Dtype> lhs(*this->loperand_);
+		Tensor<Dtype> rgrad(Shape{rbatch_, k_, n_});
+		kernel::batched_gemm(true, false, batch_, k_, n_, m_,
+							 lhs.data(), lbatch_ == 1 ? 0 : m_ * k_,
+							 dy.data(), m_ * n_,
+							 rgrad.data(), rbatch_ == 1 ? 0 : k_ * n_);
 		ConstExptr<Dtype>::make_uncontrol(rgrad);
 		this->roperand_.backward(rgrad);
 	}
-};
+}
 
 }  // namespace op
 }  // namespace el
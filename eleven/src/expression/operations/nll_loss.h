@@ -1,11 +1,37 @@
 #ifndef EXPRESSION_OPERATIONS_NLL_LOSS_H_
 #define EXPRESSION_OPERATIONS_NLL_LOSS_H_
 
+#include <vector>
+#include <utility>
 #include "../expression.h"
+#include "../dense.h"
 
 namespace el {
 namespace op {
 
+// A (rows, cols) expression which is zero except for values[i] at (i, index[i]), what the gradient of
+// nll_loss is. backward passes it as it is, no dense (batch, num_cls) matrix is built: ops which know
+// it, like log_softmax, read the index and the values directly, and to any other one it's an
+// expression whose eval is O(1).
+template<typename Dtype>
+struct OneHotExp: public Exp<Dtype> {
+	OneHotExp(index_t cols, std::vector<int_t> index, std::vector<Dtype> values)
+		: cols_(cols), index_(std::move(index)), values_(std::move(values)) {}
+	index_t dim(void) const {return 2;}
+	index_t size(index_t idx) const {return idx == 0 ? index_t(index_.size()) : cols_;}
+	bool requires_grad(void) const {return false;}
+	Dtype eval(index_t* ids) const {return ids[1] == index_[ids[0]] ? values_[ids[0]] : Dtype(0);}
+	void backward(const Exp<Dtype>& grad) const {
+		THROW_ERROR(NotImplementError, "Not Implement backward for a one-hot gradient.");
+	}
+	const int_t* index(void) const {return index_.data();}
+	const Dtype* values(void) const {return values_.data();}
+private:
+	index_t cols_;
+	std::vector<int_t> index_;
+	std::vector<Dtype> values_;
+};
+
 template<typename Dtype>
 struct NLLLossExp: public Exp<Dtype> {
 	NLLLossExp(const Exp<Dtype>& src, const Exp<int_t>& index);
@@ -19,20 +45,6 @@ struct NLLLossExp: public Exp<Dtype> {
 private:
 	ConstExptr<Dtype> src_;
 	ConstExptr<int_t> index_;
-	
-	struct GradExp: public Exp<Dtype> {
-	public:	
-		GradExp(const Exp<Dtype>& grad, const Exp<Dtype>& src, const Exp<int_t>& index);
-		index_t dim(void) const;
-		index_t size(index_t idx) const;
-		bool requires_grad(void) const;
-		Dtype eval(index_t* ids) const;
-		void backward(const Exp<Dtype>& grad) const;
-	private:
-		ConstExptr<Dtype> grad_;
-		ConstExptr<Dtype> src_;
-		ConstExptr<int_t> index_;
-	};
 };
 
 template<typename Dtype>
@@ -62,47 +74,20 @@ inline Dtype NLLLossExp<Dtype>::eval(index_t* ids) const {
 	return -src_->eval(src_ids);
 }
 
+// d_src[i, index[i]] = -grad[i], as a OneHotExp.
 template<typename Dtype>
 inline void NLLLossExp<Dtype>::backward(const Exp<Dtype>& grad) const {
-	GradExp src_grad(grad, *src_, *index_);
+	index_t num_batch = index_->size(0);
+	Dense<Dtype> dy(grad);
+	Dense<int_t> index(*index_);
+	std::vector<Dtype> values(num_batch);
+	for(index_t i = 0; i < num_batch; i++)
+		values[i] = -dy[i];
+	OneHotExp<Dtype> src_grad(src_->size(1), std::vector<int_t>(index.data(), index.data() + num_batch), values);
 	ConstExptr<Dtype>::make_uncontrol(src_grad);
 	src_.backward(src_grad);
 }
 
-// NLLLossExp
-template<typename Dtype>
-NLLLossExp<Dtype>::GradExp::GradExp(const Exp<Dtype>& grad, const Exp<Dtype>& src, const Exp<int_t>& index) {
-	ConstExptr<Dtype>::make_uncontrol(grad);
-	ConstExptr<Dtype>::make_uncontrol(src);
-	ConstExptr<int_t>::make_uncontrol(index);
-	grad_.reset(&grad, false);
-	src_.reset(&src, false);
-	index_.reset(&index, false);
-}
-
-template<typename Dtype>
-index_t NLLLossExp<Dtype>::GradExp::dim(void) const {return 2;}
-
-template<typename Dtype>
-index_t NLLLossExp<Dtype>::GradExp::size(index_t idx) const {return src_->size(idx);}
-
-template<typename Dtype>
-bool NLLLossExp<Dtype>::GradExp::requires_grad(void) const {return src_->requires_grad();}
-
-template<typename Dtype>
-Dtype NLLLossExp<Dtype>::GradExp::eval(index_t *ids) const {
-	index_t index_ids = ids[0];
-	if(ids[1] == index_->eval(&index_ids))
-		return -grad_->eval(&index_ids);
-	else
-		return 0;
-}
-
-template<typename Dtype>
-void NLLLossExp<Dtype>::GradExp::backward(const Exp<Dtype>& grad) const {
-	THROW_ERROR(NotImplementError, "Not Implement backward for NLL loss's gradient backward helper function.");
-}
-
 }  // namespace op
 }  // namespace el
 
@@ -0,0 +1,128 @@
+#ifndef EXPRESSION_OPERATIONS_POOLING_H_
+#define EXPRESSION_OPERATIONS_POOLING_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/pooling.h"
+
+namespace el {
+namespace op {
+
+// Max or average 2D pooling, with sliding or adaptive windows described by kernel::PoolParam.
+// It's computed eagerly. Max pooling records the offset of the max in each window, in one byte when
+// the window has at most 256 pixels, so backward is a single scatter of the gradient. Inputs in NHWC
+// or a blocked layout are pooled in that layout, and give an output in it.
+template<typename Dtype>
+struct Pool2DExp: public UnaryExp<Dtype> {
+	explicit Pool2DExp(const Exp<Dtype>& operand, kernel::PoolMode mode, const kernel::PoolParam& param);
+	explicit Pool2DExp(const Exp<Dtype>* operand, kernel::PoolMode mode, const kernel::PoolParam& param);
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t *ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	kernel::PoolMode mode_;
+	kernel::PoolParam param_;
+	Tensor<Dtype> out_;
+	std::vector<uint8_t> argmax8_;
+	std::vector<int32_t> argmax32_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+Pool2DExp<Dtype>::Pool2DExp(const Exp<Dtype>& operand, kernel::PoolMode mode, const kernel::PoolParam& param)
+	: UnaryExp<Dtype>(operand),
+	  mode_(mode),
+	  param_(param),
+	  out_(Shape{param_.batch, param_.channels, param_.out_h, param_.out_w}, operand.layout()) {
+	forward();
+}
+
+template<typename Dtype>
+Pool2DExp<Dtype>::Pool2DExp(const Exp<Dtype>* operand, kernel::PoolMode mode, const kernel::PoolParam& param)
+	: UnaryExp<Dtype>(operand),
+	  mode_(mode),
+	  param_(param),
+	  out_(Shape{param_.batch, param_.channels, param_.out_h, param_.out_w}, operand->layout()) {
+	forward();
+}
+
+template<typename Dtype>
+void Pool2DExp<Dtype>::forward(void) {
+	Layout layout = out_.layout();
+	Dense<Dtype> x(*this->operand_, layout);
+	index_t dsize = out_.layout_dsize();
+	if(layout != Layout::NCHW) {
+		Dtype* y = out_.layout_data();
+		if(mode_ == kernel::PoolMode::Avg) {
+			kernel::avg_pool2d_blocked_forward(param_, layout, x.data(), y);
+		} else if(param_.small_window()) {
+			argmax8_.resize(dsize);
+			kernel::max_pool2d_blocked_forward(param_, layout, x.data(), y, argmax8_.data());
+		} else {
+			argmax32_.resize(dsize);
+			kernel::max_pool2d_blocked_forward(param_, layout, x.data(), y, argmax32_.data());
+		}
+	} else if(mode_ == kernel::PoolMode::Avg) {
+		kernel::avg_pool2d_forward(param_, x.data(), out_.data());
+	} else if(param_.small_window()) {
+		argmax8_.resize(dsize);
+		kernel::max_pool2d_forward(param_, x.data(), out_.data(), argmax8_.data());
+	} else {
+		argmax32_.resize(dsize);
+		kernel::max_pool2d_forward(param_, x.data(), out_.data(), argmax32_.data());
+	}
+}
+
+template<typename Dtype>
+index_t Pool2DExp<Dtype>::dim(void) const {return 4;}
+
+template<typename Dtype>
+index_t Pool2DExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline const Dtype* Pool2DExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout Pool2DExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* Pool2DExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype Pool2DExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void Pool2DExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Layout layout = out_.layout();
+	Dense<Dtype> dy(grad, layout);
+	Tensor<Dtype> operand_grad(Shape(*this->operand_), layout);
+	Dtype* dx = operand_grad.layout_data();
+	if(layout != Layout::NCHW) {
+		if(mode_ == kernel::PoolMode::Avg)
+			kernel::avg_pool2d_blocked_backward(param_, layout, dy.data(), dx);
+		else if(param_.small_window())
+			kernel::max_pool2d_blocked_backward(param_, layout, dy.data(), argmax8_.data(), dx);
+		else
+			kernel::max_pool2d_blocked_backward(param_, layout, dy.data(), argmax32_.data(), dx);
+	} else if(mode_ == kernel::PoolMode::Avg) {
+		kernel::avg_pool2d_backward(param_, dy.data(), dx);
+	} else if(param_.small_window()) {
+		kernel::max_pool2d_backward(param_, dy.data(), argmax8_.data(), dx);
+	} else {
+		kernel::max_pool2d_backward(param_, dy.data(), argmax32_.data(), dx);
+	}
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+
+#endif
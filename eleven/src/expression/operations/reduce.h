@@ -0,0 +1,121 @@
+#ifndef EXPRESSION_OPERATIONS_REDUCE_H_
+#define EXPRESSION_OPERATIONS_REDUCE_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/reduce.h"
+
+namespace el {
+namespace op {
+
+// Sum, mean, max, min or variance over a set of axes. With keepdim, reduced axes are kept with size 1,
+// otherwise they are removed (a full reduction still gives shape (1)). It's computed eagerly by the
+// kernels in kernels/reduce.h, which give the same result for a fixed thread count.
+template<typename Dtype>
+struct ReduceExp: public UnaryExp<Dtype> {
+public:	
+	explicit ReduceExp(const Exp<Dtype>& operand, kernel::ReduceOp op, const std::vector<index_t>& axes,
+					   bool keepdim, index_t correction=1);
+	explicit ReduceExp(const Exp<Dtype>* operand, kernel::ReduceOp op, const std::vector<index_t>& axes,
+					   bool keepdim, index_t correction=1);
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	kernel::ReduceOp op_;
+	index_t correction_;
+	std::vector<bool> reduce_axes_;
+	kernel::ReduceShape shape_;
+	Tensor<Dtype> out_;
+
+	static std::vector<index_t> sizes_of(const Exp<Dtype>& operand);
+	static std::vector<bool> make_mask(const Exp<Dtype>& operand, const std::vector<index_t>& axes);
+	static Shape make_shape(const Exp<Dtype>& operand, const std::vector<bool>& reduce_axes, bool keepdim);
+	void forward(void);
+};
+
+template<typename Dtype>
+std::vector<index_t> ReduceExp<Dtype>::sizes_of(const Exp<Dtype>& operand) {
+	std::vector<index_t> sizes(operand.dim());
+	for(index_t i = 0; i < operand.dim(); i++)
+		sizes[i] = operand.size(i);
+	return sizes;
+}
+
+template<typename Dtype>
+std::vector<bool> ReduceExp<Dtype>::make_mask(const Exp<Dtype>& operand, const std::vector<index_t>& axes) {
+	std::vector<bool> mask(operand.dim(), false);
+	for(auto axis: axes)
+		mask[axis] = true;
+	return mask;
+}
+
+template<typename Dtype>
+Shape ReduceExp<Dtype>::make_shape(const Exp<Dtype>& operand, const std::vector<bool>& reduce_axes, bool keepdim) {
+	std::vector<index_t> dims;
+	for(index_t i = 0; i < operand.dim(); i++) {
+		if(!reduce_axes[i]) dims.push_back(operand.size(i));
+		else if(keepdim) dims.push_back(1);
+	}
+	if(dims.empty()) dims.push_back(1);
+	return Shape(dims.data(), dims.size());
+}
+
+template<typename Dtype>
+ReduceExp<Dtype>::ReduceExp(const Exp<Dtype>& operand, kernel::ReduceOp op, const std::vector<index_t>& axes,
+							bool keepdim, index_t correction)
+	: UnaryExp<Dtype>(operand), op_(op), correction_(correction),
+	  reduce_axes_(make_mask(operand, axes)),
+	  shape_(sizes_of(operand), reduce_axes_),
+	  out_(make_shape(operand, reduce_axes_, keepdim)) {
+	forward();
+}
+
+template<typename Dtype>
+ReduceExp<Dtype>::ReduceExp(const Exp<Dtype>* operand, kernel::ReduceOp op, const std::vector<index_t>& axes,
+							bool keepdim, index_t correction)
+	: UnaryExp<Dtype>(operand), op_(op), correction_(correction),
+	  reduce_axes_(make_mask(*operand, axes)),
+	  shape_(sizes_of(*operand), reduce_axes_),
+	  out_(make_shape(*operand, reduce_axes_, keepdim)) {
+	forward();
+}
+
+template<typename Dtype>
+void ReduceExp<Dtype>::forward(void) {
+	Dense<Dtype> x(*this->operand_);
+	kernel::reduce_forward(op_, shape_, x.data(), out_.data(), correction_);
+}
+
+template<typename Dtype>
+inline index_t ReduceExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t ReduceExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline const Dtype* ReduceExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype ReduceExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void ReduceExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad);
+	std::shared_ptr<Dense<Dtype>> x;
+	if(op_ != kernel::ReduceOp::Sum && op_ != kernel::ReduceOp::Mean)
+		x.reset(new Dense<Dtype>(*this->operand_));
+	Tensor<Dtype> operand_grad(Shape(*this->operand_));
+	kernel::reduce_backward(op_, shape_, x ? x->data() : nullptr, out_.data(), dy.data(),
+							operand_grad.data(), correction_);
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
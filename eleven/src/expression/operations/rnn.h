@@ -0,0 +1,144 @@
+#ifndef EXPRESSION_OPERATIONS_RNN_H_
+#define EXPRESSION_OPERATIONS_RNN_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/rnn.h"
+
+namespace el {
+namespace op {
+
+// LSTM or GRU over input (seq, batch, in), from zero states, giving the hidden state of every step,
+// (seq, batch, hidden). weight_ih is (gates * hidden, in), weight_hh (gates * hidden, hidden) and both
+// biases have gates * hidden values, see kernel::rnn_forward. It's computed eagerly, and the activated
+// gates and the cell states (hn for GRU) of the whole sequence are kept for backward through time.
+template<typename Dtype>
+struct RNNExp: public BinaryExp<Dtype> {
+	explicit RNNExp(kernel::RNNMode mode, const Exp<Dtype>& input, const Exp<Dtype>& weight_ih,
+					const Exp<Dtype>& weight_hh, const Exp<Dtype>& bias_ih, const Exp<Dtype>& bias_hh);
+	explicit RNNExp(kernel::RNNMode mode, const Exp<Dtype>* input, const Exp<Dtype>* weight_ih,
+					const Exp<Dtype>* weight_hh, const Exp<Dtype>* bias_ih, const Exp<Dtype>* bias_hh);
+
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	bool requires_grad(void) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	kernel::RNNMode mode_;
+	ConstExptr<Dtype> weight_hh_;
+	ConstExptr<Dtype> bias_ih_;
+	ConstExptr<Dtype> bias_hh_;
+	index_t seq_, batch_, in_, hidden_;
+	Tensor<Dtype> out_;
+	std::vector<Dtype> gates_, state_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+RNNExp<Dtype>::RNNExp(kernel::RNNMode mode, const Exp<Dtype>& input, const Exp<Dtype>& weight_ih,
+					  const Exp<Dtype>& weight_hh, const Exp<Dtype>& bias_ih, const Exp<Dtype>& bias_hh)
+	: BinaryExp<Dtype>(input, weight_ih), mode_(mode),
+	  out_(Shape{input.size(0), input.size(1), weight_hh.size(1)}) {
+	ConstExptr<Dtype>::make_uncontrol(weight_hh);
+	ConstExptr<Dtype>::make_uncontrol(bias_ih);
+	ConstExptr<Dtype>::make_uncontrol(bias_hh);
+	weight_hh_.reset(&weight_hh, false);
+	bias_ih_.reset(&bias_ih, false);
+	bias_hh_.reset(&bias_hh, false);
+	forward();
+}
+
+template<typename Dtype>
+RNNExp<Dtype>::RNNExp(kernel::RNNMode mode, const Exp<Dtype>* input, const Exp<Dtype>* weight_ih,
+					  const Exp<Dtype>* weight_hh, const Exp<Dtype>* bias_ih, const Exp<Dtype>* bias_hh)
+	: BinaryExp<Dtype>(input, weight_ih), mode_(mode), weight_hh_(weight_hh, /*with_grad=*/true),
+	  bias_ih_(bias_ih, /*with_grad=*/true), bias_hh_(bias_hh, /*with_grad=*/true),
+	  out_(Shape{input->size(0), input->size(1), weight_hh->size(1)}) {
+	forward();
+}
+
+template<typename Dtype>
+void RNNExp<Dtype>::forward(void) {
+	seq_ = this->loperand_->size(0);
+	batch_ = this->loperand_->size(1);
+	in_ = this->loperand_->size(2);
+	hidden_ = weight_hh_->size(1);
+	gates_.resize(seq_ * batch_ * kernel::rnn_gates(mode_) * hidden_);
+	state_.resize(seq_ * batch_ * hidden_);
+	Dense<Dtype> x(*this->loperand_);
+	Dense<Dtype> w_ih(*this->roperand_);
+	Dense<Dtype> w_hh(*weight_hh_);
+	Dense<Dtype> b_ih(*bias_ih_);
+	Dense<Dtype> b_hh(*bias_hh_);
+	kernel::rnn_forward(mode_, seq_, batch_, in_, hidden_, x.data(), w_ih.data(), w_hh.data(), b_ih.data(),
+						b_hh.data(), gates_.data(), state_.data(), out_.data());
+}
+
+template<typename Dtype>
+inline index_t RNNExp<Dtype>::dim(void) const {return 3;}
+
+template<typename Dtype>
+inline index_t RNNExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline bool RNNExp<Dtype>::requires_grad(void) const {
+	return this->loperand_.requires_grad() || this->roperand_.requires_grad() || weight_hh_.requires_grad()
+		   || bias_ih_.requires_grad() || bias_hh_.requires_grad();
+}
+
+template<typename Dtype>
+inline const Dtype* RNNExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype RNNExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void RNNExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dh(grad);
+	Dense<Dtype> x(*this->loperand_);
+	Dense<Dtype> w_ih(*this->roperand_);
+	Dense<Dtype> w_hh(*weight_hh_);
+	bool input_grad = this->loperand_.requires_grad();
+	bool w_ih_grad = this->roperand_.requires_grad();
+	bool w_hh_grad = weight_hh_.requires_grad();
+	bool b_ih_grad = bias_ih_.requires_grad();
+	bool b_hh_grad = bias_hh_.requires_grad();
+	Tensor<Dtype> dx(input_grad ? Shape(*this->loperand_) : Shape{1});
+	Tensor<Dtype> dw_ih(w_ih_grad ? Shape(*this->roperand_) : Shape{1});
+	Tensor<Dtype> dw_hh(w_hh_grad ? Shape(*weight_hh_) : Shape{1});
+	Tensor<Dtype> db_ih(b_ih_grad ? Shape(*bias_ih_) : Shape{1});
+	Tensor<Dtype> db_hh(b_hh_grad ? Shape(*bias_hh_) : Shape{1});
+	kernel::rnn_backward(mode_, seq_, batch_, in_, hidden_, x.data(), w_ih.data(), w_hh.data(), gates_.data(),
+						 state_.data(), out_.data(), dh.data(), input_grad ? dx.data() : nullptr,
+						 w_ih_grad ? dw_ih.data() : nullptr, w_hh_grad ? dw_hh.data() : nullptr,
+						 b_ih_grad ? db_ih.data() : nullptr, b_hh_grad ? db_hh.data() : nullptr);
+	if(b_hh_grad) {
+		ConstExptr<Dtype>::make_uncontrol(db_hh);
+		bias_hh_.backward(db_hh);
+	}
+	if(b_ih_grad) {
+		ConstExptr<Dtype>::make_uncontrol(db_ih);
+		bias_ih_.backward(db_ih);
+	}
+	if(w_hh_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dw_hh);
+		weight_hh_.backward(dw_hh);
+	}
+	if(w_ih_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dw_ih);
+		this->roperand_.backward(dw_ih);
+	}
+	if(input_grad) {
+		ConstExptr<Dtype>::make_uncontrol(dx);
+		this->loperand_.backward(dx);
+	}
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
@@ -1,38 +1,76 @@
 #ifndef EXPRESSION_OPERATIONS_SIGMOID_H_
 #define EXPRESSION_OPERATIONS_SIGMOID_H_
 
-#include "base_ops.h"
 #include "../expression.h"
+#include "../dense.h"
+#include "../kernels/activation.h"
 
 namespace el {
 namespace op {
 
+// Computed eagerly with the vectorized sigmoid, and backward takes y * (1 - y) from the output
+// instead of evaluating the sigmoid again.
 template<typename Dtype>
 struct SigmoidExp: public UnaryExp<Dtype> {
-	explicit SigmoidExp(const Exp<Dtype>& operand): UnaryExp<Dtype>(operand) {}
-	explicit SigmoidExp(const Exp<Dtype>* operand): UnaryExp<Dtype>(operand) {}
-	Dtype eval(index_t* ids) const {return 1 / (1+std::exp(-this->operand_->eval(ids)));}
-	
-	struct GradExp: public UnaryExp<Dtype> {
-		explicit GradExp(const Exp<Dtype>& operand): UnaryExp<Dtype>(operand) {}
-		Dtype eval(index_t* ids) const {
-			Dtype value = this->operand_->eval(ids);
-			return value * (1 - value);
-		}
-		void backward(const Exp<Dtype>& grad) const {
-			THROW_ERROR(NotImplementError, "Not Implement backward for sigmoid's grad  helper.");
-		}
-	};
-
-	void backward(const Exp<Dtype>& grad) const {
-		GradExp sigmoid_grad(*this);
-		MulExp<Dtype> fgrad(sigmoid_grad, grad);
-		ConstExptr<Dtype>::make_uncontrol(sigmoid_grad);
-		ConstExptr<Dtype>::make_uncontrol(fgrad);
-		this->operand_.backward(fgrad);
-	}
+	explicit SigmoidExp(const Exp<Dtype>& operand);
+	explicit SigmoidExp(const Exp<Dtype>* operand);
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	Tensor<Dtype> out_;
+
+	void forward(void);
 };
 
+template<typename Dtype>
+SigmoidExp<Dtype>::SigmoidExp(const Exp<Dtype>& operand)
+	: UnaryExp<Dtype>(operand), out_(Shape(operand), operand.layout()) {
+	forward();
+}
+
+template<typename Dtype>
+SigmoidExp<Dtype>::SigmoidExp(const Exp<Dtype>* operand)
+	: UnaryExp<Dtype>(operand), out_(Shape(*operand), operand->layout()) {
+	forward();
+}
+
+template<typename Dtype>
+void SigmoidExp<Dtype>::forward(void) {
+	Dense<Dtype> x(*this->operand_, out_.layout());
+	Dtype* y = out_.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		kernel::activation_forward(kernel::Activation::Sigmoid, x.data() + begin, y + begin, end - begin);
+	});
+}
+
+template<typename Dtype>
+inline const Dtype* SigmoidExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout SigmoidExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* SigmoidExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype SigmoidExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void SigmoidExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad, out_.layout());
+	Tensor<Dtype> operand_grad(Shape(*this->operand_), out_.layout());
+	Dtype* dx = operand_grad.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		kernel::activation_backward(kernel::Activation::Sigmoid, out_.layout_data() + begin, dy.data() + begin,
+									dx + begin, end - begin);
+	});
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
 }  // namespace op
 }  // namespace el
 
@@ -0,0 +1,76 @@
+#ifndef EXPRESSION_OPERATIONS_TANH_H_
+#define EXPRESSION_OPERATIONS_TANH_H_
+
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/activation.h"
+
+namespace el {
+namespace op {
+
+// Computed eagerly with the vectorized tanh, and backward takes 1 - y^2 from the output.
+template<typename Dtype>
+struct TanhExp: public UnaryExp<Dtype> {
+	explicit TanhExp(const Exp<Dtype>& operand);
+	explicit TanhExp(const Exp<Dtype>* operand);
+	const Dtype* data(void) const;
+	Layout layout(void) const;
+	const Dtype* layout_data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+private:
+	Tensor<Dtype> out_;
+
+	void forward(void);
+};
+
+template<typename Dtype>
+TanhExp<Dtype>::TanhExp(const Exp<Dtype>& operand)
+	: UnaryExp<Dtype>(operand), out_(Shape(operand), operand.layout()) {
+	forward();
+}
+
+template<typename Dtype>
+TanhExp<Dtype>::TanhExp(const Exp<Dtype>* operand)
+	: UnaryExp<Dtype>(operand), out_(Shape(*operand), operand->layout()) {
+	forward();
+}
+
+template<typename Dtype>
+void TanhExp<Dtype>::forward(void) {
+	Dense<Dtype> x(*this->operand_, out_.layout());
+	Dtype* y = out_.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		kernel::activation_forward(kernel::Activation::Tanh, x.data() + begin, y + begin, end - begin);
+	});
+}
+
+template<typename Dtype>
+inline const Dtype* TanhExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Layout TanhExp<Dtype>::layout(void) const {return out_.layout();}
+
+template<typename Dtype>
+inline const Dtype* TanhExp<Dtype>::layout_data(void) const {return out_.layout_data();}
+
+template<typename Dtype>
+inline Dtype TanhExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void TanhExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad, out_.layout());
+	Tensor<Dtype> operand_grad(Shape(*this->operand_), out_.layout());
+	Dtype* dx = operand_grad.layout_data();
+	parallel_for(0, out_.layout_dsize(), 4096, [&](index_t begin, index_t end) {
+		kernel::activation_backward(kernel::Activation::Tanh, out_.layout_data() + begin, dy.data() + begin,
+									dx + begin, end - begin);
+	});
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
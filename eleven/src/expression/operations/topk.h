@@ -0,0 +1,107 @@
+#ifndef EXPRESSION_OPERATIONS_TOPK_H_
+#define EXPRESSION_OPERATIONS_TOPK_H_
+
+#include <vector>
+#include "../expression.h"
+#include "../dense.h"
+#include "../kernels/topk.h"
+
+namespace el {
+namespace op {
+
+// The k largest values along dim, in decreasing order (ties by lower index), so dim gets size k.
+// indices() holds where they came from, as values of Dtype like argmax. It's computed eagerly, by a
+// partial selection of each row (kernel::topk_axis). Backward routes the gradient of each value back
+// to its position, the rest of the operand gets zeros.
+template<typename Dtype>
+struct TopKExp: public UnaryExp<Dtype> {
+public:
+	explicit TopKExp(const Exp<Dtype>& operand, index_t k, index_t dim);
+	explicit TopKExp(const Exp<Dtype>* operand, index_t k, index_t dim);
+	index_t dim(void) const;
+	index_t size(index_t idx) const;
+	const Dtype* data(void) const;
+	Dtype eval(index_t* ids) const;
+	void backward(const Exp<Dtype>& grad) const;
+	const Tensor<Dtype>& indices(void) const {return indices_;}
+private:
+	index_t k_, dim_;
+	index_t outer_, n_, inner_;
+	Tensor<Dtype> out_;
+	Tensor<Dtype> indices_;
+
+	static Shape make_shape(const Exp<Dtype>& operand, index_t k, index_t dim);
+	void forward(void);
+};
+
+template<typename Dtype>
+Shape TopKExp<Dtype>::make_shape(const Exp<Dtype>& operand, index_t k, index_t dim) {
+	std::vector<index_t> dims;
+	for(index_t i = 0; i < operand.dim(); i++)
+		dims.push_back(i == dim ? k : operand.size(i));
+	return Shape(dims.data(), dims.size());
+}
+
+template<typename Dtype>
+TopKExp<Dtype>::TopKExp(const Exp<Dtype>& operand, index_t k, index_t dim)
+	: UnaryExp<Dtype>(operand), k_(k), dim_(dim),
+	  out_(make_shape(operand, k, dim)), indices_(make_shape(operand, k, dim)) {
+	forward();
+}
+
+template<typename Dtype>
+TopKExp<Dtype>::TopKExp(const Exp<Dtype>* operand, index_t k, index_t dim)
+	: UnaryExp<Dtype>(operand), k_(k), dim_(dim),
+	  out_(make_shape(*operand, k, dim)), indices_(make_shape(*operand, k, dim)) {
+	forward();
+}
+
+template<typename Dtype>
+void TopKExp<Dtype>::forward(void) {
+	outer_ = 1;
+	inner_ = 1;
+	n_ = this->operand_->size(dim_);
+	for(index_t i = 0; i < dim_; i++)
+		outer_ *= this->operand_->size(i);
+	for(index_t i = dim_ + 1; i < this->operand_->dim(); i++)
+		inner_ *= this->operand_->size(i);
+	Dense<Dtype> x(*this->operand_);
+	kernel::topk_axis(outer_, n_, inner_, k_, x.data(), out_.data(), indices_.data());
+}
+
+template<typename Dtype>
+inline index_t TopKExp<Dtype>::dim(void) const {return out_.dim();}
+
+template<typename Dtype>
+inline index_t TopKExp<Dtype>::size(index_t idx) const {return out_.size(idx);}
+
+template<typename Dtype>
+inline const Dtype* TopKExp<Dtype>::data(void) const {return out_.data();}
+
+template<typename Dtype>
+inline Dtype TopKExp<Dtype>::eval(index_t* ids) const {return out_.eval(ids);}
+
+template<typename Dtype>
+void TopKExp<Dtype>::backward(const Exp<Dtype>& grad) const {
+	Dense<Dtype> dy(grad);
+	Tensor<Dtype> operand_grad(Shape(*this->operand_));
+	Dtype* dx = operand_grad.data();
+	const Dtype* index = indices_.data();
+	std::fill(dx, dx + outer_ * n_ * inner_, Dtype(0));
+	parallel_for(0, outer_ * inner_, std::max(1, 4096 / k_), [&](index_t begin, index_t end) {
+		for(index_t task = begin; task < end; task++) {
+			index_t o = task / inner_, i = task % inner_;
+			for(index_t r = 0; r < k_; r++) {
+				index_t out = (o * k_ + r) * inner_ + i;
+				dx[(o * n_ + (index_t)index[out]) * inner_ + i] += dy.data()[out];
+			}
+		}
+	});
+	ConstExptr<Dtype>::make_uncontrol(operand_grad);
+	this->operand_.backward(operand_grad);
+}
+
+}  // namespace op
+}  // namespace el
+
+#endif
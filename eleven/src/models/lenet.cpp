@@ -3,7 +3,7 @@
 namespace el {
 namespace models{
 
-LeNet::LeNet()
+LeNet::LeNet(bool fused, Layout layout, bool batch_norm)
 	: conv1(1, 3, 5, 1, 0),
 	  pool1(2),
 	  conv2(3, 6, 5, 1, 0),
@@ -11,17 +11,59 @@ LeNet::LeNet()
 	  fc1(96, 64),
 	  fc2(64, 64),
 	  fc3(64, 10),
-	  relu() {}
+	  relu(),
+	  bn1(3),
+	  bn2(6),
+	  bn3(64),
+	  bn4(64),
+	  fused_(fused),
+	  layout_(layout),
+	  batch_norm_(batch_norm),
+	  folded_(false) {}
+
+// The inference path has no batch norms, they must be folded into the layers.
+static bool check_folded(const LeNet& net) {
+	CHECK_TRUE(!net.has_batch_norm(), NotImplementError,
+		"LeNetInference needs the batch norms folded, call LeNet::fold_batch_norm() first");
+	return true;
+}
+
+// Convolutions and poolings keep the layout of their inputs, so activations are converted once at the
+// input, and back to NCHW before they are flattened.
+static Node<float_t> to_nchw(const Node<float_t>& x) {
+	if(x.get_exp().layout() == Layout::NCHW)
+		return x;
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(x.get_exp()), true);
+	*result = op::to_layout(x, Layout::NCHW);
+	return Node<float_t>(result);
+}
 
 Node<float_t> LeNet::forward(const Node<float_t>& inputs) {
 	index_t batch_size = inputs.size(0);
-	auto conv1_x = conv1.forward(inputs);  // b, 3, 24, 24
+	Node<float_t> x = layout_ == Layout::NCHW ? inputs : op::to_layout(inputs, layout_);
+	if(has_batch_norm()) {
+		auto pool1_x = pool1.forward(relu.forward(bn1.forward(conv1.forward(x))));  // b, 3, 12, 12
+		auto pool2_x = to_nchw(pool2.forward(relu.forward(bn2.forward(conv2.forward(pool1_x)))));  // b, 6, 4, 4
+		auto flatten = pool2_x.get_tensor().view_({batch_size, 96});
+		auto fc1_x = relu.forward(bn3.forward(fc1.forward(op::node(flatten))));  // b, 64
+		auto fc2_x = relu.forward(bn4.forward(fc2.forward(fc1_x)));  // b, 64
+		return fc3.forward(fc2_x);  // b, 10
+	}
+	if(fused_) {
+		auto pool1_x = pool1.forward(conv1.forward(x, kernel::Activation::ReLU));  // b, 3, 12, 12
+		auto pool2_x = to_nchw(pool2.forward(conv2.forward(pool1_x, kernel::Activation::ReLU)));  // b, 6, 4, 4
+		auto flatten = pool2_x.get_tensor().view_({batch_size, 96});
+		auto fc1_x = fc1.forward(op::node(flatten), kernel::Activation::ReLU);  // b, 64
+		auto fc2_x = fc2.forward(fc1_x, kernel::Activation::ReLU);  // b, 64
+		return fc3.forward(fc2_x, kernel::Activation::None);  // b, 10
+	}
+	auto conv1_x = conv1.forward(x);  // b, 3, 24, 24
 	auto relu1_x = relu.forward(conv1_x);
 	auto pool1_x = pool1.forward(relu1_x);  // b, 3, 12, 12
 
 	auto conv2_x = conv2.forward(pool1_x);  // b, 6, 8, 8
 	auto relu2_x = relu.forward(conv2_x);
-	auto pool2_x = pool2.forward(relu2_x);  // b, 6, 4, 4
+	auto pool2_x = to_nchw(pool2.forward(relu2_x));  // b, 6, 4, 4
 
 	auto flatten = pool2_x.get_tensor().view_({batch_size, 96});
 	auto fc1_x = fc1.forward(op::node(flatten));  // b, 64
@@ -34,6 +76,54 @@ Node<float_t> LeNet::forward(const Node<float_t>& inputs) {
 	return fc3_x;
 }
 
+LeNetInference::LeNetInference(const LeNet& net)
+	: check_(check_folded(net)),
+	  conv1_(net.conv1, 28, 28),
+	  pool1_(net.pool1, 3, 24, 24),
+	  conv2_(net.conv2, 12, 12),
+	  pool2_(net.pool2, 6, 8, 8),
+	  fc1_(net.fc1),
+	  fc2_(net.fc2),
+	  fc3_(net.fc3),
+	  conv1_y_(3 * 24 * 24), pool1_y_(3 * 12 * 12),
+	  conv2_y_(6 * 8 * 8), pool2_y_(96),
+	  fc1_y_(64), fc2_y_(64), fc3_y_(10) {}
+
+const float_t* LeNetInference::forward(const float_t* image) {
+	conv1_.forward(image, conv1_y_.data(), kernel::Activation::ReLU);  // 3, 24, 24
+	pool1_.forward(conv1_y_.data(), pool1_y_.data());  // 3, 12, 12
+	conv2_.forward(pool1_y_.data(), conv2_y_.data(), kernel::Activation::ReLU);  // 6, 8, 8
+	pool2_.forward(conv2_y_.data(), pool2_y_.data());  // 6, 4, 4, already the flattened 96
+	fc1_.forward(pool2_y_.data(), fc1_y_.data(), kernel::Activation::ReLU);
+	fc2_.forward(fc1_y_.data(), fc2_y_.data(), kernel::Activation::ReLU);
+	fc3_.forward(fc2_y_.data(), fc3_y_.data());
+	return fc3_y_.data();
+}
+
+void LeNet::train(bool mode) {
+	bn1.train(mode && !folded_);
+	bn2.train(mode && !folded_);
+	bn3.train(mode && !folded_);
+	bn4.train(mode && !folded_);
+}
+
+void LeNet::fold_batch_norm(void) {
+	if(!has_batch_norm())
+		return;
+	train(false);
+	nn::fold_batch_norm(conv1, bn1);
+	nn::fold_batch_norm(conv2, bn2);
+	nn::fold_batch_norm(fc1, bn3);
+	nn::fold_batch_norm(fc2, bn4);
+	folded_ = true;
+}
+
+void LeNet::prepare_inference(void) {
+	fc1.prepare_inference();
+	fc2.prepare_inference();
+	fc3.prepare_inference();
+}
+
 nn::NamedParamMap LeNet::parameters(void) {
 	nn::NamedParamMap params;
 	auto conv1_params = conv1.parameters("conv1");
@@ -46,6 +136,16 @@ nn::NamedParamMap LeNet::parameters(void) {
 	params.insert(fc2_params.begin(), fc2_params.end());
 	auto fc3_params = fc3.parameters("fc3");
 	params.insert(fc3_params.begin(), fc3_params.end());
+	if(has_batch_norm()) {
+		auto bn1_params = bn1.parameters("bn1");
+		params.insert(bn1_params.begin(), bn1_params.end());
+		auto bn2_params = bn2.parameters("bn2");
+		params.insert(bn2_params.begin(), bn2_params.end());
+		auto bn3_params = bn3.parameters("bn3");
+		params.insert(bn3_params.begin(), bn3_params.end());
+		auto bn4_params = bn4.parameters("bn4");
+		params.insert(bn4_params.begin(), bn4_params.end());
+	}
 	return params;
 }
 
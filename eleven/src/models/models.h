@@ -16,10 +16,52 @@ public:
 	nn::Linear fc2;
 	nn::Linear fc3;
 	nn::ReLU relu;
+	nn::BatchNorm2d bn1;
+	nn::BatchNorm2d bn2;
+	nn::BatchNorm1d bn3;
+	nn::BatchNorm1d bn4;
 
-	LeNet();
+	// With fused = true, bias and ReLU are applied inside the conv and linear kernels, instead of by
+	// separate ops. The results are the same. The convolutional part runs in the given layout. With
+	// batch_norm, every layer but the last is followed by a BatchNorm before its ReLU.
+	explicit LeNet(bool fused=false, Layout layout=Layout::NCHW, bool batch_norm=false);
 	Node<float_t> forward(const Node<float_t>& inputs);
 	nn::NamedParamMap parameters(void);
+	// Prepack the weights of the linear layers for serving, see nn::Linear::prepare_inference.
+	void prepare_inference(void);
+	// Training or eval mode of the batch norms.
+	void train(bool mode=true);
+	// Fold the running statistics of the batch norms into the layers before them and stop running
+	// them, see nn::fold_batch_norm. The net is in eval mode afterwards, for good.
+	void fold_batch_norm(void);
+	// Batch norms are run by forward, i.e. present and not folded.
+	bool has_batch_norm(void) const {return batch_norm_ && !folded_;}
+private:
+	bool fused_;
+	Layout layout_;
+	bool batch_norm_;
+	bool folded_;
+};
+
+// Latency path of a trained LeNet for one image at a time, see nn::inference. Its copies of the
+// weights follow the storage versions of the net's. Activations live in buffers allocated here, so
+// forward allocates nothing; one instance serves one thread.
+class LeNetInference {
+public:
+	explicit LeNetInference(const LeNet& net);
+	// image: (1, 28, 28). Returns the 10 logits, valid until the next call.
+	const float_t* forward(const float_t* image);
+private:
+	bool check_;
+	nn::inference::Conv2d conv1_;
+	nn::inference::MaxPool2D pool1_;
+	nn::inference::Conv2d conv2_;
+	nn::inference::MaxPool2D pool2_;
+	nn::inference::Linear fc1_;
+	nn::inference::Linear fc2_;
+	nn::inference::Linear fc3_;
+	std::vector<float_t> conv1_y_, pool1_y_, conv2_y_, pool2_y_;
+	std::vector<float_t> fc1_y_, fc2_y_, fc3_y_;
 };
 
 
@@ -30,9 +72,25 @@ public:
 	nn::Linear fc3;
 	nn::ReLU relu;
 
-	TripleLinear();
+	explicit TripleLinear(bool fused=false);
 	Node<float_t> forward(const Node<float_t>& inputs);
 	nn::NamedParamMap parameters(void);
+	void prepare_inference(void);
+private:
+	bool fused_;
+};
+
+// Latency path of a trained TripleLinear, three gemv with the ReLUs fused, see LeNetInference.
+class TripleLinearInference {
+public:
+	explicit TripleLinearInference(const TripleLinear& net);
+	// input: (784). Returns the 10 logits, valid until the next call.
+	const float_t* forward(const float_t* input);
+private:
+	nn::inference::Linear fc1_;
+	nn::inference::Linear fc2_;
+	nn::inference::Linear fc3_;
+	std::vector<float_t> fc1_y_, fc2_y_, fc3_y_;
 };
 
 }  // namespace models
@@ -5,13 +5,19 @@
 namespace el {
 namespace models {
 
-TripleLinear::TripleLinear()
+TripleLinear::TripleLinear(bool fused)
 	: fc1(784, 512),
 	  fc2(512, 512),
 	  fc3(512, 10),
-	  relu() {}
+	  relu(),
+	  fused_(fused) {}
 
 Node<float_t> TripleLinear::forward(const Node<float_t>& inputs) {
+	if(fused_) {
+		auto fc1_x = fc1.forward(inputs, kernel::Activation::ReLU);
+		auto fc2_x = fc2.forward(fc1_x, kernel::Activation::ReLU);
+		return fc3.forward(fc2_x, kernel::Activation::None);
+	}
 	auto fc1_x = fc1.forward(inputs);
 	auto relu1_x = relu.forward(fc1_x);
 	auto fc2_x = fc2.forward(relu1_x);
@@ -20,6 +26,23 @@ Node<float_t> TripleLinear::forward(const Node<float_t>& inputs) {
 	return fc3_x;
 }
 
+void TripleLinear::prepare_inference(void) {
+	fc1.prepare_inference();
+	fc2.prepare_inference();
+	fc3.prepare_inference();
+}
+
+TripleLinearInference::TripleLinearInference(const TripleLinear& net)
+	: fc1_(net.fc1), fc2_(net.fc2), fc3_(net.fc3),
+	  fc1_y_(512), fc2_y_(512), fc3_y_(10) {}
+
+const float_t* TripleLinearInference::forward(const float_t* input) {
+	fc1_.forward(input, fc1_y_.data(), kernel::Activation::ReLU);
+	fc2_.forward(fc1_y_.data(), fc2_y_.data(), kernel::Activation::ReLU);
+	fc3_.forward(fc2_y_.data(), fc3_y_.data());
+	return fc3_y_.data();
+}
+
 nn::NamedParamMap TripleLinear::parameters(void) {
 	nn::NamedParamMap params;
 	auto fc1_params = fc1.parameters("fc1");
@@ -0,0 +1,32 @@
+#include "activation.h"
+
+
+namespace el {
+namespace nn {
+
+static Node<float_t> materialize(const Node<float_t>& node) {
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(node.get_exp()), node.get_exp().layout(), true);
+	*result = node;
+	return Node<float_t>(result);
+}
+
+Node<float_t> Sigmoid::forward(const Node<float_t>& inputs) {
+	return materialize(op::sigmoid(inputs));
+}
+
+Node<float_t> Tanh::forward(const Node<float_t>& inputs) {
+	return materialize(op::tanh(inputs));
+}
+
+Node<float_t> GELU::forward(const Node<float_t>& inputs) {
+	return materialize(op::gelu(inputs));
+}
+
+LeakyReLU::LeakyReLU(float_t negative_slope): negative_slope_(negative_slope) {}
+
+Node<float_t> LeakyReLU::forward(const Node<float_t>& inputs) {
+	return materialize(op::leaky_relu(inputs, negative_slope_));
+}
+
+}  // namespace nn
+}  // namespace el
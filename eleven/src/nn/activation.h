@@ -0,0 +1,35 @@
+#ifndef NN_ACTIVATION_H_
+#define NN_ACTIVATION_H_
+
+#include "nn.h"
+
+namespace el {
+namespace nn{
+
+class Sigmoid {
+public:
+	Node<float_t> forward(const Node<float_t>& inputs);
+};
+
+class Tanh {
+public:
+	Node<float_t> forward(const Node<float_t>& inputs);
+};
+
+class GELU {
+public:
+	Node<float_t> forward(const Node<float_t>& inputs);
+};
+
+class LeakyReLU {
+public:
+	explicit LeakyReLU(float_t negative_slope=0.01);
+	Node<float_t> forward(const Node<float_t>& inputs);
+private:
+	float_t negative_slope_;
+};
+
+}  // namespace nn
+}  // namespace el
+
+#endif
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <chrono>
 #include "conv.h"
 #include "init.h"
 
@@ -9,14 +10,18 @@ Conv2d::Conv2d(index_t in_features,
 			   index_t out_features, 
 			   const std::pair<index_t, index_t>& kernel_size,
        	 const std::pair<index_t, index_t>& stride, 
-       	 const std::pair<index_t, index_t>& padding)
+       	 const std::pair<index_t, index_t>& padding,
+       	 index_t groups)
     : in_features_(in_features), 
       out_features_(out_features), 
+      groups_(groups),
       kernel_size_(kernel_size),
       stride_(stride), 
       padding_(padding), 
-      weight_(new Tensor<float_t>(Shape{1, out_features, in_features*kernel_size.first*kernel_size.second}, true)),
-      bias_(new Tensor<float_t>(Shape{1, out_features, 1}, true)) {
+      weight_(new Tensor<float_t>(Shape{1, out_features, in_features/groups*kernel_size.first*kernel_size.second}, true)),
+      bias_(new Tensor<float_t>(Shape{1, out_features, 1, 1}, true)),
+      algo_(kernel::ConvAlgo::Auto),
+      last_algo_(kernel::ConvAlgo::Auto) {
     reset_parameters();
 }
 
@@ -24,15 +29,17 @@ Conv2d::Conv2d(index_t in_features,
 	           index_t out_features, 
 	           index_t kernel_size,
                index_t stride, 
-               index_t padding)
+               index_t padding,
+               index_t groups)
     : Conv2d(in_features, 
     		 out_features, 
     		 {kernel_size, kernel_size}, 
     		 {stride, stride}, 
-    		 {padding, padding}) {}
+    		 {padding, padding},
+    		 groups) {}
 
 void Conv2d::reset_parameters(void) {
-    float_t fan_in = in_features_ * kernel_size_.first * kernel_size_.second;
+    float_t fan_in = in_features_ / groups_ * kernel_size_.first * kernel_size_.second;
     float_t gain = std::sqrt(2);
     float_t sigma = gain / std::sqrt(fan_in);
     float_t bound_w = std::sqrt(3.0) * sigma;
@@ -43,15 +50,79 @@ void Conv2d::reset_parameters(void) {
 }
 
 Node<float_t> Conv2d::forward(const Node<float_t>& imgs) {
-    auto col_node = op::img2col(imgs, kernel_size_, stride_, padding_);
-    auto col_exp = col_node.get<op::Img2ColExp>();
-    auto conv_node = op::bmm(weight_, col_node) + bias_;
-    Tensor<float_t>* result = new Tensor<float_t>(Shape(conv_node.get_exp()), true);
+    kernel::ConvAlgo algo = algo_;
+    if(algo == kernel::ConvAlgo::Measure && imgs.get_exp().layout() == Layout::NCHW)
+        algo = measure_algorithm(imgs);
+    auto conv = op::conv2d(imgs, weight_, kernel_size_, stride_, padding_, algo, groups_);
+    last_algo_ = conv.get<op::Conv2DExp>().algo();
+    auto conv_node = conv + bias_;
+    // The sum is evaluated lazily, so keep the layout of the convolution for the result.
+    Tensor<float_t>* result = new Tensor<float_t>(Shape(conv_node.get_exp()), conv.get_exp().layout(), true);
     *result = conv_node;
     // The result tensor would be maintained by another tensor's next_exp_ which is ConstExptr.
     // So don't worry. It'll be deconstructed at a proper time.
-    return Node<float_t>(
-        result->view_({imgs.size(0), out_features_, col_exp.out_size(0), col_exp.out_size(1)}));
+    return Node<float_t>(result);
+}
+
+Node<float_t> Conv2d::forward(const Node<float_t>& imgs, kernel::Activation act) {
+    kernel::ConvAlgo algo = algo_;
+    if(algo == kernel::ConvAlgo::Measure && imgs.get_exp().layout() == Layout::NCHW)
+        algo = measure_algorithm(imgs);
+    auto conv_node = op::conv2d(imgs, weight_, bias_, kernel_size_, stride_, padding_, act, algo, groups_);
+    last_algo_ = conv_node.get<op::Conv2DExp>().algo();
+    Tensor<float_t>* result = new Tensor<float_t>(Shape(conv_node.get_exp()), conv_node.get_exp().layout(), true);
+    *result = conv_node;
+    return Node<float_t>(result);
+}
+
+void Conv2d::set_algorithm(kernel::ConvAlgo algo) {
+    algo_ = algo;
+    measured_algo_.clear();
+}
+
+kernel::ConvAlgo Conv2d::algorithm(void) const {return last_algo_;}
+
+kernel::ConvParam Conv2d::param(index_t batch, index_t in_h, index_t in_w) const {
+    return kernel::ConvParam(batch, in_features_, in_h, in_w, out_features_,
+                             kernel_size_, stride_, padding_, groups_);
+}
+
+// Time the forward kernel of every supported algorithm on this input, and remember the fastest one
+// for this shape. Each one runs once untimed first, so none pays for the first touch of y or of
+// its workspace, then the best of a few timed runs counts. Only forward is timed, backward just
+// follows the choice.
+kernel::ConvAlgo Conv2d::measure_algorithm(const Node<float_t>& imgs) {
+    const int runs = 3;
+    kernel::ConvParam param = this->param(imgs.size(0), imgs.size(2), imgs.size(3));
+    auto found = measured_algo_.find(param);
+    if(found != measured_algo_.end())
+        return found->second;
+
+    const kernel::ConvAlgo candidates[] = {
+        kernel::ConvAlgo::Im2Col, kernel::ConvAlgo::Direct, kernel::ConvAlgo::Gemm1x1,
+        kernel::ConvAlgo::Winograd2x2, kernel::ConvAlgo::Winograd4x4, kernel::ConvAlgo::Depthwise};
+    Dense<float_t> x(imgs.get_exp());
+    Dense<float_t> w(weight_.get_exp());
+    Tensor<float_t> y(Shape{param.batch, param.out_c, param.out_h, param.out_w});
+
+    kernel::ConvAlgo best = kernel::select_conv_algo(param);
+    double best_time = -1;
+    for(auto algo: candidates) {
+        if(!kernel::conv_algo_supported(algo, param))
+            continue;
+        kernel::conv2d_forward(algo, param, x.data(), w.data(), y.data());
+        for(int i = 0; i < runs; i++) {
+            auto start = std::chrono::steady_clock::now();
+            kernel::conv2d_forward(algo, param, x.data(), w.data(), y.data());
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if(best_time < 0 || elapsed.count() < best_time) {
+                best_time = elapsed.count();
+                best = algo;
+            }
+        }
+    }
+    measured_algo_[param] = best;
+    return best;
 }
 
 NamedParamMap Conv2d::parameters(const std::string& name) {
@@ -60,5 +131,29 @@ NamedParamMap Conv2d::parameters(const std::string& name) {
                 {name + "_bias", bias_}};
 }
 
+DepthwiseSeparableConv2d::DepthwiseSeparableConv2d(index_t in_features, 
+                                                   index_t out_features, 
+                                                   index_t kernel_size,
+                                                   index_t stride, 
+                                                   index_t padding)
+    : depthwise_(in_features, in_features, kernel_size, stride, padding, in_features),
+      pointwise_(in_features, out_features, 1, 1, 0) {}
+
+Node<float_t> DepthwiseSeparableConv2d::forward(const Node<float_t>& imgs, kernel::Activation act) {
+    return pointwise_.forward(depthwise_.forward(imgs, act), act);
+}
+
+NamedParamMap DepthwiseSeparableConv2d::parameters(const std::string& name) {
+    NamedParamMap params = depthwise_.parameters(name + "_depthwise");
+    auto pointwise_params = pointwise_.parameters(name + "_pointwise");
+    params.insert(pointwise_params.begin(), pointwise_params.end());
+    return params;
+}
+
+void DepthwiseSeparableConv2d::reset_parameters(void) {
+    depthwise_.reset_parameters();
+    pointwise_.reset_parameters();
+}
+
 } // namespace nn
 } // namespace el
\ No newline at end of file
@@ -6,6 +6,8 @@
 namespace el {
 namespace nn {
 
+// With groups > 1, channels are split into groups convolved independently, and the weight is
+// (1, out_features, in_features/groups*kh*kw). groups == in_features is a depthwise convolution.
 class Conv2d {
 public:
     Node<float_t> weight_;
@@ -15,23 +17,62 @@ public:
            index_t out_features, 
            const std::pair<index_t, index_t>& kernel_size,
            const std::pair<index_t, index_t>& stride, 
-           const std::pair<index_t, index_t>& padding);
+           const std::pair<index_t, index_t>& padding,
+           index_t groups = 1);
 
     Conv2d(index_t in_features, 
            index_t out_features, 
            index_t kernel_size,
            index_t stride, 
-           index_t padding);
+           index_t padding,
+           index_t groups = 1);
 
     Node<float_t> forward(const Node<float_t>& imgs);
+    // Bias and activation are applied by the convolution kernel itself, instead of by separate ops.
+    Node<float_t> forward(const Node<float_t>& imgs, kernel::Activation act);
     NamedParamMap parameters(const std::string& name);
     void reset_parameters(void);
 
+    // Force an algorithm (for benchmarking), or let the layer choose one by a heuristic (Auto),
+    // or by timing all supported algorithms on the first input of each shape, batch size included,
+    // since the fastest one depends on it too (Measure).
+    // Images in other layouts than NCHW always use the channels-last GEMM, see op::Conv2DExp.
+    void set_algorithm(kernel::ConvAlgo algo);
+    // Algorithm used for the last forward.
+    kernel::ConvAlgo algorithm(void) const;
+    // Shape of the convolution of batch images of in_h x in_w.
+    kernel::ConvParam param(index_t batch, index_t in_h, index_t in_w) const;
+
 private:
     index_t in_features_, out_features_;
+    index_t groups_;
     std::pair<index_t, index_t> kernel_size_;
     std::pair<index_t, index_t> stride_;
     std::pair<index_t, index_t> padding_;
+    kernel::ConvAlgo algo_;
+    kernel::ConvAlgo last_algo_;
+    std::map<kernel::ConvParam, kernel::ConvAlgo> measured_algo_;
+
+    kernel::ConvAlgo measure_algorithm(const Node<float_t>& imgs);
+};
+
+// A depthwise kxk convolution followed by a pointwise 1x1 convolution, the block of MobileNet-style
+// networks. It costs about 1/out_features + 1/(k*k) of the FLOPs of a dense kxk convolution.
+class DepthwiseSeparableConv2d {
+public:
+    Conv2d depthwise_;
+    Conv2d pointwise_;
+
+    DepthwiseSeparableConv2d(index_t in_features, 
+                             index_t out_features, 
+                             index_t kernel_size,
+                             index_t stride, 
+                             index_t padding);
+
+    // act follows both convolutions.
+    Node<float_t> forward(const Node<float_t>& imgs, kernel::Activation act=kernel::Activation::ReLU);
+    NamedParamMap parameters(const std::string& name);
+    void reset_parameters(void);
 };
 
 }  // namespace nn
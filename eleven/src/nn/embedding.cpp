@@ -0,0 +1,41 @@
+#include <cmath>
+#include "embedding.h"
+#include "init.h"
+
+namespace el {
+namespace nn {
+
+Embedding::Embedding(index_t num_embeddings, index_t embedding_dim, bool sparse)
+	: weight_(new Tensor<float_t>(Shape{num_embeddings, embedding_dim}, !sparse)),
+	  sparse_grad_(embedding_dim),
+	  sparse_(sparse) {
+	reset_parameters();
+}
+
+Node<float_t> Embedding::forward(const Node<int_t>& ids) {
+	auto embedding_node = op::embedding(weight_, ids, sparse_ ? &sparse_grad_ : nullptr);
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(embedding_node.get_exp()), true);
+	*result = embedding_node;
+	return Node<float_t>(result);
+}
+
+NamedParamMap Embedding::parameters(const std::string& name) {
+	if(sparse_)
+		return NamedParamMap();
+	return NamedParamMap{{name + "_weight", weight_}};
+}
+
+SparseParamMap Embedding::sparse_parameters(const std::string& name) {
+	if(!sparse_)
+		return SparseParamMap();
+	return SparseParamMap{{name + "_weight", SparseParam{&weight_, &sparse_grad_}}};
+}
+
+// Unit variance, like the N(0, 1) of PyTorch.
+void Embedding::reset_parameters(void) {
+	nn::init::uniform_init(weight_, -std::sqrt(3.0), std::sqrt(3.0));
+	sparse_grad_.clear();
+}
+
+}  // namespace nn
+}  // namespace el
@@ -0,0 +1,33 @@
+#ifndef NN_EMBEDDING_H_
+#define NN_EMBEDDING_H_
+
+#include "nn.h"
+
+namespace el {
+namespace nn {
+
+// A table of num_embeddings rows of embedding_dim values, forward picks the rows of the given ids,
+// see op::embedding. With sparse = true, the table has no dense gradient: backward collects the
+// rows it touched in sparse_grad_, and the table is handed to the optimizer by sparse_parameters()
+// instead of parameters(), so zero_grad and step only touch those rows.
+class Embedding {
+public:
+	Node<float_t> weight_;
+	kernel::SparseRows<float_t> sparse_grad_;
+
+	Embedding(index_t num_embeddings, index_t embedding_dim, bool sparse=false);
+	// ids of any shape ==> ids' shape + (embedding_dim)
+	Node<float_t> forward(const Node<int_t>& ids);
+	NamedParamMap parameters(const std::string& name);
+	SparseParamMap sparse_parameters(const std::string& name);
+	void reset_parameters(void);
+	bool sparse(void) const {return sparse_;}
+
+private:
+	bool sparse_;
+};
+
+}  // namespace nn
+}  // namespace el
+
+#endif
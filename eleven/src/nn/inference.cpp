@@ -0,0 +1,86 @@
+#include "inference.h"
+
+namespace el {
+namespace nn {
+namespace inference {
+
+// Images up to this many pixels are convolved by the direct kernel.
+static const index_t kTinyImage = 32 * 32;
+
+// The copy is stale once the tensor's storage moved to another version.
+static bool stale(const Node<float_t>& node, index_t& version) {
+	index_t current = node.get_tensor().version();
+	if(current == version)
+		return false;
+	version = current;
+	return true;
+}
+
+// ******************** Linear ********************
+Linear::Linear(const nn::Linear& layer)
+	: weight_node_(layer.weight_), bias_node_(layer.bias_),
+	  weight_version_(-1), bias_version_(-1),
+	  in_features_(layer.weight_.size(2)), out_features_(layer.weight_.size(1)),
+	  weight_t_(in_features_ * out_features_), bias_(out_features_) {
+	refresh();
+}
+
+void Linear::refresh(void) {
+	if(stale(weight_node_, weight_version_)) {
+		Dense<float_t> w(weight_node_.get_exp());
+		for(index_t o = 0; o < out_features_; o++)
+			for(index_t i = 0; i < in_features_; i++)
+				weight_t_[i * out_features_ + o] = w.data()[o * in_features_ + i];
+	}
+	if(stale(bias_node_, bias_version_)) {
+		Dense<float_t> b(bias_node_.get_exp());
+		std::copy(b.data(), b.data() + out_features_, bias_.begin());
+	}
+}
+
+void Linear::forward(const float_t* x, float_t* y, kernel::Activation act) {
+	refresh();
+	kernel::gemv_t(in_features_, out_features_, x, weight_t_.data(), bias_.data(), act, y);
+}
+
+// ******************** Conv2d ********************
+Conv2d::Conv2d(const nn::Conv2d& layer, index_t in_h, index_t in_w)
+	: weight_node_(layer.weight_), bias_node_(layer.bias_),
+	  weight_version_(-1), bias_version_(-1),
+	  param_(layer.param(1, in_h, in_w)),
+	  weight_(param_.out_c * param_.col_rows()), bias_(param_.out_c) {
+	algo_ = param_.groups == 1 && param_.in_plane() <= kTinyImage ? kernel::ConvAlgo::Direct
+																	 : kernel::select_conv_algo(param_);
+	refresh();
+}
+
+void Conv2d::refresh(void) {
+	if(stale(weight_node_, weight_version_)) {
+		Dense<float_t> w(weight_node_.get_exp());
+		std::copy(w.data(), w.data() + weight_.size(), weight_.begin());
+	}
+	if(stale(bias_node_, bias_version_)) {
+		Dense<float_t> b(bias_node_.get_exp());
+		std::copy(b.data(), b.data() + bias_.size(), bias_.begin());
+	}
+}
+
+void Conv2d::forward(const float_t* x, float_t* y, kernel::Activation act) {
+	refresh();
+	kernel::conv2d_forward(algo_, param_, x, weight_.data(), y,
+						   kernel::BiasActEpilogue<float_t>(bias_.data(), nullptr, act));
+}
+
+// ******************** MaxPool2D ********************
+MaxPool2D::MaxPool2D(const nn::MaxPool2D& layer, index_t channels, index_t in_h, index_t in_w)
+	: param_(layer.param(1, channels, in_h, in_w)) {
+	argmax_.resize(param_.planes() * param_.out_plane());
+}
+
+void MaxPool2D::forward(const float_t* x, float_t* y) {
+	kernel::max_pool2d_forward(param_, x, y, argmax_.data());
+}
+
+}  // namespace inference
+}  // namespace nn
+}  // namespace el
@@ -0,0 +1,71 @@
+#ifndef NN_INFERENCE_H_
+#define NN_INFERENCE_H_
+
+#include <cstdint>
+#include <vector>
+#include "nn.h"
+
+namespace el {
+namespace nn {
+namespace inference {
+
+// Batch-1 forward of trained layers, for scoring one request at a time. They run the kernels on raw
+// buffers: no graph, no autograd metadata, no result tensors. The weights are copied in the form the
+// kernels want, and copied again by the next forward when the storage version of the layer's weight
+// or bias has changed. Nothing is allocated by forward otherwise, except by the convolutions of large
+// images, see Conv2d.
+
+// y = act(W x + b) by kernel::gemv_t, with W kept transposed.
+class Linear {
+public:
+	explicit Linear(const nn::Linear& layer);
+	// x: (in_features), y: (out_features).
+	void forward(const float_t* x, float_t* y, kernel::Activation act=kernel::Activation::None);
+	index_t in_features(void) const {return in_features_;}
+	index_t out_features(void) const {return out_features_;}
+private:
+	Node<float_t> weight_node_, bias_node_;
+	index_t weight_version_, bias_version_;
+	index_t in_features_, out_features_;
+	std::vector<float_t> weight_t_;
+	std::vector<float_t> bias_;
+
+	void refresh(void);
+};
+
+// Convolution of one image of a fixed size. Tiny images use the direct kernel, which needs no
+// workspace; im2col would copy the image kh*kw times for a GEMM of a single patch matrix. Larger or
+// grouped layers use the algorithm select_conv_algo picks.
+class Conv2d {
+public:
+	Conv2d(const nn::Conv2d& layer, index_t in_h, index_t in_w);
+	// x: (in_c, in_h, in_w), y: (out_c, out_h, out_w).
+	void forward(const float_t* x, float_t* y, kernel::Activation act=kernel::Activation::None);
+	const kernel::ConvParam& param(void) const {return param_;}
+private:
+	Node<float_t> weight_node_, bias_node_;
+	index_t weight_version_, bias_version_;
+	kernel::ConvParam param_;
+	kernel::ConvAlgo algo_;
+	std::vector<float_t> weight_;
+	std::vector<float_t> bias_;
+
+	void refresh(void);
+};
+
+// Max pooling of one image of a fixed size. Window offsets go to a buffer of the layer, nobody reads them.
+class MaxPool2D {
+public:
+	MaxPool2D(const nn::MaxPool2D& layer, index_t channels, index_t in_h, index_t in_w);
+	void forward(const float_t* x, float_t* y);
+	const kernel::PoolParam& param(void) const {return param_;}
+private:
+	kernel::PoolParam param_;
+	std::vector<int32_t> argmax_;
+};
+
+}  // namespace inference
+}  // namespace nn
+}  // namespace el
+
+#endif
@@ -15,6 +15,7 @@ void uniform_init(Node<float_t>& param, float_t a, float_t b) {
 	index_t dsize = tensor.size().dsize();
 	for(index_t i = 0; i < dsize; i++)
 		tensor.eval(i) = u(e);
+	tensor.version_forward();
 }
 
 void uniform_init(const NamedParamMap& params, float_t a, float_t b) {
@@ -27,6 +28,7 @@ void constant_init(Node<float_t>& param, float_t value) {
 	index_t dsize = tensor.size().dsize();
 	for(index_t i = 0; i < dsize; i++)
 		tensor.eval(i) = value;
+	tensor.version_forward();
 }
 
 void constant_init(const NamedParamMap& params, float_t value) {
@@ -5,19 +5,18 @@ namespace nn {
 
 Linear::Linear(index_t in_features, index_t out_features) 
 	: weight_(new Tensor<float_t>(Shape{1, out_features, in_features}, true)),
-	  bias_(new Tensor<float_t>(Shape{1, out_features, 1}, true)) {
+	  bias_(new Tensor<float_t>(Shape{1, out_features, 1}, true)),
+	  prepared_(false),
+	  packed_version_(-1) {
 	reset_parameters();
 }
 
-Node<float_t> Linear::forward(const Node<float_t>& input) {
-	// (batch, in) <unsqueeze> ==> (batch, in, 1)
-	// (1, out, in) <bmm> (batch, in, 1) ==> (batch, out, 1)
-	// (batch, out, 1) <+> (1, out, 1) ==> (batch, out, 1)
-	Node<float_t> unsqueeze_input(input.get_tensor().unsqueeze_(2));
-	auto linear_node = op::bmm(weight_, unsqueeze_input) + bias_;
-    Tensor<float_t>* result = new Tensor<float_t>(Shape(linear_node.get_exp()), true);
-    *result = linear_node;
-    return Node<float_t>(result->squeeze_());
+Node<float_t> Linear::forward(const Node<float_t>& input, kernel::Activation act) {
+	// (batch, in) <linear> (1, out, in), (1, out, 1) ==> (batch, out)
+	auto linear_node = op::linear(input, weight_, bias_, act, packed_weight());
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(linear_node.get_exp()), true);
+	*result = linear_node;
+	return Node<float_t>(result);
 }
 
 NamedParamMap Linear::parameters(const std::string& name) {
@@ -37,5 +36,23 @@ void Linear::reset_parameters(void) {
     nn::init::uniform_init(bias_, -bound_b, bound_b);
 }
 
+void Linear::prepare_inference(void) {
+    prepared_ = true;
+    packed_weight();
+}
+
+// weight^T is op(B) of the forward gemm, (in, out).
+const kernel::PackedMatrix<float_t>* Linear::packed_weight(void) {
+    if(!prepared_)
+        return nullptr;
+    index_t version = weight_.get_tensor().version();
+    if(version != packed_version_) {
+        Dense<float_t> w(weight_.get_exp());
+        packed_weight_.pack(false, true, weight_.size(1), weight_.size(2), w.data(), weight_.size(2));
+        packed_version_ = version;
+    }
+    return &packed_weight_;
+}
+
 }  // namespace nn
 }  // namespace el
\ No newline at end of file
@@ -12,9 +12,21 @@ public:
 	Node<float_t> bias_;
 
 	Linear(index_t in_features, index_t out_features);
-	Node<float_t> forward(const Node<float_t>& input);
+	// One (batch, in) x (in, out) gemm, with bias and activation applied in its epilogue.
+	Node<float_t> forward(const Node<float_t>& input, kernel::Activation act=kernel::Activation::None);
     NamedParamMap parameters(const std::string& name);
     void reset_parameters(void);
+    // Pack the weight once into the panels of that gemm, so forward stops packing it on every call.
+    // It's packed again when the weight's storage version changes, e.g. by an optimizer step. Writes
+    // which don't move the version (eval(), data()) aren't seen, except reset_parameters().
+    void prepare_inference(void);
+
+private:
+    bool prepared_;
+    index_t packed_version_;
+    kernel::PackedMatrix<float_t> packed_weight_;
+
+    const kernel::PackedMatrix<float_t>* packed_weight(void);
 };
 
 }  // namespace nn
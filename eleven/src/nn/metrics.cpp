@@ -0,0 +1,57 @@
+#include "metrics.h"
+
+namespace el {
+namespace nn {
+namespace metrics {
+
+ClassificationMetrics::ClassificationMetrics(index_t num_classes, index_t k)
+	: num_classes_(num_classes), k_(k), confusion_(num_classes * num_classes) {
+	reset();
+}
+
+void ClassificationMetrics::reset(void) {
+	count_ = top1_correct_ = topk_correct_ = 0;
+	std::fill(confusion_.begin(), confusion_.end(), 0);
+}
+
+void ClassificationMetrics::update(const Node<float_t>& logits, const Node<int_t>& labels) {
+	CHECK_EQUAL(logits.dim(), 2, DimNotMatch,
+		"Metrics expect logits:(batch, num_classes), but got %dD tensor", logits.dim());
+	CHECK_EQUAL(logits.size(1), num_classes_, OperandSizeNotMatch,
+		"Metrics expect %d classes, but got logits of %d classes", num_classes_, logits.size(1));
+	CHECK_TRUE(labels.dim() == 1 && labels.size(0) == logits.size(0), OperandSizeNotMatch,
+		"Metrics expect labels:(%d), but got %dD tensor with %d elements on dimension 0",
+		logits.size(0), labels.dim(), labels.size(0));
+	index_t batch = logits.size(0);
+	Dense<float_t> x(logits.get_exp());
+	Dense<int_t> y(labels.get_exp());
+	for(index_t i = 0; i < batch; i++)
+		CHECK_BETWEEN(y[i], 0, num_classes_, IndexOutOfRange,
+			"Label %d of sample %d is out of range [0, %d)", y[i], i, num_classes_);
+
+	predictions_.resize(batch);
+	ranks_.resize(batch);
+	kernel::label_rank_rows(batch, num_classes_, x.data(), y.data(), predictions_.data(), ranks_.data());
+	for(index_t i = 0; i < batch; i++) {
+		top1_correct_ += ranks_[i] == 0;
+		topk_correct_ += ranks_[i] < k_;
+		confusion_[y[i] * num_classes_ + predictions_[i]]++;
+	}
+	count_ += batch;
+}
+
+float_t ClassificationMetrics::top1(void) const {
+	return count_ == 0 ? 0 : (float_t)top1_correct_ / count_;
+}
+
+float_t ClassificationMetrics::topk(void) const {
+	return count_ == 0 ? 0 : (float_t)topk_correct_ / count_;
+}
+
+index_t ClassificationMetrics::confusion(index_t label, index_t prediction) const {
+	return confusion_[label * num_classes_ + prediction];
+}
+
+}  // namespace metrics
+}  // namespace nn
+}  // namespace el
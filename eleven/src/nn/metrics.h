@@ -0,0 +1,43 @@
+#ifndef NN_METRICS_H_
+#define NN_METRICS_H_
+
+#include <vector>
+#include "nn.h"
+
+namespace el {
+namespace nn {
+namespace metrics {
+
+// Top-1 and top-k accuracy and the confusion counts of a classifier, summed over batches. Each batch
+// of logits is read once: the label is among the top k iff fewer than k logits come before it
+// (see kernel::label_rank_rows), so no top-k list is built and any k costs the same.
+class ClassificationMetrics {
+public:
+	ClassificationMetrics(index_t num_classes, index_t k = 5);
+
+	// logits: (batch, num_classes), labels: (batch).
+	void update(const Node<float_t>& logits, const Node<int_t>& labels);
+	void reset(void);
+
+	index_t count(void) const {return count_;}
+	index_t top1_correct(void) const {return top1_correct_;}
+	index_t topk_correct(void) const {return topk_correct_;}
+	float_t top1(void) const;
+	float_t topk(void) const;
+	// Number of samples of class label predicted as class prediction.
+	index_t confusion(index_t label, index_t prediction) const;
+	// (num_classes, num_classes) row-major, rows are labels and columns are predictions.
+	const std::vector<index_t>& confusion_matrix(void) const {return confusion_;}
+
+private:
+	index_t num_classes_, k_;
+	index_t count_, top1_correct_, topk_correct_;
+	std::vector<index_t> confusion_;
+	std::vector<index_t> predictions_, ranks_;
+};
+
+}  // namespace metrics
+}  // namespace nn
+}  // namespace el
+
+#endif
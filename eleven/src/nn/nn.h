@@ -11,21 +11,51 @@ namespace nn {
 
 using NamedParamMap = std::map<std::string, Node<float_t>&>;
 
+// A parameter whose gradient is kept as sparse rows instead of its tensor's dense grad, see Embedding.
+struct SparseParam {
+	Node<float_t>* param;
+	kernel::SparseRows<float_t>* grad;
+};
+using SparseParamMap = std::map<std::string, SparseParam>;
+
+class BatchNorm;
+class BatchNorm1d;
+class BatchNorm2d;
+class LayerNorm;
+class RMSNorm;
 class Conv2d;
+class DepthwiseSeparableConv2d;
+class Embedding;
 class Linear;
+class RNNBase;
+class LSTM;
+class GRU;
 class CrossEntrpy;
 class ReLU;
+class Sigmoid;
+class Tanh;
+class GELU;
+class LeakyReLU;
 class MaxPool2D;
+class AvgPool2D;
+class AdaptiveAvgPool2D;
+class AdaptiveMaxPool2D;
 
 }  // namespace nn
 }  // namespace el
 #include "init.h"
 #include "optimizer.h"
 
+#include "activation.h"
 #include "conv.h"
 #include "cross_entropy.h"
+#include "embedding.h"
+#include "inference.h"
 #include "linear.h"
-#include "max_pool.h"
+#include "metrics.h"
+#include "norm.h"
+#include "pooling.h"
 #include "relu.h"
+#include "rnn.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include <cmath>
+#include "norm.h"
+#include "init.h"
+
+namespace el {
+namespace nn {
+
+// ******************** BatchNorm ********************
+BatchNorm::BatchNorm(index_t num_features, index_t input_dim, float_t eps, float_t momentum)
+	: weight_(new Tensor<float_t>(Shape{num_features}, true)),
+	  bias_(new Tensor<float_t>(Shape{num_features}, true)),
+	  running_mean_(Shape{num_features}),
+	  running_var_(Shape{num_features}),
+	  num_features_(num_features),
+	  input_dim_(input_dim),
+	  eps_(eps),
+	  momentum_(momentum),
+	  training_(true) {
+	reset_parameters();
+}
+
+Node<float_t> BatchNorm::forward(const Node<float_t>& inputs) {
+	CHECK_EQUAL(inputs.dim(), input_dim_, DimNotMatch,
+		"BatchNorm expect %dD input, but got %dD tensor", input_dim_, inputs.dim());
+	const Tensor<float_t>* mean = training_ ? nullptr : &running_mean_;
+	const Tensor<float_t>* var = training_ ? nullptr : &running_var_;
+	Node<float_t> norm = op::batch_norm(inputs, weight_, bias_, mean, var, eps_);
+	if(training_) {
+		const op::BatchNormExp<float_t>& exp = norm.get<op::BatchNormExp>();
+		index_t count = inputs.size(0);
+		for(index_t i = 2; i < inputs.dim(); i++)
+			count *= inputs.size(i);
+		float_t unbiased = count > 1 ? float_t(count) / (count - 1) : 1;
+		const float_t* batch_mean = exp.mean().data();
+		const float_t* batch_var = exp.var().data();
+		float_t* running_mean = running_mean_.data();
+		float_t* running_var = running_var_.data();
+		for(index_t c = 0; c < num_features_; c++) {
+			running_mean[c] = (1 - momentum_) * running_mean[c] + momentum_ * batch_mean[c];
+			running_var[c] = (1 - momentum_) * running_var[c] + momentum_ * batch_var[c] * unbiased;
+		}
+	}
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(norm.get_exp()), norm.get_exp().layout(), true);
+	*result = norm;
+	return Node<float_t>(result);
+}
+
+NamedParamMap BatchNorm::parameters(const std::string& name) {
+	return NamedParamMap{
+				{name + "_weight", weight_},
+				{name + "_bias", bias_}};
+}
+
+void BatchNorm::reset_parameters(void) {
+	nn::init::constant_init(weight_, 1);
+	nn::init::constant_init(bias_, 0);
+	reset_running_stats();
+}
+
+void BatchNorm::reset_running_stats(void) {
+	std::fill(running_mean_.data(), running_mean_.data() + num_features_, float_t(0));
+	std::fill(running_var_.data(), running_var_.data() + num_features_, float_t(1));
+}
+
+void BatchNorm::inference_affine(std::vector<float_t>& scale, std::vector<float_t>& shift) const {
+	Dense<float_t> weight(weight_.get_exp()), bias(bias_.get_exp());
+	scale.resize(num_features_);
+	shift.resize(num_features_);
+	for(index_t c = 0; c < num_features_; c++) {
+		scale[c] = weight.data()[c] / std::sqrt(running_var_.data()[c] + eps_);
+		shift[c] = bias.data()[c] - running_mean_.data()[c] * scale[c];
+	}
+}
+
+// ******************** LayerNorm ********************
+LayerNorm::LayerNorm(const Shape& normalized_shape, float_t eps)
+	: weight_(new Tensor<float_t>(normalized_shape, true)),
+	  bias_(new Tensor<float_t>(normalized_shape, true)),
+	  eps_(eps) {
+	reset_parameters();
+}
+
+Node<float_t> LayerNorm::forward(const Node<float_t>& inputs) {
+	Node<float_t> norm = op::layer_norm(inputs, weight_, bias_, eps_);
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(norm.get_exp()), true);
+	*result = norm;
+	return Node<float_t>(result);
+}
+
+NamedParamMap LayerNorm::parameters(const std::string& name) {
+	return NamedParamMap{
+				{name + "_weight", weight_},
+				{name + "_bias", bias_}};
+}
+
+void LayerNorm::reset_parameters(void) {
+	nn::init::constant_init(weight_, 1);
+	nn::init::constant_init(bias_, 0);
+}
+
+// ******************** RMSNorm ********************
+RMSNorm::RMSNorm(const Shape& normalized_shape, float_t eps)
+	: weight_(new Tensor<float_t>(normalized_shape, true)),
+	  eps_(eps) {
+	reset_parameters();
+}
+
+Node<float_t> RMSNorm::forward(const Node<float_t>& inputs) {
+	Node<float_t> norm = op::rms_norm(inputs, weight_, eps_);
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(norm.get_exp()), true);
+	*result = norm;
+	return Node<float_t>(result);
+}
+
+NamedParamMap RMSNorm::parameters(const std::string& name) {
+	return NamedParamMap{{name + "_weight", weight_}};
+}
+
+void RMSNorm::reset_parameters(void) {
+	nn::init::constant_init(weight_, 1);
+}
+
+// ******************** folding ********************
+// weight (1, out, row) and bias with out values, both replaced by assignment.
+static void fold_rows(Node<float_t>& weight, Node<float_t>& bias, const BatchNorm& bn) {
+	std::vector<float_t> scale, shift;
+	bn.inference_affine(scale, shift);
+	index_t out = weight.size(1), row = weight.size(2);
+	CHECK_EQUAL(out, bn.num_features(), OperandSizeNotMatch,
+		"Can't fold a BatchNorm of %d features into a layer of %d outputs", bn.num_features(), out);
+	Dense<float_t> w(weight.get_exp()), b(bias.get_exp());
+	Tensor<float_t> folded_weight(w.data(), Shape(weight.get_exp()));
+	Tensor<float_t> folded_bias(b.data(), Shape(bias.get_exp()));
+	for(index_t o = 0; o < out; o++) {
+		float_t* w_row = folded_weight.data() + o * row;
+		for(index_t i = 0; i < row; i++)
+			w_row[i] *= scale[o];
+		folded_bias.data()[o] = folded_bias.data()[o] * scale[o] + shift[o];
+	}
+	const_cast<Tensor<float_t>&>(weight.get_tensor()) = folded_weight;
+	const_cast<Tensor<float_t>&>(bias.get_tensor()) = folded_bias;
+}
+
+void fold_batch_norm(Conv2d& conv, const BatchNorm2d& bn) {
+	fold_rows(conv.weight_, conv.bias_, bn);
+}
+
+void fold_batch_norm(Linear& linear, const BatchNorm1d& bn) {
+	fold_rows(linear.weight_, linear.bias_, bn);
+}
+
+}  // namespace nn
+}  // namespace el
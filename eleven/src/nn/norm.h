@@ -0,0 +1,96 @@
+#ifndef NN_NORM_H_
+#define NN_NORM_H_
+
+#include <vector>
+#include "nn.h"
+
+namespace el {
+namespace nn {
+
+// Batch normalization, one mean and variance per channel (feature), see op::batch_norm. In training
+// mode a batch is normalized by its own statistics, which also update the running averages:
+// running = (1 - momentum) * running + momentum * batch statistic, with the unbiased variance. In eval
+// mode the running averages are used. BatchNorm1d takes (batch, features), BatchNorm2d (batch,
+// channels, h, w).
+class BatchNorm {
+public:
+	Node<float_t> weight_;
+	Node<float_t> bias_;
+	Tensor<float_t> running_mean_;
+	Tensor<float_t> running_var_;
+
+	Node<float_t> forward(const Node<float_t>& inputs);
+	NamedParamMap parameters(const std::string& name);
+	void reset_parameters(void);
+	void reset_running_stats(void);
+	void train(bool mode=true) {training_ = mode;}
+	void eval(void) {training_ = false;}
+	bool training(void) const {return training_;}
+	index_t num_features(void) const {return num_features_;}
+	// Eval mode as y = x * scale + shift per channel, what fold_batch_norm merges into a layer.
+	void inference_affine(std::vector<float_t>& scale, std::vector<float_t>& shift) const;
+
+protected:
+	BatchNorm(index_t num_features, index_t input_dim, float_t eps, float_t momentum);
+
+private:
+	index_t num_features_, input_dim_;
+	float_t eps_, momentum_;
+	bool training_;
+};
+
+class BatchNorm1d: public BatchNorm {
+public:
+	explicit BatchNorm1d(index_t num_features, float_t eps=1e-5, float_t momentum=0.1)
+		: BatchNorm(num_features, 2, eps, momentum) {}
+};
+
+class BatchNorm2d: public BatchNorm {
+public:
+	explicit BatchNorm2d(index_t num_features, float_t eps=1e-5, float_t momentum=0.1)
+		: BatchNorm(num_features, 4, eps, momentum) {}
+};
+
+// Layer normalization over the last dims of the input, given by normalized_shape, with a weight and
+// a bias of that shape, see op::layer_norm. E.g. LayerNorm(Shape{d}) normalizes every feature vector of
+// (batch, tokens, d). The same in training and eval.
+class LayerNorm {
+public:
+	Node<float_t> weight_;
+	Node<float_t> bias_;
+
+	explicit LayerNorm(const Shape& normalized_shape, float_t eps=1e-5);
+	Node<float_t> forward(const Node<float_t>& inputs);
+	NamedParamMap parameters(const std::string& name);
+	void reset_parameters(void);
+
+private:
+	float_t eps_;
+};
+
+// RMS normalization over the last dims of the input, scaled by a weight of normalized_shape and
+// without bias, see op::rms_norm.
+class RMSNorm {
+public:
+	Node<float_t> weight_;
+
+	explicit RMSNorm(const Shape& normalized_shape, float_t eps=1e-6);
+	Node<float_t> forward(const Node<float_t>& inputs);
+	NamedParamMap parameters(const std::string& name);
+	void reset_parameters(void);
+
+private:
+	float_t eps_;
+};
+
+// Merge the eval mode of bn into the layer right before it: weight row o and bias o are scaled by
+// scale[o], and shift[o] is added to the bias. The layer alone then gives what layer + bn gave with
+// the running statistics, so bn costs nothing at inference and must be skipped afterwards. The
+// weight and bias are assigned, so their storage versions move and prepacked copies are refreshed.
+void fold_batch_norm(Conv2d& conv, const BatchNorm2d& bn);
+void fold_batch_norm(Linear& linear, const BatchNorm1d& bn);
+
+}  // namespace nn
+}  // namespace el
+
+#endif
@@ -4,8 +4,9 @@ namespace el {
 namespace nn {
 namespace optim {
 
-SGD::SGD(NamedParamMap params, float_t lr)
+SGD::SGD(NamedParamMap params, float_t lr, SparseParamMap sparse_params)
 	: params_(params.begin(), params.end()),
+	  sparse_params_(sparse_params),
 	  lr_(lr) {}
 
 void SGD::zero_grad(void) {
@@ -13,6 +14,8 @@ void SGD::zero_grad(void) {
 		auto grad = param.second.get_tensor().grad();
 		grad = ConstantExp<float_t>(0, grad.dim());
 	}
+	for(auto param: sparse_params_)
+		param.second.grad->clear();
 }
 
 void SGD::step(void) {
@@ -20,6 +23,12 @@ void SGD::step(void) {
 		auto tensor = const_cast<Tensor<float_t>&>(param.second.get_tensor());
 		tensor += ConstantExp<float_t>(-lr_, tensor.dim()) * tensor.grad();
 	}
+	// Written through data(), so the version is moved by hand, like the dense += above does.
+	for(auto param: sparse_params_) {
+		auto& tensor = const_cast<Tensor<float_t>&>(param.second.param->get_tensor());
+		kernel::sparse_rows_axpy(-lr_, *param.second.grad, tensor.data());
+		tensor.version_forward();
+	}
 }
 
 
@@ -11,8 +11,10 @@ class SGD {
 public:
 	float_t lr_;
 	NamedParamMap params_;
+	SparseParamMap sparse_params_;
 
-	SGD(NamedParamMap params, float_t lr);
+	// Sparse parameters are updated on the rows of their gradient only, and zero_grad just drops them.
+	SGD(NamedParamMap params, float_t lr, SparseParamMap sparse_params=SparseParamMap());
 	void zero_grad(void);
 	void step(void);
 
@@ -0,0 +1,79 @@
+#include "pooling.h"
+
+namespace el {
+namespace nn {
+
+// Pooling layers have no parameters, they only keep the window settings and materialize the output.
+static Node<float_t> materialize(const Node<float_t>& pooling) {
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(pooling.get_exp()), pooling.get_exp().layout(), true);
+	*result = pooling;
+	return Node<float_t>(result);
+}
+
+// ******************** MaxPool2D ********************
+MaxPool2D::MaxPool2D(const std::pair<index_t, index_t>& kernel_size,
+					 const std::pair<index_t, index_t>& stride,
+					 const std::pair<index_t, index_t>& padding,
+					 bool ceil_mode)
+	: kernel_size_(kernel_size), stride_(stride), padding_(padding), ceil_mode_(ceil_mode) {}
+
+MaxPool2D::MaxPool2D(const std::pair<index_t, index_t>& kernel_size) 
+	: MaxPool2D(kernel_size, kernel_size, {0, 0}) {}
+
+MaxPool2D::MaxPool2D(index_t kernel_size) 
+	: MaxPool2D({kernel_size, kernel_size}) {}
+
+MaxPool2D::MaxPool2D(index_t kernel_size, index_t stride, index_t padding, bool ceil_mode)
+	: MaxPool2D({kernel_size, kernel_size}, {stride, stride}, {padding, padding}, ceil_mode) {}
+
+Node<float_t> MaxPool2D::forward(const Node<float_t>& inputs) {
+	return materialize(op::pool2d(inputs, kernel::PoolMode::Max, kernel_size_, stride_, padding_, ceil_mode_));
+}
+
+kernel::PoolParam MaxPool2D::param(index_t batch, index_t channels, index_t in_h, index_t in_w) const {
+	return kernel::PoolParam(batch, channels, in_h, in_w, kernel_size_, stride_, padding_, ceil_mode_);
+}
+
+// ******************** AvgPool2D ********************
+AvgPool2D::AvgPool2D(const std::pair<index_t, index_t>& kernel_size,
+					 const std::pair<index_t, index_t>& stride,
+					 const std::pair<index_t, index_t>& padding,
+					 bool ceil_mode)
+	: kernel_size_(kernel_size), stride_(stride), padding_(padding), ceil_mode_(ceil_mode) {}
+
+AvgPool2D::AvgPool2D(const std::pair<index_t, index_t>& kernel_size) 
+	: AvgPool2D(kernel_size, kernel_size, {0, 0}) {}
+
+AvgPool2D::AvgPool2D(index_t kernel_size) 
+	: AvgPool2D({kernel_size, kernel_size}) {}
+
+AvgPool2D::AvgPool2D(index_t kernel_size, index_t stride, index_t padding, bool ceil_mode)
+	: AvgPool2D({kernel_size, kernel_size}, {stride, stride}, {padding, padding}, ceil_mode) {}
+
+Node<float_t> AvgPool2D::forward(const Node<float_t>& inputs) {
+	return materialize(op::pool2d(inputs, kernel::PoolMode::Avg, kernel_size_, stride_, padding_, ceil_mode_));
+}
+
+// ******************** adaptive pooling ********************
+AdaptiveAvgPool2D::AdaptiveAvgPool2D(const std::pair<index_t, index_t>& output_size)
+	: output_size_(output_size) {}
+
+AdaptiveAvgPool2D::AdaptiveAvgPool2D(index_t output_size)
+	: output_size_({output_size, output_size}) {}
+
+Node<float_t> AdaptiveAvgPool2D::forward(const Node<float_t>& inputs) {
+	return materialize(op::adaptive_pool2d(inputs, kernel::PoolMode::Avg, output_size_));
+}
+
+AdaptiveMaxPool2D::AdaptiveMaxPool2D(const std::pair<index_t, index_t>& output_size)
+	: output_size_(output_size) {}
+
+AdaptiveMaxPool2D::AdaptiveMaxPool2D(index_t output_size)
+	: output_size_({output_size, output_size}) {}
+
+Node<float_t> AdaptiveMaxPool2D::forward(const Node<float_t>& inputs) {
+	return materialize(op::adaptive_pool2d(inputs, kernel::PoolMode::Max, output_size_));
+}
+
+}  // namespace nn
+}  // namespace el
@@ -0,0 +1,69 @@
+#ifndef NN_POOLING_H_
+#define NN_POOLING_H_
+
+#include "nn.h"
+
+namespace el {
+namespace nn {
+
+// Stride defaults to the kernel size, so MaxPool2D(2) pools non-overlapping 2x2 windows.
+class MaxPool2D {
+public:
+	MaxPool2D(index_t kernel_size);
+	MaxPool2D(const std::pair<index_t, index_t>& kernel_size);
+	MaxPool2D(const std::pair<index_t, index_t>& kernel_size,
+			  const std::pair<index_t, index_t>& stride,
+			  const std::pair<index_t, index_t>& padding,
+			  bool ceil_mode=false);
+	MaxPool2D(index_t kernel_size, index_t stride, index_t padding, bool ceil_mode=false);
+	Node<float_t> forward(const Node<float_t>& inputs);
+	// Shape of the pooling of batch images of channels x in_h x in_w.
+	kernel::PoolParam param(index_t batch, index_t channels, index_t in_h, index_t in_w) const;
+private:
+	std::pair<index_t, index_t> kernel_size_;
+	std::pair<index_t, index_t> stride_;
+	std::pair<index_t, index_t> padding_;
+	bool ceil_mode_;
+};
+
+// Padded pixels aren't counted in the average.
+class AvgPool2D {
+public:
+	AvgPool2D(index_t kernel_size);
+	AvgPool2D(const std::pair<index_t, index_t>& kernel_size);
+	AvgPool2D(const std::pair<index_t, index_t>& kernel_size,
+			  const std::pair<index_t, index_t>& stride,
+			  const std::pair<index_t, index_t>& padding,
+			  bool ceil_mode=false);
+	AvgPool2D(index_t kernel_size, index_t stride, index_t padding, bool ceil_mode=false);
+	Node<float_t> forward(const Node<float_t>& inputs);
+private:
+	std::pair<index_t, index_t> kernel_size_;
+	std::pair<index_t, index_t> stride_;
+	std::pair<index_t, index_t> padding_;
+	bool ceil_mode_;
+};
+
+// Pool any image to a fixed output size. AdaptiveAvgPool2D(1) is global average pooling.
+class AdaptiveAvgPool2D {
+public:
+	AdaptiveAvgPool2D(index_t output_size);
+	AdaptiveAvgPool2D(const std::pair<index_t, index_t>& output_size);
+	Node<float_t> forward(const Node<float_t>& inputs);
+private:
+	std::pair<index_t, index_t> output_size_;
+};
+
+class AdaptiveMaxPool2D {
+public:
+	AdaptiveMaxPool2D(index_t output_size);
+	AdaptiveMaxPool2D(const std::pair<index_t, index_t>& output_size);
+	Node<float_t> forward(const Node<float_t>& inputs);
+private:
+	std::pair<index_t, index_t> output_size_;
+};
+
+}
+}
+
+#endif
@@ -6,7 +6,7 @@ namespace nn {
 
 Node<float_t> ReLU::forward(const Node<float_t>& inputs) {
 	auto relu = op::relu(inputs);
-	Tensor<float_t>* result = new Tensor<float_t>(Shape(relu.get_exp()), true);
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(relu.get_exp()), inputs.get_exp().layout(), true);
 	*result = relu;
 	return Node<float_t>(result);
 }
@@ -0,0 +1,42 @@
+#include <cmath>
+#include "rnn.h"
+#include "init.h"
+
+namespace el {
+namespace nn {
+
+RNNBase::RNNBase(kernel::RNNMode mode, index_t input_size, index_t hidden_size)
+	: weight_ih_(new Tensor<float_t>(Shape{kernel::rnn_gates(mode) * hidden_size, input_size}, true)),
+	  weight_hh_(new Tensor<float_t>(Shape{kernel::rnn_gates(mode) * hidden_size, hidden_size}, true)),
+	  bias_ih_(new Tensor<float_t>(Shape{kernel::rnn_gates(mode) * hidden_size}, true)),
+	  bias_hh_(new Tensor<float_t>(Shape{kernel::rnn_gates(mode) * hidden_size}, true)),
+	  mode_(mode),
+	  hidden_size_(hidden_size) {
+	reset_parameters();
+}
+
+Node<float_t> RNNBase::forward(const Node<float_t>& inputs) {
+	Node<float_t> rnn_node = mode_ == kernel::RNNMode::LSTM
+							 ? op::lstm(inputs, weight_ih_, weight_hh_, bias_ih_, bias_hh_)
+							 : op::gru(inputs, weight_ih_, weight_hh_, bias_ih_, bias_hh_);
+	Tensor<float_t>* result = new Tensor<float_t>(Shape(rnn_node.get_exp()), true);
+	*result = rnn_node;
+	return Node<float_t>(result);
+}
+
+NamedParamMap RNNBase::parameters(const std::string& name) {
+	return NamedParamMap{
+				{name + "_weight_ih", weight_ih_},
+				{name + "_weight_hh", weight_hh_},
+				{name + "_bias_ih", bias_ih_},
+				{name + "_bias_hh", bias_hh_}};
+}
+
+// Everything uniform in [-1/sqrt(hidden), 1/sqrt(hidden)], like PyTorch.
+void RNNBase::reset_parameters(void) {
+	float_t bound = 1 / std::sqrt(float_t(hidden_size_));
+	nn::init::uniform_init(parameters("rnn"), -bound, bound);
+}
+
+}  // namespace nn
+}  // namespace el
@@ -0,0 +1,48 @@
+#ifndef NN_RNN_H_
+#define NN_RNN_H_
+
+#include "nn.h"
+
+namespace el {
+namespace nn {
+
+// A recurrent layer over a whole sequence, see op::lstm and op::gru. forward takes (seq, batch,
+// input_size) and gives the hidden state of every step, (seq, batch, hidden_size), starting from zero
+// states. The weights are (gates * hidden_size, input_size) and (gates * hidden_size, hidden_size),
+// with the gates stacked in the order of PyTorch, so its weights can be copied as they are.
+class RNNBase {
+public:
+	Node<float_t> weight_ih_;
+	Node<float_t> weight_hh_;
+	Node<float_t> bias_ih_;
+	Node<float_t> bias_hh_;
+
+	Node<float_t> forward(const Node<float_t>& inputs);
+	NamedParamMap parameters(const std::string& name);
+	void reset_parameters(void);
+	index_t hidden_size(void) const {return hidden_size_;}
+
+protected:
+	RNNBase(kernel::RNNMode mode, index_t input_size, index_t hidden_size);
+
+private:
+	kernel::RNNMode mode_;
+	index_t hidden_size_;
+};
+
+// Gates i, f, g, o.
+class LSTM: public RNNBase {
+public:
+	LSTM(index_t input_size, index_t hidden_size): RNNBase(kernel::RNNMode::LSTM, input_size, hidden_size) {}
+};
+
+// Gates r, z, n.
+class GRU: public RNNBase {
+public:
+	GRU(index_t input_size, index_t hidden_size): RNNBase(kernel::RNNMode::GRU, input_size, hidden_size) {}
+};
+
+}  // namespace nn
+}  // namespace el
+
+#endif
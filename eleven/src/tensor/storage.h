@@ -1,30 +1,53 @@
 #ifndef TENSOR_STORAGE_H_
 #define TENSOR_STORAGE_H_
 
+#include <cstddef>
 #include <cstring>
+#include <memory>
+#include <utility>
 #include <iostream>
 #include "../utils/base.h"
 
 namespace el {
 
+// Values of tensors, shared by all the views of them. It owns its buffer, or borrows one from
+// somewhere else, like a mapped file or a caller's array, without copying it. Then keep_alive is held
+// as long as any view of the storage is, and a deleter can be given to it, which runs after the last
+// one goes away. The version counter is reached by its own pointer, not found in front of the values,
+// so borrowed memory needs no room for it. Two storages borrowing the same buffer don't share one.
+// A buffer borrowed as const is read-only: the mutable accessors and version_forward() throw
+// TensorReadOnly, since nothing can be written to it, and its version never moves.
 template<typename Dtype>
 class Storage {
-    std::shared_ptr<char> bptr_;  // base pointer
+    std::shared_ptr<const void> owner_;  // the buffer, or the handle keeping a borrowed one alive
+    std::shared_ptr<index_t> version_;
+    Dtype* bptr_;  // base pointer
     Dtype* dptr_;  // data pointer
-    void init_version(void) {*reinterpret_cast<index_t*>(bptr_.get()) = 0;}
+    bool read_only_;
+
+    // An owned buffer keeps its version in a header of the same allocation, so it's still one
+    // allocation. The header keeps the values aligned as new would.
+    static constexpr size_t header_size(void) {
+        return alignof(std::max_align_t) > sizeof(index_t) ? alignof(std::max_align_t) : sizeof(index_t);
+    }
+    static std::shared_ptr<const void> allocate(index_t dsize) {
+        return std::shared_ptr<const void>(new char[header_size() + dsize * sizeof(Dtype)](),
+                                           std::default_delete<char[]>());
+    }
+    char* block(void) const {return const_cast<char*>(static_cast<const char*>(owner_.get()));}
+    void check_writable(void) const {
+        CHECK_TRUE(!read_only_, TensorReadOnly, "The storage borrows read-only memory, it can't be written to");
+    }
 public:
     // constructor
     explicit Storage(index_t dsize)
-        : bptr_(new char[dsize * sizeof(Dtype) + sizeof(index_t)](),
-                std::default_delete<char[]>()), 
-          dptr_(reinterpret_cast<Dtype*>(bptr_.get() + sizeof(index_t))) {
-        init_version();
-    }
+        : owner_(allocate(dsize)),
+          version_(owner_, reinterpret_cast<index_t*>(block())),
+          bptr_(reinterpret_cast<Dtype*>(block() + header_size())), dptr_(bptr_), read_only_(false) {}
+    // A view of the same memory, which shares its version.
     Storage(const Storage& other, index_t offset)
-        : bptr_(other.bptr_),
-          dptr_(other.dptr_ + offset){
-        init_version();
-    }
+        : owner_(other.owner_), version_(other.version_), bptr_(other.bptr_),
+          dptr_(other.dptr_ + offset), read_only_(other.read_only_) {}
     explicit Storage(const Storage& other) = default;
     Storage(const Dtype* data, index_t dsize): Storage(dsize) {
         memcpy(dptr_, data, dsize*sizeof(Dtype));
@@ -33,12 +56,24 @@ public:
         for(index_t i = 0; i < dsize; i++)
             dptr_[i] = value;
     }
+    // Borrow data without copying. It must stay valid while keep_alive is held, or, with a null
+    // keep_alive, for as long as the storage is used at all.
+    Storage(Dtype* data, std::shared_ptr<const void> keep_alive)
+        : owner_(std::move(keep_alive)), version_(std::make_shared<index_t>(0)),
+          bptr_(data), dptr_(data), read_only_(false) {}
+    // The same for memory which mustn't be written to, the storage is read-only.
+    Storage(const Dtype* data, std::shared_ptr<const void> keep_alive)
+        : owner_(std::move(keep_alive)), version_(std::make_shared<index_t>(0)),
+          bptr_(const_cast<Dtype*>(data)), dptr_(bptr_), read_only_(true) {}
     // method
     const Dtype& operator[](index_t i) const {return dptr_[i];}
-    Dtype& operator[](index_t i) {return dptr_[i];}
-    index_t offset(void) const {return dptr_ - (Dtype*)(bptr_.get()) + sizeof(index_t);}
-    index_t version(void) const {return *reinterpret_cast<index_t*>(bptr_.get());}
-    void version_forward(void) const {*reinterpret_cast<index_t*>(bptr_.get()) += 1;}
+    Dtype& operator[](index_t i) {check_writable(); return dptr_[i];}
+    const Dtype* data(void) const {return dptr_;}
+    Dtype* data(void) {check_writable(); return dptr_;}
+    index_t offset(void) const {return dptr_ - bptr_;}
+    index_t version(void) const {return *version_;}
+    void version_forward(void) const {check_writable(); *version_ += 1;}
+    bool read_only(void) const {return read_only_;}
     // ban
     Storage(void) = delete;
     Storage& operator=(const Storage& other) = delete;
@@ -3,10 +3,13 @@
 
 #include <iostream>
 #include <initializer_list>
+#include <vector>
 #include "storage.h"
 #include "shape.h"
 #include "../expression/expression.h"
 #include "../expression/node.h"
+#include "../expression/dense.h"
+#include "../expression/kernels/reduce.h"
 #include "tensor.h"
 
 namespace el {
@@ -18,6 +21,9 @@ public:
     Tensor(const Storage<Dtype>& storage, const Shape& shape, bool requires_grad=false);
     Tensor(const Dtype* data, const Shape& shape, bool requires_grad=false);
     explicit Tensor(const Shape& shape, bool requires_grad=false);
+    // A 4D tensor whose values are stored in the given layout, see utils/layout.h. It's indexed in NCHW
+    // order like any other tensor, but can't be sliced, transposed or viewed, and data() is nullptr.
+    Tensor(const Shape& shape, Layout layout, bool requires_grad=false);
     Tensor(const Tensor& other) = default;
 
 
@@ -27,7 +33,13 @@ public:
     const Shape& size(void) const;
     const IndexArray& stride(void) const;
     index_t version(void) const;
+    // Mark the values as changed, after writing them through data(), so caches and graphs holding this
+    // tensor can tell.
+    void version_forward(void) const;
     bool requires_grad(void) const;
+    Layout layout(void) const;
+    // Number of values in storage for the layout, padding included.
+    index_t layout_dsize(void) const;
 
     // operator[] can modify data of a tensor, and by the same time will increment version of the tensor.
     // Like in-place operation to a tensor in Pytorch, this operation may damage the computation graph,
@@ -69,6 +81,13 @@ public:
     Dtype& eval(index_t* ids);
     Dtype eval(index_t idx) const;
     Dtype& eval(index_t idx);
+    // Raw pointer to the data, or nullptr if the tensor isn't contiguous. Writing through it bypasses
+    // version checking as well.
+    const Dtype* data(void) const;
+    Dtype* data(void);
+    // Raw pointer to the values in the tensor's own layout, which is data() for NCHW.
+    const Dtype* layout_data(void) const;
+    Dtype* layout_data(void);
 
     template<typename Dtype1> friend class Node;
     template<typename Dtype1> friend std::ostream& operator<<(std::ostream& out, const Tensor<Dtype1>& t);
@@ -76,6 +95,7 @@ private:
     Storage<Dtype> storage_;
     Shape shape_;
     IndexArray stride_;
+    Layout layout_;
 
     // auto gradient
     struct AutoGradMeta {
@@ -86,15 +106,20 @@ private:
                      const Exp<Dtype>* next_exp, bool from_view);
         AutoGradMeta(const Storage<Dtype>& storage, const Shape& shape,
                      const Exp<Dtype>* next_exp, bool from_view);
-        AutoGradMeta(const Shape& shape);
+        AutoGradMeta(const Shape& shape, Layout layout);
     };
     std::shared_ptr<AutoGradMeta> ag_meta_;
     bool requires_grad_;
 
     // constructor
     Tensor(const Storage<Dtype>& storage, const Shape& shape, const IndexArray& stride, bool requires_grad=false);
+    Tensor(const Storage<Dtype>& storage, const Shape& shape, Layout layout, bool requires_grad=false);
     // methods
+    static index_t storage_dsize(const Shape& shape, Layout layout);
+    index_t layout_offset(const index_t* ids) const;
+    bool same_shape(const Exp<Dtype>& src) const;
     void set_self(const Exp<Dtype>& src);
+    bool add_reduced(const Exp<Dtype>& src);
 };
 
 // ******************** constructors and methods of AutoGradMeta ********************
@@ -113,8 +138,9 @@ Tensor<Dtype>::AutoGradMeta::AutoGradMeta(const Storage<Dtype>& storage, const S
 }
 
 template<typename Dtype>
-Tensor<Dtype>::AutoGradMeta::AutoGradMeta(const Shape& shape)
-    : grad_(Storage<Dtype>(shape.dsize(), 0), shape, false), next_exp_(), from_view_(false) {
+Tensor<Dtype>::AutoGradMeta::AutoGradMeta(const Shape& shape, Layout layout)
+    : grad_(Storage<Dtype>(Tensor<Dtype>::storage_dsize(shape, layout), 0), shape, layout, false),
+      next_exp_(), from_view_(false) {
     ConstExptr<Dtype>::make_uncontrol(grad_);
 }
 
@@ -122,20 +148,20 @@ Tensor<Dtype>::AutoGradMeta::AutoGradMeta(const Shape& shape)
 // ******************** constructors of Tensor ********************
 template<typename Dtype>
 Tensor<Dtype>::Tensor(const Storage<Dtype>& storage, const Shape& shape, const IndexArray& stride, bool requires_grad)
-    : storage_(storage), shape_(shape), stride_(stride), requires_grad_(requires_grad) {
+    : storage_(storage), shape_(shape), stride_(stride), layout_(Layout::NCHW), requires_grad_(requires_grad) {
     if(requires_grad_) 
-        ag_meta_.reset(new AutoGradMeta(shape_));
+        ag_meta_.reset(new AutoGradMeta(shape_, layout_));
 }
 
 template<typename Dtype>
 Tensor<Dtype>::Tensor(const Storage<Dtype>& storage, const Shape& shape, bool requires_grad)
-    : storage_(storage), shape_(shape), stride_(shape_.dim()), requires_grad_(requires_grad) {
+    : storage_(storage), shape_(shape), stride_(shape_.dim()), layout_(Layout::NCHW), requires_grad_(requires_grad) {
     for(index_t i = 0; i < shape_.dim(); i++) {
         if(shape_[i] == 1) stride_[i] = 0; // for broadcasting
         else stride_[i] = shape_.subsize(i + 1);
     }
     if(requires_grad_)
-        ag_meta_.reset(new AutoGradMeta(shape_));
+        ag_meta_.reset(new AutoGradMeta(shape_, layout_));
 }
 
 template<typename Dtype>
@@ -146,6 +172,29 @@ template<typename Dtype>
 Tensor<Dtype>::Tensor(const Shape& shape, bool requires_grad)
     : Tensor<Dtype>(Storage<Dtype>(shape.dsize()), shape, requires_grad) {}
 
+// Strides are kept as NCHW ones, but aren't used by a tensor in other layouts.
+template<typename Dtype>
+Tensor<Dtype>::Tensor(const Storage<Dtype>& storage, const Shape& shape, Layout layout, bool requires_grad)
+    : Tensor<Dtype>(storage, shape, false) {
+    layout_ = layout;
+    requires_grad_ = requires_grad;
+    if(requires_grad_)
+        ag_meta_.reset(new AutoGradMeta(shape_, layout_));
+}
+
+template<typename Dtype>
+Tensor<Dtype>::Tensor(const Shape& shape, Layout layout, bool requires_grad)
+    : Tensor<Dtype>(Storage<Dtype>(storage_dsize(shape, layout)), shape, layout, requires_grad) {}
+
+template<typename Dtype>
+index_t Tensor<Dtype>::storage_dsize(const Shape& shape, Layout layout) {
+    if(layout == Layout::NCHW)
+        return shape.dsize();
+    CHECK_EQUAL(shape.dim(), 4, DimNotMatch,
+        "Only 4D tensors can be stored in %s layout, but got a %dD one", layout_name(layout), shape.dim());
+    return el::layout_dsize(layout, shape[0], shape[1], shape[2] * shape[3]);
+}
+
 
 // ******************** Methods of Tensor ********************
 template<typename Dtype>
@@ -170,9 +219,31 @@ inline const IndexArray& Tensor<Dtype>::stride(void) const {return stride_;}
 template<typename Dtype>
 inline index_t Tensor<Dtype>::version(void) const {return storage_.version();}
 
+template<typename Dtype>
+inline void Tensor<Dtype>::version_forward(void) const {storage_.version_forward();}
+
 template<typename Dtype>
 inline bool Tensor<Dtype>::requires_grad(void) const {return requires_grad_;}
 
+template<typename Dtype>
+inline Layout Tensor<Dtype>::layout(void) const {return layout_;}
+
+template<typename Dtype>
+inline index_t Tensor<Dtype>::layout_dsize(void) const {return storage_dsize(shape_, layout_);}
+
+// Offset of NCHW indices in a tensor stored in (batch, channel blocks, height, width, block) order.
+// Indices on axes of size 1 are ignored, for broadcasting.
+template<typename Dtype>
+inline index_t Tensor<Dtype>::layout_offset(const index_t* ids) const {
+    index_t n = shape_[0] == 1 ? 0 : ids[0];
+    index_t c = shape_[1] == 1 ? 0 : ids[1];
+    index_t h = shape_[2] == 1 ? 0 : ids[2];
+    index_t w = shape_[3] == 1 ? 0 : ids[3];
+    index_t block = layout_block(layout_, shape_[1]);
+    index_t blocks = layout_blocks(layout_, shape_[1]);
+    return (((n * blocks + c / block) * shape_[2] + h) * shape_[3] + w) * block + c % block;
+}
+
 template<typename Dtype>
 inline Dtype Tensor<Dtype>::item(void) const {
     CHECK_TRUE(shape_.dim() == 1 && shape_[0] == 1, DsizeNotMatch,
@@ -188,11 +259,15 @@ Dtype& Tensor<Dtype>::operator[](std::initializer_list<index_t> ids) {
         "%dD tensor got %dD indice", dim(), ids.size());
 
     index_t offset = 0, i = 0;
+    index_t loc[4];
     for(auto idx: ids) {
         CHECK_BETWEEN(idx, 0, shape_[i], IndexOutOfRange,
             "Tensor has size %d on %d dimension, but got %d index", shape_[i], i, idx);
+        if(layout_ != Layout::NCHW) loc[i] = idx;
         offset += idx * stride_[i++];
     }
+    if(layout_ != Layout::NCHW)
+        offset = layout_offset(loc);
     storage_.version_forward();
     return storage_[offset];
 }
@@ -203,11 +278,15 @@ const Dtype& Tensor<Dtype>::operator[](std::initializer_list<index_t> ids) const
         "%dD tensor got %dD indice", dim(), ids.size());
 
     index_t offset = 0, i = 0;
+    index_t loc[4];
     for(auto idx: ids) {
         CHECK_BETWEEN(idx, 0, shape_[i], IndexOutOfRange,
             "Tensor has size %d on %d dimension, but got %d index", shape_[i], i, idx);
+        if(layout_ != Layout::NCHW) loc[i] = idx;
         offset += idx * stride_[i++];
     }
+    if(layout_ != Layout::NCHW)
+        offset = layout_offset(loc);
     return storage_[offset]; 
 }
 
@@ -223,6 +302,8 @@ const Dtype& Tensor<Dtype>::operator[](std::initializer_list<index_t> ids) const
 // 3. view tensors' backward() will call origin tensors' backward(), but doesn't pass any grad.
 template<typename Dtype>
 Tensor<Dtype> Tensor<Dtype>::slice(index_t idx, index_t dim) const {
+    CHECK_TRUE(layout_ == Layout::NCHW, NotImplementError,
+        "A tensor in %s layout can't be %s, convert it to NCHW first", layout_name(layout_), "sliced");
     CHECK_BETWEEN(dim, 0, shape_.dim(), IndexOutOfRange,
         "%dD tensor got index on th%d dimension", shape_.dim(), idx);
     CHECK_BETWEEN(idx, 0, shape_[dim], IndexOutOfRange,
@@ -250,6 +331,8 @@ Tensor<Dtype> Tensor<Dtype>::slice(index_t idx, index_t dim) const {
 
 template<typename Dtype>
 inline Tensor<Dtype> Tensor<Dtype>::slice(index_t start_idx, index_t end_idx, index_t dim) const {
+    CHECK_TRUE(layout_ == Layout::NCHW, NotImplementError,
+        "A tensor in %s layout can't be %s, convert it to NCHW first", layout_name(layout_), "sliced");
     CHECK_BETWEEN(dim, 0, shape_.dim(), IndexOutOfRange,
         "%dD tensor got index on th%d dimension", shape_.dim(), dim);
     CHECK_BETWEEN(start_idx, 0, shape_[dim], IndexOutOfRange,
@@ -273,6 +356,8 @@ inline Tensor<Dtype> Tensor<Dtype>::slice(index_t start_idx, index_t end_idx, in
 
 template<typename Dtype>
 inline Tensor<Dtype> Tensor<Dtype>::transpose(index_t dim1, index_t dim2) const {
+    CHECK_TRUE(layout_ == Layout::NCHW, NotImplementError,
+        "A tensor in %s layout can't be %s, convert it to NCHW first", layout_name(layout_), "transposed");
     CHECK_BETWEEN(dim1, 0, shape_.dim(), IndexOutOfRange,
         "%dD tensor got %d dimension index", shape_.dim(), dim1);
     CHECK_BETWEEN(dim2, 0, shape_.dim(), IndexOutOfRange,
@@ -340,6 +425,8 @@ inline Tensor<Dtype> Tensor<Dtype>::unsqueeze(index_t dim) const {
 
 template<typename Dtype>
 Tensor<Dtype>* Tensor<Dtype>::slice_(index_t idx, index_t dim) const {
+    CHECK_TRUE(layout_ == Layout::NCHW, NotImplementError,
+        "A tensor in %s layout can't be %s, convert it to NCHW first", layout_name(layout_), "sliced");
     CHECK_BETWEEN(dim, 0, shape_.dim(), IndexOutOfRange,
         "%dD tensor got index on th%d dimension", shape_.dim(), idx);
     CHECK_BETWEEN(idx, 0, shape_[dim], IndexOutOfRange,
@@ -367,6 +454,8 @@ Tensor<Dtype>* Tensor<Dtype>::slice_(index_t idx, index_t dim) const {
 
 template<typename Dtype>
 inline Tensor<Dtype>* Tensor<Dtype>::slice_(index_t start_idx, index_t end_idx, index_t dim) const {
+    CHECK_TRUE(layout_ == Layout::NCHW, NotImplementError,
+        "A tensor in %s layout can't be %s, convert it to NCHW first", layout_name(layout_), "sliced");
     CHECK_BETWEEN(dim, 0, shape_.dim(), IndexOutOfRange,
         "%dD tensor got index on th%d dimension", shape_.dim(), dim);
     CHECK_BETWEEN(start_idx, 0, shape_[dim], IndexOutOfRange,
@@ -390,6 +479,8 @@ inline Tensor<Dtype>* Tensor<Dtype>::slice_(index_t start_idx, index_t end_idx,
 
 template<typename Dtype>
 inline Tensor<Dtype>* Tensor<Dtype>::transpose_(index_t dim1, index_t dim2) const {
+    CHECK_TRUE(layout_ == Layout::NCHW, NotImplementError,
+        "A tensor in %s layout can't be %s, convert it to NCHW first", layout_name(layout_), "transposed");
     CHECK_BETWEEN(dim1, 0, shape_.dim(), IndexOutOfRange,
         "%dD tensor got %d dimension index", shape_.dim(), dim1);
     CHECK_BETWEEN(dim2, 0, shape_.dim(), IndexOutOfRange,
@@ -457,6 +548,8 @@ inline Tensor<Dtype>* Tensor<Dtype>::unsqueeze_(index_t dim) const {
 
 template<typename Dtype>
 bool Tensor<Dtype>::is_contiguous(void) const {
+    if(layout_ != Layout::NCHW)
+        return false;
     for(index_t i = 0; i < shape_.dim(); i++)
         if(stride_[i] != 0 && stride_[i] != shape_.subsize(i+1))
             return false;
@@ -465,6 +558,8 @@ bool Tensor<Dtype>::is_contiguous(void) const {
 
 template<typename Dtype>
 Dtype Tensor<Dtype>::eval(index_t* ids) const {
+    if(layout_ != Layout::NCHW)
+        return storage_[layout_offset(ids)];
     int offset = 0;
     for(index_t i = 0; i < shape_.dim(); i++)
         offset += stride_[i] * ids[i];
@@ -475,6 +570,8 @@ Dtype Tensor<Dtype>::eval(index_t* ids) const {
 // It may cause wrong gradient. Using it cautiously.
 template<typename Dtype>
 Dtype& Tensor<Dtype>::eval(index_t* ids) {
+    if(layout_ != Layout::NCHW)
+        return storage_[layout_offset(ids)];
     int offset = 0;
     for(index_t i = 0; i < shape_.dim(); i++)
         offset += stride_[i] * ids[i];
@@ -487,6 +584,32 @@ Dtype Tensor<Dtype>::eval(index_t idx) const {return storage_[idx];}
 template<typename Dtype>
 Dtype& Tensor<Dtype>::eval(index_t idx) {return storage_[idx];}
 
+template<typename Dtype>
+inline const Dtype* Tensor<Dtype>::data(void) const {return is_contiguous() ? storage_.data() : nullptr;}
+
+template<typename Dtype>
+inline Dtype* Tensor<Dtype>::data(void) {return is_contiguous() ? storage_.data() : nullptr;}
+
+template<typename Dtype>
+inline const Dtype* Tensor<Dtype>::layout_data(void) const {
+    return layout_ == Layout::NCHW ? data() : storage_.data();
+}
+
+template<typename Dtype>
+inline Dtype* Tensor<Dtype>::layout_data(void) {
+    return layout_ == Layout::NCHW ? data() : storage_.data();
+}
+
+template<typename Dtype>
+bool Tensor<Dtype>::same_shape(const Exp<Dtype>& src) const {
+    if(src.dim() != shape_.dim())
+        return false;
+    for(index_t i = 0; i < shape_.dim(); i++)
+        if(shape_[i] != src.size(i))
+            return false;
+    return true;
+}
+
 // This function was written in a recursive form originally, then was converted to a while loop form.
 // The while loop will iterate all possible indice for this tensor, so we can calculate and set each
 // value in this tensor. For element-wise operation, it's fine to use a loop like 
@@ -497,6 +620,19 @@ Dtype& Tensor<Dtype>::eval(index_t idx) {return storage_[idx];}
 template<typename Dtype>
 void Tensor<Dtype>::set_self(const Exp<Dtype>& src) {
     index_t num_dim = shape_.dim();
+    // Expressions evaluated eagerly already hold their values in a buffer, just copy it when the
+    // shapes are the same and nothing needs broadcasting. Buffers in another layout are converted.
+    const Dtype* src_data = src.layout_data();
+    Dtype* dst_data = layout_data();
+    if(src_data != nullptr && dst_data != nullptr && same_shape(src)) {
+        if(src.layout() != layout_)
+            kernel::convert_layout(src.layout(), layout_, shape_[0], shape_[1], shape_[2] * shape_[3],
+                                   src_data, dst_data);
+        else if(src_data != dst_data)
+            memcpy(dst_data, src_data, layout_dsize() * sizeof(Dtype));
+        storage_.version_forward();
+        return;
+    }
     index_t* loc = new index_t[num_dim];
     index_t idx = 0;
     IndexArray shape(num_dim);
@@ -552,9 +688,60 @@ inline Tensor<Dtype>& Tensor<Dtype>::operator=(const Node<Dtype>& src) {
     return *this;
 }
 
+// Fast path of operator+= for a contiguous tensor, when src isn't broadcast itself. Axes where this
+// tensor has size 1 and src doesn't, like a (1, out, 1) bias gradient against a (batch, out, 1) src,
+// are summed by the blocked kernel::reduce_groups first, so each element here is added to only once.
+// With no such axes, it's an element-wise add. Returns false if the general loop is needed.
+template<typename Dtype>
+bool Tensor<Dtype>::add_reduced(const Exp<Dtype>& src) {
+    index_t num_dim = shape_.dim();
+    if(layout_ != Layout::NCHW) {
+        // Gradients of a tensor in another layout come in the same layout, then storages are just added.
+        const Dtype* src_data = src.layout_data();
+        Dtype* dst_data = storage_.data();
+        if(src.layout() != layout_ || src_data == nullptr || !same_shape(src))
+            return false;
+        parallel_for(0, layout_dsize(), 4096, [&](index_t begin, index_t end) {
+            for(index_t i = begin; i < end; i++)
+                dst_data[i] += src_data[i];
+        });
+        return true;
+    }
+    Dtype* dst_data = data();
+    if(dst_data == nullptr || src.dim() != num_dim)
+        return false;
+    std::vector<index_t> src_shape(num_dim);
+    std::vector<bool> reduce_axes(num_dim);
+    for(index_t i = 0; i < num_dim; i++) {
+        src_shape[i] = src.size(i);
+        if(src_shape[i] < shape_[i])
+            return false;
+        reduce_axes[i] = src_shape[i] != shape_[i];
+    }
+
+    Dense<Dtype> dense(src);
+    const Dtype* src_data = dense.data();
+    kernel::ReduceShape reduce_shape(src_shape, reduce_axes);
+    std::vector<Dtype> reduced;
+    if(reduce_shape.reduce_count() > 1) {
+        reduced.resize(shape_.dsize());
+        kernel::reduce_groups<kernel::SumOp>(reduce_shape, src_data, reduced.data());
+        src_data = reduced.data();
+    }
+    parallel_for(0, shape_.dsize(), 4096, [&](index_t begin, index_t end) {
+        for(index_t i = begin; i < end; i++)
+            dst_data[i] += src_data[i];
+    });
+    return true;
+}
+
 template<typename Dtype>
 inline Tensor<Dtype>& Tensor<Dtype>::operator+=(const Exp<Dtype>& src) {
     CHECK_BROADCAST(*this, src);
+    if(add_reduced(src)) {
+        storage_.version_forward();
+        return *this;
+    }
     index_t num_dim = shape_.dim();
     index_t* loc = new index_t[num_dim];
     index_t idx = 0;
@@ -576,6 +763,7 @@ inline Tensor<Dtype>& Tensor<Dtype>::operator+=(const Exp<Dtype>& src) {
     }
     delete [] loc;
     storage_.version_forward();
+    return *this;
 }
 
 template<typename Dtype>
@@ -606,8 +794,10 @@ inline Tensor<Dtype>& Tensor<Dtype>::grad(void) const {
 
 template<typename Dtype>
 std::ostream& operator<<(std::ostream& out, const Tensor<Dtype>& src) {
-    Tensor<Dtype> t(src);
+    Tensor<Dtype> t(src.layout_ == Layout::NCHW ? src : Tensor<Dtype>(src.shape_));
     t.requires_grad_ = false;
+    if(src.layout_ != Layout::NCHW)
+        t.set_self(src);
 
     std::ios_base::fmtflags flags = out.flags();
     out.setf(std::ios::fixed);
@@ -22,40 +22,15 @@ string test_labels_path = "D:\\somethingElse\\other_projects\\datasets\\MNIST\\r
 index_t train_one_epoch(models::TripleLinear& net,
 						nn::CrossEntropy& criterion,
 						nn::optim::SGD& optimizer,
-						const shared_ptr<el::float_t>& images_ptr,
-						const shared_ptr<el::int_t>& labels_ptr,
-						index_t num_images,
-						index_t batch_size,
-						index_t num_pixels) {
-	auto data_indice_ptr = data::shuffle_indice(num_images);
-
-	index_t batch_pixel_size = batch_size * num_pixels;
-	shared_ptr<el::float_t> batch_images(new el::float_t[batch_pixel_size](),
-	    								 std::default_delete<el::float_t[]>());
-	shared_ptr<el::int_t> batch_labels(new el::int_t[batch_size](),
-									   std::default_delete<el::int_t[]>());
-
+						data::DataLoader& loader) {
 	index_t iter = 0;
-	index_t num_iters = (num_images + batch_size - 1) / batch_size;
+	index_t num_iters = loader.num_batches();
 	for(; iter < num_iters; iter++) {
-		index_t this_batch_size = batch_size;
-		if(iter == num_iters - 1)
-			this_batch_size = num_images - batch_size*iter;
-
-		data::dup_images(images_ptr.get(), batch_images.get(),
-					     data_indice_ptr.get() + iter*batch_size, 
-					     this_batch_size, num_pixels);
-		data::dup_labels(labels_ptr.get(), batch_labels.get(), 
-					     data_indice_ptr.get() + iter*batch_size, 
-					     this_batch_size);
-
-		Tensor<el::float_t> batch_images_tensor(batch_images.get(), 
-			                                    {this_batch_size, num_pixels});
-		Tensor<el::int_t> batch_labels_tensor(batch_labels.get(), 
-			                                  {this_batch_size});
+		data::Batch batch = loader.next();
+		Tensor<el::float_t> batch_images_tensor = batch.data.view({batch.data.size(0), 28 * 28});
 
 		auto output = net.forward(op::node(batch_images_tensor));
-		auto loss = criterion.forward(output, op::node(batch_labels_tensor));
+		auto loss = criterion.forward(output, op::node(batch.target));
 		
 		optimizer.zero_grad();
 		loss.backward();
@@ -70,61 +45,28 @@ index_t train_one_epoch(models::TripleLinear& net,
 
 }
 
-index_t validate(models::TripleLinear& net,
-				 const shared_ptr<el::float_t>& images_ptr,
-				 const shared_ptr<el::int_t>& labels_ptr,
-				 index_t num_images,
-				 index_t batch_size,
-				 index_t num_pixels) {
-	auto data_indice_ptr = data::shuffle_indice(num_images);
-
-	index_t batch_pixel_size = batch_size * num_pixels;
-	shared_ptr<el::float_t> batch_images(new el::float_t[batch_pixel_size](),
-	    								 std::default_delete<el::float_t[]>());
-	shared_ptr<el::int_t> batch_labels(new el::int_t[batch_size](),
-									   std::default_delete<el::int_t[]>());
-
+index_t validate(models::TripleLinear& net, data::DataLoader& loader) {
 	index_t iter = 0;
-	index_t num_iters = (num_images + batch_size - 1) / batch_size;
-	index_t acc = 0;
+	index_t num_iters = loader.num_batches();
+	nn::metrics::ClassificationMetrics metrics(10);
 	for(; iter < num_iters; iter++) {
-		index_t this_batch_size = batch_size;
-		if(iter == num_iters - 1)
-			this_batch_size = num_images - batch_size*iter;
-
-		data::dup_images(images_ptr.get(), batch_images.get(),
-					     data_indice_ptr.get() + iter*batch_size, 
-					     this_batch_size, num_pixels);
-		data::dup_labels(labels_ptr.get(), batch_labels.get(), 
-					     data_indice_ptr.get() + iter*batch_size, 
-					     this_batch_size);
-
-		Tensor<el::float_t> batch_images_tensor(batch_images.get(), 
-			                                    {this_batch_size, num_pixels});
+		data::Batch batch = loader.next();
+		Tensor<el::float_t> batch_images_tensor = batch.data.view({batch.data.size(0), 28 * 28});
 		auto output = net.forward(op::node(batch_images_tensor));
-		
-		Tensor<double> predict(Shape{output.size(0)});
-		predict = op::argmax(output, 1);
-		for(index_t i = 0; i < this_batch_size; i++)
-			if(predict[{i}] == batch_labels.get()[i])
-				acc++;
+		metrics.update(output, op::node(batch.target));
 	}
-	cout << "acc of test images: " << acc << " / " << num_images;
-	cout << " = " << (double)acc / (double)num_images << endl;
+	cout << "acc of test images: " << metrics.top1_correct() << " / " << loader.num_samples();
+	cout << " = " << metrics.top1() << " | top-5: " << metrics.topk() << endl;
 	return iter;
 
 }
 
 int main() {
-	cout << "read train data ..." << endl;
-	auto train_images_ptr = data::read_mnist_images(train_images_path);
-	auto train_labels_ptr = data::read_mnist_labels(train_labels_path);
-	cout << "read test data ..." << endl;
-	auto test_images_ptr = data::read_mnist_images(test_images_path);
-	auto test_labels_ptr = data::read_mnist_labels(test_labels_path);
-	index_t num_train_images = 60000, num_test_images = 10000;
-	index_t batch_size = 64;
-	index_t num_pixels = 28 * 28;
+	// The files are mapped, and batches are built from them in the background while training.
+	data::DataLoader train_loader(data::IdxFile(train_images_path), data::IdxFile(train_labels_path),
+								  64, /*shuffle=*/true);
+	data::DataLoader test_loader(data::IdxFile(test_images_path), data::IdxFile(test_labels_path),
+								 64, /*shuffle=*/false);
 
 	models::TripleLinear net;
 	nn::CrossEntropy criterion;
@@ -132,12 +74,8 @@ int main() {
 
 	for(index_t epoch = 0; epoch < 1; epoch ++) {
 		cout << "***** epoch " << epoch << " train *****" << endl;
-		train_one_epoch(net, criterion, optimizer,
-						train_images_ptr, train_labels_ptr,
-						num_train_images, batch_size, 
-						num_pixels);
-		validate(net, test_images_ptr, test_labels_ptr,
-				 num_test_images, batch_size, num_pixels);
+		train_one_epoch(net, criterion, optimizer, train_loader);
+		validate(net, test_loader);
 		optimizer.lr_ *= 0.1;
 	}
 	return 0;
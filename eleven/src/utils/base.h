@@ -1,6 +1,7 @@
 #ifndef UTILS_BASE_H_
 #define UTILS_BASE_H_
 
+#include <climits>
 #include "exception.h"
 #include "fixed_size_array.h"
 
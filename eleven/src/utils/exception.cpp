@@ -26,6 +26,9 @@ DimNotMatch::DimNotMatch(const char* file, const char* func, unsigned int line)
 TensorNotContiguous::TensorNotContiguous(const char* file, const char* func, unsigned int line)
 	: Error("TensorNotContiguous", file, func, line) {}
 
+TensorReadOnly::TensorReadOnly(const char* file, const char* func, unsigned int line)
+	: Error("TensorReadOnly", file, func, line) {}
+
 DsizeNotMatch::DsizeNotMatch(const char* file, const char* func, unsigned int line)
 	: Error("DsizeNotMatch", file, func, line) {}
 
@@ -41,5 +44,8 @@ BackwardFailure::BackwardFailure(const char* file, const char* func, unsigned in
 TensorNoGrad::TensorNoGrad(const char* file, const char* func, unsigned int line) 
     : Error("TensorNoGrad", file, func, line) {};
 
+FileReadFailure::FileReadFailure(const char* file, const char* func, unsigned int line)
+    : Error("FileReadFailure", file, func, line) {}
+
 }  // namespace err
 }  // namespace el
\ No newline at end of file
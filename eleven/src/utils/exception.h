@@ -28,6 +28,8 @@ class DimNotMatch: public Error {
     public:	DimNotMatch(const char* file, const char* func, unsigned int line);};
 class TensorNotContiguous: public Error {
     public:	TensorNotContiguous(const char* file, const char* func, unsigned int line);};
+class TensorReadOnly: public Error {
+    public:	TensorReadOnly(const char* file, const char* func, unsigned int line);};
 class DsizeNotMatch: public Error {
     public: DsizeNotMatch(const char* file, const char* func, unsigned int line);};
 class OperandSizeNotMatch: public Error {
@@ -38,6 +40,8 @@ class BackwardFailure: public Error {
     public: BackwardFailure(const char* file, const char* func, unsigned int line);};
 class TensorNoGrad: public Error {
     public: TensorNoGrad(const char* file, const char* func, unsigned int line);};
+class FileReadFailure: public Error {
+    public: FileReadFailure(const char* file, const char* func, unsigned int line);};
 
 }  // namespace err
 
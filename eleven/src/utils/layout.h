@@ -0,0 +1,50 @@
+#ifndef UTILS_LAYOUT_H_
+#define UTILS_LAYOUT_H_
+
+#include "base.h"
+
+namespace el {
+
+// Memory layout of a 4D (batch, channels, height, width) tensor. Its shape and indices are always
+// in NCHW order, only the order of values in memory differs:
+//   NCHW:    plane by plane, the default of every tensor.
+//   NHWC:    channels last, all channels of a pixel are adjacent.
+//   NCHW8c:  channels split into blocks of 8, each block stored as NHWC. The last block is padded.
+//   NCHW16c: the same with blocks of 16.
+// All of them are (batch, channel blocks, height, width, block) in memory, with block = 1 for NCHW and
+// block = channels for NHWC, so kernels deal with one form. Channels are innermost in all layouts but
+// NCHW, and kernels vectorize over them.
+enum class Layout {NCHW, NHWC, NCHW8c, NCHW16c};
+
+inline const char* layout_name(Layout layout) {
+	switch(layout) {
+		case Layout::NHWC: return "NHWC";
+		case Layout::NCHW8c: return "NCHW8c";
+		case Layout::NCHW16c: return "NCHW16c";
+		default: return "NCHW";
+	}
+}
+
+// Number of channels stored together.
+inline index_t layout_block(Layout layout, index_t channels) {
+	switch(layout) {
+		case Layout::NHWC: return channels;
+		case Layout::NCHW8c: return 8;
+		case Layout::NCHW16c: return 16;
+		default: return 1;
+	}
+}
+
+inline index_t layout_blocks(Layout layout, index_t channels) {
+	index_t block = layout_block(layout, channels);
+	return (channels + block - 1) / block;
+}
+
+// Number of values in memory, padding included.
+inline index_t layout_dsize(Layout layout, index_t batch, index_t channels, index_t plane) {
+	return batch * layout_blocks(layout, channels) * plane * layout_block(layout, channels);
+}
+
+}  // namespace el
+
+#endif
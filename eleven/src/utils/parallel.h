@@ -0,0 +1,62 @@
+#ifndef UTILS_PARALLEL_H_
+#define UTILS_PARALLEL_H_
+
+#include <algorithm>
+#include "base.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace el {
+
+// Threads are provided by OpenMP when compiling with -fopenmp. Without it, everything below just
+// runs in the calling thread, so the codes still work on any compiler.
+inline index_t& max_num_threads(void) {
+#ifdef _OPENMP
+	static index_t num = omp_get_max_threads();
+#else
+	static index_t num = 1;
+#endif
+	return num;
+}
+
+inline index_t num_threads(void) {return max_num_threads();}
+inline void set_num_threads(index_t num) {max_num_threads() = std::max(num, 1);}
+
+// Number of chunks [begin, end) would be split into. Chunks are never smaller than grain, unless
+// the whole range is, and there are at most num_threads() of them.
+inline index_t num_chunks(index_t begin, index_t end, index_t grain) {
+	if(end <= begin) return 0;
+	index_t num = (end - begin + grain - 1) / std::max(grain, (index_t)1);
+	return std::max((index_t)1, std::min(num_threads(), num));
+}
+
+// Call func(chunk, chunk_begin, chunk_end) for each chunk of [begin, end) in parallel. The partition 
+// only depends on the range and the thread count, so a kernel which keeps one partial result per chunk 
+// and combines them in order gets the same result for a fixed thread count.
+template<typename Func>
+void parallel_chunks(index_t begin, index_t end, index_t grain, const Func& func) {
+	index_t chunks = num_chunks(begin, end, grain);
+	if(chunks == 0) return;
+	if(chunks == 1) {
+		func(0, begin, end);
+		return;
+	}
+	index_t range = end - begin;
+#ifdef _OPENMP
+	#pragma omp parallel for num_threads(chunks) schedule(static, 1)
+#endif
+	for(index_t chunk = 0; chunk < chunks; chunk++)
+		func(chunk, begin + (index_t)((long long)range * chunk / chunks),
+					 begin + (index_t)((long long)range * (chunk + 1) / chunks));
+}
+
+// Call func(chunk_begin, chunk_end) for each chunk of [begin, end) in parallel.
+template<typename Func>
+void parallel_for(index_t begin, index_t end, index_t grain, const Func& func) {
+	parallel_chunks(begin, end, grain, [&func](index_t chunk, index_t b, index_t e) {func(b, e);});
+}
+
+}  // namespace el
+
+#endif